@@ -418,6 +418,9 @@ main(argc, argv)
 			      server_dir_name,
 			      emulator_name);
 
+	if (index(flag_string, 'v'))
+	    file_cache_statistics();
+
 	/*
 	 * Start up the thread
 	 */
@@ -0,0 +1,494 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	dirbench/dirbench.c
+ *
+ *	Times search_directory against the number of entries in the
+ *	directory, with and without the name cache.  search_directory
+ *	and the name cache are copied from file_io.c, without the
+ *	locks; buf_read_file is replaced by a lookup in a directory
+ *	image built in memory, as if every block were in the block
+ *	cache, so the times are the CPU cost of one path component
+ *	of open_file and leave out any disk reads.
+ *
+ *		cc -O -idirafter .. -o dirbench dirbench.c
+ *		dirbench [lookups]
+ *
+ *	For each directory size, "scan" times the old directory scan
+ *	for names that are there, "absent" the scan for names that
+ *	are not, "hit" and "neghit" the cached lookups of the same
+ *	names.  The cached lookups cycle through 64 names, fewer than
+ *	the cache holds, as repeated opens of the same paths do;
+ *	"thrash" cycles through every name in the directory, so that
+ *	once it holds more names than the cache, nearly every lookup
+ *	misses, scans and enters the name.  Every lookup is checked
+ *	against the expected inode number.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define	DEV_BSIZE	512
+
+#include <dir.h>
+#include <queue.h>
+
+typedef int		boolean_t;
+#define	TRUE		((boolean_t) 1)
+#define	FALSE		((boolean_t) 0)
+
+typedef unsigned int	mach_port_t;
+typedef unsigned long	vm_offset_t;
+typedef unsigned long	vm_size_t;
+typedef int		kern_return_t;
+#define	KERN_SUCCESS	0
+
+#define	FS_NO_ENTRY	5001		/* from file_io.h */
+#define	FS_NOT_IN_FILE	5005
+
+#define	bcopy(from, to, len)	memcpy((to), (from), (len))
+
+/*
+ *	Just the fields of struct file that search_directory uses.
+ */
+struct file {
+	mach_port_t	f_dev;		/* port to device */
+	ino_t		f_ino;		/* inode number */
+	vm_size_t	i_size;		/* size of directory */
+	char		*f_data;	/* directory image */
+};
+
+/*
+ *	buf_read_file, for a directory image in memory: the rest
+ *	of the directory block that holds offset.
+ */
+int
+buf_read_file(fp, offset, buf_p, size_p)
+	register struct file	*fp;
+	vm_offset_t		offset;
+	vm_offset_t		*buf_p;		/* out */
+	vm_size_t		*size_p;	/* out */
+{
+	if (offset >= fp->i_size)
+	    return (FS_NOT_IN_FILE);
+
+	*buf_p = (vm_offset_t) (fp->f_data + offset);
+	*size_p = DIRBLKSIZ - (offset % DIRBLKSIZ);
+	return (0);
+}
+
+/*
+ *	From file_io.c.
+ */
+#define	NNCACHE		128		/* entries in the cache */
+#define	NCHHSZ		64		/* hash buckets; power of 2 */
+#define	NCHNAMLEN	31		/* longest name cached */
+
+struct ncache {
+	queue_chain_t	nc_hash;	/* hash chain, if valid */
+	queue_chain_t	nc_lru;		/* LRU queue */
+	mach_port_t	nc_dev;		/* device */
+	ino_t		nc_dir;		/* directory inode number */
+	ino_t		nc_ino;		/* inode number, or 0 if
+					   name is not there */
+	int		nc_namlen;	/* length of name */
+	char		nc_name[NCHNAMLEN+1];
+	boolean_t	nc_valid;	/* on hash chain */
+};
+
+boolean_t	ncache_initialized = FALSE;
+struct ncache	ncache[NNCACHE];
+queue_head_t	ncache_hash[NCHHSZ];
+queue_head_t	ncache_lru;		/* head is least recently used */
+
+int	ncache_hits = 0;		/* names found */
+int	ncache_neghits = 0;		/* names known not to be there */
+int	ncache_misses = 0;		/* directory searches */
+
+void
+ncache_init()
+{
+	register struct ncache	*ncp;
+	register int		i;
+
+	for (i = 0; i < NCHHSZ; i++)
+	    queue_init(&ncache_hash[i]);
+	queue_init(&ncache_lru);
+
+	for (ncp = &ncache[0]; ncp < &ncache[NNCACHE]; ncp++) {
+	    ncp->nc_valid = FALSE;
+	    queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+	}
+	ncache_initialized = TRUE;
+}
+
+queue_t
+ncache_bucket(dev, dir, name, namlen)
+	mach_port_t	dev;
+	ino_t		dir;
+	register char	*name;
+	register int	namlen;
+{
+	register unsigned int	h;
+
+	h = dev + dir;
+	while (--namlen >= 0)
+	    h = h * 31 + *name++;
+	return (&ncache_hash[h & (NCHHSZ - 1)]);
+}
+
+struct ncache *
+ncache_find(bucket, dev, dir, name, namlen)
+	queue_t		bucket;
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+{
+	register struct ncache	*ncp;
+
+	queue_iterate(bucket, ncp, struct ncache *, nc_hash) {
+	    if (ncp->nc_dir == dir &&
+		ncp->nc_dev == dev &&
+		ncp->nc_namlen == namlen &&
+		!strcmp(ncp->nc_name, name))
+		return (ncp);
+	}
+	return ((struct ncache *) 0);
+}
+
+boolean_t
+ncache_lookup(dev, dir, name, namlen, inumber_p)
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+	ino_t		*inumber_p;	/* out */
+{
+	register struct ncache	*ncp;
+
+	if (namlen > NCHNAMLEN)
+	    return (FALSE);
+
+	if (!ncache_initialized)
+	    ncache_init();
+
+	ncp = ncache_find(ncache_bucket(dev, dir, name, namlen),
+			  dev, dir, name, namlen);
+	if (ncp == 0) {
+	    ncache_misses++;
+	    return (FALSE);
+	}
+	if (ncp->nc_ino != 0)
+	    ncache_hits++;
+	else
+	    ncache_neghits++;
+	queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+	queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+	*inumber_p = ncp->nc_ino;
+	return (TRUE);
+}
+
+void
+ncache_enter(dev, dir, name, namlen, inumber)
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+	ino_t		inumber;
+{
+	register struct ncache	*ncp;
+	register queue_t	bucket;
+
+	if (namlen > NCHNAMLEN)
+	    return;
+
+	if (!ncache_initialized)
+	    ncache_init();
+
+	bucket = ncache_bucket(dev, dir, name, namlen);
+	ncp = ncache_find(bucket, dev, dir, name, namlen);
+	if (ncp == 0) {
+	    queue_remove_first(&ncache_lru, ncp, struct ncache *, nc_lru);
+	    if (ncp->nc_valid)
+		queue_remove(ncache_bucket(ncp->nc_dev, ncp->nc_dir,
+					   ncp->nc_name, ncp->nc_namlen),
+			     ncp, struct ncache *, nc_hash);
+	    ncp->nc_dev = dev;
+	    ncp->nc_dir = dir;
+	    ncp->nc_namlen = namlen;
+	    bcopy(name, ncp->nc_name, namlen);
+	    ncp->nc_name[namlen] = '\0';
+	    ncp->nc_valid = TRUE;
+	    queue_enter(bucket, ncp, struct ncache *, nc_hash);
+	}
+	else
+	    queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+	ncp->nc_ino = inumber;
+	queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+}
+
+void
+ncache_purge(dev)
+	mach_port_t	dev;
+{
+	register struct ncache	*ncp;
+
+	if (ncache_initialized) {
+	    for (ncp = &ncache[0]; ncp < &ncache[NNCACHE]; ncp++) {
+		if (ncp->nc_valid && ncp->nc_dev == dev) {
+		    queue_remove(ncache_bucket(ncp->nc_dev, ncp->nc_dir,
+					       ncp->nc_name, ncp->nc_namlen),
+				 ncp, struct ncache *, nc_hash);
+		    ncp->nc_valid = FALSE;
+		    queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+		    queue_enter_first(&ncache_lru, ncp, struct ncache *, nc_lru);
+		}
+	    }
+	}
+}
+
+/*
+ *	search_directory as it is now, and as it was (use_cache
+ *	FALSE).
+ */
+int
+search_directory(name, fp, inumber_p, use_cache)
+	char *		name;
+	register struct file *fp;
+	ino_t		*inumber_p;	/* out */
+	boolean_t	use_cache;
+{
+	vm_offset_t	buf;
+	vm_size_t	buf_size;
+	vm_offset_t	offset;
+	register struct direct *dp;
+	int		length;
+	kern_return_t	rc;
+
+	length = strlen(name);
+
+	if (use_cache &&
+	    ncache_lookup(fp->f_dev, fp->f_ino, name, length, inumber_p))
+	    return ((*inumber_p != 0) ? 0 : FS_NO_ENTRY);
+
+	offset = 0;
+	while (offset < fp->i_size) {
+	    rc = buf_read_file(fp, offset, &buf, &buf_size);
+	    if (rc != KERN_SUCCESS)
+		return (rc);
+
+	    dp = (struct direct *)buf;
+	    if (dp->d_ino != 0) {
+		if (dp->d_namlen == length &&
+		    !strcmp(name, dp->d_name))
+	    	{
+		    /* found entry */
+		    *inumber_p = dp->d_ino;
+		    if (use_cache)
+			ncache_enter(fp->f_dev, fp->f_ino, name, length,
+				     *inumber_p);
+		    return (0);
+		}
+	    }
+	    offset += dp->d_reclen;
+	}
+	if (use_cache)
+	    ncache_enter(fp->f_dev, fp->f_ino, name, length, (ino_t) 0);
+	return (FS_NO_ENTRY);
+}
+
+#define	NWORKING	64		/* names in the working set */
+#define	FIRSTINO	3		/* inode number of the first entry */
+
+/*
+ *	A directory of n entries "f00000" and up, with inode numbers
+ *	FIRSTINO and up, packed into DIRBLKSIZ blocks as the file
+ *	system lays them out.
+ */
+void
+dir_build(fp, n)
+	struct file	*fp;
+	int		n;
+{
+	struct direct	*dp, *last;
+	vm_offset_t	off, blkend;
+	int		i;
+
+	fp->f_data = calloc(n / 16 + 1, DIRBLKSIZ);
+	if (fp->f_data == 0) {
+	    fprintf(stderr, "dirbench: out of memory\n");
+	    exit(1);
+	}
+	fp->f_dev = 1;
+	fp->f_ino = 2;
+
+	off = 0;
+	blkend = DIRBLKSIZ;
+	last = 0;
+	for (i = 0; i < n; i++) {
+	    dp = (struct direct *) (fp->f_data + off);
+	    dp->d_ino = FIRSTINO + i;
+	    dp->d_namlen = sprintf(dp->d_name, "f%05d", i);
+	    dp->d_reclen = DIRSIZ(dp);
+	    if (off + dp->d_reclen > blkend) {
+		last->d_reclen += blkend - off;
+		off = blkend;
+		blkend += DIRBLKSIZ;
+		bcopy((char *) dp, fp->f_data + off, DIRSIZ(dp));
+		dp = (struct direct *) (fp->f_data + off);
+	    }
+	    off += dp->d_reclen;
+	    last = dp;
+	}
+	last->d_reclen += blkend - off;
+	fp->i_size = blkend;
+}
+
+double
+nsecs(start, end, count)
+	struct timeval *start, *end;
+	long count;
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000.0 +
+		(end->tv_usec - start->tv_usec)) * 1000.0 / count;
+}
+
+static unsigned long	seed = 1;
+
+int
+random_next()
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+/*
+ *	Look up count names from the list, checking each one;
+ *	returns ns per lookup.
+ */
+double
+lookups(fp, names, nnames, inos, count, use_cache)
+	struct file	*fp;
+	char		(*names)[8];
+	int		nnames;
+	ino_t		*inos;
+	long		count;
+	boolean_t	use_cache;
+{
+	struct timeval	start, end;
+	ino_t		ino;
+	long		i;
+	int		j, rc;
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++) {
+	    j = i % nnames;
+	    ino = 0;
+	    rc = search_directory(names[j], fp, &ino, use_cache);
+	    if ((rc == 0) != (inos[j] != 0) || ino != inos[j]) {
+		fprintf(stderr, "dirbench: bad lookup of %s\n", names[j]);
+		exit(1);
+	    }
+	}
+	gettimeofday(&end, (struct timezone *) 0);
+	return (nsecs(&start, &end, count));
+}
+
+void
+bench(n, count)
+	int	n;
+	long	count;
+{
+	struct file	f;
+	char		(*names)[8], absent[NWORKING][8];
+	ino_t		*inos, absent_inos[NWORKING];
+	double		scan, abscan, hit, neghit, thrash;
+	long		scan_count;
+	int		i, k;
+
+	dir_build(&f, n);
+	names = (char (*)[8]) malloc(n * sizeof names[0]);
+	inos = (ino_t *) malloc(n * sizeof inos[0]);
+	for (i = 0; i < n; i++) {
+	    k = (random_next() * 32768 + random_next()) % n;
+	    sprintf(names[i], "f%05d", k);
+	    inos[i] = FIRSTINO + k;
+	}
+	for (i = 0; i < NWORKING; i++) {
+	    sprintf(absent[i], "g%05d", i);
+	    absent_inos[i] = 0;
+	}
+
+	/*
+	 *	The scans are linear, so do fewer of them in big
+	 *	directories.
+	 */
+	scan_count = count / (n / 16 + 1);
+	scan = lookups(&f, names, (n < NWORKING) ? n : NWORKING, inos,
+		       scan_count, FALSE);
+	abscan = lookups(&f, absent, NWORKING, absent_inos, scan_count, FALSE);
+
+	ncache_purge(f.f_dev);
+	hit = lookups(&f, names, (n < NWORKING) ? n : NWORKING, inos,
+		      count, TRUE);
+	neghit = lookups(&f, absent, NWORKING, absent_inos, count, TRUE);
+
+	ncache_purge(f.f_dev);
+	thrash = lookups(&f, names, n, inos, scan_count, TRUE);
+
+	printf("%8d %10.1f %10.1f %8.1f %8.1f %10.1f\n",
+	       n, scan, abscan, hit, neghit, thrash);
+	ncache_purge(f.f_dev);
+	free(f.f_data);
+	free((char *) names);
+	free((char *) inos);
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	long count;
+	int n;
+
+	count = (argc > 1) ? atol(argv[1]) : 1000000;
+	if (count <= 0) {
+	    fprintf(stderr, "usage: dirbench [lookups]\n");
+	    exit(2);
+	}
+
+	printf("%8s %10s %10s %8s %8s %10s   (ns per lookup)\n",
+	       "entries", "scan", "absent", "hit", "neghit", "thrash");
+	for (n = 16; n <= 16384; n *= 4)
+	    bench(n, count);
+	printf("name cache: %d hits, %d negative hits, %d misses\n",
+	       ncache_hits, ncache_neghits, ncache_misses);
+	exit(0);
+}
@@ -121,41 +121,720 @@
 
 #include <file_io.h>
 #include <dir.h>
+#include <queue.h>
+
+extern void *kalloc();
+extern void kfree();
 
 void	close_file();	/* forward */
 
 /*
- * Free file buffers, but don't close file.
+ * Block cache.
+ *
+ * Disk blocks read through open files - inode blocks, indirect
+ * blocks and data blocks - are kept in one cache shared by all
+ * files, named by device port and disk address and replaced in
+ * LRU order.  A buffer that is in use (b_refs > 0) is off the
+ * LRU queue and is not replaced.  A buffer whose name is taken
+ * away while it is in use has its data freed when it is released,
+ * and goes back on the LRU queue empty.  Private buffers, made
+ * when every cache buffer is in use, never join the cache; they
+ * are freed outright when released, so the cache stays at NBUF.
+ *
+ * As in block_map before the cache existed, nothing that might
+ * block for memory (device_read, vm_deallocate, kalloc) is done
+ * while holding bcache_lock; otherwise a non-privileged thread
+ * could deadlock with the privileged threads.
+ */
+#define	NBUF		128		/* buffers in the cache */
+#define	BUFHSZ		64		/* hash buckets; power of 2 */
+#define	MAXREADAHEAD	8		/* most blocks read ahead */
+
+struct buf {
+	queue_chain_t	b_hash;		/* hash chain, if named */
+	queue_chain_t	b_lru;		/* LRU queue, if not in use */
+	mach_port_t	b_dev;		/* device */
+	daddr_t		b_blkno;	/* disk address */
+	vm_offset_t	b_data;		/* data, or 0 */
+	vm_size_t	b_size;		/* size of data */
+	int		b_refs;		/* references */
+	boolean_t	b_named;	/* on hash chain */
+	boolean_t	b_readahead;	/* read ahead, not yet used */
+	boolean_t	b_private;	/* made by bcache_private */
+};
+
+#define	BUFHASH(dev, blkno) \
+		(&bcache_hash[((dev) + (blkno)) & (BUFHSZ - 1)])
+
+struct mutex	bcache_lock = MUTEX_INITIALIZER;
+boolean_t	bcache_initialized = FALSE;
+struct buf	bcache_bufs[NBUF];
+queue_head_t	bcache_hash[BUFHSZ];
+queue_head_t	bcache_lru;		/* head is least recently used */
+
+/*
+ * Statistics.
+ */
+int	bcache_hits = 0;		/* lookups found in cache */
+int	bcache_misses = 0;		/* lookups that read the disk */
+int	bcache_ra_blocks = 0;		/* blocks read ahead */
+int	bcache_ra_hits = 0;		/* read-ahead blocks later used */
+
+/*
+ * Set up the cache.  Called with bcache_lock held.
  */
 void
-free_file_buffers(fp)
-	register struct file	*fp;
+bcache_init()
+{
+	register struct buf	*bp;
+	register int		i;
+
+	for (i = 0; i < BUFHSZ; i++)
+	    queue_init(&bcache_hash[i]);
+	queue_init(&bcache_lru);
+
+	for (bp = &bcache_bufs[0]; bp < &bcache_bufs[NBUF]; bp++) {
+	    bp->b_data = 0;
+	    bp->b_size = 0;
+	    bp->b_refs = 0;
+	    bp->b_named = FALSE;
+	    bp->b_readahead = FALSE;
+	    bp->b_private = FALSE;
+	    queue_enter(&bcache_lru, bp, struct buf *, b_lru);
+	}
+	bcache_initialized = TRUE;
+}
+
+/*
+ * Find the buffer for a disk block.  Called with bcache_lock held.
+ */
+struct buf *
+bcache_lookup(dev, blkno)
+	mach_port_t	dev;
+	daddr_t		blkno;
+{
+	register queue_t	bucket;
+	register struct buf	*bp;
+
+	bucket = BUFHASH(dev, blkno);
+	queue_iterate(bucket, bp, struct buf *, b_hash) {
+	    if (bp->b_dev == dev && bp->b_blkno == blkno)
+		return (bp);
+	}
+	return ((struct buf *) 0);
+}
+
+/*
+ * Take the name away from a buffer.  Called with bcache_lock held.
+ * An idle buffer moves to the head of the LRU queue, to be
+ * reused first.
+ */
+void
+bcache_unname(bp)
+	register struct buf	*bp;
+{
+	queue_remove(BUFHASH(bp->b_dev, bp->b_blkno),
+		     bp, struct buf *, b_hash);
+	bp->b_named = FALSE;
+	bp->b_readahead = FALSE;
+
+	if (bp->b_refs == 0) {
+	    queue_remove(&bcache_lru, bp, struct buf *, b_lru);
+	    queue_enter_first(&bcache_lru, bp, struct buf *, b_lru);
+	}
+}
+
+/*
+ * Take the least recently used buffer for reuse.  Called with
+ * bcache_lock held.  Returns 0 if every buffer is in use.  The
+ * buffer's old data is returned in *data_p and *size_p, for the
+ * caller to deallocate after unlocking.
+ */
+struct buf *
+bcache_victim(data_p, size_p)
+	vm_offset_t	*data_p;
+	vm_size_t	*size_p;
+{
+	register struct buf	*bp;
+
+	if (queue_empty(&bcache_lru))
+	    return ((struct buf *) 0);
+
+	queue_remove_first(&bcache_lru, bp, struct buf *, b_lru);
+	if (bp->b_named) {
+	    queue_remove(BUFHASH(bp->b_dev, bp->b_blkno),
+			 bp, struct buf *, b_hash);
+	    bp->b_named = FALSE;
+	}
+	*data_p = bp->b_data;
+	*size_p = bp->b_size;
+	bp->b_data = 0;
+	bp->b_size = 0;
+	bp->b_readahead = FALSE;
+	return (bp);
+}
+
+/*
+ * Make a buffer with no name, when the cache is all in use or
+ * the block is not on disk.  The buffer and its data are freed
+ * when it is released.
+ */
+struct buf *
+bcache_private(data, size)
+	vm_offset_t	data;
+	vm_size_t	size;
+{
+	register struct buf	*bp;
+
+	bp = (struct buf *) kalloc(sizeof(struct buf));
+	bp->b_private = TRUE;
+	bp->b_data = data;
+	bp->b_size = size;
+	bp->b_refs = 1;
+	bp->b_named = FALSE;
+	bp->b_readahead = FALSE;
+	return (bp);
+}
+
+/*
+ * Release a buffer.
+ */
+void
+bcache_release(bp)
+	register struct buf	*bp;
+{
+	vm_offset_t	data = 0;
+	vm_size_t	size;
+	boolean_t	free_buf = FALSE;
+
+	mutex_lock(&bcache_lock);
+	if (--bp->b_refs == 0) {
+	    if (bp->b_named) {
+		queue_enter(&bcache_lru, bp, struct buf *, b_lru);
+	    }
+	    else {
+		/*
+		 * Nobody can find this buffer again.  Free its
+		 * data, and keep a cache buffer for reuse.
+		 */
+		data = bp->b_data;
+		size = bp->b_size;
+		bp->b_data = 0;
+		bp->b_size = 0;
+		if (bp->b_private)
+		    free_buf = TRUE;
+		else
+		    queue_enter_first(&bcache_lru, bp, struct buf *, b_lru);
+	    }
+	}
+	mutex_unlock(&bcache_lock);
+
+	if (data != 0)
+	    (void) vm_deallocate(mach_task_self(), data, size);
+	if (free_buf)
+	    kfree(bp, sizeof(struct buf));
+}
+
+/*
+ * Forget any cached copy of a disk block that is being written.
+ */
+void
+bcache_invalidate(dev, blkno)
+	mach_port_t	dev;
+	daddr_t		blkno;
+{
+	register struct buf	*bp;
+
+	mutex_lock(&bcache_lock);
+	if (bcache_initialized) {
+	    bp = bcache_lookup(dev, blkno);
+	    if (bp != 0)
+		bcache_unname(bp);
+	}
+	mutex_unlock(&bcache_lock);
+}
+
+/*
+ * Return a buffer holding at least size bytes of the disk block
+ * at blkno.  The caller must release it.
+ *
+ * On a miss, if count > 1 the block is a full file system block
+ * and the count - 1 blocks that follow it on disk are read in
+ * the same device_read and cached for later.
+ */
+int
+bcache_read(dev, fs, blkno, size, count, bp_p)
+	mach_port_t		dev;
+	register struct fs	*fs;
+	daddr_t			blkno;
+	vm_size_t		size;
+	int			count;
+	struct buf		**bp_p;		/* out */
 {
-	register int level;
+	register struct buf	*bp;
+	struct buf		*result;
+	vm_offset_t		data;
+	mach_msg_type_number_t	data_size;
+	vm_offset_t		freedata[MAXREADAHEAD+2];
+	vm_size_t		freesize[MAXREADAHEAD+2];
+	int			nfree;
+	int			nblocks;
+	register int		i;
+	kern_return_t		rc;
+
+	mutex_lock(&bcache_lock);
+	if (!bcache_initialized)
+	    bcache_init();
+
+	bp = bcache_lookup(dev, blkno);
+	if (bp != 0 && bp->b_size >= size) {
+	    bcache_hits++;
+	    if (bp->b_readahead) {
+		bp->b_readahead = FALSE;
+		bcache_ra_hits++;
+	    }
+	    if (bp->b_refs++ == 0)
+		queue_remove(&bcache_lru, bp, struct buf *, b_lru);
+	    mutex_unlock(&bcache_lock);
+
+	    *bp_p = bp;
+	    return (0);
+	}
+	bcache_misses++;
+	mutex_unlock(&bcache_lock);
 
 	/*
-	 * Free the indirect blocks
+	 * Read-ahead splits the data returned into separate
+	 * blocks, so the blocks must be whole pages.
 	 */
-	for (level = 0; level < NIADDR; level++) {
-	    if (fp->f_blk[level] != 0) {
-		(void) vm_deallocate(mach_task_self(),
-				     fp->f_blk[level],
-				     fp->f_blksize[level]);
-		fp->f_blk[level] = 0;
+	if (size != fs->fs_bsize || fs->fs_bsize % vm_page_size != 0)
+	    count = 1;
+	if (count > MAXREADAHEAD + 1)
+	    count = MAXREADAHEAD + 1;
+
+	rc = device_read(dev,
+			 0,
+			 (recnum_t) fsbtodb(fs, blkno),
+			 (int) (size * count),
+			 (char **) &data,
+			 &data_size);
+	if (rc != KERN_SUCCESS)
+	    return (rc);
+
+	nfree = 0;
+	if (count == 1) {
+	    nblocks = 1;
+	}
+	else {
+	    nblocks = data_size / size;
+	    if (nblocks == 0) {
+		nblocks = 1;
+	    }
+	    else if (data_size > nblocks * size) {
+		freedata[nfree] = data + nblocks * size;
+		freesize[nfree] = data_size - nblocks * size;
+		nfree++;
+		data_size = nblocks * size;
+	    }
+	    if (nblocks > 1)
+		data_size = size;
+	}
+
+	mutex_lock(&bcache_lock);
+
+	result = 0;
+	for (i = 0; i < nblocks; i++) {
+	    vm_offset_t	bdata = data + i * data_size;
+	    daddr_t	bblkno = blkno + i * fs->fs_frag;
+
+	    bp = bcache_lookup(dev, bblkno);
+	    if (bp != 0) {
+		if (i > 0) {
+		    /*
+		     * Already cached: keep the copy we have.
+		     */
+		    freedata[nfree] = bdata;
+		    freesize[nfree] = data_size;
+		    nfree++;
+		    continue;
+		}
+		/*
+		 * Cached copy is too short.
+		 */
+		bcache_unname(bp);
+	    }
+
+	    bp = bcache_victim(&freedata[nfree], &freesize[nfree]);
+	    if (bp == 0) {
+		if (i > 0) {
+		    freedata[nfree] = bdata;
+		    freesize[nfree] = data_size;
+		    nfree++;
+		    continue;
+		}
+		/*
+		 * Every buffer is in use.  Hand the block
+		 * back in a private buffer.
+		 */
+		mutex_unlock(&bcache_lock);
+		result = bcache_private(bdata, data_size);
+		mutex_lock(&bcache_lock);
+		continue;
+	    }
+	    if (freedata[nfree] != 0)
+		nfree++;
+
+	    bp->b_dev = dev;
+	    bp->b_blkno = bblkno;
+	    bp->b_data = bdata;
+	    bp->b_size = data_size;
+	    bp->b_named = TRUE;
+	    queue_enter(BUFHASH(dev, bblkno), bp, struct buf *, b_hash);
+
+	    if (i == 0) {
+		bp->b_refs = 1;
+		result = bp;
+	    }
+	    else {
+		bp->b_refs = 0;
+		bp->b_readahead = TRUE;
+		bcache_ra_blocks++;
+		queue_enter(&bcache_lru, bp, struct buf *, b_lru);
+	    }
+	}
+
+	mutex_unlock(&bcache_lock);
+
+	for (i = 0; i < nfree; i++)
+	    (void) vm_deallocate(mach_task_self(), freedata[i], freesize[i]);
+
+	*bp_p = result;
+	return (0);
+}
+
+/*
+ * Forget every cached block of a device.
+ */
+void
+bcache_purge(dev)
+	mach_port_t	dev;
+{
+	register struct buf	*bp, *next;
+	register int		i;
+
+	mutex_lock(&bcache_lock);
+	if (bcache_initialized) {
+	    for (i = 0; i < BUFHSZ; i++) {
+		bp = (struct buf *) queue_first(&bcache_hash[i]);
+		while (!queue_end(&bcache_hash[i], (queue_entry_t) bp)) {
+		    next = (struct buf *) queue_next(&bp->b_hash);
+		    if (bp->b_dev == dev)
+			bcache_unname(bp);
+		    bp = next;
+		}
+	    }
+	}
+	mutex_unlock(&bcache_lock);
+}
+
+/*
+ * Name cache.
+ *
+ * The results of search_directory, including names that were
+ * not found, are kept by device, directory inode number and
+ * name, and replaced in LRU order.  Names longer than NCHNAMLEN
+ * are not cached.
+ */
+#define	NNCACHE		128		/* entries in the cache */
+#define	NCHHSZ		64		/* hash buckets; power of 2 */
+#define	NCHNAMLEN	31		/* longest name cached */
+
+struct ncache {
+	queue_chain_t	nc_hash;	/* hash chain, if valid */
+	queue_chain_t	nc_lru;		/* LRU queue */
+	mach_port_t	nc_dev;		/* device */
+	ino_t		nc_dir;		/* directory inode number */
+	ino_t		nc_ino;		/* inode number, or 0 if
+					   name is not there */
+	int		nc_namlen;	/* length of name */
+	char		nc_name[NCHNAMLEN+1];
+	boolean_t	nc_valid;	/* on hash chain */
+};
+
+struct mutex	ncache_lock = MUTEX_INITIALIZER;
+boolean_t	ncache_initialized = FALSE;
+struct ncache	ncache[NNCACHE];
+queue_head_t	ncache_hash[NCHHSZ];
+queue_head_t	ncache_lru;		/* head is least recently used */
+
+/*
+ * Statistics.
+ */
+int	ncache_hits = 0;		/* names found */
+int	ncache_neghits = 0;		/* names known not to be there */
+int	ncache_misses = 0;		/* directory searches */
+
+/*
+ * Set up the name cache.  Called with ncache_lock held.
+ */
+void
+ncache_init()
+{
+	register struct ncache	*ncp;
+	register int		i;
+
+	for (i = 0; i < NCHHSZ; i++)
+	    queue_init(&ncache_hash[i]);
+	queue_init(&ncache_lru);
+
+	for (ncp = &ncache[0]; ncp < &ncache[NNCACHE]; ncp++) {
+	    ncp->nc_valid = FALSE;
+	    queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+	}
+	ncache_initialized = TRUE;
+}
+
+queue_t
+ncache_bucket(dev, dir, name, namlen)
+	mach_port_t	dev;
+	ino_t		dir;
+	register char	*name;
+	register int	namlen;
+{
+	register unsigned int	h;
+
+	h = dev + dir;
+	while (--namlen >= 0)
+	    h = h * 31 + *name++;
+	return (&ncache_hash[h & (NCHHSZ - 1)]);
+}
+
+/*
+ * Find a name.  Called with ncache_lock held.
+ */
+struct ncache *
+ncache_find(bucket, dev, dir, name, namlen)
+	queue_t		bucket;
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+{
+	register struct ncache	*ncp;
+
+	queue_iterate(bucket, ncp, struct ncache *, nc_hash) {
+	    if (ncp->nc_dir == dir &&
+		ncp->nc_dev == dev &&
+		ncp->nc_namlen == namlen &&
+		!strcmp(ncp->nc_name, name))
+		return (ncp);
+	}
+	return ((struct ncache *) 0);
+}
+
+/*
+ * Look up a name in the cache.  Returns TRUE if the answer is
+ * known, with the inode number (0 if the name is not in the
+ * directory) in *inumber_p.
+ */
+boolean_t
+ncache_lookup(dev, dir, name, namlen, inumber_p)
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+	ino_t		*inumber_p;	/* out */
+{
+	register struct ncache	*ncp;
+
+	if (namlen > NCHNAMLEN)
+	    return (FALSE);
+
+	mutex_lock(&ncache_lock);
+	if (!ncache_initialized)
+	    ncache_init();
+
+	ncp = ncache_find(ncache_bucket(dev, dir, name, namlen),
+			  dev, dir, name, namlen);
+	if (ncp == 0) {
+	    ncache_misses++;
+	    mutex_unlock(&ncache_lock);
+	    return (FALSE);
+	}
+	if (ncp->nc_ino != 0)
+	    ncache_hits++;
+	else
+	    ncache_neghits++;
+	queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+	queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+	*inumber_p = ncp->nc_ino;
+	mutex_unlock(&ncache_lock);
+	return (TRUE);
+}
+
+/*
+ * Enter the result of a directory search.
+ */
+void
+ncache_enter(dev, dir, name, namlen, inumber)
+	mach_port_t	dev;
+	ino_t		dir;
+	char		*name;
+	int		namlen;
+	ino_t		inumber;
+{
+	register struct ncache	*ncp;
+	register queue_t	bucket;
+
+	if (namlen > NCHNAMLEN)
+	    return;
+
+	mutex_lock(&ncache_lock);
+	if (!ncache_initialized)
+	    ncache_init();
+
+	bucket = ncache_bucket(dev, dir, name, namlen);
+	ncp = ncache_find(bucket, dev, dir, name, namlen);
+	if (ncp == 0) {
+	    queue_remove_first(&ncache_lru, ncp, struct ncache *, nc_lru);
+	    if (ncp->nc_valid)
+		queue_remove(ncache_bucket(ncp->nc_dev, ncp->nc_dir,
+					   ncp->nc_name, ncp->nc_namlen),
+			     ncp, struct ncache *, nc_hash);
+	    ncp->nc_dev = dev;
+	    ncp->nc_dir = dir;
+	    ncp->nc_namlen = namlen;
+	    bcopy(name, ncp->nc_name, namlen);
+	    ncp->nc_name[namlen] = '\0';
+	    ncp->nc_valid = TRUE;
+	    queue_enter(bucket, ncp, struct ncache *, nc_hash);
+	}
+	else
+	    queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+	ncp->nc_ino = inumber;
+	queue_enter(&ncache_lru, ncp, struct ncache *, nc_lru);
+	mutex_unlock(&ncache_lock);
+}
+
+/*
+ * Forget every cached name on a device.
+ */
+void
+ncache_purge(dev)
+	mach_port_t	dev;
+{
+	register struct ncache	*ncp;
+
+	mutex_lock(&ncache_lock);
+	if (ncache_initialized) {
+	    for (ncp = &ncache[0]; ncp < &ncache[NNCACHE]; ncp++) {
+		if (ncp->nc_valid && ncp->nc_dev == dev) {
+		    queue_remove(ncache_bucket(ncp->nc_dev, ncp->nc_dir,
+					       ncp->nc_name, ncp->nc_namlen),
+				 ncp, struct ncache *, nc_hash);
+		    ncp->nc_valid = FALSE;
+		    queue_remove(&ncache_lru, ncp, struct ncache *, nc_lru);
+		    queue_enter_first(&ncache_lru, ncp, struct ncache *, nc_lru);
+		}
 	    }
-	    fp->f_blkno[level] = -1;
 	}
+	mutex_unlock(&ncache_lock);
+}
 
+/*
+ * The caches outlive the open files they were filled through,
+ * so they must notice when the file system on a device is
+ * unmounted and changed behind our back (by the server, once it
+ * is running).  Each device's superblock write time and summary
+ * counts are remembered when it is mounted here; if they differ
+ * at the next mount, the old contents are purged.
+ */
+#define	NMOUNT		8		/* devices remembered */
+
+struct mount_ident {
+	mach_port_t	m_dev;		/* device, or MACH_PORT_NULL */
+	time_t		m_time;		/* superblock fs_time */
+	struct csum	m_cstotal;	/* superblock fs_cstotal */
+};
+
+struct mutex		mount_lock = MUTEX_INITIALIZER;
+struct mount_ident	mount_idents[NMOUNT];
+int			mount_next = 0;	/* next slot to reuse */
+
+void
+file_cache_check(dev, fs)
+	mach_port_t		dev;
+	register struct fs	*fs;
+{
+	register struct mount_ident	*mp;
+	mach_port_t			old_dev = MACH_PORT_NULL;
+
+	mutex_lock(&mount_lock);
+	for (mp = &mount_idents[0]; mp < &mount_idents[NMOUNT]; mp++) {
+	    if (mp->m_dev == dev)
+		break;
+	}
+	if (mp < &mount_idents[NMOUNT]) {
+	    if (mp->m_time == fs->fs_time &&
+		mp->m_cstotal.cs_ndir == fs->fs_cstotal.cs_ndir &&
+		mp->m_cstotal.cs_nbfree == fs->fs_cstotal.cs_nbfree &&
+		mp->m_cstotal.cs_nifree == fs->fs_cstotal.cs_nifree &&
+		mp->m_cstotal.cs_nffree == fs->fs_cstotal.cs_nffree) {
+		mutex_unlock(&mount_lock);
+		return;
+	    }
+	}
+	else {
+	    /*
+	     * Take over another device's slot; its cached data can
+	     * no longer be checked, so it goes too.
+	     */
+	    mp = &mount_idents[mount_next];
+	    mount_next = (mount_next + 1) % NMOUNT;
+	    old_dev = mp->m_dev;
+	    mp->m_dev = dev;
+	}
+	mp->m_time = fs->fs_time;
+	mp->m_cstotal = fs->fs_cstotal;
+	mutex_unlock(&mount_lock);
+
+	bcache_purge(dev);
+	ncache_purge(dev);
+	if (old_dev != MACH_PORT_NULL) {
+	    bcache_purge(old_dev);
+	    ncache_purge(old_dev);
+	}
+}
+
+/*
+ * Print cache statistics.
+ */
+void
+file_cache_statistics()
+{
+	printf("file cache: %d hits, %d misses, %d blocks read ahead (%d used)\n",
+		bcache_hits, bcache_misses, bcache_ra_blocks, bcache_ra_hits);
+	printf("name cache: %d hits, %d negative hits, %d misses\n",
+		ncache_hits, ncache_neghits, ncache_misses);
+}
+
+/*
+ * Free file buffers, but don't close file.
+ */
+void
+free_file_buffers(fp)
+	register struct file	*fp;
+{
 	/*
-	 * Free the data block
+	 * Release the data block
 	 */
 	if (fp->f_buf != 0) {
-	    (void) vm_deallocate(mach_task_self(),
-				 fp->f_buf,
-				 fp->f_buf_size);
+	    bcache_release(fp->f_buf);
 	    fp->f_buf = 0;
 	}
 	fp->f_buf_blkno = -1;
+	fp->f_nextblk = -1;
+	fp->f_readahead = 0;
 }
 
 /*
@@ -166,8 +845,7 @@ read_inode(inumber, fp)
 	ino_t			inumber;
 	register struct file	*fp;
 {
-	vm_offset_t		buf;
-	mach_msg_type_number_t	buf_size;
+	struct buf		*bp;
 	register struct fs	*fs;
 	daddr_t			disk_block;
 	kern_return_t		rc;
@@ -175,24 +853,21 @@ read_inode(inumber, fp)
 	fs = fp->f_fs;
 	disk_block = itod(fs, inumber);
 
-	rc = device_read(fp->f_dev,
-			 0,
-			 (recnum_t) fsbtodb(fp->f_fs, disk_block),
-			 (int) fs->fs_bsize,
-			 (char **)&buf,
-			 &buf_size);
+	rc = bcache_read(fp->f_dev, fs, disk_block, (vm_size_t) fs->fs_bsize,
+			 1, &bp);
 	if (rc != KERN_SUCCESS)
 	    return (rc);
 
 	{
 	    register struct dinode *dp;
 
-	    dp = (struct dinode *)buf;
+	    dp = (struct dinode *)bp->b_data;
 	    dp += itoo(fs, inumber);
 	    fp->i_ic = dp->di_ic;
 	}
+	fp->f_ino = inumber;
 
-	(void) vm_deallocate(mach_task_self(), buf, buf_size);
+	bcache_release(bp);
 
 	/*
 	 * Clear out the old buffers
@@ -217,9 +892,6 @@ block_map(fp, file_block, disk_block_p)
 	daddr_t		ind_block_num;
 	kern_return_t	rc;
 
-	vm_offset_t	olddata[NIADDR+1];
-	vm_size_t	oldsize[NIADDR+1];
-
 	/*
 	 * Index structure of an inode:
 	 *
@@ -245,14 +917,15 @@ block_map(fp, file_block, disk_block_p)
 	 *			NDADDR + NINDIR(fs) + NINDIR(fs)**2 ..
 	 *			NDADDR + NINDIR(fs) + NINDIR(fs)**2
 	 *				+ NINDIR(fs)**3 - 1
+	 *
+	 * The inode fields do not change once the file is open,
+	 * and the indirect blocks come from the shared block
+	 * cache, so no file lock is needed here.
 	 */
 
-	mutex_lock(&fp->f_lock);
-
 	if (file_block < NDADDR) {
 	    /* Direct block. */
 	    *disk_block_p = fp->i_db[file_block];
-	    mutex_unlock(&fp->f_lock);
 	    return (0);
 	}
 
@@ -271,77 +944,26 @@ block_map(fp, file_block, disk_block_p)
 	}
 	if (level == NIADDR) {
 	    /* Block number too high */
-	    mutex_unlock(&fp->f_lock);
 	    return (FS_NOT_IN_FILE);
 	}
 
 	ind_block_num = fp->i_ib[level];
 
-	/*
-	 * Initialize array of blocks to free.
-	 */
-	for (idx = 0; idx < NIADDR; idx++)
-	    oldsize[idx] = 0;
-
 	for (; level >= 0; level--) {
 
-	    vm_offset_t	data;
-	    mach_msg_type_number_t	size;
+	    struct buf	*bp;
 
 	    if (ind_block_num == 0)
 		break;
 
-	    if (fp->f_blkno[level] == ind_block_num) {
-		/*
-		 *	Cache hit.  Just pick up the data.
-		 */
-
-		data = fp->f_blk[level];
-	    }
-	    else {
-		/*
-		 *	Drop our lock while doing the read.
-		 *	(The f_dev and f_fs fields don`t change.)
-		 */
-		mutex_unlock(&fp->f_lock);
-
-		rc = device_read(fp->f_dev,
-				0,
-				(recnum_t) fsbtodb(fp->f_fs, ind_block_num),
-				fp->f_fs->fs_bsize,
-				(char **)&data,
-				&size);
-		if (rc != KERN_SUCCESS)
-		    return (rc);
-
-		/*
-		 *	See if we can cache the data.  Need a write lock to
-		 *	do this.  While we hold the write lock, we can`t do
-		 *	*anything* which might block for memory.  Otherwise
-		 *	a non-privileged thread might deadlock with the
-		 *	privileged threads.  We can`t block while taking the
-		 *	write lock.  Otherwise a non-privileged thread
-		 *	blocked in the vm_deallocate (while holding a read
-		 *	lock) will block a privileged thread.  For the same
-		 *	reason, we can`t take a read lock and then use
-		 *	lock_read_to_write.
-		 */
-
-		mutex_lock(&fp->f_lock);
-
-		olddata[level] = fp->f_blk[level];
-		oldsize[level] = fp->f_blksize[level];
-
-		fp->f_blkno[level] = ind_block_num;
-		fp->f_blk[level] = data;
-		fp->f_blksize[level] = size;
-
-		/*
-		 *	Return to holding a read lock, and
-		 *	dispose of old data.
-		 */
-
-	    }
+	    rc = bcache_read(fp->f_dev,
+			     fp->f_fs,
+			     ind_block_num,
+			     (vm_size_t) fp->f_fs->fs_bsize,
+			     1,
+			     &bp);
+	    if (rc != KERN_SUCCESS)
+		return (rc);
 
 	    if (level > 0) {
 		idx = file_block / fp->f_nindir[level-1];
@@ -350,21 +972,10 @@ block_map(fp, file_block, disk_block_p)
 	    else
 		idx = file_block;
 
-	    ind_block_num = ((daddr_t *)data)[idx];
+	    ind_block_num = ((daddr_t *)bp->b_data)[idx];
+	    bcache_release(bp);
 	}
 
-	mutex_unlock(&fp->f_lock);
-
-	/*
-	 * After unlocking the file, free any blocks that
-	 * we need to free.
-	 */
-	for (idx = 0; idx < NIADDR; idx++)
-	    if (oldsize[idx] != 0)
-		(void) vm_deallocate(mach_task_self(),
-				     olddata[idx],
-				     oldsize[idx]);
-
 	*disk_block_p = ind_block_num;
 	return (0);
 }
@@ -397,33 +1008,66 @@ buf_read_file(fp, offset, buf_p, size_p)
 	block_size = blksize(fs, fp, file_block);
 
 	if (file_block != fp->f_buf_blkno) {
+	    struct buf	*bp;
+	    int		count;
+
 	    rc = block_map(fp, file_block, &disk_block);
 	    if (rc != 0)
 		return (rc);
 
-	    if (fp->f_buf)
-		(void)vm_deallocate(mach_task_self(),
-				    fp->f_buf,
-				    fp->f_buf_size);
+	    /*
+	     * While the file is read sequentially, read ahead,
+	     * doubling the amount each time up to MAXREADAHEAD
+	     * blocks.  Any other access stops read-ahead.
+	     */
+	    if (file_block == fp->f_nextblk) {
+		if (fp->f_readahead == 0)
+		    fp->f_readahead = 1;
+		else if (fp->f_readahead < MAXREADAHEAD)
+		    fp->f_readahead *= 2;
+	    }
+	    else
+		fp->f_readahead = 0;
+	    fp->f_nextblk = file_block + 1;
+
+	    /*
+	     * Read ahead only the following full-size blocks
+	     * that are next to this one on disk.
+	     */
+	    count = 1;
+	    if (disk_block != 0 && block_size == fs->fs_bsize) {
+		daddr_t	next_block;
+
+		while (count <= fp->f_readahead) {
+		    if (lblkno(fs, fp->i_size - 1) < file_block + count ||
+			blksize(fs, fp, file_block + count) != fs->fs_bsize)
+			break;
+		    if (block_map(fp, file_block + count, &next_block) != 0 ||
+			next_block != disk_block + count * fs->fs_frag)
+			break;
+		    count++;
+		}
+	    }
 
 	    if (disk_block == 0) {
+		vm_offset_t	zero_buf;
+
 		(void)vm_allocate(mach_task_self(),
-				  &fp->f_buf,
+				  &zero_buf,
 				  block_size,
 				  TRUE);
-		fp->f_buf_size = block_size;
+		bp = bcache_private(zero_buf, block_size);
 	    }
 	    else {
-		rc = device_read(fp->f_dev,
-				0,
-				(recnum_t) fsbtodb(fs, disk_block),
-				(int) block_size,
-				(char **) &fp->f_buf,
-				(mach_msg_type_number_t *)&fp->f_buf_size);
+		rc = bcache_read(fp->f_dev, fs, disk_block, block_size,
+				 count, &bp);
+		if (rc)
+		    return (rc);
 	    }
-	    if (rc)
-		return (rc);
 
+	    if (fp->f_buf)
+		bcache_release(fp->f_buf);
+	    fp->f_buf = bp;
 	    fp->f_buf_blkno = file_block;
 	}
 
@@ -432,7 +1076,7 @@ buf_read_file(fp, offset, buf_p, size_p)
 	 * offset, and size of remainder of buffer after that
 	 * byte.
 	 */
-	*buf_p = fp->f_buf + off;
+	*buf_p = fp->f_buf->b_data + off;
 	*size_p = block_size - off;
 
 	/*
@@ -463,6 +1107,9 @@ search_directory(name, fp, inumber_p)
 
 	length = strlen(name);
 
+	if (ncache_lookup(fp->f_dev, fp->f_ino, name, length, inumber_p))
+	    return ((*inumber_p != 0) ? 0 : FS_NO_ENTRY);
+
 	offset = 0;
 	while (offset < fp->i_size) {
 	    rc = buf_read_file(fp, offset, &buf, &buf_size);
@@ -476,11 +1123,14 @@ search_directory(name, fp, inumber_p)
 	    	{
 		    /* found entry */
 		    *inumber_p = dp->d_ino;
+		    ncache_enter(fp->f_dev, fp->f_ino, name, length,
+				 *inumber_p);
 		    return (0);
 		}
 	    }
 	    offset += dp->d_reclen;
 	}
+	ncache_enter(fp->f_dev, fp->f_ino, name, length, (ino_t) 0);
 	return (FS_NO_ENTRY);
 }
 
@@ -524,6 +1174,8 @@ mount_fs(fp)
 	    return (error);
 	fs = fp->f_fs;
 
+	file_cache_check(fp->f_dev, fs);
+
 	/*
 	 * Calculate indirect block levels.
 	 */
@@ -576,6 +1228,10 @@ open_file(master_device_port, path, fp)
 	    return FS_NO_ENTRY;
 	}
 
+	fp->f_fs = 0;
+	fp->f_buf = 0;
+	free_file_buffers(fp);
+
 	/*
 	 * Copy name into buffer to allow modifying it.
 	 */
@@ -1278,6 +1934,11 @@ page_write_file_direct(fdp, offset, addr, size, size_written)
 	    disk_block = fdp->fd_blocks[file_block];
 	    if (disk_block == 0)
 		return (FS_NOT_IN_FILE);
+
+	    /*
+	     * Don't leave a stale copy in the block cache.
+	     */
+	    bcache_invalidate(fdp->fd_dev, disk_block);
 	}
 
 	if (size > fdp->fd_bsize)
@@ -126,19 +126,15 @@ struct file {
 	struct mutex	f_lock;		/* lock */
 	mach_port_t	f_dev;		/* port to device */
 	struct fs *	f_fs;		/* pointer to super-block */
+	ino_t		f_ino;		/* inode number */
 	struct icommon	i_ic;		/* copy of on-disk inode */
 	int		f_nindir[NIADDR+1];
 					/* number of blocks mapped by
 					   indirect block at level i */
-	vm_offset_t	f_blk[NIADDR];	/* buffer for indirect block at
-					   level i */
-	vm_size_t	f_blksize[NIADDR];
-					/* size of buffer */
-	daddr_t		f_blkno[NIADDR];
-					/* disk address of block in buffer */
-	vm_offset_t	f_buf;		/* buffer for data block */
-	vm_size_t	f_buf_size;	/* size of data block */
+	struct buf *	f_buf;		/* cached data block in use */
 	daddr_t		f_buf_blkno;	/* block number of data block */
+	daddr_t		f_nextblk;	/* next block if read sequentially */
+	int		f_readahead;	/* blocks to read ahead */
 };
 
 #define file_is_structured(_fp_)	((_fp_)->f_fs != 0)
@@ -164,6 +160,7 @@ struct file_direct {
 extern int	open_file();
 extern void	close_file();
 extern int	read_file();
+extern void	file_cache_statistics();
 
 extern int	open_file_direct();
 extern int	add_file_direct();
@@ -85,7 +85,7 @@ intel_read_fault(map, vaddr)
 	vm_page_t		result_page;	/* Result of vm_fault_page */
 	vm_page_t		top_page;	/* Placeholder page */
 	boolean_t		wired;		/* Is map region wired? */
-	boolean_t		su;
+	vm_behavior_t		behavior;	/* Expected access pattern */
 	kern_return_t		result;
 	register vm_page_t	m;
 
@@ -96,7 +96,7 @@ intel_read_fault(map, vaddr)
 	 *	to begin search.
 	 */
 	result = vm_map_lookup(&map, vaddr, VM_PROT_READ, &version,
-			&object, &offset, &prot, &wired, &su);
+			&object, &offset, &prot, &wired, &behavior);
 	if (result != KERN_SUCCESS)
 	    return (result);
 
@@ -109,7 +109,7 @@ intel_read_fault(map, vaddr)
 	vm_object_paging_begin(object);
 
 	result = vm_fault_page(object, offset, VM_PROT_READ, FALSE, TRUE,
-			       &prot, &result_page, &top_page,
+			       behavior, &prot, &result_page, &top_page,
 			       FALSE, (void (*)()) 0);
 
 	if (result != VM_FAULT_SUCCESS) {
@@ -169,7 +169,7 @@ intel_read_fault(map, vaddr)
 
 	    result = vm_map_lookup(&map, vaddr, VM_PROT_READ, &version,
 				&retry_object, &retry_offset, &retry_prot,
-				&wired, &su);
+				&wired, &behavior);
 	    if (result != KERN_SUCCESS) {
 		vm_object_lock(m->object);
 		RELEASE_PAGE(m);
@@ -440,9 +440,12 @@ ipc_entry_alloc_name(space, name, entryp)
 
 		/*
 		 *	Allocate a tree entry and try again.
+		 *	While nothing is locked, let the global
+		 *	reverse hash table grow if it needs to.
 		 */
 
 		is_write_unlock(space);
+		ipc_hash_global_adjust();
 		tree_entry = ite_alloc();
 		if (tree_entry == ITE_NULL)
 			return KERN_RESOURCE_SHORTAGE;
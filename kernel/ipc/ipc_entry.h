@@ -131,6 +131,7 @@ typedef struct ipc_tree_entry {
 	struct ipc_space *ite_space;
 	struct ipc_tree_entry *ite_lchild;
 	struct ipc_tree_entry *ite_rchild;
+	unsigned int ite_height;	/* height of subtree, for balancing */
 } *ipc_tree_entry_t;
 
 #define	ITE_NULL	((ipc_tree_entry_t) 0)
@@ -166,32 +166,63 @@ ipc_hash_delete(space, obj, name, entry)
 /*
  *	The global reverse hash table holds splay tree entries.
  *	It is a simple open-chaining hash table with singly-linked buckets.
- *	Each bucket is locked separately, with an exclusive lock.
  *	Within each bucket, move-to-front is used.
+ *
+ *	The table grows with the number of entries in it.  Its size
+ *	is always a power of two and a multiple of IH_GLOBAL_LOCKS.
+ *	A bucket is protected by the lock of the stripe given by
+ *	the low bits of its index, so growing only moves entries
+ *	between buckets of the same stripe.  The table is rehashed
+ *	one stripe at a time while the other stripes stay in use.
+ *	Each stripe records which table it is using.
+ *
+ *	Entries are inserted with the space locked, when we can't
+ *	allocate memory.  An insertion that overloads its stripe
+ *	sets ipc_hash_global_want_grow, and ipc_hash_global_adjust,
+ *	called before allocating a splay tree entry, does the work.
  */
 
 typedef unsigned int ipc_hash_index_t;
 
 ipc_hash_index_t ipc_hash_global_size;
-ipc_hash_index_t ipc_hash_global_mask;
+ipc_hash_index_t ipc_hash_global_max;		/* patchable */
+unsigned int ipc_hash_global_resizes = 0;
+
+#define	IH_GLOBAL_LOCKS		64	/* lock stripes, a power of two */
+#define	IH_GLOBAL_LOAD		2	/* entries per bucket before growing */
+#define	IH_GLOBAL_HISTOGRAM	32	/* chain lengths told apart */
 
 #define IH_GLOBAL_HASH(space, obj)					\
-	(((((ipc_hash_index_t) ((vm_offset_t)space)) >> 4) +		\
-	  (((ipc_hash_index_t) ((vm_offset_t)obj)) >> 6)) &		\
-	 ipc_hash_global_mask)
+	((((ipc_hash_index_t) ((vm_offset_t)space)) >> 4) +		\
+	 (((ipc_hash_index_t) ((vm_offset_t)obj)) >> 6))
 
 typedef struct ipc_hash_global_bucket {
-	decl_simple_lock_data(, ihgb_lock_data)
 	ipc_tree_entry_t ihgb_head;
 } *ipc_hash_global_bucket_t;
 
 #define	IHGB_NULL	((ipc_hash_global_bucket_t) 0)
 
-#define	ihgb_lock_init(ihgb)	simple_lock_init(&(ihgb)->ihgb_lock_data)
-#define	ihgb_lock(ihgb)		simple_lock(&(ihgb)->ihgb_lock_data)
-#define	ihgb_unlock(ihgb)	simple_unlock(&(ihgb)->ihgb_lock_data)
+typedef struct ipc_hash_global_stripe {
+	decl_simple_lock_data(, ihgs_lock_data)
+	ipc_hash_global_bucket_t ihgs_table;	/* table in use */
+	ipc_hash_index_t ihgs_mask;		/* its size - 1 */
+	unsigned int ihgs_count;		/* entries in the stripe */
+} *ipc_hash_global_stripe_t;
+
+#define	ihgs_lock_init(ihgs)	simple_lock_init(&(ihgs)->ihgs_lock_data)
+#define	ihgs_lock(ihgs)		simple_lock(&(ihgs)->ihgs_lock_data)
+#define	ihgs_unlock(ihgs)	simple_unlock(&(ihgs)->ihgs_lock_data)
+
+#define	ihgs_stripe(hash)						\
+		(&ipc_hash_global_stripes[(hash) & (IH_GLOBAL_LOCKS - 1)])
+#define	ihgs_bucket(ihgs, hash)						\
+		(&(ihgs)->ihgs_table[(hash) & (ihgs)->ihgs_mask])
+
+struct ipc_hash_global_stripe ipc_hash_global_stripes[IH_GLOBAL_LOCKS];
 
-ipc_hash_global_bucket_t ipc_hash_global_table;
+boolean_t ipc_hash_global_want_grow = FALSE;
+boolean_t ipc_hash_global_growing = FALSE;
+decl_simple_lock_data(, ipc_hash_global_grow_lock_data)
 
 /*
  *	Routine:	ipc_hash_global_lookup
@@ -210,14 +241,18 @@ ipc_hash_global_lookup(space, obj, namep, entryp)
 	mach_port_t *namep;
 	ipc_tree_entry_t *entryp;
 {
+	ipc_hash_global_stripe_t stripe;
 	ipc_hash_global_bucket_t bucket;
 	ipc_tree_entry_t this, *last;
+	ipc_hash_index_t hash;
 
 	assert(space != IS_NULL);
 	assert(obj != IO_NULL);
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
+	hash = IH_GLOBAL_HASH(space, obj);
+	stripe = ihgs_stripe(hash);
+	ihgs_lock(stripe);
+	bucket = ihgs_bucket(stripe, hash);
 
 	if ((this = bucket->ihgb_head) != ITE_NULL) {
 		if ((this->ite_object == obj) &&
@@ -244,7 +279,7 @@ ipc_hash_global_lookup(space, obj, namep, entryp)
 		}
 	}
 
-	ihgb_unlock(bucket);
+	ihgs_unlock(stripe);
 	return this != ITE_NULL;
 }
 
@@ -263,7 +298,9 @@ ipc_hash_global_insert(space, obj, name, entry)
 	mach_port_t name;
 	ipc_tree_entry_t entry;
 {
+	ipc_hash_global_stripe_t stripe;
 	ipc_hash_global_bucket_t bucket;
+	ipc_hash_index_t hash;
 
 	assert(entry->ite_name == name);
 	assert(space != IS_NULL);
@@ -274,15 +311,20 @@ ipc_hash_global_insert(space, obj, name, entry)
 	space->is_tree_hash++;
 	assert(space->is_tree_hash <= space->is_tree_total);
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
+	hash = IH_GLOBAL_HASH(space, obj);
+	stripe = ihgs_stripe(hash);
+	ihgs_lock(stripe);
+	bucket = ihgs_bucket(stripe, hash);
 
 	/* insert at front of bucket */
 
 	entry->ite_next = bucket->ihgb_head;
 	bucket->ihgb_head = entry;
 
-	ihgb_unlock(bucket);
+	if (++stripe->ihgs_count > IH_GLOBAL_LOAD * (stripe->ihgs_mask + 1))
+		ipc_hash_global_want_grow = TRUE;
+
+	ihgs_unlock(stripe);
 }
 
 /*
@@ -300,8 +342,10 @@ ipc_hash_global_delete(space, obj, name, entry)
 	mach_port_t name;
 	ipc_tree_entry_t entry;
 {
+	ipc_hash_global_stripe_t stripe;
 	ipc_hash_global_bucket_t bucket;
 	ipc_tree_entry_t this, *last;
+	ipc_hash_index_t hash;
 
 	assert(entry->ite_name == name);
 	assert(space != IS_NULL);
@@ -312,8 +356,10 @@ ipc_hash_global_delete(space, obj, name, entry)
 	assert(space->is_tree_hash > 0);
 	space->is_tree_hash--;
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
+	hash = IH_GLOBAL_HASH(space, obj);
+	stripe = ihgs_stripe(hash);
+	ihgs_lock(stripe);
+	bucket = ihgs_bucket(stripe, hash);
 
 	for (last = &bucket->ihgb_head;
 	     (this = *last) != ITE_NULL;
@@ -327,7 +373,118 @@ ipc_hash_global_delete(space, obj, name, entry)
 	}
 	assert(this != ITE_NULL);
 
-	ihgb_unlock(bucket);
+	assert(stripe->ihgs_count > 0);
+	stripe->ihgs_count--;
+
+	ihgs_unlock(stripe);
+}
+
+/*
+ *	Routine:	ipc_hash_global_grow
+ *	Purpose:
+ *		Rehashes the global table into a table of the given size.
+ *	Conditions:
+ *		Nothing locked.  May block.
+ *		The caller has set ipc_hash_global_growing.
+ */
+
+void
+ipc_hash_global_grow(size)
+	ipc_hash_index_t size;
+{
+	ipc_hash_global_bucket_t new_table, old_table;
+	ipc_hash_index_t old_size, i, j;
+
+	new_table = (ipc_hash_global_bucket_t)
+		kalloc((vm_size_t) (size *
+				    sizeof(struct ipc_hash_global_bucket)));
+	if (new_table == IHGB_NULL)
+		return;
+
+	for (i = 0; i < size; i++)
+		new_table[i].ihgb_head = ITE_NULL;
+
+	old_table = ipc_hash_global_stripes[0].ihgs_table;
+	old_size = ipc_hash_global_size;
+
+	for (i = 0; i < IH_GLOBAL_LOCKS; i++) {
+		ipc_hash_global_stripe_t stripe = &ipc_hash_global_stripes[i];
+
+		ihgs_lock(stripe);
+		for (j = i; j < old_size; j += IH_GLOBAL_LOCKS) {
+			ipc_tree_entry_t this, next;
+
+			for (this = old_table[j].ihgb_head;
+			     this != ITE_NULL;
+			     this = next) {
+				ipc_hash_global_bucket_t bucket;
+
+				next = this->ite_next;
+				bucket = &new_table[IH_GLOBAL_HASH(
+						this->ite_space,
+						this->ite_object) & (size - 1)];
+				this->ite_next = bucket->ihgb_head;
+				bucket->ihgb_head = this;
+			}
+		}
+		stripe->ihgs_table = new_table;
+		stripe->ihgs_mask = size - 1;
+		ihgs_unlock(stripe);
+	}
+
+	ipc_hash_global_size = size;
+	ipc_hash_global_resizes++;
+
+	/* every stripe has switched, so nobody uses the old table */
+
+	kfree((vm_offset_t) old_table,
+	      (vm_size_t) (old_size * sizeof(struct ipc_hash_global_bucket)));
+}
+
+/*
+ *	Routine:	ipc_hash_global_adjust
+ *	Purpose:
+ *		Grows the global table if insertions have
+ *		overloaded it.  Cheap if there is nothing to do.
+ *	Conditions:
+ *		Nothing locked.  May block.
+ */
+
+void
+ipc_hash_global_adjust()
+{
+	ipc_hash_index_t size;
+	unsigned int count, i;
+
+	if (!ipc_hash_global_want_grow)
+		return;
+
+	simple_lock(&ipc_hash_global_grow_lock_data);
+	if (ipc_hash_global_growing) {
+		simple_unlock(&ipc_hash_global_grow_lock_data);
+		return;
+	}
+	ipc_hash_global_growing = TRUE;
+	ipc_hash_global_want_grow = FALSE;
+	simple_unlock(&ipc_hash_global_grow_lock_data);
+
+	/* one stripe can be unlucky; size for the total */
+
+	count = 0;
+	for (i = 0; i < IH_GLOBAL_LOCKS; i++)
+		count += ipc_hash_global_stripes[i].ihgs_count;
+
+	size = ipc_hash_global_size;
+	while ((count > IH_GLOBAL_LOAD * size) &&
+	       (size < ipc_hash_global_max))
+		size <<= 1;
+
+	if (size != ipc_hash_global_size)
+		ipc_hash_global_grow(size);
+
+	simple_lock(&ipc_hash_global_grow_lock_data);
+	ipc_hash_global_growing = FALSE;
+	simple_unlock(&ipc_hash_global_grow_lock_data);
 }
 
 /*
@@ -558,49 +715,52 @@ ipc_hash_local_delete(space, obj, index, entry)
 void
 ipc_hash_init()
 {
+	ipc_hash_global_bucket_t table;
 	ipc_hash_index_t i;
 
 	/* if not configured, initialize ipc_hash_global_size */
 
 	if (ipc_hash_global_size == 0) {
 		ipc_hash_global_size = ipc_tree_entry_max >> 8;
-		if (ipc_hash_global_size < 32)
-			ipc_hash_global_size = 32;
+		if (ipc_hash_global_size < IH_GLOBAL_LOCKS)
+			ipc_hash_global_size = IH_GLOBAL_LOCKS;
 	}
 
 	/* make sure it is a power of two */
 
-	ipc_hash_global_mask = ipc_hash_global_size - 1;
-	if ((ipc_hash_global_size & ipc_hash_global_mask) != 0) {
-		unsigned int bit;
+	for (i = IH_GLOBAL_LOCKS; i < ipc_hash_global_size; i <<= 1)
+		continue;
+	ipc_hash_global_size = i;
 
-		/* round up to closest power of two */
+	/* by default, allow a bucket for every splay tree entry */
 
-		for (bit = 1;; bit <<= 1) {
-			ipc_hash_global_mask |= bit;
-			ipc_hash_global_size = ipc_hash_global_mask + 1;
+	if (ipc_hash_global_max == 0)
+		ipc_hash_global_max = ipc_tree_entry_max;
+	if (ipc_hash_global_max < ipc_hash_global_size)
+		ipc_hash_global_max = ipc_hash_global_size;
 
-			if ((ipc_hash_global_size & ipc_hash_global_mask) == 0)
-				break;
-		}
-	}
+	/* allocate the initial table */
 
-	/* allocate ipc_hash_global_table */
-
-	ipc_hash_global_table = (ipc_hash_global_bucket_t)
+	table = (ipc_hash_global_bucket_t)
 		kalloc((vm_size_t) (ipc_hash_global_size *
 				    sizeof(struct ipc_hash_global_bucket)));
-	assert(ipc_hash_global_table != IHGB_NULL);
+	assert(table != IHGB_NULL);
 
 	/* and initialize it */
 
-	for (i = 0; i < ipc_hash_global_size; i++) {
-		ipc_hash_global_bucket_t bucket;
+	for (i = 0; i < ipc_hash_global_size; i++)
+		table[i].ihgb_head = ITE_NULL;
+
+	for (i = 0; i < IH_GLOBAL_LOCKS; i++) {
+		ipc_hash_global_stripe_t stripe = &ipc_hash_global_stripes[i];
 
-		bucket = &ipc_hash_global_table[i];
-		ihgb_lock_init(bucket);
-		bucket->ihgb_head = ITE_NULL;
+		ihgs_lock_init(stripe);
+		stripe->ihgs_table = table;
+		stripe->ihgs_mask = ipc_hash_global_size - 1;
+		stripe->ihgs_count = 0;
 	}
+
+	simple_lock_init(&ipc_hash_global_grow_lock_data);
 }
 
 #if	MACH_IPC_DEBUG
@@ -621,28 +781,87 @@ ipc_hash_info(info, count)
 	hash_info_bucket_t *info;
 	unsigned int count;
 {
-	ipc_hash_index_t i;
+	ipc_hash_index_t i, j, size;
+
+	for (i = 0; i < IH_GLOBAL_LOCKS; i++) {
+		ipc_hash_global_stripe_t stripe = &ipc_hash_global_stripes[i];
 
-	if (ipc_hash_global_size < count)
-		count = ipc_hash_global_size;
+		ihgs_lock(stripe);
+		size = stripe->ihgs_mask + 1;
+		ihgs_unlock(stripe);
 
-	for (i = 0; i < count; i++) {
-		ipc_hash_global_bucket_t bucket = &ipc_hash_global_table[i];
-		unsigned int bucket_count = 0;
-		ipc_tree_entry_t entry;
+		for (j = i; (j < size) && (j < count); j += IH_GLOBAL_LOCKS) {
+			unsigned int bucket_count = 0;
+			ipc_tree_entry_t entry;
 
-		ihgb_lock(bucket);
-		for (entry = bucket->ihgb_head;
-		     entry != ITE_NULL;
-		     entry = entry->ite_next)
-			bucket_count++;
-		ihgb_unlock(bucket);
+			ihgs_lock(stripe);
+			if (j <= stripe->ihgs_mask)
+				for (entry = stripe->ihgs_table[j].ihgb_head;
+				     entry != ITE_NULL;
+				     entry = entry->ite_next)
+					bucket_count++;
+			ihgs_unlock(stripe);
 
-		/* don't touch pageable memory while holding locks */
-		info[i].hib_count = bucket_count;
+			/* don't touch pageable memory while holding locks */
+			info[j].hib_count = bucket_count;
+		}
 	}
 
 	return ipc_hash_global_size;
 }
 
+/*
+ *	Routine:	ipc_hash_histogram
+ *	Purpose:
+ *		Return a histogram of the chain lengths in the global
+ *		reverse hash table: info[n] is the number of buckets
+ *		holding n entries, and the last element counts the
+ *		buckets holding that many or more.
+ *		Fills the buffer with as much information as possible
+ *		and returns the desired size of the buffer.
+ *	Conditions:
+ *		Nothing locked.  The caller should provide
+ *		possibly-pageable memory.
+ */
+
+unsigned int
+ipc_hash_histogram(info, count)
+	hash_info_bucket_t *info;
+	unsigned int count;
+{
+	unsigned int histogram[IH_GLOBAL_HISTOGRAM];
+	ipc_hash_index_t i, j;
+
+	for (i = 0; i < IH_GLOBAL_HISTOGRAM; i++)
+		histogram[i] = 0;
+
+	for (i = 0; i < IH_GLOBAL_LOCKS; i++) {
+		ipc_hash_global_stripe_t stripe = &ipc_hash_global_stripes[i];
+
+		ihgs_lock(stripe);
+		for (j = i; j <= stripe->ihgs_mask; j += IH_GLOBAL_LOCKS) {
+			unsigned int length = 0;
+			ipc_tree_entry_t entry;
+
+			for (entry = stripe->ihgs_table[j].ihgb_head;
+			     entry != ITE_NULL;
+			     entry = entry->ite_next)
+				length++;
+
+			if (length >= IH_GLOBAL_HISTOGRAM)
+				length = IH_GLOBAL_HISTOGRAM - 1;
+			histogram[length]++;
+		}
+		ihgs_unlock(stripe);
+	}
+
+	if (count > IH_GLOBAL_HISTOGRAM)
+		count = IH_GLOBAL_HISTOGRAM;
+
+	for (i = 0; i < count; i++)
+		info[i].hib_count = histogram[i];
+
+	return IH_GLOBAL_HISTOGRAM;
+}
+
 #endif	MACH_IPC_DEBUG
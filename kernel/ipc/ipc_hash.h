@@ -70,6 +70,9 @@ ipc_hash_init();
 extern unsigned int
 ipc_hash_info(/* hash_info_bucket_t *, unsigned int */);
 
+extern unsigned int
+ipc_hash_histogram(/* hash_info_bucket_t *, unsigned int */);
+
 #endif	MACH_IPC_DEBUG
 
 extern boolean_t
@@ -102,6 +105,9 @@ extern void
 ipc_hash_global_delete(/* ipc_space_t space, ipc_object_t obj,
 			  mach_port_t name, ipc_tree_entry_t entry */);
 
+extern void
+ipc_hash_global_adjust();
+
 extern boolean_t
 ipc_hash_local_lookup(/* ipc_space_t space, ipc_object_t obj,
 			 mach_port_t *namep, ipc_entry_t *entryp */);
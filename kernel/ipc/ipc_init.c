@@ -90,6 +90,7 @@
 #include <mach/kern_return.h>
 #include <kern/mach_param.h>
 #include <kern/ipc_host.h>
+#include <kern/ipc_kobject.h>
 #include <vm/vm_map.h>
 #include <vm/vm_kern.h>
 #include <ipc/ipc_entry.h>
@@ -199,4 +200,5 @@ ipc_init()
 				       ipc_kernel_map_size, TRUE);
 
 	ipc_host_init();
+	ipc_kobject_init();
 }
@@ -259,6 +259,11 @@
 
 #include <ipc/ipc_machdep.h>
 
+#include <mach_ipc_debug.h>
+#if	MACH_IPC_DEBUG
+#include <mach_debug/ipc_info.h>
+#endif
+
 extern int copyinmap();
 extern int copyoutmap();
 void ipc_msg_print(); /* forward */
@@ -267,7 +272,7 @@ void ipc_msg_print(); /* forward */
 #define ptr_align(x)	\
 	( ( ((vm_offset_t)(x)) + (sizeof(vm_offset_t)-1) ) & ~(sizeof(vm_offset_t)-1) )
 
-ipc_kmsg_t ipc_kmsg_cache[NCPUS];
+struct ipc_kmsg_cache ipc_kmsg_cache[NCPUS][IKM_CACHE_CLASSES];
 
 /*
  *	Routine:	ipc_kmsg_enqueue
@@ -681,6 +686,153 @@ ipc_kmsg_free(kmsg)
 	}
 }
 
+/*
+ *	Routine:	ipc_kmsg_cache_alloc
+ *	Purpose:
+ *		Allocates a kernel message buffer for a message
+ *		of the given size, from the current processor's
+ *		cache if possible.
+ *	Conditions:
+ *		Nothing locked.  Not at interrupt level.
+ */
+
+ipc_kmsg_t
+ipc_kmsg_cache_alloc(size)
+	mach_msg_size_t size;
+{
+	register ipc_kmsg_cache_t cache;
+	register ipc_kmsg_t kmsg;
+	register int class;
+	vm_size_t kmsg_size = ikm_plus_overhead(size);
+
+	for (class = 0; class < IKM_CACHE_CLASSES; class++)
+		if (kmsg_size <= ikm_cache_size(class))
+			break;
+
+	if (class == IKM_CACHE_CLASSES) {
+		kmsg = ikm_alloc(size);
+		if (kmsg != IKM_NULL)
+			ikm_init(kmsg, size);
+		return kmsg;
+	}
+
+	cache = &ipc_kmsg_cache[cpu_number()][class];
+	kmsg = cache->ikc_kmsgs;
+	if (kmsg != IKM_NULL) {
+		cache->ikc_kmsgs = kmsg->ikm_next;
+		cache->ikc_count--;
+		cache->ikc_hits++;
+		if ((++cache->ikc_run >= IKM_CACHE_DECAY) &&
+		    (cache->ikc_depth > IKM_CACHE_MIN_DEPTH)) {
+			cache->ikc_run = 0;
+			cache->ikc_depth--;
+		}
+		ikm_check_initialized(kmsg, ikm_cache_size(class));
+		return kmsg;
+	}
+
+	cache->ikc_misses++;
+	cache->ikc_run = 0;
+	if (cache->ikc_depth < ikm_cache_max_depth(class))
+		cache->ikc_depth++;
+
+	kmsg = (ipc_kmsg_t) kalloc(ikm_cache_size(class));
+	if (kmsg != IKM_NULL)
+		ikm_init_special(kmsg, ikm_cache_size(class));
+	return kmsg;
+}
+
+/*
+ *	Routine:	ipc_kmsg_cache_free
+ *	Purpose:
+ *		Frees a kernel message buffer, to the current
+ *		processor's cache if it is a cached size and
+ *		the cache isn't full.
+ *	Conditions:
+ *		Nothing locked.  Not at interrupt level.
+ *		The message buffer must have clean header
+ *		(ikm_marequest) fields.
+ */
+
+void
+ipc_kmsg_cache_free(kmsg)
+	register ipc_kmsg_t kmsg;
+{
+	register ipc_kmsg_cache_t cache;
+	register int class;
+	vm_size_t size = kmsg->ikm_size;
+
+	for (class = 0; class < IKM_CACHE_CLASSES; class++)
+		if (size == ikm_cache_size(class))
+			break;
+
+	if (class < IKM_CACHE_CLASSES) {
+		ikm_check_initialized(kmsg, size);
+
+		cache = &ipc_kmsg_cache[cpu_number()][class];
+		if (cache->ikc_count < cache->ikc_depth) {
+			kmsg->ikm_next = cache->ikc_kmsgs;
+			cache->ikc_kmsgs = kmsg;
+			cache->ikc_count++;
+			cache->ikc_frees++;
+			return;
+		}
+		cache->ikc_overflows++;
+	}
+
+	ikm_free(kmsg);
+}
+
+#if	MACH_IPC_DEBUG
+
+/*
+ *	Routine:	ipc_kmsg_cache_info
+ *	Purpose:
+ *		Return information about the kmsg caches, one
+ *		element per size class, summed over processors.
+ *		Fills the buffer with as much information as possible
+ *		and returns the desired size of the buffer.
+ *	Conditions:
+ *		Nothing locked.  The caller should provide
+ *		possibly-pageable memory.
+ */
+
+unsigned int
+ipc_kmsg_cache_info(info, count)
+	ipc_info_kmsg_cache_t *info;
+	unsigned int count;
+{
+	int class, cpu;
+
+	if (IKM_CACHE_CLASSES < count)
+		count = IKM_CACHE_CLASSES;
+
+	for (class = 0; class < count; class++) {
+		ipc_info_kmsg_cache_t ikc;
+
+		bzero((char *) &ikc, sizeof ikc);
+		ikc.iikc_size = ikm_cache_size(class);
+
+		for (cpu = 0; cpu < NCPUS; cpu++) {
+			ipc_kmsg_cache_t cache = &ipc_kmsg_cache[cpu][class];
+
+			ikc.iikc_count += cache->ikc_count;
+			ikc.iikc_depth += cache->ikc_depth;
+			ikc.iikc_hits += cache->ikc_hits;
+			ikc.iikc_misses += cache->ikc_misses;
+			ikc.iikc_frees += cache->ikc_frees;
+			ikc.iikc_overflows += cache->ikc_overflows;
+		}
+
+		/* don't touch pageable memory while reading the caches */
+		info[class] = ikc;
+	}
+
+	return IKM_CACHE_CLASSES;
+}
+
+#endif	MACH_IPC_DEBUG
+
 /*
  *	Routine:	ipc_kmsg_get
  *	Purpose:
@@ -707,23 +859,9 @@ ipc_kmsg_get(msg, size, kmsgp)
 	if ((size < sizeof(mach_msg_header_t)) || (size & 3))
 		return MACH_SEND_MSG_TOO_SMALL;
 
-	if (size <= IKM_SAVED_MSG_SIZE) {
-		kmsg = ikm_cache();
-		if (kmsg != IKM_NULL) {
-			ikm_cache() = IKM_NULL;
-			ikm_check_initialized(kmsg, IKM_SAVED_KMSG_SIZE);
-		} else {
-			kmsg = ikm_alloc(IKM_SAVED_MSG_SIZE);
-			if (kmsg == IKM_NULL)
-				return MACH_SEND_NO_BUFFER;
-			ikm_init(kmsg, IKM_SAVED_MSG_SIZE);
-		}
-	} else {
-		kmsg = ikm_alloc(size);
-		if (kmsg == IKM_NULL)
-			return MACH_SEND_NO_BUFFER;
-		ikm_init(kmsg, size);
-	}
+	kmsg = ipc_kmsg_cache_alloc(size);
+	if (kmsg == IKM_NULL)
+		return MACH_SEND_NO_BUFFER;
 
 	if (copyinmsg((char *) msg, (char *) &kmsg->ikm_header, size)) {
 		ikm_free(kmsg);
@@ -800,11 +938,7 @@ ipc_kmsg_put(msg, kmsg, size)
 	else
 		mr = MACH_MSG_SUCCESS;
 
-	if ((kmsg->ikm_size == IKM_SAVED_KMSG_SIZE) &&
-	    (ikm_cache() == IKM_NULL))
-		ikm_cache() = kmsg;
-	else
-		ikm_free(kmsg);
+	ipc_kmsg_cache_free(kmsg);
 
 	return mr;
 }
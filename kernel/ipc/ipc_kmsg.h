@@ -93,6 +93,7 @@
 
 #include <cpus.h>
 #include <mach_ipc_compat.h>
+#include <mach_ipc_debug.h>
 #include <norma_ipc.h>
 
 #include <mach/machine/vm_types.h>
@@ -140,24 +141,65 @@ typedef struct ipc_kmsg {
 #define	ikm_less_overhead(size)	((mach_msg_size_t)((size) - IKM_OVERHEAD))
 
 /*
- *	We keep a per-processor cache of kernel message buffers.
- *	The cache saves the overhead/locking of using kalloc/kfree.
- *	The per-processor cache seems to miss less than a per-thread cache,
- *	and it also uses less memory.  Access to the cache doesn't
- *	require locking.
+ *	The size of the kernel message buffers used by exception RPCs.
+ *	IKM_SAVED_KMSG_SIZE includes overhead; IKM_SAVED_MSG_SIZE doesn't.
  */
 
-extern ipc_kmsg_t ipc_kmsg_cache[NCPUS];
-
-#define ikm_cache()	ipc_kmsg_cache[cpu_number()]
+#define	IKM_SAVED_KMSG_SIZE	((vm_size_t) 256)
+#define	IKM_SAVED_MSG_SIZE	ikm_less_overhead(IKM_SAVED_KMSG_SIZE)
 
 /*
- *	The size of the kernel message buffers that will be cached.
- *	IKM_SAVED_KMSG_SIZE includes overhead; IKM_SAVED_MSG_SIZE doesn't.
+ *	We keep per-processor caches of kernel message buffers,
+ *	one for each of IKM_CACHE_CLASSES buffer sizes, starting
+ *	at IKM_SAVED_KMSG_SIZE and doubling.  The caches save the
+ *	overhead/locking of using kalloc/kfree.  Per-processor caches
+ *	seem to miss less than per-thread caches, and they also use
+ *	less memory.  Access to the caches doesn't require locking,
+ *	but they can't be used at interrupt level.
+ *
+ *	The depth of each cache adapts to its use.  A miss raises
+ *	it, up to a limit that keeps each cache under
+ *	IKM_CACHE_MAX_BYTES; a run of IKM_CACHE_DECAY hits lowers it.
  */
 
-#define	IKM_SAVED_KMSG_SIZE	((vm_size_t) 256)
-#define	IKM_SAVED_MSG_SIZE	ikm_less_overhead(IKM_SAVED_KMSG_SIZE)
+#define	IKM_CACHE_CLASSES	6		/* 256 to 8192 bytes */
+#define	IKM_CACHE_MIN_DEPTH	1
+#define	IKM_CACHE_MAX_DEPTH	16
+#define	IKM_CACHE_MAX_BYTES	((vm_size_t) (32 * 1024))
+#define	IKM_CACHE_DECAY		256
+
+#define	ikm_cache_size(class)	(IKM_SAVED_KMSG_SIZE << (class))
+
+#define	ikm_cache_max_depth(class)					\
+	((IKM_CACHE_MAX_BYTES / ikm_cache_size(class) < IKM_CACHE_MAX_DEPTH) \
+		? IKM_CACHE_MAX_BYTES / ikm_cache_size(class)		\
+		: IKM_CACHE_MAX_DEPTH)
+
+typedef struct ipc_kmsg_cache {
+	ipc_kmsg_t ikc_kmsgs;		/* cached buffers, via ikm_next */
+	unsigned int ikc_count;		/* number of cached buffers */
+	unsigned int ikc_depth;		/* current limit on ikc_count */
+	unsigned int ikc_run;		/* hits since the last miss */
+	unsigned int ikc_hits;		/* allocations from the cache */
+	unsigned int ikc_misses;	/* allocations from kalloc */
+	unsigned int ikc_frees;		/* buffers freed to the cache */
+	unsigned int ikc_overflows;	/* buffers freed with cache full */
+} *ipc_kmsg_cache_t;
+
+extern struct ipc_kmsg_cache ipc_kmsg_cache[NCPUS][IKM_CACHE_CLASSES];
+
+extern ipc_kmsg_t
+ipc_kmsg_cache_alloc(/* mach_msg_size_t */);
+
+extern void
+ipc_kmsg_cache_free(/* ipc_kmsg_t */);
+
+#if	MACH_IPC_DEBUG
+
+extern unsigned int
+ipc_kmsg_cache_info(/* ipc_info_kmsg_cache_t *, unsigned int */);
+
+#endif	MACH_IPC_DEBUG
 
 #define	ikm_alloc(size)							\
 		((ipc_kmsg_t) kalloc(ikm_plus_overhead(size)))
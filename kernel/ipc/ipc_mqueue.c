@@ -177,6 +177,51 @@ ipc_mqueue_init(mqueue)
 	ipc_thread_queue_init(&mqueue->imq_threads);
 }
 
+/*
+ *	Routine:	ipc_mqueue_deliver
+ *	Purpose:
+ *		Give a message that was sent to port to a receiver
+ *		blocked on the queue, or else queue it.
+ *	Conditions:
+ *		The queue is locked.
+ *		(This is sufficient to manipulate port->ip_seqno.)
+ *	Returns:
+ *		TRUE if the message was queued.
+ */
+
+boolean_t
+ipc_mqueue_deliver(mqueue, kmsg, port)
+	ipc_mqueue_t mqueue;
+	ipc_kmsg_t kmsg;
+	ipc_port_t port;
+{
+	ipc_thread_queue_t blockedq = &mqueue->imq_threads;
+	ipc_thread_t th;
+
+	while ((th = ipc_thread_dequeue(blockedq)) != ITH_NULL) {
+		assert(ipc_kmsg_queue_empty(&mqueue->imq_messages));
+
+		thread_go(th);
+
+		/* check if the receiver can handle the message */
+
+		if (kmsg->ikm_header.msgh_size <= th->ith_msize) {
+			th->ith_state = MACH_MSG_SUCCESS;
+			th->ith_kmsg = kmsg;
+			th->ith_seqno = port->ip_seqno++;
+			return FALSE;
+		}
+
+		th->ith_state = MACH_RCV_TOO_LARGE;
+		th->ith_msize = kmsg->ikm_header.msgh_size;
+	}
+
+	/* didn't find a receiver to handle the message */
+
+	ipc_kmsg_enqueue(&mqueue->imq_messages, kmsg);
+	return TRUE;
+}
+
 /*
  *	Routine:	ipc_mqueue_move
  *	Purpose:
@@ -193,14 +238,10 @@ ipc_mqueue_move(dest, source, port)
 	ipc_mqueue_t source;
 	ipc_port_t port;
 {
-	ipc_kmsg_queue_t oldq, newq;
-	ipc_thread_queue_t blockedq;
+	ipc_kmsg_queue_t oldq;
 	ipc_kmsg_t kmsg, next;
-	ipc_thread_t th;
 
 	oldq = &source->imq_messages;
-	newq = &dest->imq_messages;
-	blockedq = &dest->imq_threads;
 
 	for (kmsg = ipc_kmsg_queue_first(oldq);
 	     kmsg != IKM_NULL; kmsg = next) {
@@ -212,32 +253,7 @@ ipc_mqueue_move(dest, source, port)
 			continue;
 
 		ipc_kmsg_rmqueue(oldq, kmsg);
-
-		/* before adding kmsg to newq, check for a blocked receiver */
-
-		while ((th = ipc_thread_dequeue(blockedq)) != ITH_NULL) {
-			assert(ipc_kmsg_queue_empty(newq));
-
-			thread_go(th);
-
-			/* check if the receiver can handle the message */
-
-			if (kmsg->ikm_header.msgh_size <= th->ith_msize) {
-				th->ith_state = MACH_MSG_SUCCESS;
-				th->ith_kmsg = kmsg;
-				th->ith_seqno = port->ip_seqno++;
-
-				goto next_kmsg;
-			}
-
-			th->ith_state = MACH_RCV_TOO_LARGE;
-			th->ith_msize = kmsg->ikm_header.msgh_size;
-		}
-
-		/* didn't find a receiver to handle the message */
-
-		ipc_kmsg_enqueue(newq, kmsg);
-	    next_kmsg:;
+		(void) ipc_mqueue_deliver(dest, kmsg, port);
 	}
 }
 
@@ -486,7 +502,11 @@ ipc_mqueue_send(kmsg, option, time_out)
 		if (receiver == ITH_NULL) {
 			/* no receivers; queue kmsg */
 
-			ipc_kmsg_enqueue_macro(&mqueue->imq_messages, kmsg);
+			if (pset == IPS_NULL)
+				ipc_kmsg_enqueue_macro(&mqueue->imq_messages,
+						       kmsg);
+			else
+				ipc_pset_enqueue(pset, port, kmsg);
 			imq_unlock(mqueue);
 			break;
 		}
@@ -710,6 +730,22 @@ ipc_mqueue_receive(mqueue, option, max_size, time_out,
 			ipc_kmsg_rmqueue_first_macro(kmsgs, kmsg);
 			port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
 			seqno = port->ip_seqno++;
+
+			if (port->ip_pset_kmsg == kmsg) {
+				ipc_kmsg_queue_t backlog;
+				ipc_kmsg_t next;
+
+				/* fair set: the port's next message goes last */
+
+				backlog = &port->ip_messages.imq_messages;
+				next = ipc_kmsg_queue_first(backlog);
+				if (next != IKM_NULL) {
+					ipc_kmsg_rmqueue_first_macro(backlog,
+								     next);
+					ipc_kmsg_enqueue_macro(kmsgs, next);
+				}
+				port->ip_pset_kmsg = next;
+			}
 			break;
 		}
 
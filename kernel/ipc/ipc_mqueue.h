@@ -84,6 +84,9 @@ typedef struct ipc_mqueue {
 extern void
 ipc_mqueue_init(/* ipc_mqueue_t */);
 
+extern boolean_t
+ipc_mqueue_deliver(/* ipc_mqueue_t, ipc_kmsg_t, ipc_port_t */);
+
 extern void
 ipc_mqueue_move(/* ipc_mqueue_t, ipc_mqueue_t, ipc_port_t */);
 
@@ -564,6 +564,7 @@ ipc_port_init(port, space, name)
 
 	port->ip_pset = IPS_NULL;
 	port->ip_seqno = 0;
+	port->ip_pset_kmsg = IKM_NULL;
 	port->ip_msgcount = 0;
 	port->ip_qlimit = MACH_PORT_QLIMIT_DEFAULT;
 
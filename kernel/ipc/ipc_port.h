@@ -148,6 +148,7 @@ typedef struct ipc_port {
 
 	struct ipc_pset *ip_pset;
 	mach_port_seqno_t ip_seqno;		/* locked by message queue */
+	struct ipc_kmsg *ip_pset_kmsg;		/* locked by message queue */
 	mach_port_msgcount_t ip_msgcount;
 	mach_port_msgcount_t ip_qlimit;
 	struct ipc_mqueue ip_messages;
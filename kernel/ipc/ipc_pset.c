@@ -67,6 +67,12 @@
 #include <ipc/ipc_right.h>
 #include <ipc/ipc_space.h>
 
+/*
+ *	New port sets are fair (see ipc/ipc_pset.h) if this is set.
+ *	The owner of a set can change it with mach_port_set_fair.
+ */
+
+boolean_t ipc_pset_fair = FALSE;
 
 /*
  *	Routine:	ipc_pset_alloc
@@ -100,6 +106,7 @@ ipc_pset_alloc(space, namep, psetp)
 	/* pset is locked */
 
 	pset->ips_local_name = name;
+	pset->ips_fair = ipc_pset_fair;
 	ipc_mqueue_init(&pset->ips_messages);
 
 	*namep = name;
@@ -138,6 +145,7 @@ ipc_pset_alloc_name(space, name, psetp)
 	/* pset is locked */
 
 	pset->ips_local_name = name;
+	pset->ips_fair = ipc_pset_fair;
 	ipc_mqueue_init(&pset->ips_messages);
 
 	*psetp = pset;
@@ -170,11 +178,32 @@ ipc_pset_add(pset, port)
 	imq_lock(&port->ip_messages);
 	imq_lock(&pset->ips_messages);
 
-	/* move messages from port's queue to the port set's queue */
+	if (pset->ips_fair) {
+		ipc_kmsg_queue_t kmsgs = &port->ip_messages.imq_messages;
+		ipc_kmsg_t kmsg;
+
+		/*
+		 *	Hand messages to blocked receivers until one
+		 *	is queued in the set.  The rest stay behind it
+		 *	on the port's queue.
+		 */
+
+		assert(port->ip_pset_kmsg == IKM_NULL);
+		while ((kmsg = ipc_kmsg_queue_first(kmsgs)) != IKM_NULL) {
+			ipc_kmsg_rmqueue_first_macro(kmsgs, kmsg);
+			if (ipc_mqueue_deliver(&pset->ips_messages,
+					       kmsg, port)) {
+				port->ip_pset_kmsg = kmsg;
+				break;
+			}
+		}
+	} else {
+		/* move messages from port's queue to the port set's queue */
 
-	ipc_mqueue_move(&pset->ips_messages, &port->ip_messages, port);
+		ipc_mqueue_move(&pset->ips_messages, &port->ip_messages, port);
+		assert(ipc_kmsg_queue_empty(&port->ip_messages.imq_messages));
+	}
 	imq_unlock(&pset->ips_messages);
-	assert(ipc_kmsg_queue_empty(&port->ip_messages.imq_messages));
 
 	/* wake up threads waiting to receive from the port */
 
@@ -207,14 +236,122 @@ ipc_pset_remove(pset, port)
 	imq_lock(&port->ip_messages);
 	imq_lock(&pset->ips_messages);
 
-	/* move messages from port set's queue to the port's queue */
+	if (pset->ips_fair) {
+		ipc_kmsg_t kmsg = port->ip_pset_kmsg;
 
-	ipc_mqueue_move(&port->ip_messages, &pset->ips_messages, port);
+		/*
+		 *	The port's other messages are already on its
+		 *	own queue.  Put the one in the set back first.
+		 */
+
+		if (kmsg != IKM_NULL) {
+			ipc_kmsg_queue_t kmsgs =
+				&port->ip_messages.imq_messages;
+
+			ipc_kmsg_rmqueue(&pset->ips_messages.imq_messages,
+					 kmsg);
+			ipc_kmsg_enqueue_macro(kmsgs, kmsg);
+			kmsgs->ikmq_base = kmsg;	/* circular queue */
+			port->ip_pset_kmsg = IKM_NULL;
+		}
+	} else {
+		/* move messages from port set's queue to the port's queue */
+
+		ipc_mqueue_move(&port->ip_messages, &pset->ips_messages, port);
+	}
 
 	imq_unlock(&pset->ips_messages);
 	imq_unlock(&port->ip_messages);
 }
 
+/*
+ *	Routine:	ipc_pset_enqueue
+ *	Purpose:
+ *		Queue a message sent to a member of a port set.
+ *		In a fair set, only the port's oldest message
+ *		goes on the set's queue.
+ *	Conditions:
+ *		The set's message queue is locked.
+ *		The port is a member of the set.
+ */
+
+void
+ipc_pset_enqueue(pset, port, kmsg)
+	ipc_pset_t pset;
+	ipc_port_t port;
+	ipc_kmsg_t kmsg;
+{
+	assert(port->ip_pset == pset);
+
+	if (!pset->ips_fair)
+		ipc_kmsg_enqueue_macro(&pset->ips_messages.imq_messages, kmsg);
+	else if (port->ip_pset_kmsg != IKM_NULL)
+		ipc_kmsg_enqueue_macro(&port->ip_messages.imq_messages, kmsg);
+	else {
+		ipc_kmsg_enqueue_macro(&pset->ips_messages.imq_messages, kmsg);
+		port->ip_pset_kmsg = kmsg;
+	}
+}
+
+/*
+ *	Routine:	ipc_pset_set_fair
+ *	Purpose:
+ *		Make a port set fair or not, rearranging the
+ *		messages queued for its members to suit.
+ *		A set made FIFO keeps each member's messages
+ *		in order, but not the order between members.
+ *	Conditions:
+ *		The port set is locked and active.
+ */
+
+void
+ipc_pset_set_fair(pset, fair)
+	ipc_pset_t pset;
+	boolean_t fair;
+{
+	ipc_kmsg_queue_t kmsgs = &pset->ips_messages.imq_messages;
+	ipc_kmsg_queue_t backlog;
+	ipc_kmsg_t kmsg, next;
+	ipc_port_t port;
+
+	imq_lock(&pset->ips_messages);
+	if (pset->ips_fair == fair) {
+		imq_unlock(&pset->ips_messages);
+		return;
+	}
+
+	for (kmsg = ipc_kmsg_queue_first(kmsgs);
+	     kmsg != IKM_NULL; kmsg = next) {
+		next = ipc_kmsg_queue_next(kmsgs, kmsg);
+		port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
+		backlog = &port->ip_messages.imq_messages;
+
+		if (fair) {
+			/* keep the oldest; the rest wait on the port */
+
+			if (port->ip_pset_kmsg == IKM_NULL)
+				port->ip_pset_kmsg = kmsg;
+			else {
+				ipc_kmsg_rmqueue(kmsgs, kmsg);
+				ipc_kmsg_enqueue_macro(backlog, kmsg);
+			}
+		} else if (port->ip_pset_kmsg == kmsg) {
+			/* bring the port's other messages back */
+
+			while ((next = ipc_kmsg_queue_first(backlog))
+							!= IKM_NULL) {
+				ipc_kmsg_rmqueue_first_macro(backlog, next);
+				ipc_kmsg_enqueue_macro(kmsgs, next);
+			}
+			port->ip_pset_kmsg = IKM_NULL;
+			next = ipc_kmsg_queue_next(kmsgs, kmsg);
+		}
+	}
+
+	pset->ips_fair = fair;
+	imq_unlock(&pset->ips_messages);
+}
+
 /*
  *	Routine:	ipc_pset_move
  *	Purpose:
@@ -357,7 +494,8 @@ ipc_pset_print(pset)
 	indent += 2;
 
 	ipc_object_print(&pset->ips_object);
-	iprintf("local_name = 0x%x\n", pset->ips_local_name);
+	iprintf("local_name = 0x%x", pset->ips_local_name);
+	printf(",fair = %d\n", pset->ips_fair);
 	iprintf("kmsgs = 0x%x", pset->ips_messages.imq_messages.ikmq_base);
 	printf(",rcvrs = 0x%x\n", pset->ips_messages.imq_threads.ithq_base);
 
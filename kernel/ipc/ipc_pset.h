@@ -67,10 +67,29 @@
 #include <ipc/ipc_object.h>
 #include <ipc/ipc_mqueue.h>
 
+/*
+ *  A port set's message queue usually holds all the messages
+ *  sent to its members, in the order they were sent.
+ *
+ *  A fair set (ips_fair) holds only the oldest message of each
+ *  member that has messages.  That member's ip_pset_kmsg points to
+ *  the message, and the member's other messages wait on its own
+ *  queue, which the set's message queue lock protects while the
+ *  port is in the set.  The set's queue is then a ready list of
+ *  members.  Receiving a message moves the member's next message
+ *  to the end of the list.  The members are served round-robin
+ *  however many messages each one has queued, and receives still
+ *  take the first message of the set's queue.
+ *
+ *  New sets take ips_fair from ipc_pset_fair; mach_port_set_fair
+ *  changes it for one set.
+ */
+
 typedef struct ipc_pset {
 	struct ipc_object ips_object;
 
 	mach_port_t ips_local_name;
+	boolean_t ips_fair;		/* serve members round-robin */
 	struct ipc_mqueue ips_messages;
 } *ipc_pset_t;
 
@@ -92,12 +111,20 @@ ipc_pset_alloc(/* ipc_space_t, mach_port_t *, ipc_pset_t * */);
 extern kern_return_t
 ipc_pset_alloc_name(/* ipc_space_t, mach_port_t, ipc_pset_t * */);
 
+extern boolean_t ipc_pset_fair;
+
 extern void
 ipc_pset_add(/* ipc_pset_t, ipc_port_t */);
 
 extern void
 ipc_pset_remove(/* ipc_pset_t, ipc_port_t */);
 
+extern void
+ipc_pset_enqueue(/* ipc_pset_t, ipc_port_t, ipc_kmsg_t */);
+
+extern void
+ipc_pset_set_fair(/* ipc_pset_t, boolean_t */);
+
 extern kern_return_t
 ipc_pset_move(/* ipc_space_t, mach_port_t, mach_port_t */);
 
@@ -280,6 +280,7 @@ ipc_space_destroy(space)
 	ipc_space_t space;
 {
 	ipc_tree_entry_t tentry;
+	mach_port_t tname;
 	ipc_entry_t table;
 	ipc_entry_num_t size;
 	mach_port_index_t index;
@@ -331,11 +332,15 @@ ipc_space_destroy(space)
 
 	it_entries_free(space->is_table_next-1, table);
 
-	for (tentry = ipc_splay_traverse_start(&space->is_tree);
-	     tentry != ITE_NULL;
-	     tentry = ipc_splay_traverse_next(&space->is_tree, TRUE)) {
+	/*
+	 *	Empty the tree one entry at a time rather than with
+	 *	a traversal: ipc_right_clean can block, and a traversal
+	 *	holds the tree's simple lock.  Nobody else looks at the
+	 *	tree of a dead space, so it needs no lock here.
+	 */
+
+	while (ipc_splay_tree_pick(&space->is_tree, &tname, &tentry)) {
 		mach_port_type_t type = IE_BITS_TYPE(tentry->ite_bits);
-		mach_port_t name = tentry->ite_name;
 
 		assert(type != MACH_PORT_TYPE_NONE);
 
@@ -343,11 +348,11 @@ ipc_space_destroy(space)
 
 		if (type == MACH_PORT_TYPE_SEND)
 			ipc_hash_global_delete(space, tentry->ite_object,
-					       name, tentry);
+					       tname, tentry);
 
-		ipc_right_clean(space, name, &tentry->ite_entry);
+		ipc_right_clean(space, tname, &tentry->ite_entry);
+		ipc_splay_tree_delete(&space->is_tree, tname, tentry);
 	}
-	ipc_splay_traverse_finish(&space->is_tree);
 
 #if	MACH_IPC_COMPAT
 	if (IP_VALID(space->is_notify))
@@ -85,6 +85,13 @@
  *	is_growing marks when the table is in the process of growing.
  *	When the table is growing, it can't be freed or grown by another
  *	thread, because of krealloc/kmem_realloc's requirements.
+ *
+ *	The space lock is a non-sleeping read/write lock.  Name lookups
+ *	(the message send fast paths, ipc_mqueue_copyin, etc.) only take
+ *	it for reading, so threads of one task sending on different
+ *	ports don't serialize on their space.  Anything that changes the
+ *	table, the tree, or an entry takes it for writing.  Holders may
+ *	not block, just as with a simple lock.
  */
 
 typedef unsigned int ipc_space_refs_t;
@@ -93,7 +100,7 @@ typedef struct ipc_space {
 	decl_simple_lock_data(,is_ref_lock_data)
 	ipc_space_refs_t is_references;
 
-	decl_simple_lock_data(,is_lock_data)
+	lock_data_t is_lock_data;	/* read/write lock, never sleeps */
 	boolean_t is_active;		/* is the space alive? */
 	boolean_t is_growing;		/* is the space growing? */
 	ipc_entry_t is_table;		/* an array of entries */
@@ -145,16 +152,16 @@ MACRO_BEGIN								\
 		is_free(is);						\
 MACRO_END
 
-#define	is_lock_init(is)	simple_lock_init(&(is)->is_lock_data)
+#define	is_lock_init(is)	lock_init(&(is)->is_lock_data, FALSE)
 
-#define	is_read_lock(is)	simple_lock(&(is)->is_lock_data)
-#define is_read_unlock(is)	simple_unlock(&(is)->is_lock_data)
+#define	is_read_lock(is)	lock_read(&(is)->is_lock_data)
+#define is_read_unlock(is)	lock_read_done(&(is)->is_lock_data)
 
-#define	is_write_lock(is)	simple_lock(&(is)->is_lock_data)
-#define	is_write_lock_try(is)	simple_lock_try(&(is)->is_lock_data)
-#define is_write_unlock(is)	simple_unlock(&(is)->is_lock_data)
+#define	is_write_lock(is)	lock_write(&(is)->is_lock_data)
+#define	is_write_lock_try(is)	lock_try_write(&(is)->is_lock_data)
+#define is_write_unlock(is)	lock_write_done(&(is)->is_lock_data)
 
-#define	is_write_to_read_lock(is)
+#define	is_write_to_read_lock(is) lock_write_to_read(&(is)->is_lock_data)
 
 extern void ipc_space_reference(/* ipc_space_t space */);
 extern void ipc_space_release(/* ipc_space_t space */);
@@ -58,7 +58,7 @@
  *	Author:	Rich Draves
  *	Date:	1989
  *
- *	Primitive splay tree operations.
+ *	Primitive operations on the tree of overflow entries.
  */
 
 #include <mach/port.h>
@@ -70,210 +70,290 @@
 
 
 /*
- *	Splay trees are self-adjusting binary search trees.
- *	They have the following attractive properties:
- *		1) Space efficient; only two pointers per entry.
- *		2) Robust performance; amortized O(log n) per operation.
- *		3) Recursion not needed.
- *	This makes them a good fall-back data structure for those
- *	entries that don't fit into the lookup table.
+ *	The tree holds the entries that don't fit into a space's table.
+ *	It used to be a splay tree, but splaying restructures the tree
+ *	on every lookup.  With many entries in the tree that means writes
+ *	to shared entries on every name translation, and lookups can't
+ *	run in parallel under the space's read lock.
  *
- *	The paper by Sleator and Tarjan, JACM v. 32, no. 3, pp. 652-686,
- *	describes the splaying operation.  ipc_splay_prim_lookup
- *	and ipc_splay_prim_assemble implement the top-down splay
- *	described on p. 669.
+ *	It is now a height-balanced (AVL) binary search tree, still
+ *	threaded through the ite_lchild/ite_rchild fields of the entries,
+ *	so insertions need no memory allocation.  Lookups, picks and
+ *	bounds never write to the tree.  The height of the tree is at most
+ *	about 1.44 log2(n), so lookups touch few entries even when a task
+ *	holds hundreds of thousands of rights.
  *
- *	The tree is stored in an unassembled form.  If ist_root is null,
- *	then the tree has no entries.  Otherwise, ist_name records
- *	the value used for the last lookup.  ist_root points to the
- *	middle tree obtained from the top-down splay.  ist_ltree and
- *	ist_rtree point to left and right subtrees, whose entries
- *	are all smaller (larger) than those in the middle tree.
- *	ist_ltreep and ist_rtreep are pointers to fields in the
- *	left and right subtrees.  ist_ltreep points to the rchild field
- *	of the largest entry in ltree, and ist_rtreep points to the
- *	lchild field of the smallest entry in rtree.  The pointed-to
- *	fields aren't initialized.  If the left (right) subtree is null,
- *	then ist_ltreep (ist_rtreep) points to the ist_ltree (ist_rtree)
- *	field in the splay structure itself.
+ *	Insertion, deletion, split and join restructure the tree, and
+ *	callers hold the space write lock (or own the tree privately).
+ *	A traversal keeps its position in the tree's one ist_next
+ *	cursor, so ipc_splay_traverse_start takes the tree's lock and
+ *	ipc_splay_traverse_finish releases it.  Two readers of a space
+ *	that traverse the tree (mach_port_names, say) take turns;
+ *	lookups take no tree lock and go on meanwhile.
  *
- *	The primary advantage of the unassembled form is that repeated
- *	unsuccessful lookups are efficient.  In particular, an unsuccessful
- *	lookup followed by an insert only requires one splaying operation.
- *
- *	The traversal algorithm works via pointer inversion.
- *	When descending down the tree, child pointers are reversed
- *	to point back to the parent entry.  When ascending,
- *	the pointers are restored to their original value.
- *
- *	The biggest potential problem with the splay tree implementation
- *	is that the operations, even lookup, require an exclusive lock.
- *	If IPC spaces are protected with exclusive locks, then
- *	the splay tree doesn't require its own lock, and ist_lock/ist_unlock
- *	needn't do anything.  If IPC spaces are protected with read/write
- *	locks then ist_lock/ist_unlock should provide exclusive access.
- *
- *	If it becomes important to let lookups run in parallel,
- *	or if the restructuring makes lookups too expensive, then
- *	there is hope.  Use a read/write lock on the splay tree.
- *	Keep track of the number of entries in the tree.  When doing
- *	a lookup, first try a non-restructuring lookup with a read lock held,
- *	with a bound (based on log of size of the tree) on the number of
- *	entries to traverse.  If the lookup runs up against the bound,
- *	then take a write lock and do a reorganizing lookup.
- *	This way, if lookups only access roughly balanced parts
- *	of the tree, then lookups run in parallel and do no restructuring.
- *
- *	The traversal algorithm currently requires an exclusive lock.
- *	If that is a problem, the tree could be changed from an lchild/rchild
- *	representation to a leftmost child/right sibling representation.
- *	In conjunction with non-restructing lookups, this would let
- *	lookups and traversals all run in parallel.  But this representation
- *	is more complicated and would slow down the operations.
+ *	The routine names are unchanged so that users of the
+ *	tree didn't have to change.
  */
 
 /*
- *	Boundary values to hand to ipc_splay_prim_lookup:
+ *	Boundary values returned by ipc_splay_tree_bounds:
  */
 
 #define	MACH_PORT_SMALLEST	((mach_port_t) 0)
 #define MACH_PORT_LARGEST	((mach_port_t) ~0)
 
 /*
- *	Routine:	ipc_splay_prim_lookup
+ *	The height of an AVL tree with n entries is less than
+ *	1.44 log2(n+2), so this is enough for any 32-bit name space.
+ */
+
+#define	IPC_SPLAY_MAX_HEIGHT	48
+
+#define	ite_height_of(entry)						\
+		(((entry) == ITE_NULL) ? 0 : (entry)->ite_height)
+
+/*
+ *	Routine:	ipc_splay_prim_height
  *	Purpose:
- *		Searches for the node labeled name in the splay tree.
- *		Returns three nodes (treep, ltreep, rtreep) and
- *		two pointers to nodes (ltreepp, rtreepp).
- *
- *		ipc_splay_prim_lookup splits the supplied tree into
- *		three subtrees, left, middle, and right, returned
- *		in ltreep, treep, and rtreep.
- *
- *		If name is present in the tree, then it is at
- *		the root of the middle tree.  Otherwise, the root
- *		of the middle tree is the last node traversed.
- *
- *		ipc_splay_prim_lookup returns a pointer into
- *		the left subtree, to the rchild field of its
- *		largest node, in ltreepp.  It returns a pointer
- *		into the right subtree, to the lchild field of its
- *		smallest node, in rtreepp.
+ *		Recomputes the height of an entry from its children.
+ */
+
+static void
+ipc_splay_prim_height(entry)
+	ipc_tree_entry_t entry;
+{
+	unsigned int lheight = ite_height_of(entry->ite_lchild);
+	unsigned int rheight = ite_height_of(entry->ite_rchild);
+
+	entry->ite_height = ((lheight > rheight) ? lheight : rheight) + 1;
+}
+
+/*
+ *	Routine:	ipc_splay_prim_rotate
+ *	Purpose:
+ *		Rotates the subtree at *treep.  If "left" is TRUE,
+ *		the right child moves up; otherwise the left child does.
  */
 
 static void
-ipc_splay_prim_lookup(name, tree, treep, ltreep, ltreepp, rtreep, rtreepp)
+ipc_splay_prim_rotate(treep, left)
+	ipc_tree_entry_t *treep;
+	boolean_t left;
+{
+	ipc_tree_entry_t tree = *treep;
+	ipc_tree_entry_t child;
+
+	if (left) {
+		child = tree->ite_rchild;
+		tree->ite_rchild = child->ite_lchild;
+		child->ite_lchild = tree;
+	} else {
+		child = tree->ite_lchild;
+		tree->ite_lchild = child->ite_rchild;
+		child->ite_rchild = tree;
+	}
+
+	ipc_splay_prim_height(tree);
+	ipc_splay_prim_height(child);
+	*treep = child;
+}
+
+/*
+ *	Routine:	ipc_splay_prim_balance
+ *	Purpose:
+ *		Restores the height invariant at *treep, assuming
+ *		the subtrees of *treep are balanced and their heights
+ *		differ by at most two.  Recomputes the height.
+ */
+
+static void
+ipc_splay_prim_balance(treep)
+	ipc_tree_entry_t *treep;
+{
+	ipc_tree_entry_t tree = *treep;
+	unsigned int lheight = ite_height_of(tree->ite_lchild);
+	unsigned int rheight = ite_height_of(tree->ite_rchild);
+
+	if (lheight > rheight + 1) {
+		ipc_tree_entry_t child = tree->ite_lchild;
+
+		if (ite_height_of(child->ite_lchild) <
+		    ite_height_of(child->ite_rchild))
+			ipc_splay_prim_rotate(&tree->ite_lchild, TRUE);
+		ipc_splay_prim_rotate(treep, FALSE);
+	} else if (rheight > lheight + 1) {
+		ipc_tree_entry_t child = tree->ite_rchild;
+
+		if (ite_height_of(child->ite_rchild) <
+		    ite_height_of(child->ite_lchild))
+			ipc_splay_prim_rotate(&tree->ite_rchild, FALSE);
+		ipc_splay_prim_rotate(treep, TRUE);
+	} else
+		ipc_splay_prim_height(tree);
+}
+
+/*
+ *	Routine:	ipc_splay_prim_remove
+ *	Purpose:
+ *		Unlinks the entry labeled name from the tree at *treep
+ *		and rebalances.  The name must be present.
+ *		Returns the unlinked entry, which isn't freed.
+ */
+
+static ipc_tree_entry_t
+ipc_splay_prim_remove(treep, name)
+	ipc_tree_entry_t *treep;
 	mach_port_t name;
-	ipc_tree_entry_t tree, *treep;
-	ipc_tree_entry_t *ltreep, **ltreepp;
-	ipc_tree_entry_t *rtreep, **rtreepp;
 {
-	mach_port_t tname;			/* temp name */
-	ipc_tree_entry_t lchild, rchild;	/* temp child pointers */
-
-	assert(tree != ITE_NULL);
-
-#define	link_left					\
-MACRO_BEGIN						\
-	*ltreep = tree;					\
-	ltreep = &tree->ite_rchild;			\
-	tree = *ltreep;					\
-MACRO_END
-
-#define	link_right					\
-MACRO_BEGIN						\
-	*rtreep = tree;					\
-	rtreep = &tree->ite_lchild;			\
-	tree = *rtreep;					\
-MACRO_END
-
-#define rotate_left					\
-MACRO_BEGIN						\
-	ipc_tree_entry_t temp = tree;			\
-							\
-	tree = temp->ite_rchild;			\
-	temp->ite_rchild = tree->ite_lchild;		\
-	tree->ite_lchild = temp;			\
-MACRO_END
-
-#define rotate_right					\
-MACRO_BEGIN						\
-	ipc_tree_entry_t temp = tree;			\
-							\
-	tree = temp->ite_lchild;			\
-	temp->ite_lchild = tree->ite_rchild;		\
-	tree->ite_rchild = temp;			\
-MACRO_END
-
-	while (name != (tname = tree->ite_name)) {
-		if (name < tname) {
-			/* descend to left */
-
-			lchild = tree->ite_lchild;
-			if (lchild == ITE_NULL)
-				break;
-			tname = lchild->ite_name;
-
-			if ((name < tname) &&
-			    (lchild->ite_lchild != ITE_NULL))
-				rotate_right;
-			link_right;
-			if ((name > tname) &&
-			    (lchild->ite_rchild != ITE_NULL))
-				link_left;
-		} else {
-			/* descend to right */
-
-			rchild = tree->ite_rchild;
-			if (rchild == ITE_NULL)
-				break;
-			tname = rchild->ite_name;
-
-			if ((name > tname) &&
-			    (rchild->ite_rchild != ITE_NULL))
-				rotate_left;
-			link_left;
-			if ((name < tname) &&
-			    (rchild->ite_lchild != ITE_NULL))
-				link_right;
+	ipc_tree_entry_t *path[IPC_SPLAY_MAX_HEIGHT];
+	ipc_tree_entry_t entry, succ;
+	ipc_tree_entry_t *succp;
+	int depth = 0, spot;
+
+	for (;;) {
+		entry = *treep;
+		assert(entry != ITE_NULL);
+
+		if (entry->ite_name == name)
+			break;
+
+		assert(depth < IPC_SPLAY_MAX_HEIGHT);
+		path[depth++] = treep;
+		treep = (name < entry->ite_name) ?
+			&entry->ite_lchild : &entry->ite_rchild;
+	}
+
+	if (entry->ite_lchild == ITE_NULL)
+		*treep = entry->ite_rchild;
+	else if (entry->ite_rchild == ITE_NULL)
+		*treep = entry->ite_lchild;
+	else {
+		/*
+		 *	Replace the entry with the smallest entry
+		 *	in its right subtree.  Entries are linked,
+		 *	not copied, because other structures point
+		 *	at them.
+		 */
+
+		assert(depth < IPC_SPLAY_MAX_HEIGHT);
+		spot = depth;
+		path[depth++] = treep;
+
+		succp = &entry->ite_rchild;
+		while ((*succp)->ite_lchild != ITE_NULL) {
+			assert(depth < IPC_SPLAY_MAX_HEIGHT);
+			path[depth++] = succp;
+			succp = &(*succp)->ite_lchild;
 		}
 
-		assert(tree != ITE_NULL);
+		succ = *succp;
+		*succp = succ->ite_rchild;
+		succ->ite_lchild = entry->ite_lchild;
+		succ->ite_rchild = entry->ite_rchild;
+		*treep = succ;
+
+		/* the path went through the removed entry */
+
+		if (spot + 1 < depth)
+			path[spot + 1] = &succ->ite_rchild;
+	}
+
+	while (--depth >= 0)
+		ipc_splay_prim_balance(path[depth]);
+
+	return entry;
+}
+
+/*
+ *	Routine:	ipc_splay_prim_join
+ *	Purpose:
+ *		Makes a tree from "ltree", "entry", and "rtree",
+ *		where every name in ltree is smaller than entry's name
+ *		and every name in rtree is larger.  Returns the root.
+ *
+ *		Recursion depth is bounded by the difference
+ *		in height of the two trees.
+ */
+
+static ipc_tree_entry_t
+ipc_splay_prim_join(ltree, entry, rtree)
+	ipc_tree_entry_t ltree, entry, rtree;
+{
+	unsigned int lheight = ite_height_of(ltree);
+	unsigned int rheight = ite_height_of(rtree);
+
+	if (lheight > rheight + 1) {
+		ltree->ite_rchild =
+			ipc_splay_prim_join(ltree->ite_rchild, entry, rtree);
+		ipc_splay_prim_balance(&ltree);
+		return ltree;
 	}
 
-	*treep = tree;
-	*ltreepp = ltreep;
-	*rtreepp = rtreep;
+	if (rheight > lheight + 1) {
+		rtree->ite_lchild =
+			ipc_splay_prim_join(ltree, entry, rtree->ite_lchild);
+		ipc_splay_prim_balance(&rtree);
+		return rtree;
+	}
 
-#undef	link_left
-#undef	link_right
-#undef	rotate_left
-#undef	rotate_right
+	entry->ite_lchild = ltree;
+	entry->ite_rchild = rtree;
+	ipc_splay_prim_height(entry);
+	return entry;
 }
 
 /*
- *	Routine:	ipc_splay_prim_assemble
+ *	Routine:	ipc_splay_prim_split
  *	Purpose:
- *		Assembles the results of ipc_splay_prim_lookup
- *		into a splay tree with the found node at the root.
+ *		Splits the tree into entries smaller than name,
+ *		returned in *ltreep, and the rest, in *rtreep.
  *
- *		ltree and rtree are by-reference so storing
- *		through ltreep and rtreep can change them.
+ *		Recursion depth is bounded by the height of the tree.
  */
 
 static void
-ipc_splay_prim_assemble(tree, ltree, ltreep, rtree, rtreep)
+ipc_splay_prim_split(tree, name, ltreep, rtreep)
 	ipc_tree_entry_t tree;
-	ipc_tree_entry_t *ltree, *ltreep;
-	ipc_tree_entry_t *rtree, *rtreep;
+	mach_port_t name;
+	ipc_tree_entry_t *ltreep, *rtreep;
 {
-	assert(tree != ITE_NULL);
+	ipc_tree_entry_t ltree, rtree;
+
+	if (tree == ITE_NULL) {
+		*ltreep = ITE_NULL;
+		*rtreep = ITE_NULL;
+	} else if (name <= tree->ite_name) {
+		ipc_splay_prim_split(tree->ite_lchild, name, ltreep, &rtree);
+		*rtreep = ipc_splay_prim_join(rtree, tree, tree->ite_rchild);
+	} else {
+		ipc_splay_prim_split(tree->ite_rchild, name, &ltree, rtreep);
+		*ltreep = ipc_splay_prim_join(tree->ite_lchild, tree, ltree);
+	}
+}
 
-	*ltreep = tree->ite_lchild;
-	*rtreep = tree->ite_rchild;
+/*
+ *	Routine:	ipc_splay_prim_next
+ *	Purpose:
+ *		Returns the entry with the smallest name
+ *		larger than "name", or ITE_NULL.
+ */
 
-	tree->ite_lchild = *ltree;
-	tree->ite_rchild = *rtree;
+static ipc_tree_entry_t
+ipc_splay_prim_next(tree, name)
+	ipc_tree_entry_t tree;
+	mach_port_t name;
+{
+	ipc_tree_entry_t next = ITE_NULL;
+
+	while (tree != ITE_NULL) {
+		if (name < tree->ite_name) {
+			next = tree;
+			tree = tree->ite_lchild;
+		} else
+			tree = tree->ite_rchild;
+	}
+
+	return next;
 }
 
 /*
@@ -286,7 +366,9 @@ void
 ipc_splay_tree_init(splay)
 	ipc_splay_tree_t splay;
 {
+	ist_lock_init(splay);
 	splay->ist_root = ITE_NULL;
+	splay->ist_next = ITE_NULL;
 }
 
 /*
@@ -304,16 +386,12 @@ ipc_splay_tree_pick(splay, namep, entryp)
 {
 	ipc_tree_entry_t root;
 
-	ist_lock(splay);
-
 	root = splay->ist_root;
 	if (root != ITE_NULL) {
 		*namep = root->ite_name;
 		*entryp = root;
 	}
 
-	ist_unlock(splay);
-
 	return root != ITE_NULL;
 }
 
@@ -322,6 +400,7 @@ ipc_splay_tree_pick(splay, namep, entryp)
  *	Purpose:
  *		Finds an entry in a splay tree.
  *		Returns ITE_NULL if not found.
+ *		Doesn't modify the tree.
  */
 
 ipc_tree_entry_t
@@ -329,30 +408,14 @@ ipc_splay_tree_lookup(splay, name)
 	ipc_splay_tree_t splay;
 	mach_port_t name;
 {
-	ipc_tree_entry_t root;
-
-	ist_lock(splay);
+	register ipc_tree_entry_t entry;
 
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-			splay->ist_name = name;
-			splay->ist_root = root;
-		}
+	entry = splay->ist_root;
+	while ((entry != ITE_NULL) && (entry->ite_name != name))
+		entry = (name < entry->ite_name) ?
+			entry->ite_lchild : entry->ite_rchild;
 
-		if (name != root->ite_name)
-			root = ITE_NULL;
-	}
-
-	ist_unlock(splay);
-
-	return root;
+	return entry;
 }
 
 /*
@@ -369,51 +432,30 @@ ipc_splay_tree_insert(splay, name, entry)
 	mach_port_t name;
 	ipc_tree_entry_t entry;
 {
-	ipc_tree_entry_t root;
+	ipc_tree_entry_t *path[IPC_SPLAY_MAX_HEIGHT];
+	ipc_tree_entry_t *treep;
+	int depth = 0;
 
 	assert(entry != ITE_NULL);
 
-	ist_lock(splay);
+	treep = &splay->ist_root;
+	while (*treep != ITE_NULL) {
+		assert((*treep)->ite_name != name);
+		assert(depth < IPC_SPLAY_MAX_HEIGHT);
 
-	root = splay->ist_root;
-	if (root == ITE_NULL) {
-		entry->ite_lchild = ITE_NULL;
-		entry->ite_rchild = ITE_NULL;
-	} else {
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-		}
-
-		assert(root->ite_name != name);
-
-		if (name < root->ite_name) {
-			assert(root->ite_lchild == ITE_NULL);
-
-			*splay->ist_ltreep = ITE_NULL;
-			*splay->ist_rtreep = root;
-		} else {
-			assert(root->ite_rchild == ITE_NULL);
-
-			*splay->ist_ltreep = root;
-			*splay->ist_rtreep = ITE_NULL;
-		}
-
-		entry->ite_lchild = splay->ist_ltree;
-		entry->ite_rchild = splay->ist_rtree;
+		path[depth++] = treep;
+		treep = (name < (*treep)->ite_name) ?
+			&(*treep)->ite_lchild : &(*treep)->ite_rchild;
 	}
 
 	entry->ite_name = name;
-	splay->ist_root = entry;
-	splay->ist_name = name;
-	splay->ist_ltreep = &splay->ist_ltree;
-	splay->ist_rtreep = &splay->ist_rtree;
+	entry->ite_lchild = ITE_NULL;
+	entry->ite_rchild = ITE_NULL;
+	entry->ite_height = 1;
+	*treep = entry;
 
-	ist_unlock(splay);
+	while (--depth >= 0)
+		ipc_splay_prim_balance(path[depth]);
 }
 
 /*
@@ -422,9 +464,6 @@ ipc_splay_tree_insert(splay, name, entry)
  *		Deletes an entry from a splay tree.
  *		The name must be present in the tree.
  *		Frees the entry.
- *
- *		The "entry" argument isn't currently used.
- *		Other implementations might want it, though.
  */
 
 void
@@ -433,59 +472,11 @@ ipc_splay_tree_delete(splay, name, entry)
 	mach_port_t name;
 	ipc_tree_entry_t entry;
 {
-	ipc_tree_entry_t root, saved;
+	ipc_tree_entry_t removed;
 
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	assert(root != ITE_NULL);
-
-	if (splay->ist_name != name) {
-		ipc_splay_prim_assemble(root,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-		ipc_splay_prim_lookup(name, root, &root,
-			&splay->ist_ltree, &splay->ist_ltreep,
-			&splay->ist_rtree, &splay->ist_rtreep);
-	}
-
-	assert(root->ite_name == name);
-	assert(root == entry);
-
-	*splay->ist_ltreep = root->ite_lchild;
-	*splay->ist_rtreep = root->ite_rchild;
-	ite_free(root);
-
-	root = splay->ist_ltree;
-	saved = splay->ist_rtree;
-
-	if (root == ITE_NULL)
-		root = saved;
-	else if (saved != ITE_NULL) {
-		/*
-		 *	Find the largest node in the left subtree, and splay it
-		 *	to the root.  Then add the saved right subtree.
-		 */
-
-		ipc_splay_prim_lookup(MACH_PORT_LARGEST, root, &root,
-			&splay->ist_ltree, &splay->ist_ltreep,
-			&splay->ist_rtree, &splay->ist_rtreep);
-		ipc_splay_prim_assemble(root,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-
-		assert(root->ite_rchild == ITE_NULL);
-		root->ite_rchild = saved;
-	}
-
-	splay->ist_root = root;
-	if (root != ITE_NULL) {
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
-	}
-
-	ist_unlock(splay);
+	removed = ipc_splay_prim_remove(&splay->ist_root, name);
+	assert(removed == entry);
+	ite_free(removed);
 }
 
 /*
@@ -504,70 +495,13 @@ ipc_splay_tree_split(splay, name, small)
 	mach_port_t name;
 	ipc_splay_tree_t small;
 {
-	ipc_tree_entry_t root;
+	ipc_tree_entry_t ltree, rtree;
 
 	ipc_splay_tree_init(small);
 
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		/* lookup name, to get it (or last traversed) to the top */
-
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-		}
-
-		if (root->ite_name < name) {
-			/* root goes into small */
-
-			*splay->ist_ltreep = root->ite_lchild;
-			*splay->ist_rtreep = ITE_NULL;
-			root->ite_lchild = splay->ist_ltree;
-			assert(root->ite_rchild == ITE_NULL);
-
-			small->ist_root = root;
-			small->ist_name = root->ite_name;
-			small->ist_ltreep = &small->ist_ltree;
-			small->ist_rtreep = &small->ist_rtree;
-
-			/* rtree goes into splay */
-
-			root = splay->ist_rtree;
-			splay->ist_root = root;
-			if (root != ITE_NULL) {
-				splay->ist_name = root->ite_name;
-				splay->ist_ltreep = &splay->ist_ltree;
-				splay->ist_rtreep = &splay->ist_rtree;
-			}
-		} else {
-			/* root stays in splay */
-
-			*splay->ist_ltreep = root->ite_lchild;
-			root->ite_lchild = ITE_NULL;
-
-			splay->ist_root = root;
-			splay->ist_name = name;
-			splay->ist_ltreep = &splay->ist_ltree;
-
-			/* ltree goes into small */
-
-			root = splay->ist_ltree;
-			small->ist_root = root;
-			if (root != ITE_NULL) {
-				small->ist_name = root->ite_name;
-				small->ist_ltreep = &small->ist_ltree;
-				small->ist_rtreep = &small->ist_rtree;
-			}
-		}		
-	}
-
-	ist_unlock(splay);
+	ipc_splay_prim_split(splay->ist_root, name, &ltree, &rtree);
+	small->ist_root = ltree;
+	splay->ist_root = rtree;
 }
 
 /*
@@ -583,61 +517,28 @@ ipc_splay_tree_join(splay, small)
 	ipc_splay_tree_t splay;
 	ipc_splay_tree_t small;
 {
-	ipc_tree_entry_t sroot;
-
-	/* pull entries out of small */
-
-	ist_lock(small);
+	ipc_tree_entry_t sroot, largest;
 
 	sroot = small->ist_root;
-	if (sroot != ITE_NULL) {
-		ipc_splay_prim_assemble(sroot,
-			&small->ist_ltree, small->ist_ltreep,
-			&small->ist_rtree, small->ist_rtreep);
-		small->ist_root = ITE_NULL;
-	}
-
-	ist_unlock(small);
-
-	/* put entries, if any, into splay */
+	if (sroot == ITE_NULL)
+		return;
+	small->ist_root = ITE_NULL;
 
-	if (sroot != ITE_NULL) {
-		ipc_tree_entry_t root;
-
-		ist_lock(splay);
+	if (splay->ist_root == ITE_NULL) {
+		splay->ist_root = sroot;
+		return;
+	}
 
-		root = splay->ist_root;
-		if (root == ITE_NULL) {
-			root = sroot;
-		} else {
-			/* get smallest entry in splay tree to top */
-
-			if (splay->ist_name != MACH_PORT_SMALLEST) {
-				ipc_splay_prim_assemble(root,
-					&splay->ist_ltree, splay->ist_ltreep,
-					&splay->ist_rtree, splay->ist_rtreep);
-				ipc_splay_prim_lookup(MACH_PORT_SMALLEST,
-					root, &root,
-					&splay->ist_ltree, &splay->ist_ltreep,
-					&splay->ist_rtree, &splay->ist_rtreep);
-			}
-
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-
-			assert(root->ite_lchild == ITE_NULL);
-			assert(sroot->ite_name < root->ite_name);
-			root->ite_lchild = sroot;
-		}
+	/* use the largest small entry to glue the trees together */
 
-		splay->ist_root = root;
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
+	for (largest = sroot;
+	     largest->ite_rchild != ITE_NULL;
+	     largest = largest->ite_rchild)
+		continue;
 
-		ist_unlock(splay);
-	}
+	(void) ipc_splay_prim_remove(&sroot, largest->ite_name);
+	splay->ist_root = ipc_splay_prim_join(sroot, largest,
+					      splay->ist_root);
 }
 
 /*
@@ -670,66 +571,29 @@ ipc_splay_tree_bounds(splay, name, lowerp, upperp)
 	mach_port_t name;
 	mach_port_t *lowerp, *upperp;
 {
-	ipc_tree_entry_t root;
-
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root == ITE_NULL) {
-		*lowerp = MACH_PORT_LARGEST;
-		*upperp = MACH_PORT_SMALLEST;
-	} else {
-		mach_port_t rname;
-
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-			splay->ist_name = name;
-			splay->ist_root = root;
-		}
-
-		rname = root->ite_name;
+	ipc_tree_entry_t entry;
+	mach_port_t lower = MACH_PORT_LARGEST;
+	mach_port_t upper = MACH_PORT_SMALLEST;
 
-		/*
-		 *	OK, it's a hack.  We convert the ltreep and rtreep
-		 *	pointers back into real entry pointers,
-		 *	so we can pick the names out of the entries.
-		 */
+	for (entry = splay->ist_root; entry != ITE_NULL;) {
+		mach_port_t ename = entry->ite_name;
 
-		if (rname <= name)
-			*lowerp = rname;
-		else if (splay->ist_ltreep == &splay->ist_ltree)
-			*lowerp = MACH_PORT_LARGEST;
-		else {
-			ipc_tree_entry_t entry;
-
-			entry = (ipc_tree_entry_t)
-				((char *)splay->ist_ltreep -
-				 ((char *)&root->ite_rchild -
-				  (char *)root));
-			*lowerp = entry->ite_name;
+		if (ename == name) {
+			lower = upper = name;
+			break;
 		}
 
-		if (rname >= name)
-			*upperp = rname;
-		else if (splay->ist_rtreep == &splay->ist_rtree)
-			*upperp = MACH_PORT_SMALLEST;
-		else {
-			ipc_tree_entry_t entry;
-
-			entry = (ipc_tree_entry_t)
-				((char *)splay->ist_rtreep -
-				 ((char *)&root->ite_lchild -
-				  (char *)root));
-			*upperp = entry->ite_name;
+		if (name < ename) {
+			upper = ename;
+			entry = entry->ite_lchild;
+		} else {
+			lower = ename;
+			entry = entry->ite_rchild;
 		}
 	}
 
-	ist_unlock(splay);
+	*lowerp = lower;
+	*upperp = upper;
 }
 
 /*
@@ -750,37 +614,24 @@ ipc_splay_tree_bounds(splay, name, lowerp, upperp)
  *		is removed from the tree and deallocated.
  *
  *		During the traversal, the splay tree is locked.
+ *		Each step finds the successor from the root,
+ *		so a traversal without deletions doesn't modify the tree.
  */
 
 ipc_tree_entry_t
 ipc_splay_traverse_start(splay)
 	ipc_splay_tree_t splay;
 {
-	ipc_tree_entry_t current, parent;
+	ipc_tree_entry_t current;
 
 	ist_lock(splay);
 
 	current = splay->ist_root;
-	if (current != ITE_NULL) {
-		ipc_splay_prim_assemble(current,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-
-		parent = ITE_NULL;
-
-		while (current->ite_lchild != ITE_NULL) {
-			ipc_tree_entry_t next;
-
-			next = current->ite_lchild;
-			current->ite_lchild = parent;
-			parent = current;
-			current = next;
-		}
-
-		splay->ist_ltree = current;
-		splay->ist_rtree = parent;
-	}
+	if (current != ITE_NULL)
+		while (current->ite_lchild != ITE_NULL)
+			current = current->ite_lchild;
 
+	splay->ist_next = current;
 	return current;
 }
 
@@ -789,156 +640,29 @@ ipc_splay_traverse_next(splay, delete)
 	ipc_splay_tree_t splay;
 	boolean_t delete;
 {
-	ipc_tree_entry_t current, parent;
-
-	/* pick up where traverse_entry left off */
+	ipc_tree_entry_t current, next;
+	mach_port_t name;
 
-	current = splay->ist_ltree;
-	parent = splay->ist_rtree;
+	current = splay->ist_next;
 	assert(current != ITE_NULL);
 
-	if (!delete)
-		goto traverse_right;
-
-	/* we must delete current and patch the tree */
-
-	if (current->ite_lchild == ITE_NULL) {
-		if (current->ite_rchild == ITE_NULL) {
-			/* like traverse_back, but with deletion */
-
-			if (parent == ITE_NULL) {
-				ite_free(current);
-
-				splay->ist_root = ITE_NULL;
-				return ITE_NULL;
-			}
-
-			if (current->ite_name < parent->ite_name) {
-				ite_free(current);
-
-				current = parent;
-				parent = current->ite_lchild;
-				current->ite_lchild = ITE_NULL;
-				goto traverse_entry;
-			} else {
-				ite_free(current);
-
-				current = parent;
-				parent = current->ite_rchild;
-				current->ite_rchild = ITE_NULL;
-				goto traverse_back;
-			}
-		} else {
-			ipc_tree_entry_t prev;
-
-			prev = current;
-			current = current->ite_rchild;
-			ite_free(prev);
-			goto traverse_left;
-		}
-	} else {
-		if (current->ite_rchild == ITE_NULL) {
-			ipc_tree_entry_t prev;
-
-			prev = current;
-			current = current->ite_lchild;
-			ite_free(prev);
-			goto traverse_back;
-		} else {
-			ipc_tree_entry_t prev;
-			ipc_tree_entry_t ltree, rtree;
-			ipc_tree_entry_t *ltreep, *rtreep;
-
-			/* replace current with largest of left children */
-
-			prev = current;
-			ipc_splay_prim_lookup(MACH_PORT_LARGEST,
-				current->ite_lchild, &current,
-				&ltree, &ltreep, &rtree, &rtreep);
-			ipc_splay_prim_assemble(current,
-				&ltree, ltreep, &rtree, rtreep);
-
-			assert(current->ite_rchild == ITE_NULL);
-			current->ite_rchild = prev->ite_rchild;
-			ite_free(prev);
-			goto traverse_right;
-		}
-	}
-	/*NOTREACHED*/
-
-	/*
-	 *	A state machine:  for each entry, we
-	 *		1) traverse left subtree
-	 *		2) traverse the entry
-	 *		3) traverse right subtree
-	 *		4) traverse back to parent
-	 */
-
-    traverse_left:
-	if (current->ite_lchild != ITE_NULL) {
-		ipc_tree_entry_t next;
-
-		next = current->ite_lchild;
-		current->ite_lchild = parent;
-		parent = current;
-		current = next;
-		goto traverse_left;
-	}
-
-    traverse_entry:
-	splay->ist_ltree = current;
-	splay->ist_rtree = parent;
-	return current;
-
-    traverse_right:
-	if (current->ite_rchild != ITE_NULL) {
-		ipc_tree_entry_t next;
+	name = current->ite_name;
+	next = ipc_splay_prim_next(splay->ist_root, name);
 
-		next = current->ite_rchild;
-		current->ite_rchild = parent;
-		parent = current;
-		current = next;
-		goto traverse_left;
+	if (delete) {
+		(void) ipc_splay_prim_remove(&splay->ist_root, name);
+		ite_free(current);
 	}
 
-    traverse_back:
-	if (parent == ITE_NULL) {
-		splay->ist_root = current;
-		return ITE_NULL;
-	}
-
-	if (current->ite_name < parent->ite_name) {
-		ipc_tree_entry_t prev;
-
-		prev = current;
-		current = parent;
-		parent = current->ite_lchild;
-		current->ite_lchild = prev;
-		goto traverse_entry;
-	} else {
-		ipc_tree_entry_t prev;
-
-		prev = current;
-		current = parent;
-		parent = current->ite_rchild;
-		current->ite_rchild = prev;
-		goto traverse_back;
-	}
+	splay->ist_next = next;
+	return next;
 }
 
 void
 ipc_splay_traverse_finish(splay)
 	ipc_splay_tree_t splay;
 {
-	ipc_tree_entry_t root;
-
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
-	}
+	splay->ist_next = ITE_NULL;
 
 	ist_unlock(splay);
 }
-
@@ -60,20 +60,26 @@
 
 #include <mach/port.h>
 #include <kern/assert.h>
+#include <kern/lock.h>
 #include <kern/macro_help.h>
 #include <ipc/ipc_entry.h>
 
+/*
+ *	The tree is a height-balanced binary search tree.  Lookups
+ *	don't modify it and can run under the space's read lock.
+ *	Updates need the space's write lock.  ist_next is the position
+ *	of a traversal in progress, protected by the tree's own lock.
+ */
+
 typedef struct ipc_splay_tree {
-	mach_port_t ist_name;		/* name used in last lookup */
-	ipc_tree_entry_t ist_root;	/* root of middle tree */
-	ipc_tree_entry_t ist_ltree;	/* root of left tree */
-	ipc_tree_entry_t *ist_ltreep;	/* pointer into left tree */
-	ipc_tree_entry_t ist_rtree;	/* root of right tree */
-	ipc_tree_entry_t *ist_rtreep;	/* pointer into right tree */
+	decl_simple_lock_data(,ist_lock_data)
+	ipc_tree_entry_t ist_root;	/* root of the tree */
+	ipc_tree_entry_t ist_next;	/* current entry of traversal */
 } *ipc_splay_tree_t;
 
-#define	ist_lock(splay)		/* no locking */
-#define ist_unlock(splay)	/* no locking */
+#define	ist_lock_init(splay)	simple_lock_init(&(splay)->ist_lock_data)
+#define	ist_lock(splay)		simple_lock(&(splay)->ist_lock_data)
+#define ist_unlock(splay)	simple_unlock(&(splay)->ist_lock_data)
 
 extern void
 ipc_splay_tree_init(/* ipc_splay_tree_t splay */);
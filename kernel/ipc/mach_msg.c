@@ -150,6 +150,7 @@
 #include <mach/message.h>
 #include <kern/assert.h>
 #include <kern/counters.h>
+#include <kern/kalloc.h>
 #include <kern/lock.h>
 #include <kern/sched_prim.h>
 #include <kern/ipc_sched.h>
@@ -257,6 +258,157 @@ mach_msg_send(msg, option, send_size, time_out, notify)
 	return mr;
 }
 
+/*
+ *	Routine:	mach_msg_send_vector_trap [mach trap]
+ *	Purpose:
+ *		Send one message body to many destinations.
+ *		Each element of the vector supplies a header;
+ *		every message is that header followed by the
+ *		body_size bytes at body.  The body is copied in
+ *		once and must be simple (no MACH_MSGH_BITS_COMPLEX),
+ *		so only the header's rights are copied in per message.
+ *
+ *		The result of each send is stored in its element's
+ *		msgv_return.  A message that couldn't be sent has its
+ *		header rights pseudo-copied out into the element's
+ *		header, as mach_msg does with the whole message.
+ *		A failed send doesn't stop the others, but an
+ *		interrupted one does.  At most mach_msg_vector_max
+ *		messages are sent per trap.  When the vector stops
+ *		early, for either reason, the first unsent element
+ *		is marked MACH_SEND_INTERRUPTED; the caller resends
+ *		from there.
+ *
+ *		The only option is MACH_SEND_TIMEOUT.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		MACH_MSG_SUCCESS	Sent every message.
+ *		MACH_SEND_MSG_TOO_SMALL	Body size not a multiple of 4.
+ *		MACH_SEND_NO_BUFFER	Couldn't allocate a buffer.
+ *		MACH_SEND_INVALID_DATA	Couldn't copy the body or vector.
+ *		Otherwise, the first error stored in a msgv_return.
+ */
+
+int mach_msg_vector_max = 64;		/* messages per trap, patchable */
+
+mach_msg_return_t
+mach_msg_send_vector_trap(vector, count, body, body_size, option, time_out)
+	mach_msg_vector_t *vector;
+	mach_msg_type_number_t count;
+	char *body;
+	mach_msg_size_t body_size;
+	mach_msg_option_t option;
+	mach_msg_timeout_t time_out;
+{
+	ipc_space_t space = current_space();
+	vm_map_t map = current_map();
+	mach_msg_size_t size = sizeof(mach_msg_header_t) + body_size;
+	mach_msg_return_t mr, result = MACH_MSG_SUCCESS;
+	vm_offset_t template = 0;
+	unsigned int i;
+
+	if ((body_size & 3) || (size < body_size))
+		return MACH_SEND_MSG_TOO_SMALL;
+
+	if (body_size != 0) {
+		template = kalloc(body_size);
+		if (template == 0)
+			return MACH_SEND_NO_BUFFER;
+
+		if (copyinmsg(body, (char *) template, body_size)) {
+			kfree(template, body_size);
+			return MACH_SEND_INVALID_DATA;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		mach_msg_vector_t *msgv = &vector[i];
+		ipc_kmsg_t kmsg;
+
+		if (i == mach_msg_vector_max) {
+			/* leave the rest for the caller to resend */
+
+			mr = MACH_SEND_INTERRUPTED;
+			(void) copyout((vm_offset_t) &mr,
+				       (vm_offset_t) &msgv->msgv_return,
+				       sizeof(mach_msg_return_t));
+			if (result == MACH_MSG_SUCCESS)
+				result = mr;
+			break;
+		}
+
+		kmsg = ipc_kmsg_cache_alloc(size);
+		if (kmsg == IKM_NULL) {
+			mr = MACH_SEND_NO_BUFFER;
+			goto done_one;
+		}
+
+		if (copyinmsg((char *) &msgv->msgv_header,
+			      (char *) &kmsg->ikm_header,
+			      sizeof(mach_msg_header_t))) {
+			ikm_free(kmsg);
+			result = MACH_SEND_INVALID_DATA;
+			break;
+		}
+
+		if (kmsg->ikm_header.msgh_bits & MACH_MSGH_BITS_COMPLEX) {
+			ikm_free(kmsg);
+			mr = MACH_SEND_INVALID_HEADER;
+			goto done_one;
+		}
+
+		kmsg->ikm_header.msgh_size = size;
+		if (body_size != 0)
+			bcopy((char *) template,
+			      (char *) (&kmsg->ikm_header + 1), body_size);
+
+		mr = ipc_kmsg_copyin(kmsg, space, map, MACH_PORT_NULL);
+		if (mr != MACH_MSG_SUCCESS) {
+			ikm_free(kmsg);
+			goto done_one;
+		}
+
+		mr = ipc_mqueue_send(kmsg, option & MACH_SEND_TIMEOUT,
+				     time_out);
+		if (mr != MACH_MSG_SUCCESS) {
+			mr |= ipc_kmsg_copyout_pseudo(kmsg, space, map);
+
+			assert(kmsg->ikm_marequest == IMAR_NULL);
+			(void) ipc_kmsg_put(&msgv->msgv_header, kmsg,
+					    sizeof(mach_msg_header_t));
+		}
+
+	    done_one:
+		if ((mr != MACH_MSG_SUCCESS) && (result == MACH_MSG_SUCCESS))
+			result = mr;
+
+		if (copyout((vm_offset_t) &mr,
+			    (vm_offset_t) &msgv->msgv_return,
+			    sizeof(mach_msg_return_t))) {
+			result = MACH_SEND_INVALID_DATA;
+			break;
+		}
+
+		if ((mr &~ MACH_MSG_MASK) == MACH_SEND_INTERRUPTED) {
+			mr = MACH_SEND_INTERRUPTED;
+
+			/* leave the rest for the caller to resend */
+
+			if (++i < count)
+				(void) copyout((vm_offset_t) &mr,
+					(vm_offset_t) &vector[i].msgv_return,
+					sizeof(mach_msg_return_t));
+			break;
+		}
+	}
+
+	if (template != 0)
+		kfree(template, body_size);
+
+	return result;
+}
+
 /*
  *	Routine:	mach_msg_receive
  *	Purpose:
@@ -310,6 +462,7 @@ mach_msg_receive(msg, option, rcv_size, rcv_name, time_out, notify)
 	self->ith_msg = msg;
 	self->ith_option = option;
 	self->ith_rcv_size = rcv_size;
+	self->ith_rcv_name = rcv_name;
 	self->ith_timeout = time_out;
 	self->ith_notify = notify;
 	self->ith_object = object;
@@ -376,6 +529,16 @@ mach_msg_receive(msg, option, rcv_size, rcv_name, time_out, notify)
 		return mr;
 	}
 
+	if (option & MACH_RCV_BATCH) {
+		mach_msg_size_t size = kmsg->ikm_header.msgh_size;
+
+		mr = ipc_kmsg_put(msg, kmsg, size);
+		if (mr == MACH_MSG_SUCCESS)
+			mach_msg_receive_batch(msg, size, option, rcv_size,
+					       rcv_name, notify);
+		return mr;
+	}
+
 	return ipc_kmsg_put(msg, kmsg, kmsg->ikm_header.msgh_size);
 }
 
@@ -472,11 +635,129 @@ mach_msg_receive_continue()
 		/*NOTREACHED*/
 	}
 
+	if (option & MACH_RCV_BATCH) {
+		mach_msg_size_t size = kmsg->ikm_header.msgh_size;
+
+		mr = ipc_kmsg_put(msg, kmsg, size);
+		if (mr == MACH_MSG_SUCCESS)
+			mach_msg_receive_batch(msg, size, option, rcv_size,
+					       self->ith_rcv_name, notify);
+		thread_syscall_return(mr);
+		/*NOTREACHED*/
+	}
+
 	mr = ipc_kmsg_put(msg, kmsg, kmsg->ikm_header.msgh_size);
 	thread_syscall_return(mr);
 	/*NOTREACHED*/
 }
 
+/*
+ *	Routine:	mach_msg_receive_batch
+ *	Purpose:
+ *		For MACH_RCV_BATCH.  Having put a message of "size"
+ *		bytes at "msg", take messages that are already queued
+ *		and put them after it, then end the batch with an
+ *		empty header.  Never blocks waiting for a message.
+ *
+ *		Each message is dequeued, given its seqno, and copied
+ *		out exactly as by mach_msg_receive.  A message that
+ *		doesn't leave room for the ending header stays queued.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+int mach_msg_batch_max = 64;		/* messages per trap, patchable */
+
+void
+mach_msg_receive_batch(msg, size, option, rcv_size, rcv_name, notify)
+	mach_msg_header_t *msg;
+	mach_msg_size_t size;
+	mach_msg_option_t option;
+	mach_msg_size_t rcv_size;
+	mach_port_t rcv_name;
+	mach_port_t notify;
+{
+	ipc_space_t space = current_space();
+	vm_map_t map = current_map();
+	vm_offset_t addr = (vm_offset_t) msg + size;
+	vm_offset_t end = (vm_offset_t) msg + rcv_size;
+	mach_msg_header_t header;
+	mach_msg_return_t mr = MACH_MSG_SUCCESS;
+	int count;
+
+	for (count = 1; count < mach_msg_batch_max; count++) {
+		ipc_object_t object;
+		ipc_mqueue_t mqueue;
+		ipc_kmsg_t kmsg;
+		mach_port_seqno_t seqno;
+
+		if (end - addr < 2 * sizeof(mach_msg_header_t))
+			break;
+
+		if (ipc_mqueue_copyin(space, rcv_name, &mqueue, &object)
+							!= MACH_MSG_SUCCESS)
+			break;
+		/* hold ref for object; mqueue is locked */
+
+		if (ipc_mqueue_receive(mqueue, MACH_RCV_TIMEOUT,
+				(mach_msg_size_t) (end - addr -
+						   sizeof(mach_msg_header_t)),
+				0, FALSE, (void (*)()) 0,
+				&kmsg, &seqno) != MACH_MSG_SUCCESS) {
+			/* nothing queued, or the next one doesn't fit */
+
+			ipc_object_release(object);
+			break;
+		}
+		/* mqueue is unlocked */
+		ipc_object_release(object);
+
+		kmsg->ikm_header.msgh_seqno = seqno;
+		size = kmsg->ikm_header.msgh_size;
+
+		if (option & MACH_RCV_NOTIFY) {
+			if (notify == MACH_PORT_NULL)
+				mr = MACH_RCV_INVALID_NOTIFY;
+			else
+				mr = ipc_kmsg_copyout(kmsg, space, map,
+						      notify);
+		} else
+			mr = ipc_kmsg_copyout(kmsg, space, map,
+					      MACH_PORT_NULL);
+		if (mr != MACH_MSG_SUCCESS) {
+			if ((mr &~ MACH_MSG_MASK) == MACH_RCV_BODY_ERROR) {
+				(void) ipc_kmsg_put((mach_msg_header_t *) addr,
+						    kmsg, size);
+			} else {
+				ipc_kmsg_copyout_dest(kmsg, space);
+				(void) ipc_kmsg_put((mach_msg_header_t *) addr,
+						    kmsg, sizeof *msg);
+			}
+
+			addr += size;
+			break;
+		}
+
+		mr = ipc_kmsg_put((mach_msg_header_t *) addr, kmsg, size);
+		addr += size;
+		if (mr != MACH_MSG_SUCCESS)
+			break;
+	}
+
+	/* the empty header ending the batch */
+
+	if (end - addr >= sizeof(mach_msg_header_t)) {
+		header.msgh_bits = 0;
+		header.msgh_size = 0;
+		header.msgh_remote_port = MACH_PORT_NULL;
+		header.msgh_local_port = MACH_PORT_NULL;
+		header.msgh_seqno = 0;
+		header.msgh_id = mr;
+
+		(void) copyout((vm_offset_t) &header, addr, sizeof header);
+	}
+}
+
 /*
  *	Routine:	mach_msg_trap [mach trap]
  *	Purpose:
@@ -556,18 +837,15 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 		 *	optimized ipc_kmsg_get
 		 *
 		 *	No locks, references, or messages held.
-		 *	We must clear ikm_cache before copyinmsg.
+		 *	We must take the buffer from the cache
+		 *	before copyinmsg.
 		 */
 
-		if ((send_size > IKM_SAVED_MSG_SIZE) ||
-		    (send_size < sizeof(mach_msg_header_t)) ||
+		if ((send_size < sizeof(mach_msg_header_t)) ||
 		    (send_size & 3) ||
-		    ((kmsg = ikm_cache()) == IKM_NULL))
+		    ((kmsg = ipc_kmsg_cache_alloc(send_size)) == IKM_NULL))
 			goto slow_get;
 
-		ikm_cache() = IKM_NULL;
-		ikm_check_initialized(kmsg, IKM_SAVED_KMSG_SIZE);
-
 		if (copyinmsg((vm_offset_t) msg, (vm_offset_t) &kmsg->ikm_header,
 			      send_size)) {
 			ikm_free(kmsg);
@@ -1049,9 +1327,13 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 
 			if ((receiver->swap_func ==
 				(void (*)()) mach_msg_receive_continue) &&
-			    ((receiver->ith_option & MACH_RCV_NOTIFY) == 0)) {
+			    ((receiver->ith_option & MACH_RCV_NOTIFY) == 0) &&
+			    ((receiver->ith_option & MACH_RCV_BATCH) == 0)) {
 				/*
 				 *	We can still use the optimized code.
+				 *	(A batch receive must go through
+				 *	mach_msg_receive_continue to end
+				 *	the batch.)
 				 */
 			} else {
 				counter(c_mach_msg_trap_block_slow++);
@@ -1364,18 +1646,16 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 		 *	We have the reply message data in kmsg,
 		 *	and the reply message size in reply_size.
 		 *	Just need to copy it out to the user and free kmsg.
-		 *	We must check ikm_cache after copyoutmsg.
+		 *	We must free kmsg to the cache after copyoutmsg.
 		 */
 
 		ikm_check_initialized(kmsg, kmsg->ikm_size);
 
-		if ((kmsg->ikm_size != IKM_SAVED_KMSG_SIZE) ||
-		    copyoutmsg((vm_offset_t) &kmsg->ikm_header, (vm_offset_t) msg,
-			       reply_size) ||
-		    (ikm_cache() != IKM_NULL))
+		if (copyoutmsg((vm_offset_t) &kmsg->ikm_header, (vm_offset_t) msg,
+			       reply_size))
 			goto slow_put;
 
-		ikm_cache() = kmsg;
+		ipc_kmsg_cache_free(kmsg);
 		thread_syscall_return(MACH_MSG_SUCCESS);
 		/*NOTREACHED*/
 		return MACH_MSG_SUCCESS; /* help for the compiler */
@@ -62,6 +62,11 @@ extern mach_msg_return_t
 mach_msg_send(/* mach_msg_header_t *, mach_msg_option_t,
 		 mach_msg_size_t, mach_msg_timeout_t, mach_port_t */);
 
+extern mach_msg_return_t
+mach_msg_send_vector_trap(/* mach_msg_vector_t *, mach_msg_type_number_t,
+			     char *, mach_msg_size_t, mach_msg_option_t,
+			     mach_msg_timeout_t */);
+
 extern mach_msg_return_t
 mach_msg_receive(/* mach_msg_header_t *, mach_msg_option_t,
 		    mach_msg_size_t, mach_port_t,
@@ -70,6 +75,11 @@ mach_msg_receive(/* mach_msg_header_t *, mach_msg_option_t,
 extern void
 mach_msg_receive_continue();
 
+extern void
+mach_msg_receive_batch(/* mach_msg_header_t *, mach_msg_size_t,
+			  mach_msg_option_t, mach_msg_size_t,
+			  mach_port_t, mach_port_t */);
+
 extern void
 mach_msg_continue();
 
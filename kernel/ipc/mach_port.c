@@ -927,6 +927,45 @@ mach_port_set_seqno(space, name, seqno)
 	return KERN_SUCCESS;
 }
 
+/*
+ *	Routine:	mach_port_set_fair [kernel call]
+ *	Purpose:
+ *		Makes a port set serve its members round-robin,
+ *		or in the order messages were sent to them.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		Changed the port set.
+ *		KERN_INVALID_TASK	The space is null.
+ *		KERN_INVALID_TASK	The space is dead.
+ *		KERN_INVALID_NAME	The name doesn't denote a right.
+ *		KERN_INVALID_RIGHT	Name doesn't denote a port set.
+ */
+
+kern_return_t
+mach_port_set_fair(space, name, fair)
+	ipc_space_t space;
+	mach_port_t name;
+	boolean_t fair;
+{
+	ipc_pset_t pset;
+	kern_return_t kr;
+
+	if (space == IS_NULL)
+		return KERN_INVALID_TASK;
+
+	kr = ipc_object_translate(space, name, MACH_PORT_RIGHT_PORT_SET,
+				  (ipc_object_t *) &pset);
+	if (kr != KERN_SUCCESS)
+		return kr;
+	/* pset is locked and active */
+
+	ipc_pset_set_fair(pset, fair);
+
+	ips_unlock(pset);
+	return KERN_SUCCESS;
+}
+
 /*
  *	Routine:	mach_port_gst_helper
  *	Purpose:
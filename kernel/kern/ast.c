@@ -216,7 +216,6 @@ ast_check()
 	register int		mycpu = cpu_number();
 	register processor_t	myprocessor;
 	register thread_t	thread = current_thread();
-	register run_queue_t	rq;
 	spl_t			s = splsched();
 
 	/*
@@ -255,19 +254,13 @@ ast_check()
 			break;
 
 		/*
-		 *	Context switch check.  The csw_needed macro isn't
-		 *	used here because the rq->low hint may be wrong,
-		 *	and fixing it here avoids an extra ast.
-		 *	First check the easy cases.
+		 *	Context switch check.  First check the easy cases.
 		 */
 		if (thread->state & TH_SUSP || myprocessor->runq.count > 0) {
 			ast_on(mycpu, AST_BLOCK);
 			break;
 		}
 
-		/*
-		 *	Update lazy evaluated runq->low if only timesharing.
-		 */
 #if	MACH_FIXPRI
 		if (myprocessor->processor_set->policies & POLICY_FIXEDPRI) {
 		    if (csw_needed(thread,myprocessor)) {
@@ -285,38 +278,16 @@ ast_check()
 		}
 		else {
 #endif	MACH_FIXPRI			
-		rq = &(myprocessor->processor_set->runq);
-		if (!(myprocessor->first_quantum) && (rq->count > 0)) {
-		    register queue_t 	q;
-		    /*
-		     *	This is not the first quantum, and there may
-		     *	be something in the processor_set runq.
-		     *	Check whether low hint is accurate.
-		     */
-		    q = rq->runq + *(volatile int *)&rq->low;
-		    if (queue_empty(q)) {
-			register int i;
-
-			/*
-			 *	Need to recheck and possibly update hint.
-			 */
-			simple_lock(&rq->lock);
-			q = rq->runq + rq->low;
-			if (rq->count > 0) {
-			    for (i = rq->low; i < NRQS; i++) {
-				if(!(queue_empty(q)))
-				    break;
-				q++;
-			    }
-			    rq->low = i;
-			}
-			simple_unlock(&rq->lock);
-		    }
-
-		    if (rq->low <= thread->sched_pri) {
+		/*
+		 *	If this is not the first quantum, switch if any
+		 *	of the processor set's run queues has a thread
+		 *	at this priority or better.
+		 */
+		if (!(myprocessor->first_quantum) &&
+		    (pset_runq_low(myprocessor->processor_set) <=
+							thread->sched_pri)) {
 			ast_on(mycpu, AST_BLOCK);
 			break;
-		    }
 		}
 #if	MACH_FIXPRI
 		}
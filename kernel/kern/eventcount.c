@@ -110,7 +110,7 @@ void simpler_thread_setrun(
 	boolean_t	may_preempt); /* forward */
 #endif
 
-#define	MAX_EVCS	10		/* xxx for now */
+#define	MAX_EVCS	64		/* xxx for now; rings use them too */
 evc_t	all_eventcounters[MAX_EVCS];
 
 /*
@@ -399,9 +399,7 @@ simpler_thread_setrun(
 	whichq = (th)->sched_pri;
 	simple_lock(&(rq)->lock);	/* lock the run queue */
 	enqueue_head(&(rq)->runq[whichq], (queue_entry_t) (th));
-
-	if (whichq < (rq)->low || (rq)->count == 0)
-		 (rq)->low = whichq;	/* minimize */
+	run_queue_set(rq, whichq);
 	(rq)->count++;
 	(th)->runq = (rq);
 	simple_unlock(&(rq)->lock);
@@ -453,16 +453,9 @@ exception_raise(dest_port, thread_port, task_port,
 	 *	and it will give the buffer back with its reply.
 	 */
 
-	kmsg = ikm_cache();
-	if (kmsg != IKM_NULL) {
-		ikm_cache() = IKM_NULL;
-		ikm_check_initialized(kmsg, IKM_SAVED_KMSG_SIZE);
-	} else {
-		kmsg = ikm_alloc(IKM_SAVED_MSG_SIZE);
-		if (kmsg == IKM_NULL)
-			panic("exception_raise");
-		ikm_init(kmsg, IKM_SAVED_MSG_SIZE);
-	}
+	kmsg = ipc_kmsg_cache_alloc(IKM_SAVED_MSG_SIZE);
+	if (kmsg == IKM_NULL)
+		panic("exception_raise");
 
 	/*
 	 *	We need a reply port for the RPC.
@@ -559,7 +552,8 @@ exception_raise(dest_port, thread_port, task_port,
 	      ((receiver->swap_func ==
 				(void (*)()) mach_msg_receive_continue) &&
 	       (sizeof(struct mach_exception) <= receiver->ith_msize) &&
-	       ((receiver->ith_option & MACH_RCV_NOTIFY) == 0))) ||
+	       ((receiver->ith_option & MACH_RCV_NOTIFY) == 0) &&
+	       ((receiver->ith_option & MACH_RCV_BATCH) == 0))) ||
 	    !thread_handoff(self, exception_raise_continue, receiver)) {
 		imq_unlock(reply_mqueue);
 		imq_unlock(dest_mqueue);
@@ -789,22 +783,21 @@ exception_raise(dest_port, thread_port, task_port,
 
 	/*
 	 *	Optimized version of ipc_kmsg_put.
-	 *	We must check ikm_cache after copyoutmsg.
+	 *	We must free kmsg to the cache after copyoutmsg.
 	 */
 
 	ikm_check_initialized(kmsg, kmsg->ikm_size);
 	assert(kmsg->ikm_size == IKM_SAVED_KMSG_SIZE);
 
 	if (copyoutmsg((vm_offset_t) &kmsg->ikm_header, (vm_offset_t)receiver->ith_msg,
-		       sizeof(struct mach_exception)) ||
-	    (ikm_cache() != IKM_NULL)) {
+		       sizeof(struct mach_exception))) {
 		mr = ipc_kmsg_put(receiver->ith_msg, kmsg,
 				  kmsg->ikm_header.msgh_size);
 		thread_syscall_return(mr);
 		/*NOTREACHED*/
 	}
 
-	ikm_cache() = kmsg;
+	ipc_kmsg_cache_free(kmsg);
 	thread_syscall_return(MACH_MSG_SUCCESS);
 	/*NOTREACHED*/
 #ifndef	__GNUC__
@@ -920,11 +913,7 @@ exception_parse_reply(kmsg)
 
 	kr = msg->RetCode;
 
-	if ((kmsg->ikm_size == IKM_SAVED_KMSG_SIZE) &&
-	    (ikm_cache() == IKM_NULL))
-		ikm_cache() = kmsg;
-	else
-		ikm_free(kmsg);
+	ipc_kmsg_cache_free(kmsg);
 
 	return kr;
 }
@@ -95,6 +95,7 @@
  *	Functions for letting a port represent a kernel object.
  */
 
+#include <cpus.h>
 #include <mach_debug.h>
 #include <mach_ipc_test.h>
 #include <mach_machine_routines.h>
@@ -106,7 +107,10 @@
 #include <mach/message.h>
 #include <mach/mig_errors.h>
 #include <mach/notify.h>
+#include <mach_debug/ipc_info.h>
 #include <kern/ipc_kobject.h>
+#include <kern/cpu_number.h>
+#include <kern/ring.h>
 #include <ipc/ipc_object.h>
 #include <ipc/ipc_kmsg.h>
 #include <ipc/ipc_port.h>
@@ -117,6 +121,138 @@
 #endif
 
 
+/*
+ *	The kernel's MIG subsystems, in the order they are asked
+ *	for a request's server routine.
+ */
+
+extern mig_routine_t	mach_server_routine(),
+			mach_port_server_routine(),
+			mach_host_server_routine(),
+			device_server_routine(),
+			device_pager_server_routine(),
+			mach4_server_routine();
+#if	MACH_DEBUG
+extern mig_routine_t	mach_debug_server_routine();
+#endif
+#if	NORMA_TASK
+extern mig_routine_t	mach_norma_server_routine();
+extern mig_routine_t	norma_internal_server_routine();
+#endif
+#if	NORMA_VM
+extern mig_routine_t	proxy_server_routine();
+#endif
+#if	MACH_MACHINE_ROUTINES
+extern mig_routine_t	MACHINE_SERVER_ROUTINE();
+#endif
+
+mig_routine_t (*ipc_kobject_subsystems[])() = {
+	mach_server_routine,
+	mach_port_server_routine,
+	mach_host_server_routine,
+	device_server_routine,
+	device_pager_server_routine,
+#if	MACH_DEBUG
+	mach_debug_server_routine,
+#endif	MACH_DEBUG
+#if	NORMA_TASK
+	mach_norma_server_routine,
+	norma_internal_server_routine,
+#endif	NORMA_TASK
+#if	NORMA_VM
+	proxy_server_routine,
+#endif	NORMA_VM
+	mach4_server_routine,
+#if	MACH_MACHINE_ROUTINES
+	MACHINE_SERVER_ROUTINE,
+#endif	MACH_MACHINE_ROUTINES
+	0
+};
+
+/*
+ *	The dispatch table maps the msgh_ids from IKO_DEMUX_MIN
+ *	up to IKO_DEMUX_MAX straight to their server routines,
+ *	which covers the subsystems from mach.defs (2000) to
+ *	mach4.defs (4000).  Requests with other ids (the NORMA
+ *	subsystems, notifications) still ask each subsystem.
+ *
+ *	The requests for each entry are counted per processor, in
+ *	that processor's row of ipc_kobject_calls, so counting
+ *	needs no lock.  The kernel isn't preemptible, so a thread
+ *	is still on the processor cpu_number() named when it
+ *	increments the count.
+ */
+
+#define	IKO_DEMUX_MIN	2000
+#define	IKO_DEMUX_MAX	4100
+
+mig_routine_t	ipc_kobject_demux[IKO_DEMUX_MAX - IKO_DEMUX_MIN];
+unsigned int	ipc_kobject_calls[NCPUS][IKO_DEMUX_MAX - IKO_DEMUX_MIN];
+
+/*
+ *	Routine:	ipc_kobject_init
+ *	Purpose:
+ *		Fill in the dispatch table by asking each
+ *		subsystem about each msgh_id in the table.
+ *		The first subsystem to claim an id gets it,
+ *		as in ipc_kobject_server.
+ */
+
+void
+ipc_kobject_init()
+{
+	mach_msg_header_t header;
+	mig_routine_t (**server)();
+	mig_routine_t routine;
+	int i;
+
+	for (i = 0; i < IKO_DEMUX_MAX - IKO_DEMUX_MIN; i++) {
+		header.msgh_id = IKO_DEMUX_MIN + i;
+
+		for (server = ipc_kobject_subsystems; *server != 0; server++)
+			if ((routine = (**server)(&header)) != 0) {
+				ipc_kobject_demux[i] = routine;
+				break;
+			}
+	}
+}
+
+/*
+ *	Routine:	ipc_kobject_info
+ *	Purpose:
+ *		Return the request count of each routine in the
+ *		dispatch table, summed over the processors.
+ *		Returns the number of routines; only fills in
+ *		the first count.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+unsigned int
+ipc_kobject_info(info, count)
+	ipc_info_kobject_t *info;
+	unsigned int count;
+{
+	unsigned int i = 0;
+	int id, cpu;
+
+	for (id = IKO_DEMUX_MIN; id < IKO_DEMUX_MAX; id++) {
+		if (ipc_kobject_demux[id - IKO_DEMUX_MIN] == 0)
+			continue;
+
+		if (i < count) {
+			info[i].iiko_id = id;
+			info[i].iiko_calls = 0;
+			for (cpu = 0; cpu < NCPUS; cpu++)
+				info[i].iiko_calls +=
+				    ipc_kobject_calls[cpu][id - IKO_DEMUX_MIN];
+		}
+		i++;
+	}
+
+	return i;
+}
+
 /*
  *	Routine:	ipc_kobject_server
  *	Purpose:
@@ -178,51 +314,28 @@ ipc_kobject_server(request)
 	 * to perform the kernel function
 	 */
     {
-	extern mig_routine_t	mach_server_routine(),
-				mach_port_server_routine(),
-				mach_host_server_routine(),
-				device_server_routine(),
-				device_pager_server_routine(),
-				mach4_server_routine();
-#if	MACH_DEBUG
-	extern mig_routine_t	mach_debug_server_routine();
-#endif
-#if	NORMA_TASK
-	extern mig_routine_t	mach_norma_server_routine();
-	extern mig_routine_t	norma_internal_server_routine();
-#endif
-#if	NORMA_VM
-	extern mig_routine_t	proxy_server_routine();
-#endif
-
-#if	MACH_MACHINE_ROUTINES
-	extern mig_routine_t	MACHINE_SERVER_ROUTINE();
-#endif
+	mach_msg_id_t id = request->ikm_header.msgh_id;
 
 	check_simple_locks();
-	if ((routine = mach_server_routine(&request->ikm_header)) != 0
-	 || (routine = mach_port_server_routine(&request->ikm_header)) != 0
-	 || (routine = mach_host_server_routine(&request->ikm_header)) != 0
-	 || (routine = device_server_routine(&request->ikm_header)) != 0
-	 || (routine = device_pager_server_routine(&request->ikm_header)) != 0
-#if	MACH_DEBUG
-	 || (routine = mach_debug_server_routine(&request->ikm_header)) != 0
-#endif	MACH_DEBUG
-#if	NORMA_TASK
-	 || (routine = mach_norma_server_routine(&request->ikm_header)) != 0
-	 || (routine = norma_internal_server_routine(&request->ikm_header)) != 0
-#endif	NORMA_TASK
-#if	NORMA_VM
-	 || (routine = proxy_server_routine(&request->ikm_header)) != 0
-#endif	NORMA_VM
-	 || (routine = mach4_server_routine(&request->ikm_header)) != 0
-#if	MACH_MACHINE_ROUTINES
-	 || (routine = MACHINE_SERVER_ROUTINE(&request->ikm_header)) != 0
-#endif	MACH_MACHINE_ROUTINES
-	) {
-	    (*routine)(&request->ikm_header, &reply->ikm_header);
+	if ((id >= IKO_DEMUX_MIN) && (id < IKO_DEMUX_MAX)) {
+	    routine = ipc_kobject_demux[id - IKO_DEMUX_MIN];
+	    if (routine != 0) {
+		ipc_kobject_calls[cpu_number()][id - IKO_DEMUX_MIN]++;
+		(*routine)(&request->ikm_header, &reply->ikm_header);
+	    }
+	} else {
+	    mig_routine_t (**server)();
+
+	    routine = 0;
+	    for (server = ipc_kobject_subsystems; *server != 0; server++)
+		if ((routine = (**server)(&request->ikm_header)) != 0) {
+		    (*routine)(&request->ikm_header, &reply->ikm_header);
+		    break;
+		}
 	}
-	else if (!ipc_kobject_notify(&request->ikm_header,&reply->ikm_header)){
+
+	if ((routine == 0) &&
+	    !ipc_kobject_notify(&request->ikm_header, &reply->ikm_header)) {
 		((mig_reply_header_t *) &reply->ikm_header)->RetCode
 		    = MIG_BAD_ID;
 #if	MACH_IPC_TEST
@@ -276,11 +389,7 @@ ipc_kobject_server(request)
 		/* like ipc_kmsg_put, but without the copyout */
 
 		ikm_check_initialized(request, request->ikm_size);
-		if ((request->ikm_size == IKM_SAVED_KMSG_SIZE) &&
-		    (ikm_cache() == IKM_NULL))
-			ikm_cache() = request;
-		else
-			ikm_free(request);
+		ipc_kmsg_cache_free(request);
 	} else {
 		/*
 		 *	The message contents of the request are intact.
@@ -416,6 +525,9 @@ ipc_kobject_notify(request_header, reply_header)
 		case IKOT_DEVICE:
 		return ds_notify(request_header);
 
+		case IKOT_RING:
+		return ring_notify(request_header);
+
 		default:
 		return FALSE;
 	}
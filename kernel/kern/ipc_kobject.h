@@ -100,6 +100,7 @@ typedef unsigned int ipc_kobject_type_t;
 #define	IKOT_XMM_OBJECT		14
 #define	IKOT_XMM_KERNEL		15
 #define	IKOT_XMM_REPLY		16
+#define	IKOT_RING		17
 
 /*
  *	Define types of kernel objects that use page lists instead
@@ -111,6 +112,12 @@ typedef unsigned int ipc_kobject_type_t;
 
 #define ipc_kobject_vm_page_steal(ikot)	(ikot == IKOT_PAGING_REQUEST)
 
+extern void
+ipc_kobject_init();
+
+extern unsigned int
+ipc_kobject_info(/* ipc_info_kobject_t *, unsigned int */);
+
 extern struct ipc_kmsg *
 ipc_kobject_server(/* ipc_kmsg_t */);
 
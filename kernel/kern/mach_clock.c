@@ -231,9 +231,186 @@ MACRO_BEGIN							\
 	}							\
 MACRO_END
 
-decl_simple_lock_data(,	timer_lock)	/* lock for ... */
-timer_elt_data_t	timer_head;	/* ordered list of timeouts */
-					/* (doubles as end-of-list) */
+/*
+ *	Timeouts are kept in hierarchical timing wheels, one per
+ *	processor, so that set_timeout and reset_timeout take
+ *	constant time and don't contend across processors.
+ *
+ *	The first level has a slot for each of the next TW0_SIZE
+ *	ticks.  Each further level has TWN_SIZE slots, each covering
+ *	as many ticks as the whole of the level below.  When the first
+ *	level wraps, the next slot of the level above is cascaded:
+ *	its timers are redistributed into the levels below.
+ *
+ *	A wheel's curtick is the next tick it will process.  It trails
+ *	elapsed_ticks until softclock catches up.  Its nexttick is the
+ *	earliest tick at which softclock has work on it: a timer is
+ *	due or a slot must be cascaded.  It may be early, never late.
+ */
+#define	TW0_BITS	8
+#define	TW0_SIZE	(1 << TW0_BITS)
+#define	TW0_MASK	(TW0_SIZE - 1)
+#define	TWN_BITS	6
+#define	TWN_SIZE	(1 << TWN_BITS)
+#define	TWN_MASK	(TWN_SIZE - 1)
+#define	TWN_LEVELS	4		/* TW0_BITS + 4*TWN_BITS == 32 */
+
+#define	TW_SHIFT(level)	(TW0_BITS + (level) * TWN_BITS)
+
+struct timer_wheel {
+	decl_simple_lock_data(,	lock)	/* lock for wheel and its timers */
+	unsigned long	curtick;	/* next tick to process */
+	unsigned long	nexttick;	/* no work before this tick */
+	int		count;		/* number of timers set */
+	boolean_t	running;	/* softclock is running it */
+	queue_head_t	tw0[TW0_SIZE];	/* timers due in the next ticks */
+	queue_head_t	twn[TWN_LEVELS][TWN_SIZE]; /* later timers */
+};
+
+struct timer_wheel	timer_wheels[NCPUS];
+
+decl_simple_lock_data(,	timeout_lock)	/* lock for timeout_timers */
+
+/*
+ *	Put a timer in the slot matching its expiration time.
+ *	The wheel must be locked.
+ */
+void timer_wheel_insert(w, telt)
+	register struct timer_wheel	*w;
+	register timer_elt_t		telt;
+{
+	register unsigned long	delta = telt->ticks - w->curtick;
+	register queue_t	slot;
+	register int		level;
+
+	if ((long) delta < 0) {
+		/*
+		 *	Already due: run at the tick being processed.
+		 */
+		slot = &w->tw0[w->curtick & TW0_MASK];
+	}
+	else if (delta < TW0_SIZE) {
+		slot = &w->tw0[telt->ticks & TW0_MASK];
+	}
+	else {
+		for (level = 0; level < TWN_LEVELS - 1; level++)
+			if (delta < (1UL << TW_SHIFT(level + 1)))
+				break;
+		slot = &w->twn[level][(telt->ticks >> TW_SHIFT(level)) &
+				      TWN_MASK];
+	}
+
+	enqueue_tail(slot, (queue_entry_t) telt);
+}
+
+/*
+ *	Redistribute the timers in one slot of an upper level.
+ *	The wheel must be locked.
+ */
+void timer_wheel_cascade(w, level, index)
+	register struct timer_wheel	*w;
+	int				level;
+	int				index;
+{
+	register queue_t	slot = &w->twn[level][index];
+	register timer_elt_t	telt;
+
+	while (!queue_empty(slot)) {
+		telt = (timer_elt_t) dequeue_head(slot);
+		timer_wheel_insert(w, telt);
+	}
+}
+
+/*
+ *	Find the next tick softclock must process: the first
+ *	non-empty slot of the first level, or the next cascade.
+ *	The wheel must be locked.
+ */
+void timer_wheel_next(w)
+	register struct timer_wheel	*w;
+{
+	register unsigned long	next = w->curtick;
+
+	while (((next & TW0_MASK) != 0) &&
+	       queue_empty(&w->tw0[next & TW0_MASK]))
+		next++;
+	w->nexttick = next;
+}
+
+/*
+ *	Run the timeouts that are due on one wheel.  The
+ *	timeout functions are called at the caller's spl,
+ *	with the wheel unlocked.
+ */
+void timer_wheel_run(w)
+	register struct timer_wheel	*w;
+{
+	register timer_elt_t	telt;
+	register queue_t	slot;
+	register int		(*fcn)();
+	register char		*param;
+	register int		level, index;
+	spl_t			s;
+
+	s = splsched();
+	simple_lock(&w->lock);
+
+	/*
+	 *	The wheel is unlocked while timeout functions run;
+	 *	if another processor is in the middle of running it,
+	 *	that run will catch up to elapsed_ticks.
+	 */
+	if (w->running) {
+	    simple_unlock(&w->lock);
+	    splx(s);
+	    return;
+	}
+	w->running = TRUE;
+
+	while ((long) (elapsed_ticks - w->curtick) >= 0) {
+	    if (w->count == 0) {
+		/*
+		 *	Nothing to cascade or run.
+		 */
+		w->curtick = elapsed_ticks + 1;
+		break;
+	    }
+
+	    if ((w->curtick & TW0_MASK) == 0) {
+		for (level = 0; level < TWN_LEVELS; level++) {
+		    index = (w->curtick >> TW_SHIFT(level)) & TWN_MASK;
+		    timer_wheel_cascade(w, level, index);
+		    if (index != 0)
+			break;
+		}
+	    }
+
+	    slot = &w->tw0[w->curtick & TW0_MASK];
+	    while (!queue_empty(slot)) {
+		telt = (timer_elt_t) dequeue_head(slot);
+		fcn = telt->fcn;
+		param = telt->param;
+		telt->set = TELT_UNSET;
+		w->count--;
+
+		simple_unlock(&w->lock);
+		splx(s);
+
+		assert(fcn != 0);
+		(*fcn)(param);
+
+		s = splsched();
+		simple_lock(&w->lock);
+	    }
+
+	    w->curtick++;
+	}
+
+	timer_wheel_next(w);
+	w->running = FALSE;
+	simple_unlock(&w->lock);
+	splx(s);
+}
 
 /*
  *	Handle clock interrupts.
@@ -311,8 +488,7 @@ void clock_interrupt(usec, usermode, basepri)
 	 */
 	if (my_cpu == master_cpu) {
 
-	    register spl_t s;
-	    register timer_elt_t	telt;
+	    register int	cpu;
 	    boolean_t	needsoft = FALSE;
 
 #if	TS_FORMAT == 1
@@ -324,19 +500,21 @@ void clock_interrupt(usec, usermode, basepri)
 
 	    /*
 	     *	Update the tick count since bootup, and handle
-	     *	timeouts.
+	     *	timeouts.  Softclock is wanted only when some
+	     *	wheel has work due.  The wheels are looked at
+	     *	unlocked; a nexttick lowered meanwhile is seen
+	     *	on the next tick.
 	     */
 
-	    s = splsched();
-	    simple_lock(&timer_lock);
-
 	    elapsed_ticks++;
 
-	    telt = (timer_elt_t)queue_first(&timer_head.chain);
-	    if (telt->ticks <= elapsed_ticks)
-		needsoft = TRUE;
-	    simple_unlock(&timer_lock);
-	    splx(s);
+	    for (cpu = 0; cpu < NCPUS; cpu++)
+		if ((timer_wheels[cpu].count != 0) &&
+		    ((long) (elapsed_ticks - timer_wheels[cpu].nexttick)
+								>= 0)) {
+		    needsoft = TRUE;
+		    break;
+		}
 
 	    /*
 	     *	Increment the time-of-day clock.
@@ -398,34 +576,15 @@ void clock_interrupt(usec, usermode, basepri)
 
 void softclock()
 {
+	register int	cpu;
+
 	/*
-	 *	Handle timeouts.
+	 *	Handle timeouts.  Any processor may take the soft
+	 *	interrupt, so run every wheel that has timers.
 	 */
-	spl_t	s;
-	register timer_elt_t	telt;
-	register int	(*fcn)();
-	register char	*param;
-
-	while (TRUE) {
-	    s = splsched();
-	    simple_lock(&timer_lock);
-	    telt = (timer_elt_t) queue_first(&timer_head.chain);
-	    if (telt->ticks > elapsed_ticks) {
-		simple_unlock(&timer_lock);
-		splx(s);
-		break;
-	    }
-	    fcn = telt->fcn;
-	    param = telt->param;
-
-	    remqueue(&timer_head.chain, (queue_entry_t)telt);
-	    telt->set = TELT_UNSET;
-	    simple_unlock(&timer_lock);
-	    splx(s);
-
-	    assert(fcn != 0);
-	    (*fcn)(param);
-	}
+	for (cpu = 0; cpu < NCPUS; cpu++)
+	    if (timer_wheels[cpu].count != 0)
+		timer_wheel_run(&timer_wheels[cpu]);
 }
 
 /*
@@ -434,65 +593,90 @@ void softclock()
  *	Parameters:
  *		telt	 timer element.  Function and param are already set.
  *		interval time-out interval, in hz.
+ *
+ *	The timer goes on the current processor's wheel.
  */
 void set_timeout(telt, interval)
 	register timer_elt_t	telt;	/* already loaded */
 	register unsigned int	interval;
 {
-	spl_t			s;
-	register timer_elt_t	next;
+	spl_t				s;
+	register struct timer_wheel	*w;
 
 	s = splsched();
-	simple_lock(&timer_lock);
-
-	interval += elapsed_ticks;
-
-	for (next = (timer_elt_t)queue_first(&timer_head.chain);
-	     ;
-	     next = (timer_elt_t)queue_next((queue_entry_t)next)) {
+	w = &timer_wheels[cpu_number()];
+	simple_lock(&w->lock);
 
-	    if (next->ticks > interval)
-		break;
-	}
-	telt->ticks = interval;
 	/*
-	 * Insert new timer element before 'next'
-	 * (after 'next'->prev)
+	 *	An empty wheel may have fallen behind;
+	 *	there is nothing to cascade, so catch up.
+	 *	Not while softclock is running it, though:
+	 *	its cursor must not move under it.
 	 */
-	insque((queue_entry_t) telt, ((queue_entry_t)next)->prev);
+	if ((w->count == 0) && !w->running) {
+	    w->curtick = elapsed_ticks;
+	    w->nexttick = (w->curtick | TW0_MASK) + 1;
+	}
+
+	telt->ticks = elapsed_ticks + interval;
+	telt->wheel = w;
+	timer_wheel_insert(w, telt);
+	w->count++;
 	telt->set = TELT_SET;
-	simple_unlock(&timer_lock);
+
+	if ((long) (telt->ticks - w->nexttick) < 0)
+	    w->nexttick = telt->ticks;
+
+	simple_unlock(&w->lock);
 	splx(s);
 }
 
 boolean_t reset_timeout(telt)
 	register timer_elt_t	telt;
 {
-	spl_t	s;
+	spl_t				s;
+	register struct timer_wheel	*w;
 
 	s = splsched();
-	simple_lock(&timer_lock);
-	if (telt->set) {
-	    remqueue(&timer_head.chain, (queue_entry_t)telt);
-	    telt->set = TELT_UNSET;
-	    simple_unlock(&timer_lock);
-	    splx(s);
-	    return TRUE;
-	}
-	else {
-	    simple_unlock(&timer_lock);
-	    splx(s);
-	    return FALSE;
+	while (telt->set == TELT_SET) {
+	    w = telt->wheel;
+	    simple_lock(&w->lock);
+	    if ((telt->set == TELT_SET) && (telt->wheel == w)) {
+		remqueue((queue_t) 0, (queue_entry_t) telt);
+		w->count--;
+		telt->set = TELT_UNSET;
+		simple_unlock(&w->lock);
+		splx(s);
+		return TRUE;
+	    }
+	    simple_unlock(&w->lock);
 	}
+	splx(s);
+	return FALSE;
 }
 
 void init_timeout()
 {
-	simple_lock_init(&timer_lock);
-	queue_init(&timer_head.chain);
-	timer_head.ticks = ~0;	/* MAXUINT - sentinel */
+	register int			cpu, level, i;
+	register struct timer_wheel	*w;
 
 	elapsed_ticks = 0;
+
+	for (cpu = 0; cpu < NCPUS; cpu++) {
+	    w = &timer_wheels[cpu];
+	    simple_lock_init(&w->lock);
+	    w->curtick = 0;
+	    w->nexttick = 0;
+	    w->count = 0;
+	    w->running = FALSE;
+	    for (i = 0; i < TW0_SIZE; i++)
+		queue_init(&w->tw0[i]);
+	    for (level = 0; level < TWN_LEVELS; level++)
+		for (i = 0; i < TWN_SIZE; i++)
+		    queue_init(&w->twn[level][i]);
+	}
+
+	simple_lock_init(&timeout_lock);
 }
 
 /*
@@ -648,7 +832,7 @@ void timeout(fcn, param, interval)
 	register timer_elt_t elt;
 
 	s = splsched();
-	simple_lock(&timer_lock);
+	simple_lock(&timeout_lock);
 	for (elt = &timeout_timers[0]; elt < &timeout_timers[NTIMERS]; elt++)
 	    if (elt->set == TELT_UNSET)
 		break;
@@ -657,7 +841,7 @@ void timeout(fcn, param, interval)
 	elt->fcn = fcn;
 	elt->param = param;
 	elt->set = TELT_ALLOC;
-	simple_unlock(&timer_lock);
+	simple_unlock(&timeout_lock);
 	splx(s);
 
 	set_timeout(elt, (unsigned int)interval);
@@ -665,32 +849,32 @@ void timeout(fcn, param, interval)
 
 /*
  * Returns a boolean indicating whether the timeout element was found
- * and removed.
+ * and removed.  Only timers set with timeout are looked for; each
+ * knows its wheel and is unlinked from its slot directly, so this
+ * costs the same however many timers are pending.  Private timers
+ * are cancelled with reset_timeout.
+ *
+ * timeout_lock is held throughout, so the element can't be given to
+ * another caller of timeout between the match and the removal.
  */
 boolean_t untimeout(fcn, param)
 	register int	(*fcn)();
 	register char *	param;
 {
 	spl_t	s;
-	register timer_elt_t elt;
+	register timer_elt_t	elt;
+	boolean_t	found = FALSE;
 
 	s = splsched();
-	simple_lock(&timer_lock);
-	queue_iterate(&timer_head.chain, elt, timer_elt_t, chain) {
-
-	    if ((fcn == elt->fcn) && (param == elt->param)) {
-		/*
-		 *	Found it.
-		 */
-		remqueue(&timer_head.chain, (queue_entry_t)elt);
-		elt->set = TELT_UNSET;
-
-		simple_unlock(&timer_lock);
-		splx(s);
-		return (TRUE);
+	simple_lock(&timeout_lock);
+	for (elt = &timeout_timers[0]; elt < &timeout_timers[NTIMERS]; elt++)
+	    if ((elt->set != TELT_UNSET) &&
+		(fcn == elt->fcn) && (param == elt->param) &&
+		reset_timeout(elt)) {
+		found = TRUE;
+		break;
 	    }
-	}
-	simple_unlock(&timer_lock);
+	simple_unlock(&timeout_lock);
 	splx(s);
-	return (FALSE);
+	return (found);
 }
@@ -128,7 +128,7 @@ void compute_mach_factor()
 		/*
 		 *	Count number of threads.
 		 */
-		nthreads = pset->runq.count;
+		nthreads = pset_runq_count(pset);
 		processor = (processor_t) queue_first(&pset->processors);
 		while (!queue_end(&pset->processors,
 		    (queue_entry_t)processor)) {
@@ -147,6 +147,7 @@ void thread_quantum_update(mycpu, thread, nticks, state)
 	register processor_t		myprocessor;
 #if	NCPUS > 1
 	register processor_set_t	pset;
+	register int			runnable;
 #endif
 	spl_t				s;
 
@@ -173,9 +174,10 @@ void thread_quantum_update(mycpu, thread, nticks, state)
 	 *	Update set_quantum and calculate the current quantum.
 	 */
 #if	NCPUS > 1
-	pset->set_quantum = pset->machine_quantum[
-		((pset->runq.count > pset->processor_count) ?
-		  pset->processor_count : pset->runq.count)];
+	runnable = pset_runq_count(pset);
+	if (runnable > pset->processor_count)
+		runnable = pset->processor_count;
+	pset->set_quantum = pset->machine_quantum[runnable];
 
 	if (myprocessor->runq.count != 0)
 		quantum = min_quantum;
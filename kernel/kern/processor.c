@@ -279,11 +279,8 @@ void pset_init(
 {
 	int	i;
 
-	simple_lock_init(&pset->runq.lock);
-	pset->runq.low = 0;
-	pset->runq.count = 0;
-	for (i = 0; i < NRQS; i++) {
-	    queue_init(&(pset->runq.runq[i]));
+	for (i = 0; i < NCPUS; i++) {
+	    run_queue_init(&pset->runq[i]);
 	}
 	queue_init(&pset->idle_queue);
 	pset->idle_count = 0;
@@ -329,14 +326,7 @@ void processor_init(
 	register processor_t pr,
 	int		slot_num)
 {
-	int	i;
-
-	simple_lock_init(&pr->runq.lock);
-	pr->runq.low = 0;
-	pr->runq.count = 0;
-	for (i = 0; i < NRQS; i++) {
-	    queue_init(&(pr->runq.runq[i]));
-	}
+	run_queue_init(&pr->runq);
 	queue_init(&pr->processor_queue);
 	pr->state = PROCESSOR_OFF_LINE;
 	pr->next_thread = THREAD_NULL;
@@ -650,8 +640,9 @@ void quantum_set(
 	}
 	pset->machine_quantum[0] = 2 * pset->machine_quantum[1];
 
-	i = ((pset->runq.count > pset->processor_count) ?
-		pset->processor_count : pset->runq.count);
+	i = pset_runq_count(pset);
+	if (i > pset->processor_count)
+		i = pset->processor_count;
 	pset->set_quantum = pset->machine_quantum[i];
 #else	/* NCPUS > 1 */
 	default_pset.set_quantum = min_quantum;
@@ -131,7 +131,7 @@
 #endif	/* NCPUS > 1 */
 
 struct processor_set {
-	struct run_queue	runq;		/* runq for this set */
+	struct run_queue	runq[NCPUS];	/* runqs for this set, by slot */
 	queue_head_t		idle_queue;	/* idle processors */
 	int			idle_count;	/* how many ? */
 	decl_simple_lock_data(,	idle_lock)	/* lock for above */
@@ -0,0 +1,395 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	kern/rbtree.c
+ *
+ *	Red-black tree primitives.  See kern/rbtree.h.
+ *
+ *	The caller provides all synchronization.
+ */
+
+#include <mach/boolean.h>
+#include <kern/assert.h>
+#include <kern/macro_help.h>
+#include <kern/rbtree.h>
+
+#define	rb_is_black(n)	(((n) == RBTREE_NODE_NULL) || ((n)->color == RB_BLACK))
+#define	rb_is_red(n)	(!rb_is_black(n))
+
+/*
+ *	Replace the link from "node"'s parent (or the root)
+ *	with "repl".  Does not touch repl's own parent pointer.
+ */
+#define	rb_replace_child(tree, node, repl)				\
+MACRO_BEGIN								\
+	if ((node)->parent == RBTREE_NODE_NULL)				\
+		(tree)->root = (repl);					\
+	else if ((node)->parent->left == (node))			\
+		(node)->parent->left = (repl);				\
+	else								\
+		(node)->parent->right = (repl);				\
+MACRO_END
+
+static void rb_rotate_left(tree, x)
+	register rbtree_t	tree;
+	register rbtree_node_t	x;
+{
+	register rbtree_node_t	y = x->right;
+
+	x->right = y->left;
+	if (y->left != RBTREE_NODE_NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	rb_replace_child(tree, x, y);
+	y->left = x;
+	x->parent = y;
+}
+
+static void rb_rotate_right(tree, x)
+	register rbtree_t	tree;
+	register rbtree_node_t	x;
+{
+	register rbtree_node_t	y = x->left;
+
+	x->left = y->right;
+	if (y->right != RBTREE_NODE_NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	rb_replace_child(tree, x, y);
+	y->right = x;
+	x->parent = y;
+}
+
+/*
+ *	Restore the red-black invariants after "x" has been
+ *	linked in as a red leaf.
+ */
+static void rb_insert_fixup(tree, x)
+	register rbtree_t	tree;
+	register rbtree_node_t	x;
+{
+	register rbtree_node_t	p, g, u;
+
+	while (((p = x->parent) != RBTREE_NODE_NULL) &&
+	       (p->color == RB_RED)) {
+		/*
+		 *	A red node is never the root,
+		 *	so the grandparent exists.
+		 */
+		g = p->parent;
+		if (p == g->left) {
+			u = g->right;
+			if (rb_is_red(u)) {
+				p->color = RB_BLACK;
+				u->color = RB_BLACK;
+				g->color = RB_RED;
+				x = g;
+				continue;
+			}
+			if (x == p->right) {
+				rb_rotate_left(tree, p);
+				x = p;
+				p = x->parent;
+			}
+			p->color = RB_BLACK;
+			g->color = RB_RED;
+			rb_rotate_right(tree, g);
+		} else {
+			u = g->left;
+			if (rb_is_red(u)) {
+				p->color = RB_BLACK;
+				u->color = RB_BLACK;
+				g->color = RB_RED;
+				x = g;
+				continue;
+			}
+			if (x == p->left) {
+				rb_rotate_right(tree, p);
+				x = p;
+				p = x->parent;
+			}
+			p->color = RB_BLACK;
+			g->color = RB_RED;
+			rb_rotate_left(tree, g);
+		}
+	}
+	tree->root->color = RB_BLACK;
+}
+
+/*
+ *	Routine:	rbtree_insert_at
+ *	Purpose:
+ *		Link "node" as the left (if "left" is TRUE) or right
+ *		child of "parent", which must have no child on that
+ *		side, and rebalance.  A null parent means the tree
+ *		is empty.  Used by callers that descend the tree
+ *		themselves to find the insertion point.
+ */
+void rbtree_insert_at(tree, parent, left, node)
+	register rbtree_t	tree;
+	register rbtree_node_t	parent;
+	boolean_t		left;
+	register rbtree_node_t	node;
+{
+	node->parent = parent;
+	node->left = RBTREE_NODE_NULL;
+	node->right = RBTREE_NODE_NULL;
+	node->color = RB_RED;
+
+	if (parent == RBTREE_NODE_NULL) {
+		assert(tree->root == RBTREE_NODE_NULL);
+		tree->root = node;
+	} else if (left) {
+		assert(parent->left == RBTREE_NODE_NULL);
+		parent->left = node;
+	} else {
+		assert(parent->right == RBTREE_NODE_NULL);
+		parent->right = node;
+	}
+
+	rb_insert_fixup(tree, node);
+}
+
+/*
+ *	Routine:	rbtree_insert_after
+ *	Purpose:
+ *		Insert "node" so that it immediately follows "pred"
+ *		in the in-order traversal.  A null "pred" makes
+ *		"node" the new first element.  No keys are compared;
+ *		the caller guarantees the ordering is consistent.
+ */
+void rbtree_insert_after(tree, pred, node)
+	register rbtree_t	tree;
+	register rbtree_node_t	pred;
+	register rbtree_node_t	node;
+{
+	register rbtree_node_t	p;
+
+	if (pred == RBTREE_NODE_NULL) {
+		p = tree->root;
+		if (p == RBTREE_NODE_NULL) {
+			rbtree_insert_at(tree, p, TRUE, node);
+			return;
+		}
+		while (p->left != RBTREE_NODE_NULL)
+			p = p->left;
+		rbtree_insert_at(tree, p, TRUE, node);
+	} else if (pred->right == RBTREE_NODE_NULL) {
+		rbtree_insert_at(tree, pred, FALSE, node);
+	} else {
+		/*
+		 *	The successor of pred is the leftmost node
+		 *	of its right subtree, and has no left child.
+		 */
+		p = pred->right;
+		while (p->left != RBTREE_NODE_NULL)
+			p = p->left;
+		rbtree_insert_at(tree, p, TRUE, node);
+	}
+}
+
+/*
+ *	Restore the red-black invariants after a black node
+ *	was spliced out.  "x" (possibly null) now occupies its
+ *	place, below "parent".
+ */
+static void rb_remove_fixup(tree, x, parent)
+	register rbtree_t	tree;
+	register rbtree_node_t	x;
+	register rbtree_node_t	parent;
+{
+	register rbtree_node_t	w;
+
+	while ((x != tree->root) && rb_is_black(x)) {
+		if (x == parent->left) {
+			w = parent->right;
+			if (w->color == RB_RED) {
+				w->color = RB_BLACK;
+				parent->color = RB_RED;
+				rb_rotate_left(tree, parent);
+				w = parent->right;
+			}
+			if (rb_is_black(w->left) && rb_is_black(w->right)) {
+				w->color = RB_RED;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (rb_is_black(w->right)) {
+					w->left->color = RB_BLACK;
+					w->color = RB_RED;
+					rb_rotate_right(tree, w);
+					w = parent->right;
+				}
+				w->color = parent->color;
+				parent->color = RB_BLACK;
+				w->right->color = RB_BLACK;
+				rb_rotate_left(tree, parent);
+				x = tree->root;
+				break;
+			}
+		} else {
+			w = parent->left;
+			if (w->color == RB_RED) {
+				w->color = RB_BLACK;
+				parent->color = RB_RED;
+				rb_rotate_right(tree, parent);
+				w = parent->left;
+			}
+			if (rb_is_black(w->left) && rb_is_black(w->right)) {
+				w->color = RB_RED;
+				x = parent;
+				parent = x->parent;
+			} else {
+				if (rb_is_black(w->left)) {
+					w->right->color = RB_BLACK;
+					w->color = RB_RED;
+					rb_rotate_left(tree, w);
+					w = parent->left;
+				}
+				w->color = parent->color;
+				parent->color = RB_BLACK;
+				w->left->color = RB_BLACK;
+				rb_rotate_right(tree, parent);
+				x = tree->root;
+				break;
+			}
+		}
+	}
+	if (x != RBTREE_NODE_NULL)
+		x->color = RB_BLACK;
+}
+
+/*
+ *	Routine:	rbtree_remove
+ *	Purpose:
+ *		Unlink "node" from the tree and rebalance.
+ */
+void rbtree_remove(tree, node)
+	register rbtree_t	tree;
+	register rbtree_node_t	node;
+{
+	register rbtree_node_t	y, x, parent;
+	int			color;
+
+	/*
+	 *	"y" is the node actually spliced out of the tree:
+	 *	either "node" itself, or its successor when "node"
+	 *	has two children.
+	 */
+	if ((node->left == RBTREE_NODE_NULL) ||
+	    (node->right == RBTREE_NODE_NULL))
+		y = node;
+	else {
+		y = node->right;
+		while (y->left != RBTREE_NODE_NULL)
+			y = y->left;
+	}
+
+	x = (y->left != RBTREE_NODE_NULL) ? y->left : y->right;
+	parent = y->parent;
+	if (x != RBTREE_NODE_NULL)
+		x->parent = parent;
+	rb_replace_child(tree, y, x);
+	color = y->color;
+
+	if (y != node) {
+		/*
+		 *	Put the successor in node's place.
+		 */
+		y->left = node->left;
+		y->right = node->right;
+		y->parent = node->parent;
+		y->color = node->color;
+		rb_replace_child(tree, node, y);
+		if (y->left != RBTREE_NODE_NULL)
+			y->left->parent = y;
+		if (y->right != RBTREE_NODE_NULL)
+			y->right->parent = y;
+		if (parent == node)
+			parent = y;
+	}
+
+	if (color == RB_BLACK)
+		rb_remove_fixup(tree, x, parent);
+}
+
+rbtree_node_t rbtree_first(tree)
+	rbtree_t		tree;
+{
+	register rbtree_node_t	node = tree->root;
+
+	if (node == RBTREE_NODE_NULL)
+		return(RBTREE_NODE_NULL);
+	while (node->left != RBTREE_NODE_NULL)
+		node = node->left;
+	return(node);
+}
+
+rbtree_node_t rbtree_last(tree)
+	rbtree_t		tree;
+{
+	register rbtree_node_t	node = tree->root;
+
+	if (node == RBTREE_NODE_NULL)
+		return(RBTREE_NODE_NULL);
+	while (node->right != RBTREE_NODE_NULL)
+		node = node->right;
+	return(node);
+}
+
+rbtree_node_t rbtree_next(node)
+	register rbtree_node_t	node;
+{
+	register rbtree_node_t	p;
+
+	if (node->right != RBTREE_NODE_NULL) {
+		node = node->right;
+		while (node->left != RBTREE_NODE_NULL)
+			node = node->left;
+		return(node);
+	}
+	while (((p = node->parent) != RBTREE_NODE_NULL) &&
+	       (node == p->right))
+		node = p;
+	return(p);
+}
+
+rbtree_node_t rbtree_prev(node)
+	register rbtree_node_t	node;
+{
+	register rbtree_node_t	p;
+
+	if (node->left != RBTREE_NODE_NULL) {
+		node = node->left;
+		while (node->right != RBTREE_NODE_NULL)
+			node = node->right;
+		return(node);
+	}
+	while (((p = node->parent) != RBTREE_NODE_NULL) &&
+	       (node == p->left))
+		node = p;
+	return(p);
+}
@@ -0,0 +1,90 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	kern/rbtree.h
+ *
+ *	Definitions for intrusive red-black trees.
+ *
+ *	The tree only keeps structure; ordering is decided by the
+ *	caller, which either descends the tree itself to find the
+ *	insertion point or inserts relative to a known neighbour
+ *	(rbtree_insert_after).  Lookups never modify the tree, so
+ *	they may be performed by several readers at once.
+ */
+
+#ifndef	_KERN_RBTREE_H_
+#define	_KERN_RBTREE_H_
+
+/*
+ *	A node is embedded in each element of the tree,
+ *	much like a queue_chain_t.
+ */
+struct rbtree_node {
+	struct rbtree_node	*parent;	/* parent, or null for root */
+	struct rbtree_node	*left;		/* lesser elements */
+	struct rbtree_node	*right;		/* greater elements */
+	int			color;		/* RB_RED or RB_BLACK */
+};
+
+#define	RB_RED		0
+#define	RB_BLACK	1
+
+typedef struct rbtree_node	*rbtree_node_t;
+
+#define	RBTREE_NODE_NULL	((rbtree_node_t) 0)
+
+struct rbtree {
+	struct rbtree_node	*root;
+};
+
+typedef struct rbtree		*rbtree_t;
+
+#define	rbtree_init(tree)	((tree)->root = RBTREE_NODE_NULL)
+#define	rbtree_empty(tree)	((tree)->root == RBTREE_NODE_NULL)
+#define	rbtree_root(tree)	((tree)->root)
+
+/*
+ *	Macro:		rbtree_entry
+ *	Function:
+ *		Return the element containing the given node.
+ *	Header:
+ *		<type> *rbtree_entry(node, type, member)
+ *			rbtree_node_t	node;
+ *			<type>		type;		struct tag
+ *			<field>		member;		node field in type
+ */
+#define	rbtree_entry(node, type, member)				\
+	((type *) ((char *) (node) - (char *) &((type *) 0)->member))
+
+extern void		rbtree_insert_after();
+extern void		rbtree_insert_at();
+extern void		rbtree_remove();
+extern rbtree_node_t	rbtree_first();
+extern rbtree_node_t	rbtree_last();
+extern rbtree_node_t	rbtree_next();
+extern rbtree_node_t	rbtree_prev();
+
+#endif	_KERN_RBTREE_H_
@@ -0,0 +1,384 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	kern/ring.c
+ *
+ *	Ring channels: a wired buffer shared by a producer task
+ *	and a consumer task, with an eventcount for the consumer
+ *	to sleep on.  The kernel only sets the channel up and
+ *	delivers wakeups; records move through the buffer without
+ *	kernel involvement.  See mach/ring.h for the buffer layout.
+ */
+
+#include <mach/kern_return.h>
+#include <mach/vm_prot.h>
+#include <mach/vm_inherit.h>
+#include <mach/notify.h>
+#include <kern/kalloc.h>
+#include <kern/ipc_kobject.h>
+#include <kern/task.h>
+#include <kern/ring.h>
+#include <ipc/ipc_port.h>
+#include <ipc/ipc_space.h>
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+
+#define	ring_lock(ring)		simple_lock(&(ring)->lock)
+#define	ring_unlock(ring)	simple_unlock(&(ring)->lock)
+
+/*
+ *	Ring buffers are wired, so the memory in all of them is
+ *	limited.  A buffer is charged to ring_memory from ring_create
+ *	until it is freed.  If a task still has the buffer mapped
+ *	when the ring is destroyed, the ring waits on ring_lingering,
+ *	still charged, until ring_reclaim finds the buffer gone.
+ */
+vm_size_t	ring_memory_max = 8 * 1024 * 1024;	/* patchable */
+vm_size_t	ring_memory = 0;	/* bytes charged to buffers */
+queue_head_t	ring_lingering;		/* rings whose buffer is mapped */
+decl_simple_lock_data(,	ring_memory_lock)
+
+void ring_init(void)
+{
+	simple_lock_init(&ring_memory_lock);
+	queue_init(&ring_lingering);
+}
+
+/*
+ *	Uncharge and free the rings whose buffers have been freed
+ *	since they were destroyed.  A lingering buffer keeps its
+ *	kernel map entry, marked to go with the last user mapping.
+ */
+static void ring_reclaim(void)
+{
+	register ring_t		ring, next;
+	queue_head_t		gone;
+	vm_map_entry_t		entry;
+
+	queue_init(&gone);
+	vm_map_lock_read(kernel_map);
+	simple_lock(&ring_memory_lock);
+	for (ring = (ring_t) queue_first(&ring_lingering);
+	     !queue_end(&ring_lingering, (queue_entry_t) ring);
+	     ring = next) {
+		next = (ring_t) queue_next(&ring->lingering);
+		if (vm_map_lookup_entry(kernel_map, ring->kaddr, &entry) &&
+		    (entry->vme_start == ring->kaddr) &&
+		    (entry->object.vm_object == ring->object) &&
+		    (entry->projected_on == (vm_map_entry_t) -1))
+			continue;
+		queue_remove(&ring_lingering, ring, ring_t, lingering);
+		ring_memory -= ring->size;
+		queue_enter(&gone, ring, ring_t, lingering);
+	}
+	simple_unlock(&ring_memory_lock);
+	vm_map_unlock_read(kernel_map);
+
+	while (!queue_empty(&gone)) {
+		queue_remove_first(&gone, ring, ring_t, lingering);
+		kfree((vm_offset_t) ring, sizeof(struct ring));
+	}
+}
+
+void ring_reference(
+	register ring_t	ring)
+{
+	if (ring == RING_NULL)
+		return;
+
+	ring_lock(ring);
+	ring->ref_count++;
+	ring_unlock(ring);
+}
+
+/*
+ *	Drop a reference.  The last one goes when the ring's port
+ *	has no more senders and no kernel call still uses the ring.
+ *	The buffer itself lives on until every task has unmapped it.
+ */
+void ring_deallocate(
+	register ring_t	ring)
+{
+	register int c;
+
+	if (ring == RING_NULL)
+		return;
+
+	ring_lock(ring);
+	c = --(ring->ref_count);
+	ring_unlock(ring);
+	if (c != 0)
+		return;
+
+	evc_destroy(&ring->evc);
+	if (projected_buffer_release(ring->kaddr)) {
+		simple_lock(&ring_memory_lock);
+		ring_memory -= ring->size;
+		simple_unlock(&ring_memory_lock);
+		kfree((vm_offset_t) ring, sizeof(struct ring));
+	} else {
+		simple_lock(&ring_memory_lock);
+		queue_enter(&ring_lingering, ring, ring_t, lingering);
+		simple_unlock(&ring_memory_lock);
+	}
+}
+
+/*
+ *	Routine:	ring_create [kernel call]
+ *	Purpose:
+ *		Create a ring channel with a data area of size
+ *		bytes, and map it into the target task.
+ *	Returns:
+ *		KERN_SUCCESS		The ring was created.
+ *		KERN_INVALID_ARGUMENT	size is not a power of two
+ *					between RING_SIZE_MIN and
+ *					RING_SIZE_MAX.
+ *		KERN_RESOURCE_SHORTAGE	No eventcount or port, or
+ *					the buffer would take the
+ *					wired memory in all rings
+ *					past ring_memory_max.
+ */
+kern_return_t ring_create(
+	task_t		task,
+	vm_size_t	size,
+	vm_offset_t	*address,
+	ring_t		*ringp)
+{
+	register ring_t		ring;
+	register ring_header_t	rh;
+	ipc_port_t		port, notify;
+	vm_offset_t		user_addr;
+	vm_size_t		rsize;
+	vm_map_entry_t		entry;
+	kern_return_t		kr;
+
+	if (task == TASK_NULL)
+		return KERN_INVALID_ARGUMENT;
+	if ((size < RING_SIZE_MIN) || (size > RING_SIZE_MAX) ||
+	    ((size & (size - 1)) != 0))
+		return KERN_INVALID_ARGUMENT;
+	rsize = round_page(sizeof(struct ring_header) + size);
+
+	ring_reclaim();
+	simple_lock(&ring_memory_lock);
+	if (ring_memory + rsize > ring_memory_max) {
+		simple_unlock(&ring_memory_lock);
+		return KERN_RESOURCE_SHORTAGE;
+	}
+	ring_memory += rsize;
+	simple_unlock(&ring_memory_lock);
+
+	ring = (ring_t) kalloc(sizeof(struct ring));
+	if (ring == RING_NULL) {
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto uncharge;
+	}
+
+	simple_lock_init(&ring->lock);
+	ring->ref_count = 1;		/* for the port */
+	ring->size = rsize;
+
+	evc_init(&ring->evc);
+	if (ring->evc.sanity != &ring->evc) {
+		kfree((vm_offset_t) ring, sizeof(struct ring));
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto uncharge;
+	}
+
+	/*
+	 *	The kernel mapping is persistent, so that ring_map
+	 *	can find it even when no task has the buffer mapped.
+	 */
+	kr = projected_buffer_allocate(task->map, ring->size, TRUE,
+				       &ring->kaddr, &user_addr,
+				       VM_PROT_READ|VM_PROT_WRITE,
+				       VM_INHERIT_NONE);
+	if (kr != KERN_SUCCESS) {
+		evc_destroy(&ring->evc);
+		kfree((vm_offset_t) ring, sizeof(struct ring));
+		goto uncharge;
+	}
+
+	vm_map_lock_read(kernel_map);
+	if (!vm_map_lookup_entry(kernel_map, ring->kaddr, &entry))
+		panic("ring_create");
+	ring->object = entry->object.vm_object;
+	vm_map_unlock_read(kernel_map);
+
+	rh = (ring_header_t) ring->kaddr;
+	rh->rh_size = size;
+	rh->rh_evc = ring->evc.ev_id;
+
+	port = ipc_port_alloc_kernel();
+	if (port == IP_NULL) {
+		(void) projected_buffer_deallocate(task->map, user_addr,
+						   user_addr + ring->size);
+		ring_deallocate(ring);
+		return KERN_RESOURCE_SHORTAGE;
+	}
+	ring->self = port;
+	ipc_kobject_set(port, (ipc_kobject_t) ring, IKOT_RING);
+
+	/*
+	 *	The ring goes away when the last send right does.
+	 */
+	notify = ipc_port_make_sonce(port);
+	ip_lock(port);
+	ipc_port_nsrequest(port, 1, notify, &notify);
+	assert(notify == IP_NULL);
+
+	ring_reference(ring);		/* for convert_ring_to_port */
+	*address = user_addr;
+	*ringp = ring;
+	return KERN_SUCCESS;
+
+    uncharge:
+	simple_lock(&ring_memory_lock);
+	ring_memory -= rsize;
+	simple_unlock(&ring_memory_lock);
+	return kr;
+}
+
+/*
+ *	Routine:	ring_map [kernel call]
+ *	Purpose:
+ *		Map an existing ring into another task.
+ */
+kern_return_t ring_map(
+	ring_t		ring,
+	task_t		task,
+	vm_offset_t	*address)
+{
+	if ((ring == RING_NULL) || (task == TASK_NULL))
+		return KERN_INVALID_ARGUMENT;
+
+	return projected_buffer_map(task->map, ring->kaddr, ring->size,
+				    address, VM_PROT_READ|VM_PROT_WRITE,
+				    VM_INHERIT_NONE);
+}
+
+/*
+ *	Routine:	ring_signal [kernel call]
+ *	Purpose:
+ *		Wake the consumer of a ring.  Producers call this
+ *		only when they find rh_sleeping set.
+ */
+kern_return_t ring_signal(
+	ring_t		ring)
+{
+	if (ring == RING_NULL)
+		return KERN_INVALID_ARGUMENT;
+
+	evc_signal(&ring->evc);
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	convert_port_to_ring
+ *	Purpose:
+ *		Convert from a port to a ring.
+ *		Doesn't consume the port ref; produces a ring ref,
+ *		which may be null.
+ *	Conditions:
+ *		Nothing locked.
+ */
+ring_t
+convert_port_to_ring(
+	ipc_port_t	port)
+{
+	ring_t ring = RING_NULL;
+
+	if (IP_VALID(port)) {
+		ip_lock(port);
+		if (ip_active(port) &&
+		    (ip_kotype(port) == IKOT_RING)) {
+			ring = (ring_t) port->ip_kobject;
+			ring_reference(ring);
+		}
+		ip_unlock(port);
+	}
+
+	return ring;
+}
+
+/*
+ *	Routine:	convert_ring_to_port
+ *	Purpose:
+ *		Convert from a ring to a port.
+ *		Consumes a ring ref; produces a naked send right
+ *		which may be invalid.
+ *	Conditions:
+ *		Nothing locked.
+ */
+ipc_port_t
+convert_ring_to_port(
+	ring_t		ring)
+{
+	ipc_port_t port;
+
+	ring_lock(ring);
+	if (ring->self != IP_NULL)
+		port = ipc_port_make_send(ring->self);
+	else
+		port = IP_NULL;
+	ring_unlock(ring);
+
+	ring_deallocate(ring);
+	return port;
+}
+
+/*
+ *	Routine:	ring_notify
+ *	Purpose:
+ *		Handle a no-senders notification for a ring port,
+ *		by destroying the port and dropping its reference.
+ */
+boolean_t
+ring_notify(
+	mach_msg_header_t	*msg)
+{
+	ipc_port_t port;
+	ring_t ring;
+
+	if (msg->msgh_id != MACH_NOTIFY_NO_SENDERS) {
+		printf("ring_notify: strange notification %d\n",
+		       msg->msgh_id);
+		return FALSE;
+	}
+
+	port = (ipc_port_t) msg->msgh_remote_port;
+	assert(ip_kotype(port) == IKOT_RING);
+	ring = (ring_t) port->ip_kobject;
+	ipc_kobject_set(port, IKO_NULL, IKOT_NONE);
+
+	ring_lock(ring);
+	ring->self = IP_NULL;
+	ring_unlock(ring);
+
+	ipc_port_dealloc_kernel(port);
+	ring_deallocate(ring);
+	return TRUE;
+}
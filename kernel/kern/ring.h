@@ -0,0 +1,64 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	kern/ring.h
+ *
+ *	Kernel side of ring channels.  See mach/ring.h.
+ */
+
+#ifndef	_KERN_RING_H_
+#define	_KERN_RING_H_
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <mach/message.h>
+#include <mach/ring.h>
+#include <kern/lock.h>
+#include <kern/queue.h>
+#include <kern/thread.h>
+#include <kern/eventcount.h>
+
+typedef struct ring {
+	decl_simple_lock_data(,	lock)
+	int			ref_count;	/* number of references */
+	struct ipc_port		*self;		/* port naming the ring */
+	vm_offset_t		kaddr;		/* kernel mapping of buffer */
+	vm_size_t		size;		/* size of buffer */
+	struct vm_object	*object;	/* object of buffer */
+	struct evc		evc;		/* consumer wakeups */
+	queue_chain_t		lingering;	/* buffer outlives ring */
+} *ring_t;
+
+#define	RING_NULL	((ring_t) 0)
+
+extern void		ring_init(void);
+extern void		ring_reference(ring_t ring);
+extern void		ring_deallocate(ring_t ring);
+extern ring_t		convert_port_to_ring(struct ipc_port *port);
+extern struct ipc_port	*convert_ring_to_port(ring_t ring);
+extern boolean_t	ring_notify(mach_msg_header_t *msg);
+
+#endif	/* _KERN_RING_H_ */
@@ -112,16 +112,66 @@
 #endif	STAT_TIME
 #define NRQS	32			/* 32 run queues per cpu */
 
+/*
+ *	Bit n of the bitmap is set when runq[n] is non-empty, so
+ *	the highest priority runnable thread is found with
+ *	run_queue_first and low is always exact.  NRQS must not
+ *	exceed the number of bits in the bitmap.
+ */
 struct run_queue {
 	queue_head_t		runq[NRQS];	/* one for each priority */
 	decl_simple_lock_data(,	lock)		/* one lock for all queues */
-	int			low;		/* low queue value */
+	unsigned int		bitmap;		/* non-empty queues */
+	int			low;		/* low queue value, or NRQS */
 	int			count;		/* count of threads runable */
 };
 
 typedef struct run_queue	*run_queue_t;
 #define RUN_QUEUE_NULL	((run_queue_t) 0)
 
+/*
+ *	Note that a queue has become non-empty or empty.
+ *	The run queue must be locked.
+ */
+#define run_queue_bit(pri)	(1 << (pri))
+
+extern int		run_queue_first();
+
+#define run_queue_set(rq, pri)						\
+MACRO_BEGIN								\
+	(rq)->bitmap |= run_queue_bit(pri);				\
+	if ((pri) < (rq)->low)						\
+		(rq)->low = (pri);					\
+MACRO_END
+
+#define run_queue_clear(rq, pri)					\
+MACRO_BEGIN								\
+	(rq)->bitmap &= ~run_queue_bit(pri);				\
+	(rq)->low = run_queue_first((rq)->bitmap);			\
+MACRO_END
+
+/*
+ *	A processor set has a run queue for each processor slot.
+ *	Unbound threads are put on the queue of the processor they
+ *	last ran on, and a processor takes work from another's queue
+ *	when that has higher priority threads than its own, so
+ *	processors don't all contend for one lock.  The totals
+ *	below are unlocked snapshots.
+ */
+#if	NCPUS > 1
+#define pset_runq_slot(pset, processor)					\
+		(&(pset)->runq[(processor)->slot_num])
+
+extern int		pset_runq_count();
+extern int		pset_runq_low();
+#else	/* NCPUS > 1 */
+#define pset_runq_slot(pset, processor)	(&(pset)->runq[0])
+#define pset_runq_count(pset)						\
+		(*(volatile int *) &(pset)->runq[0].count)
+#define pset_runq_low(pset)						\
+		(*(volatile int *) &(pset)->runq[0].low)
+#endif	/* NCPUS > 1 */
+
 #if	MACH_FIXPRI
 /*
  *	NOTE: For fixed priority threads, first_quantum indicates
@@ -133,24 +183,21 @@ typedef struct run_queue	*run_queue_t;
 	((processor)->runq.count > 0) ||				\
 	((thread)->policy == POLICY_TIMESHARE &&			\
 		(processor)->first_quantum == FALSE &&			\
-		(processor)->processor_set->runq.count > 0 &&		\
-		  (processor)->processor_set->runq.low <=		\
+		  pset_runq_low((processor)->processor_set) <=		\
 			(thread)->sched_pri) ||				\
 	((thread)->policy == POLICY_FIXEDPRI &&				\
-		(processor)->processor_set->runq.count > 0 &&		\
 		 ((((processor)->first_quantum == FALSE) &&		\
-		  ((processor)->processor_set->runq.low <=		\
+		  (pset_runq_low((processor)->processor_set) <=		\
 			(thread)->sched_pri)) ||			\
-		 ((processor)->processor_set->runq.low <		\
+		 (pset_runq_low((processor)->processor_set) <		\
 			(thread)->sched_pri))))
 
 #else	MACH_FIXPRI
 #define csw_needed(thread, processor) ((thread)->state & TH_SUSP ||	\
 		((processor)->runq.count > 0) ||			\
 		((processor)->first_quantum == FALSE &&			\
-		 ((processor)->processor_set->runq.count > 0 &&		\
-		  (processor)->processor_set->runq.low <=		\
-			((thread)->sched_pri))))
+		  pset_runq_low((processor)->processor_set) <=		\
+			((thread)->sched_pri)))
 #endif	MACH_FIXPRI
 
 /*
@@ -159,6 +206,9 @@ typedef struct run_queue	*run_queue_t;
 
 extern struct run_queue	*rem_runq();
 extern struct thread	*choose_thread();
+extern void		run_queue_init();
+extern struct thread	*run_queue_dequeue();
+extern void		run_queue_remove();
 extern queue_head_t	action_queue;	/* assign/shutdown queue */
 decl_simple_lock_data(extern,action_lock);
 
@@ -303,11 +303,13 @@
 #include <hw_footprint.h>
 #include <fast_tas.h>
 #include <power_save.h>
+#include <mach_debug.h>
 
 #include <mach/machine.h>
 #include <kern/ast.h>
 #include <kern/counters.h>
 #include <kern/cpu_number.h>
+#include <kern/kalloc.h>
 #include <kern/lock.h>
 #include <kern/macro_help.h>
 #include <kern/processor.h>
@@ -322,6 +324,12 @@
 #include <vm/vm_kern.h>
 #include <vm/vm_map.h>
 #include <machine/machspl.h>	/* For def'n of splsched() */
+#if	MACH_DEBUG
+#include <mach/kern_return.h>
+#include <mach_debug/hash_info.h>
+#include <mach_debug/wait_info.h>
+#include <kern/host.h>
+#endif	/* MACH_DEBUG */
 
 #if	MACH_FIXPRI
 #include <mach/policy.h>
@@ -346,6 +354,7 @@ void set_pri(thread_t, int, boolean_t);
 void do_thread_scan(void);
 
 thread_t	choose_pset_thread();
+run_queue_t	pset_runq_choose();
 
 timer_elt_data_t recompute_priorities_timer;
 
@@ -408,26 +417,145 @@ void thread_check(thread_t, run_queue_t);
  *	interrupts below splsched() must be prevented when holding
  *	thread or hash bucket locks.
  *
+ *	The table grows with the number of threads.  Its size is
+ *	always a power of two and a multiple of WAIT_LOCKS, and a
+ *	bucket is protected by the lock of the stripe given by the
+ *	low bits of its index.  Growing only moves threads between
+ *	buckets of the same stripe, so the table is rehashed one
+ *	stripe at a time while the others stay in use.  Each stripe
+ *	records which table it is using.
+ *
  *	The wait event hash table declarations are as follows:
  */
 
-#define NUMQUEUES	59
+#define WAIT_LOCKS	64		/* lock stripes, a power of two */
+#define WAIT_QUEUES_MIN	WAIT_LOCKS	/* initial table size */
+
+struct wait_stripe {
+	decl_simple_lock_data(,	lock)		/* lock for the stripe */
+	queue_t			table;		/* table in use */
+	unsigned int		mask;		/* its size - 1 */
+	unsigned int		waiters;	/* threads waiting */
+	unsigned int		wakeups;	/* thread_wakeup_prim calls */
+	unsigned int		scanned;	/* waiters they examined */
+	unsigned int		woken;		/* waiters they woke */
+};
 
-queue_head_t		wait_queue[NUMQUEUES];
-decl_simple_lock_data(,	wait_lock[NUMQUEUES])
+struct wait_stripe	wait_stripes[WAIT_LOCKS];
+queue_head_t		wait_queue_initial[WAIT_QUEUES_MIN];
 
-/* NOTE: we want a small positive integer out of this */
-#define wait_hash(event) \
-	((((int)(event) < 0) ? ~(int)(event) : (int)(event)) % NUMQUEUES)
+unsigned int		wait_queue_size = WAIT_QUEUES_MIN;
+unsigned int		wait_queue_max = 16384;		/* patchable */
+unsigned int		wait_queue_resizes = 0;
+
+/*
+ *	Fold the high bits of the product into the low ones,
+ *	which would otherwise reflect only the event's alignment.
+ */
+#define wait_hash(event)						\
+	wait_hash_mix((unsigned int)(event) * 2654435761U)
+#define wait_hash_mix(h)	((h) ^ ((h) >> 16))
+
+#define wait_stripe(hash)	(&wait_stripes[(hash) & (WAIT_LOCKS - 1)])
+#define wait_bucket(ws, hash)	(&(ws)->table[(hash) & (ws)->mask])
 
 void wait_queue_init(void)
 {
 	register int i;
 
-	for (i = 0; i < NUMQUEUES; i++) {
-		queue_init(&wait_queue[i]);
-		simple_lock_init(&wait_lock[i]);
+	for (i = 0; i < WAIT_QUEUES_MIN; i++)
+		queue_init(&wait_queue_initial[i]);
+
+	for (i = 0; i < WAIT_LOCKS; i++) {
+		register struct wait_stripe *ws = &wait_stripes[i];
+
+		simple_lock_init(&ws->lock);
+		ws->table = wait_queue_initial;
+		ws->mask = WAIT_QUEUES_MIN - 1;
+		ws->waiters = 0;
+		ws->wakeups = 0;
+		ws->scanned = 0;
+		ws->woken = 0;
+	}
+}
+
+/*
+ *	wait_queue_grow:
+ *
+ *	Rehash the wait queues into a table of the given size.
+ *	Only called from the scheduler thread; may block.
+ */
+void wait_queue_grow(
+	unsigned int	size)
+{
+	register queue_t		new_table, old_table;
+	register struct wait_stripe	*ws;
+	register thread_t		thread;
+	register unsigned int		i, j, hash;
+	unsigned int			old_size;
+	spl_t				s;
+
+	new_table = (queue_t) kalloc(size * sizeof(queue_head_t));
+	if (new_table == (queue_t) 0)
+		return;
+	for (i = 0; i < size; i++)
+		queue_init(&new_table[i]);
+
+	old_table = wait_stripes[0].table;
+	old_size = wait_queue_size;
+
+	for (i = 0; i < WAIT_LOCKS; i++) {
+		ws = &wait_stripes[i];
+
+		s = splsched();
+		simple_lock(&ws->lock);
+		for (j = i; j < old_size; j += WAIT_LOCKS) {
+			register queue_t q = &old_table[j];
+
+			while (!queue_empty(q)) {
+				thread = (thread_t) dequeue_head(q);
+				hash = wait_hash(thread->wait_event);
+				enqueue_tail(&new_table[hash & (size - 1)],
+					     (queue_entry_t) thread);
+			}
+		}
+		ws->table = new_table;
+		ws->mask = size - 1;
+		simple_unlock(&ws->lock);
+		splx(s);
 	}
+
+	wait_queue_size = size;
+	wait_queue_resizes++;
+
+	if (old_table != wait_queue_initial)
+		kfree((vm_offset_t) old_table,
+		      old_size * sizeof(queue_head_t));
+}
+
+/*
+ *	wait_queue_adjust:
+ *
+ *	Grow the wait queue table if there are more threads
+ *	than buckets.
+ */
+void wait_queue_adjust(void)
+{
+	register processor_set_t	pset;
+	register unsigned int		nthreads, size;
+
+	nthreads = 0;
+	simple_lock(&all_psets_lock);
+	queue_iterate(&all_psets, pset, processor_set_t, all_psets)
+		nthreads += pset->thread_count;
+	simple_unlock(&all_psets_lock);
+
+	size = wait_queue_size;
+	while (size < nthreads && size < wait_queue_max)
+		size <<= 1;
+
+	if (size != wait_queue_size)
+		wait_queue_grow(size);
 }
 
 void sched_init(void)
@@ -504,12 +632,9 @@ void assert_wait(
 	event_t		event,
 	boolean_t	interruptible)
 {
-	register queue_t	q;
-	register int		index;
+	register struct wait_stripe *ws;
+	register unsigned int	hash;
 	register thread_t	thread;
-#if	MACH_SLOCKS
-	register simple_lock_t	lock;
-#endif	/* MACH_SLOCKS */
 	spl_t			s;
 
 	thread = current_thread();
@@ -519,21 +644,19 @@ void assert_wait(
 	}
  	s = splsched();
 	if (event != 0) {
-		index = wait_hash(event);
-		q = &wait_queue[index];
-#if	MACH_SLOCKS
-		lock = &wait_lock[index];
-#endif	/* MACH_SLOCKS */
-		simple_lock(lock);
+		hash = wait_hash(event);
+		ws = wait_stripe(hash);
+		simple_lock(&ws->lock);
 		thread_lock(thread);
-		enqueue_tail(q, (queue_entry_t) thread);
+		enqueue_tail(wait_bucket(ws, hash), (queue_entry_t) thread);
+		ws->waiters++;
 		thread->wait_event = event;
 		if (interruptible)
 			thread->state |= TH_WAIT;
 		else
 			thread->state |= TH_WAIT | TH_UNINT;
 		thread_unlock(thread);
-		simple_unlock(lock);
+		simple_unlock(&ws->lock);
 	}
 	else {
 		thread_lock(thread);
@@ -563,11 +686,7 @@ void clear_wait(
 	int			result,
 	boolean_t		interrupt_only)
 {
-	register int		index;
-	register queue_t	q;
-#if	MACH_SLOCKS
-	register simple_lock_t	lock;
-#endif	/* MACH_SLOCKS */
+	register struct wait_stripe *ws;
 	register event_t	event;
 	spl_t			s;
 
@@ -585,12 +704,8 @@ void clear_wait(
 	event = thread->wait_event;
 	if (event != 0) {
 		thread_unlock(thread);
-		index = wait_hash(event);
-		q = &wait_queue[index];
-#if	MACH_SLOCKS
-		lock = &wait_lock[index];
-#endif	/* MACH_SLOCKS */
-		simple_lock(lock);
+		ws = wait_stripe(wait_hash(event));
+		simple_lock(&ws->lock);
 		/*
 		 *	If the thread is still waiting on that event,
 		 *	then remove it from the list.  If it is waiting
@@ -599,11 +714,12 @@ void clear_wait(
 		 */
 		thread_lock(thread);
 		if (thread->wait_event == event) {
-			remqueue(q, (queue_entry_t)thread);
+			remqueue((queue_t) 0, (queue_entry_t)thread);
+			ws->waiters--;
 			thread->wait_event = 0;
 			event = 0;		/* cause to run below */
 		}
-		simple_unlock(lock);
+		simple_unlock(&ws->lock);
 	}
 	if (event == 0) {
 		register int	state = thread->state;
@@ -659,28 +775,28 @@ void thread_wakeup_prim(
 	int		result)
 {
 	register queue_t	q;
-	register int		index;
+	register struct wait_stripe *ws;
+	register unsigned int	hash;
 	register thread_t	thread, next_th;
-#if	MACH_SLOCKS
-	register simple_lock_t	lock;
-#endif  /* MACH_SLOCKS */
 	spl_t			s;
 	register int		state;
 
-	index = wait_hash(event);
-	q = &wait_queue[index];
+	hash = wait_hash(event);
+	ws = wait_stripe(hash);
 	s = splsched();
-#if	MACH_SLOCKS
-	lock = &wait_lock[index];
-#endif	/* MACH_SLOCKS */
-	simple_lock(lock);
+	simple_lock(&ws->lock);
+	ws->wakeups++;
+	q = wait_bucket(ws, hash);
 	thread = (thread_t) queue_first(q);
 	while (!queue_end(q, (queue_entry_t)thread)) {
 		next_th = (thread_t) queue_next((queue_t) thread);
+		ws->scanned++;
 
 		if (thread->wait_event == event) {
 			thread_lock(thread);
 			remqueue(q, (queue_entry_t) thread);
+			ws->waiters--;
+			ws->woken++;
 			thread->wait_event = 0;
 			reset_timeout_check(&thread->timer);
 
@@ -721,10 +837,160 @@ void thread_wakeup_prim(
 		}
 		thread = next_th;
 	}
-	simple_unlock(lock);
+	simple_unlock(&ws->lock);
 	splx(s);
 }
 
+#if	MACH_DEBUG
+/*
+ *	wait_queue_info:
+ *
+ *	Fill in statistics, and the bucket counts if there is
+ *	room for them.  Returns the number of buckets.
+ *	The buckets may be pageable, so each chain is counted
+ *	with its stripe locked and stored after unlocking.
+ */
+unsigned int wait_queue_info(
+	wait_queue_info_t	*info,
+	hash_info_bucket_t	*buckets,
+	unsigned int		count)
+{
+	register struct wait_stripe	*ws;
+	register queue_t		q;
+	register queue_entry_t		e;
+	register unsigned int		i, j, n, size;
+	unsigned int			waiters, wakeups, scanned, woken;
+	spl_t				s;
+
+	bzero((char *) info, sizeof *info);
+	bzero((char *) buckets, count * sizeof *buckets);
+	size = 0;
+
+	for (i = 0; i < WAIT_LOCKS; i++) {
+		ws = &wait_stripes[i];
+
+		s = splsched();
+		simple_lock(&ws->lock);
+		waiters = ws->waiters;
+		wakeups = ws->wakeups;
+		scanned = ws->scanned;
+		woken = ws->woken;
+		if (ws->mask + 1 > size)
+			size = ws->mask + 1;
+		simple_unlock(&ws->lock);
+		splx(s);
+
+		info->wqi_waiters += waiters;
+		info->wqi_wakeups += wakeups;
+		info->wqi_scanned += scanned;
+		info->wqi_woken += woken;
+
+		for (j = i; ; j += WAIT_LOCKS) {
+			s = splsched();
+			simple_lock(&ws->lock);
+			if (j > ws->mask) {
+				simple_unlock(&ws->lock);
+				splx(s);
+				break;
+			}
+			q = &ws->table[j];
+			n = 0;
+			for (e = queue_first(q); !queue_end(q, e);
+			     e = queue_next(e))
+				n++;
+			simple_unlock(&ws->lock);
+			splx(s);
+
+			/* don't touch pageable memory while holding locks */
+			if (n > info->wqi_max_chain)
+				info->wqi_max_chain = n;
+			if (j < count)
+				buckets[j].hib_count = n;
+		}
+	}
+
+	info->wqi_size = size;
+	info->wqi_resizes = wait_queue_resizes;
+	return size;
+}
+
+/*
+ *	Routine:	host_wait_queue_info
+ *	Purpose:
+ *		Return information about the wait queue hash table.
+ *	Conditions:
+ *		Nothing locked.  Obeys CountInOut protocol.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ *		KERN_RESOURCE_SHORTAGE	Couldn't allocate memory.
+ */
+
+kern_return_t
+host_wait_queue_info(host, infop, bucketsp, countp)
+	host_t			host;
+	wait_queue_info_t	*infop;
+	hash_info_bucket_array_t *bucketsp;
+	unsigned int		*countp;
+{
+	vm_offset_t addr;
+	vm_size_t size = 0; /* '=0' to shut up lint */
+	hash_info_bucket_t *buckets;
+	unsigned int potential, actual;
+	kern_return_t kr;
+
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	/* start with in-line data */
+
+	buckets = *bucketsp;
+	potential = *countp;
+
+	for (;;) {
+		actual = wait_queue_info(infop, buckets, potential);
+		if (actual <= potential)
+			break;
+
+		/* allocate more memory */
+
+		if (buckets != *bucketsp)
+			kmem_free(ipc_kernel_map, addr, size);
+
+		size = round_page(actual * sizeof *buckets);
+		kr = kmem_alloc_pageable(ipc_kernel_map, &addr, size);
+		if (kr != KERN_SUCCESS)
+			return KERN_RESOURCE_SHORTAGE;
+
+		buckets = (hash_info_bucket_t *) addr;
+		potential = size/sizeof *buckets;
+	}
+
+	if (buckets == *bucketsp) {
+		/* data fit in-line; nothing to deallocate */
+
+		*countp = actual;
+	} else {
+		vm_map_copy_t copy;
+		vm_size_t used;
+
+		used = round_page(actual * sizeof *buckets);
+
+		if (used != size)
+			kmem_free(ipc_kernel_map, addr + used, size - used);
+
+		kr = vm_map_copyin(ipc_kernel_map, addr, used,
+				   TRUE, &copy);
+		assert(kr == KERN_SUCCESS);
+
+		*bucketsp = (hash_info_bucket_t *) copy;
+		*countp = actual;
+	}
+
+	return KERN_SUCCESS;
+}
+#endif	/* MACH_DEBUG */
+
 /*
  *	thread_sleep:
  *
@@ -779,8 +1045,7 @@ thread_t thread_select(
 
 	myprocessor->first_quantum = TRUE;
 	/*
-	 *	Check for obvious simple case; local runq is
-	 *	empty and global runq has entry at hint.
+	 *	Bound threads in the local runq come first.
 	 */
 	if (myprocessor->runq.count > 0) {
 		thread = choose_thread(myprocessor);
@@ -794,11 +1059,7 @@ thread_t thread_select(
 #else	/* MACH_HOST */
 		pset = &default_pset;
 #endif	/* MACH_HOST */
-		simple_lock(&pset->runq.lock);
-#if	DEBUG
-		checkrq(&pset->runq, "thread_select");
-#endif	/* DEBUG */
-		if (pset->runq.count == 0) {
+		if (pset_runq_count(pset) == 0) {
 			/*
 			 *	Nothing else runnable.  Return if this
 			 *	thread is still runnable on this processor.
@@ -812,7 +1073,6 @@ thread_t thread_select(
 			    ((thread->bound_processor == PROCESSOR_NULL) ||
 			     (thread->bound_processor == myprocessor))) {
 
-				simple_unlock(&pset->runq.lock);
 				thread_lock(thread);
 				if (thread->sched_stamp != sched_tick)
 				    update_priority(thread);
@@ -823,40 +1083,7 @@ thread_t thread_select(
 			}
 		}
 		else {
-			register queue_t	q;
-
-			/*
-			 *	If there is a thread at hint, grab it,
-			 *	else call choose_pset_thread.
-			 */
-			q = pset->runq.runq + pset->runq.low;
-
-			if (queue_empty(q)) {
-				pset->runq.low++;
-				thread = choose_pset_thread(myprocessor, pset);
-			}
-			else {
-				thread = (thread_t) dequeue_head(q);
-				thread->runq = RUN_QUEUE_NULL;
-				pset->runq.count--;
-#if	MACH_FIXPRI
-				/*
-				 *	Cannot lazy evaluate pset->runq.low for
-				 *	fixed priority policy
-				 */
-				if ((pset->runq.count > 0) &&
-				    (pset->policies & POLICY_FIXEDPRI)) {
-					    while (queue_empty(q)) {
-						pset->runq.low++;
-						q++;
-					    }
-				}
-#endif	/* MACH_FIXPRI */
-#if	DEBUG
-				checkrq(&pset->runq, "thread_select: after");
-#endif	/* DEBUG */
-				simple_unlock(&pset->runq.lock);
-			}
+			thread = choose_pset_thread(myprocessor, pset);
 		}
 
 #if	MACH_FIXPRI
@@ -1468,10 +1695,7 @@ void update_priority(
 	    simple_lock(&(rq)->lock);	/* lock the run queue */	\
 	    checkrq((rq), "thread_setrun: before adding thread");	\
 	    enqueue_tail(&(rq)->runq[whichq], (queue_entry_t) (th));	\
-									\
-	    if (whichq < (rq)->low || (rq)->count == 0) 		\
-		 (rq)->low = whichq;	/* minimize */			\
-									\
+	    run_queue_set((rq), whichq);				\
 	    (rq)->count++;						\
 	    (th)->runq = (rq);						\
 	    thread_check((th), (rq));					\
@@ -1491,10 +1715,7 @@ void update_priority(
 									\
 	    simple_lock(&(rq)->lock);	/* lock the run queue */	\
 	    enqueue_tail(&(rq)->runq[whichq], (queue_entry_t) (th));	\
-									\
-	    if (whichq < (rq)->low || (rq)->count == 0) 		\
-		 (rq)->low = whichq;	/* minimize */			\
-									\
+	    run_queue_set((rq), whichq);				\
 	    (rq)->count++;						\
 	    (th)->runq = (rq);						\
 	    simple_unlock(&(rq)->lock);					\
@@ -1578,7 +1799,13 @@ void thread_setrun(
 		}
 		simple_unlock(&pset->idle_lock);
 	    }
-	    rq = &(pset->runq);
+	    /*
+	     *	Queue it for the processor it last ran on, if any.
+	     */
+	    if (th->last_processor != PROCESSOR_NULL)
+		rq = pset_runq_slot(pset, th->last_processor);
+	    else
+		rq = pset_runq_slot(pset, current_processor());
 	    run_queue_enqueue(rq,th);
 	    /*
 	     * Preempt check
@@ -1649,7 +1876,7 @@ void thread_setrun(
 	    return;
 	}
 	if (th->bound_processor == PROCESSOR_NULL) {
-	    	rq = &(default_pset.runq);
+	    	rq = pset_runq_slot(&default_pset, master_processor);
 	}
 	else {
 		rq = &(master_processor->runq);
@@ -1731,12 +1958,10 @@ struct run_queue *rem_runq(
 			checkrq(rq, "rem_runq: before removing thread");
 			thread_check(th, rq);
 #endif	/* DEBUG */
-			remqueue(&rq->runq[0], (queue_entry_t) th);
-			rq->count--;
+			run_queue_remove(rq, th);
 #if	DEBUG
 			checkrq(rq, "rem_runq: after removing thread");
 #endif	/* DEBUG */
-			th->runq = RUN_QUEUE_NULL;
 			simple_unlock(&rq->lock);
 		}
 		else {
@@ -1755,6 +1980,192 @@ struct run_queue *rem_runq(
 }
 
 
+/*
+ *	run_queue_init:
+ *
+ *	Initialize an empty run queue.
+ */
+
+void run_queue_init(
+	register run_queue_t	rq)
+{
+	register int	i;
+
+	simple_lock_init(&rq->lock);
+	for (i = 0; i < NRQS; i++) {
+	    queue_init(&rq->runq[i]);
+	}
+	rq->bitmap = 0;
+	rq->low = NRQS;
+	rq->count = 0;
+}
+
+/*
+ *	run_queue_dequeue:
+ *
+ *	Remove and return the highest priority thread from a run
+ *	queue.  The run queue must be locked and not empty.
+ */
+
+thread_t run_queue_dequeue(
+	register run_queue_t	rq)
+{
+	register queue_t	q;
+	register thread_t	th;
+
+	assert(rq->count > 0);
+	q = rq->runq + rq->low;
+	th = (thread_t) dequeue_head(q);
+	if (queue_empty(q))
+	    run_queue_clear(rq, rq->low);
+	rq->count--;
+	th->runq = RUN_QUEUE_NULL;
+	return th;
+}
+
+/*
+ *	run_queue_remove:
+ *
+ *	Remove a thread from the run queue it is on.  The run queue
+ *	must be locked.
+ */
+
+void run_queue_remove(
+	register run_queue_t	rq,
+	register thread_t	th)
+{
+	register queue_t	q;
+
+	/*
+	 *	If the thread is alone on its queue, both its
+	 *	links point at the queue head.
+	 */
+	q = (queue_t) th->links.next;
+	if (q == (queue_t) th->links.prev)
+	    run_queue_clear(rq, q - rq->runq);
+	remqueue(q, (queue_entry_t) th);
+	rq->count--;
+	th->runq = RUN_QUEUE_NULL;
+}
+
+/*
+ *	run_queue_first:
+ *
+ *	Index of the lowest set bit in a run queue bitmap, which is
+ *	the highest priority non-empty queue, or NRQS if none is set.
+ *	Only a few machines provide ffs, so this is done in C by
+ *	halving the bitmap.
+ */
+
+int run_queue_first(
+	register unsigned int	bitmap)
+{
+	register int	pri;
+
+	if (bitmap == 0)
+	    return NRQS;
+
+	pri = 0;
+	if ((bitmap & 0xffff) == 0) {
+	    bitmap >>= 16;
+	    pri += 16;
+	}
+	if ((bitmap & 0xff) == 0) {
+	    bitmap >>= 8;
+	    pri += 8;
+	}
+	if ((bitmap & 0xf) == 0) {
+	    bitmap >>= 4;
+	    pri += 4;
+	}
+	if ((bitmap & 0x3) == 0) {
+	    bitmap >>= 2;
+	    pri += 2;
+	}
+	if ((bitmap & 0x1) == 0)
+	    pri += 1;
+	return pri;
+}
+
+#if	NCPUS > 1
+/*
+ *	pset_runq_count:
+ *
+ *	Number of threads on a processor set's runqs.
+ */
+
+int pset_runq_count(
+	register processor_set_t	pset)
+{
+	register int	i, count;
+
+	count = 0;
+	for (i = 0; i < NCPUS; i++)
+	    count += *(volatile int *) &pset->runq[i].count;
+	return count;
+}
+
+/*
+ *	pset_runq_low:
+ *
+ *	Highest priority (lowest value) of the threads on a
+ *	processor set's runqs, or NRQS if there are none.
+ */
+
+int pset_runq_low(
+	register processor_set_t	pset)
+{
+	register unsigned int	bitmap;
+	register int		i;
+
+	bitmap = 0;
+	for (i = 0; i < NCPUS; i++)
+	    bitmap |= *(volatile unsigned int *) &pset->runq[i].bitmap;
+	return run_queue_first(bitmap);
+}
+#endif	/* NCPUS > 1 */
+
+/*
+ *	pset_runq_choose:
+ *
+ *	Pick the processor set runq that myprocessor should take its
+ *	next thread from: its own, unless another holds a higher
+ *	priority thread.  Returns RUN_QUEUE_NULL if all are empty.
+ *	No locks are taken; the caller must recheck the count.
+ */
+
+run_queue_t pset_runq_choose(
+	processor_set_t		pset,
+	processor_t		myprocessor)
+{
+	register run_queue_t	rq, best;
+#if	NCPUS > 1
+	register int		i, low;
+
+	best = pset_runq_slot(pset, myprocessor);
+	if (*(volatile int *) &best->count > 0)
+	    low = *(volatile int *) &best->low;
+	else {
+	    best = RUN_QUEUE_NULL;
+	    low = NRQS;
+	}
+
+	for (i = 0; i < NCPUS; i++) {
+	    rq = &pset->runq[i];
+	    if (*(volatile int *) &rq->count > 0 &&
+		*(volatile int *) &rq->low < low) {
+		best = rq;
+		low = rq->low;
+	    }
+	}
+#else	/* NCPUS > 1 */
+	rq = pset_runq_slot(pset, myprocessor);
+	best = (pset_runq_count(pset) > 0) ? rq : RUN_QUEUE_NULL;
+#endif	/* NCPUS > 1 */
+
+	return best;
+}
+
 /*
  *	choose_thread:
  *
@@ -1774,48 +2185,36 @@ struct run_queue *rem_runq(
 thread_t choose_thread(
 	processor_t myprocessor)
 {
-	thread_t th;
-	register queue_t q;
 	register run_queue_t runq;
-	register int i;
-	register processor_set_t pset;
+	register thread_t th;
 
 	runq = &myprocessor->runq;
 
 	simple_lock(&runq->lock);
 	if (runq->count > 0) {
-	    q = runq->runq + runq->low;
-	    for (i = runq->low; i < NRQS ; i++, q++) {
-		if (!queue_empty(q)) {
-		    th = (thread_t) dequeue_head(q);
-		    th->runq = RUN_QUEUE_NULL;
-		    runq->count--;
-		    runq->low = i;
-		    simple_unlock(&runq->lock);
-		    return th;
-		}
-	    }
-	    panic("choose_thread");
-	    /*NOTREACHED*/
+	    th = run_queue_dequeue(runq);
+	    simple_unlock(&runq->lock);
+	    return th;
 	}
 	simple_unlock(&runq->lock);
 
-	pset = myprocessor->processor_set;
-
-	simple_lock(&pset->runq.lock);
-	return choose_pset_thread(myprocessor,pset);
+	return choose_pset_thread(myprocessor, myprocessor->processor_set);
 }
 
 /*
- *	choose_pset_thread:  choose a thread from processor_set runq or
+ *	choose_pset_thread:  choose a thread from processor_set runqs or
  *		set processor idle and choose its idle thread.
  *
- *	Caller must be at splsched and have a lock on the runq.  This
- *	lock is released by this routine.  myprocessor is always the current
+ *	Caller must be at splsched.  myprocessor is always the current
  *	processor, and pset must be its processor set.
- *	This routine chooses and removes a thread from the runq if there
+ *	This routine chooses and removes a thread from the runqs if there
  *	is one (and returns it), else it sets the processor idle and
  *	returns its idle thread.
+ *
+ *	The thread comes from this processor's own runq unless another
+ *	processor's runq has a higher priority thread, in which case
+ *	it is taken from there.  The choice is made without locks and
+ *	retried if the chosen runq was emptied meanwhile.
  */
 
 thread_t choose_pset_thread(
@@ -1824,43 +2223,19 @@ thread_t choose_pset_thread(
 {
 	register run_queue_t runq;
 	register thread_t th;
-	register queue_t q;
-	register int i;
 
-	runq = &pset->runq;
-
-	if (runq->count > 0) {
-	    q = runq->runq + runq->low;
-	    for (i = runq->low; i < NRQS ; i++, q++) {
-		if (!queue_empty(q)) {
-		    th = (thread_t) dequeue_head(q);
-		    th->runq = RUN_QUEUE_NULL;
-		    runq->count--;
-		    /*
-		     *	For POLICY_FIXEDPRI, runq->low must be
-		     *	accurate!
-		     */
-#if	MACH_FIXPRI
-		    if ((runq->count > 0) &&
-			(pset->policies & POLICY_FIXEDPRI)) {
-			    while (queue_empty(q)) {
-				q++;
-				i++;
-			    }
-		    }
-#endif	/* MACH_FIXPRI */
-		    runq->low = i;
+	while ((runq = pset_runq_choose(pset, myprocessor)) != RUN_QUEUE_NULL) {
+	    simple_lock(&runq->lock);
+	    if (runq->count > 0) {
+		th = run_queue_dequeue(runq);
 #if	DEBUG
-		    checkrq(runq, "choose_pset_thread");
+		checkrq(runq, "choose_pset_thread");
 #endif	/* DEBUG */
-		    simple_unlock(&runq->lock);
-		    return th;
-		}
+		simple_unlock(&runq->lock);
+		return th;
 	    }
-	    panic("choose_pset_thread");
-	    /*NOTREACHED*/
+	    simple_unlock(&runq->lock);
 	}
-	simple_unlock(&runq->lock);
 
 	/*
 	 *	Nothing is runnable, so set this processor idle if it
@@ -1905,7 +2280,7 @@ void idle_thread_continue(void)
 {
 	register processor_t myprocessor;
 	register volatile thread_t *threadp;
-	register volatile int *gcount;
+	register processor_set_t pset;
 	register volatile int *lcount;
 	register thread_t new_thread;
 	register int state;
@@ -1923,10 +2298,9 @@ void idle_thread_continue(void)
 #endif	/* MARK_CPU_IDLE */
 
 #if	MACH_HOST
-		gcount = (volatile int *)
-				&myprocessor->processor_set->runq.count;
+		pset = myprocessor->processor_set;
 #else	/* MACH_HOST */
-		gcount = (volatile int *) &default_pset.runq.count;
+		pset = &default_pset;
 #endif	/* MACH_HOST */
 
 /*
@@ -1934,7 +2308,7 @@ void idle_thread_continue(void)
  *	to the value of the thread to run next.  Also check runq counts.
  */
 		while ((*threadp == (volatile thread_t)THREAD_NULL) &&
-		       (*gcount == 0) && (*lcount == 0)) {
+		       (pset_runq_count(pset) == 0) && (*lcount == 0)) {
 
 			/* check for ASTs while we wait */
 
@@ -2007,8 +2381,6 @@ retry:
 			thread_run(idle_thread_continue, new_thread);
 		}
 		else if (state == PROCESSOR_IDLE) {
-			register processor_set_t pset;
-
 			pset = myprocessor->processor_set;
 			simple_lock(&pset->idle_lock);
 			if (myprocessor->state != PROCESSOR_IDLE) {
@@ -2096,6 +2468,7 @@ void sched_thread_continue(void)
 {
     while (TRUE) {
 	(void) compute_mach_factor();
+	wait_queue_adjust();
 
 	/*
 	 *	Check for stuck threads.  This can't be done off of
@@ -2203,9 +2576,7 @@ do_runq_scan(
 			     *	see it.  So we remove the thread
 			     *	from the runq to make it safe.
 			     */
-			    remqueue(q, (queue_entry_t) thread);
-			    runq->count--;
-			    thread->runq = RUN_QUEUE_NULL;
+			    run_queue_remove(runq, thread);
 
 			    stuck_threads[stuck_count++] = thread;
 if (do_thread_scan_debug)
@@ -2223,6 +2594,23 @@ if (do_thread_scan_debug)
 	return FALSE;
 }
 
+/*
+ *	do_pset_runq_scan scans each of a processor set's runqs.
+ */
+
+boolean_t
+do_pset_runq_scan(
+	processor_set_t	pset)
+{
+	register int	i;
+
+	for (i = 0; i < NCPUS; i++)
+	    if (do_runq_scan(&pset->runq[i]))
+		return TRUE;
+
+	return FALSE;
+}
+
 void do_thread_scan(void)
 {
 	register spl_t		s;
@@ -2236,12 +2624,12 @@ void do_thread_scan(void)
 #if	MACH_HOST
 	    simple_lock(&all_psets_lock);
 	    queue_iterate(&all_psets, pset, processor_set_t, all_psets) {
-		if (restart_needed = do_runq_scan(&pset->runq))
+		if (restart_needed = do_pset_runq_scan(pset))
 			break;
 	    }
 	    simple_unlock(&all_psets_lock);
 #else	/* MACH_HOST */
-	    restart_needed = do_runq_scan(&default_pset.runq);
+	    restart_needed = do_pset_runq_scan(&default_pset);
 #endif	/* MACH_HOST */
 	    if (!restart_needed)
 	    	restart_needed = do_runq_scan(&master_processor->runq);
@@ -2279,8 +2667,10 @@ void checkrq(
 	register int		i, j;
 	register queue_entry_t	e;
 	register int		low;
+	register unsigned int	bitmap;
 
 	low = -1;
+	bitmap = 0;
 	j = 0;
 	q1 = rq->runq;
 	for (i = 0; i < NRQS; i++) {
@@ -2291,6 +2681,7 @@ void checkrq(
 	    else {
 		if (low == -1)
 		    low = i;
+		bitmap |= run_queue_bit(i);
 		
 		for (e = q1->next; e != q1; e = e->next) {
 		    j++;
@@ -2304,7 +2695,9 @@ void checkrq(
 	}
 	if (j != rq->count)
 	    panic("checkrq: count wrong at %s", msg);
-	if (rq->count != 0 && low < rq->low)
+	if (bitmap != rq->bitmap)
+	    panic("checkrq: bitmap wrong at %s", msg);
+	if ((rq->count == 0) ? (rq->low != NRQS) : (low != rq->low))
 	    panic("checkrq: low wrong at %s", msg);
 }
 
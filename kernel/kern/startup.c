@@ -188,6 +188,7 @@
 #include <ipc/ipc_init.h>
 #include <kern/cpu_number.h>
 #include <kern/processor.h>
+#include <kern/ring.h>
 #include <kern/sched_prim.h>
 #include <kern/task.h>
 #include <kern/thread.h>
@@ -277,6 +278,7 @@ void setup_main()
 	task_init();
 	thread_init();
 	swapper_init();
+	ring_init();
 #if	MACH_HOST
 	pset_sys_init();
 #endif	MACH_HOST
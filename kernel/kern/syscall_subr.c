@@ -173,7 +173,7 @@ void swtch_continue()
 
 	myprocessor = current_processor();
 	thread_syscall_return(myprocessor->runq.count > 0 ||
-			      myprocessor->processor_set->runq.count > 0);
+			      pset_runq_count(myprocessor->processor_set) > 0);
 	/*NOTREACHED*/
 }
 
@@ -184,7 +184,7 @@ boolean_t swtch()
 #if	NCPUS > 1
 	myprocessor = current_processor();
 	if (myprocessor->runq.count == 0 &&
-	    myprocessor->processor_set->runq.count == 0)
+	    pset_runq_count(myprocessor->processor_set) == 0)
 		return(FALSE);
 #endif	NCPUS > 1
 
@@ -192,7 +192,7 @@ boolean_t swtch()
 	thread_block(swtch_continue);
 	myprocessor = current_processor();
 	return(myprocessor->runq.count > 0 ||
-	       myprocessor->processor_set->runq.count > 0);
+	       pset_runq_count(myprocessor->processor_set) > 0);
 }
 
 void swtch_pri_continue()
@@ -204,7 +204,7 @@ void swtch_pri_continue()
 		(void) thread_depress_abort(thread);
 	myprocessor = current_processor();
 	thread_syscall_return(myprocessor->runq.count > 0 ||
-			      myprocessor->processor_set->runq.count > 0);
+			      pset_runq_count(myprocessor->processor_set) > 0);
 	/*NOTREACHED*/
 }
 
@@ -221,7 +221,7 @@ boolean_t  swtch_pri(pri)
 #if	NCPUS > 1
 	myprocessor = current_processor();
 	if (myprocessor->runq.count == 0 &&
-	    myprocessor->processor_set->runq.count == 0)
+	    pset_runq_count(myprocessor->processor_set) == 0)
 		return(FALSE);
 #endif	NCPUS > 1
 
@@ -238,7 +238,7 @@ boolean_t  swtch_pri(pri)
 		(void) thread_depress_abort(thread);
 	myprocessor = current_processor();
 	return(myprocessor->runq.count > 0 ||
-	       myprocessor->processor_set->runq.count > 0);
+	       pset_runq_count(myprocessor->processor_set) > 0);
 }
 
 extern int hz;
@@ -363,7 +363,7 @@ mach_msg_timeout_t option_time;
      */
 #if	NCPUS > 1
     myprocessor = current_processor();
-    if (myprocessor->processor_set->runq.count > 0 ||
+    if (pset_runq_count(myprocessor->processor_set) > 0 ||
 	myprocessor->runq.count > 0)
 #endif	NCPUS > 1
     {
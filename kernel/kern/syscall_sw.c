@@ -285,7 +285,7 @@ mach_trap_t	mach_trap_table[] = {
 	MACH_TRAP(kern_invalid, 0),		/* 22 */
 #endif	/* MACH_IPC_COMPAT */
 	MACH_TRAP(kern_invalid, 0),		/* 23 */
-	MACH_TRAP(kern_invalid, 0),		/* 24 */
+	MACH_TRAP(mach_msg_send_vector_trap, 6),	/* 24 */
 	MACH_TRAP_STACK(mach_msg_trap, 7),	/* 25 */
 	MACH_TRAP(mach_reply_port, 0),		/* 26 */
 	MACH_TRAP(mach_thread_self, 0),		/* 27 */
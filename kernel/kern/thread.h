@@ -355,6 +355,7 @@ struct thread {
 			mach_msg_header_t *msg;
 			mach_msg_option_t option;
 			mach_msg_size_t rcv_size;
+			mach_port_t rcv_name;
 			mach_msg_timeout_t timeout;
 			mach_port_t notify;
 			struct ipc_object *object;
@@ -412,6 +413,7 @@ struct thread {
 #define	ith_msg		saved.receive.msg
 #define	ith_option	saved.receive.option
 #define ith_rcv_size	saved.receive.rcv_size
+#define ith_rcv_name	saved.receive.rcv_name
 #define ith_timeout	saved.receive.timeout
 #define ith_notify	saved.receive.notify
 #define ith_object	saved.receive.object
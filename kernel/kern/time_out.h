@@ -72,11 +72,12 @@ extern int	tick;		/* number of usec per tick */
  *	Time-out element.
  */
 struct timer_elt {
-	queue_chain_t	chain;		/* chain in order of expiration */
+	queue_chain_t	chain;		/* chain in timer wheel slot */
 	int		(*fcn)();	/* function to call */
 	char *		param;		/* with this parameter */
 	unsigned long	ticks;		/* expiration time, in ticks */
 	int		set;		/* unset | set | allocated */
+	struct timer_wheel *wheel;	/* wheel it is set on */
 };
 #define	TELT_UNSET	0		/* timer not set */
 #define	TELT_SET	1		/* timer set */
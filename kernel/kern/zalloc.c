@@ -242,6 +242,9 @@
  *	data blocks for which quick allocation/deallocation is possible.
  */
 
+#include <cpus.h>
+
+#include <kern/cpu_number.h>
 #include <kern/macro_help.h>
 #include <kern/sched.h>
 #include <kern/time_out.h>
@@ -261,46 +264,64 @@
 #include <vm/vm_kern.h>
 #endif
 
+extern void		zone_slab_free();
+extern vm_offset_t	zone_slab_alloc();
+
 #define ADD_TO_ZONE(zone, element)					\
 MACRO_BEGIN								\
+	if ((zone)->slab)						\
+		zone_slab_free((zone), (vm_offset_t) (element));	\
+	else {								\
 		*((vm_offset_t *)(element)) = (zone)->free_elements;	\
 		(zone)->free_elements = (vm_offset_t) (element);	\
-		(zone)->count--;					\
+	}								\
+	(zone)->count--;						\
 MACRO_END
 
 #define REMOVE_FROM_ZONE(zone, ret, type)				\
 MACRO_BEGIN								\
-	(ret) = (type) (zone)->free_elements;				\
-	if ((ret) != (type) 0) {					\
-		(zone)->count++;					\
-		(zone)->free_elements = *((vm_offset_t *)(ret));	\
+	if ((zone)->slab)						\
+		(ret) = (type) zone_slab_alloc(zone);			\
+	else {								\
+		(ret) = (type) (zone)->free_elements;			\
+		if ((ret) != (type) 0)					\
+			(zone)->free_elements =				\
+				*((vm_offset_t *)(ret));		\
 	}								\
+	if ((ret) != (type) 0)						\
+		(zone)->count++;					\
 MACRO_END
 
 /*
- * Support for garbage collection of unused zone pages:
+ *	Slab descriptors.
+ *
+ *	There is one entry for every page in the zone_map.  The entry
+ *	for the first page of a slab describes the whole slab; the
+ *	entries for its other pages only record how far back the first
+ *	page is.  Descriptors are protected by the lock of the zone
+ *	owning the slab.
  */
 
 struct zone_page_table_entry {
-	struct	zone_page_table_entry	*next;
-	short 	in_free_list;
-	short	alloc_count;
+	queue_chain_t	links;		/* on a zone slab list */
+	vm_offset_t	free_elements;	/* free elements in the slab */
+	int		free_count;	/* number of free elements */
+	int		bin;		/* slab list, or ZONE_SLAB_FULL */
+	int		first;		/* pages back to start of slab */
 };
 
+typedef struct zone_page_table_entry	*zone_slab_t;
+
 extern struct zone_page_table_entry * zone_page_table;
 extern vm_offset_t zone_map_min_address;
 
-#define lock_zone_page_table() simple_lock(&zone_page_table_lock)
-#define unlock_zone_page_table() simple_unlock(&zone_page_table_lock)
-
 #define	zone_page(addr) \
     (&(zone_page_table[(atop(((vm_offset_t)addr) - zone_map_min_address))]))
 
+#define	zone_slab(addr)		(zone_page(addr) - zone_page(addr)->first)
 
-extern void		zone_page_alloc();
-extern void		zone_page_dealloc();
-extern void		zone_page_in_use();
-extern void		zone_page_free();
+#define	zone_slab_addr(slab) \
+    (zone_map_min_address + ptoa((slab) - zone_page_table))
 
 zone_t		zone_zone;	/* this is the zone containing other zones */
 
@@ -351,6 +372,164 @@ MACRO_BEGIN						\
 	}						\
 MACRO_END
 
+#if	NCPUS > 1
+/*
+ *	Per-processor element caches.
+ *
+ *	A cache belongs to one processor and is only examined or
+ *	changed by that processor at splhigh, so no lock is needed.
+ *	Elements are chained through their first word, as on the
+ *	zone's free list.  Elements in a cache are counted as in use
+ *	by the zone; they move to and from the zone's free list
+ *	(the depot) in batches of half the cache depth.
+ *
+ *	Since zone_gc can not safely reach into other processors'
+ *	caches, it asks them to drain by setting the drain flag;
+ *	each processor empties its cache into the depot the next
+ *	time it uses the zone.
+ */
+
+boolean_t	zone_cache_enable = TRUE;
+
+#define	zone_cache_batch(zone)	(((zone)->cache_max + 1) >> 1)
+
+/*
+ *	Choose the cache depth for a zone: about a page worth
+ *	of elements, but at least two and at most ZONE_CACHE_MAX.
+ */
+int zone_cache_depth(elem_size)
+	vm_size_t	elem_size;
+{
+	register vm_size_t	depth;
+
+	depth = PAGE_SIZE / elem_size;
+	if (depth > ZONE_CACHE_MAX)
+		depth = ZONE_CACHE_MAX;
+	if (depth < 2)
+		depth = 2;
+	return((int) depth);
+}
+
+/*
+ *	Move up to "n" elements from the cache to the depot.
+ *	The zone must be locked, at splhigh.
+ */
+void zone_cache_flush(zone, zc, n)
+	register zone_t			zone;
+	register struct zone_cache	*zc;
+	register int			n;
+{
+	register vm_offset_t	elem;
+
+	while ((n-- > 0) && ((elem = zc->free_elements) != 0)) {
+		zc->free_elements = *((vm_offset_t *) elem);
+		zc->count--;
+		ADD_TO_ZONE(zone, elem);
+	}
+}
+
+/*
+ *	Move up to "n" elements from the depot to the cache.
+ *	The zone must be locked, at splhigh.
+ */
+void zone_cache_fill(zone, zc, n)
+	register zone_t			zone;
+	register struct zone_cache	*zc;
+	register int			n;
+{
+	register vm_offset_t	elem;
+
+	while (n-- > 0) {
+		REMOVE_FROM_ZONE(zone, elem, vm_offset_t);
+		if (elem == 0)
+			break;
+		*((vm_offset_t *) elem) = zc->free_elements;
+		zc->free_elements = elem;
+		zc->count++;
+	}
+}
+
+/*
+ *	Take an element from this processor's cache, refilling
+ *	it from the depot if it is empty.  Returns zero if both
+ *	are empty; the caller then takes the ordinary path.
+ */
+vm_offset_t zone_cache_get(zone)
+	register zone_t	zone;
+{
+	register struct zone_cache	*zc;
+	register vm_offset_t		addr;
+	spl_t				s;
+
+	s = splhigh();
+	zc = &zone->cache[cpu_number()];
+
+	if (zc->drain) {
+		lock_zone(zone);
+		zone_cache_flush(zone, zc, zc->count);
+		unlock_zone(zone);
+		zc->drain = FALSE;
+		zc->misses++;
+		splx(s);
+		return(0);
+	}
+
+	if ((addr = zc->free_elements) == 0) {
+		zc->misses++;
+		lock_zone(zone);
+		zone_cache_fill(zone, zc, zone_cache_batch(zone));
+		unlock_zone(zone);
+		if ((addr = zc->free_elements) == 0) {
+			splx(s);
+			return(0);
+		}
+	} else
+		zc->hits++;
+
+	zc->free_elements = *((vm_offset_t *) addr);
+	zc->count--;
+	splx(s);
+	return(addr);
+}
+
+/*
+ *	Return an element to this processor's cache.  If the cache
+ *	is full, half of it is first moved to the depot; if a drain
+ *	was requested, all of it and the element go to the depot.
+ */
+void zone_cache_put(zone, elem)
+	register zone_t	zone;
+	vm_offset_t	elem;
+{
+	register struct zone_cache	*zc;
+	spl_t				s;
+
+	s = splhigh();
+	zc = &zone->cache[cpu_number()];
+
+	if (zc->drain) {
+		lock_zone(zone);
+		zone_cache_flush(zone, zc, zc->count);
+		ADD_TO_ZONE(zone, elem);
+		unlock_zone(zone);
+		zc->drain = FALSE;
+		splx(s);
+		return;
+	}
+
+	if (zc->count >= zone->cache_max) {
+		lock_zone(zone);
+		zone_cache_flush(zone, zc, zone_cache_batch(zone));
+		unlock_zone(zone);
+	}
+
+	*((vm_offset_t *) elem) = zc->free_elements;
+	zc->free_elements = elem;
+	zc->count++;
+	splx(s);
+}
+#endif	NCPUS > 1
+
 vm_offset_t zget_space();
 
 decl_simple_lock_data(,zget_space_lock)
@@ -359,20 +538,13 @@ vm_offset_t zalloc_end_of_space;
 vm_size_t zalloc_wasted_space;
 
 /*
- *	Garbage collection map information
+ *	Slab descriptor information
  */
-decl_simple_lock_data(,zone_page_table_lock)
 struct zone_page_table_entry *	zone_page_table;
 vm_offset_t			zone_map_min_address;
 vm_offset_t			zone_map_max_address;
 int				zone_pages;
 
-extern void zone_page_init();
-
-#define	ZONE_PAGE_USED  0
-#define ZONE_PAGE_UNUSED -1
-
-
 /*
  *	Protects first_zone, last_zone, num_zones,
  *	and the next_zone field of zones.
@@ -429,8 +601,39 @@ zone_t zinit(size, max, alloc, pageable, name)
 	z->exhaustible = z->sleepable = FALSE;
 	z->collectable = FALSE;
 	z->expandable  = TRUE;
+	z->slab = FALSE;
+	z->slab_elems = 0;
+	z->slab_count = 0;
+	z->slab_empty_count = 0;
+	{
+		register int	i;
+
+		for (i = 0; i <= ZONE_SLAB_EMPTY; i++)
+			queue_init(&z->slab_lists[i]);
+	}
 	lock_zone_init(z);
 
+#if	NCPUS > 1
+	{
+		register int	cpu;
+
+		if (pageable || !zone_cache_enable)
+			z->cache_max = 0;
+		else
+			z->cache_max = zone_cache_depth(z->elem_size);
+
+		for (cpu = 0; cpu < NCPUS; cpu++) {
+			z->cache[cpu].free_elements = 0;
+			z->cache[cpu].count = 0;
+			z->cache[cpu].drain = FALSE;
+			z->cache[cpu].hits = 0;
+			z->cache[cpu].misses = 0;
+		}
+	}
+#else	NCPUS > 1
+	z->cache_max = 0;
+#endif	NCPUS > 1
+
 	/*
 	 *	Add the zone to the all-zones list.
 	 */
@@ -458,12 +661,14 @@ void zcram(zone, newmem, size)
 	if (newmem == (vm_offset_t) 0) {
 		panic("zcram - memory at zero");
 	}
+	if (zone->slab) {
+		panic("zcram - slab zone");
+	}
 	elem_size = zone->elem_size;
 
 	lock_zone(zone);
 	while (size >= elem_size) {
 		ADD_TO_ZONE(zone, newmem);
-		zone_page_alloc(newmem, elem_size);
 		zone->count++;	/* compensate for ADD_TO_ZONE */
 		size -= elem_size;
 		newmem += elem_size;
@@ -512,8 +717,6 @@ vm_offset_t zget_space(size)
 					     &new_space, space_to_add)
 							!= KERN_SUCCESS)
 				return(0);
-			zone_page_init(new_space, space_to_add,
-							ZONE_PAGE_USED);
 			simple_lock(&zget_space_lock);
 			continue;
 		}
@@ -584,7 +787,7 @@ void zone_init()
 				 zone_map_size, FALSE);
 
 	/*
-	 * Setup garbage collection information:
+	 * Setup slab descriptors:
 	 */
 
  	zone_table_size = atop(zone_max - zone_min) * 
@@ -596,8 +799,176 @@ void zone_init()
 	zone_pages = atop(zone_max - zone_min);
 	zone_map_min_address = zone_min;
 	zone_map_max_address = zone_max;
-	simple_lock_init(&zone_page_table_lock);
-	zone_page_init(zone_min, zone_max - zone_min, ZONE_PAGE_UNUSED);
+}
+
+/*
+ *	Routine:	zone_slab_cram
+ *	Purpose:
+ *		Turn alloc_size bytes of wired zone_map memory
+ *		into a free slab of the zone.
+ *	Conditions:
+ *		The zone is locked.
+ */
+void zone_slab_cram(zone, addr)
+	register zone_t	zone;
+	vm_offset_t	addr;
+{
+	register zone_slab_t	slab;
+	register vm_offset_t	elem;
+	register int		i;
+
+	assert((addr >= zone_map_min_address) &&
+	       (addr + zone->alloc_size <= zone_map_max_address));
+
+	slab = zone_page(addr);
+	for (i = 0; i < atop(zone->alloc_size); i++)
+		slab[i].first = i;
+
+	slab->free_elements = 0;
+	for (i = 0, elem = addr; i < zone->slab_elems;
+	     i++, elem += zone->elem_size) {
+		*((vm_offset_t *) elem) = slab->free_elements;
+		slab->free_elements = elem;
+	}
+	slab->free_count = zone->slab_elems;
+
+	slab->bin = ZONE_SLAB_EMPTY;
+	enqueue_tail(&zone->slab_lists[ZONE_SLAB_EMPTY],
+		     (queue_entry_t) slab);
+	zone->slab_empty_count++;
+	zone->slab_count++;
+	zone->cur_size += zone->alloc_size;
+}
+
+/*
+ *	Routine:	zone_slab_requeue
+ *	Purpose:
+ *		Move a slab to the list matching its free count,
+ *		after an element was taken from or returned to it.
+ *		Recently used partial slabs go to the head of
+ *		their list.
+ *	Conditions:
+ *		The zone is locked.
+ */
+void zone_slab_requeue(zone, slab)
+	register zone_t		zone;
+	register zone_slab_t	slab;
+{
+	register int	bin;
+
+	if (slab->free_count == 0)
+		bin = ZONE_SLAB_FULL;
+	else if (slab->free_count == zone->slab_elems)
+		bin = ZONE_SLAB_EMPTY;
+	else
+		bin = ((zone->slab_elems - slab->free_count) *
+		       ZONE_SLAB_BINS) / zone->slab_elems;
+
+	if (bin == slab->bin)
+		return;
+
+	if (slab->bin != ZONE_SLAB_FULL) {
+		remqueue(&zone->slab_lists[slab->bin], (queue_entry_t) slab);
+		if (slab->bin == ZONE_SLAB_EMPTY)
+			zone->slab_empty_count--;
+	}
+
+	if (bin == ZONE_SLAB_EMPTY) {
+		enqueue_tail(&zone->slab_lists[bin], (queue_entry_t) slab);
+		zone->slab_empty_count++;
+	} else if (bin != ZONE_SLAB_FULL)
+		enqueue_head(&zone->slab_lists[bin], (queue_entry_t) slab);
+
+	slab->bin = bin;
+}
+
+/*
+ *	Routine:	zone_slab_alloc
+ *	Purpose:
+ *		Take an element from the fullest partial slab, or
+ *		from a free slab if there are no partial ones.
+ *		Returns zero if the zone has no free elements.
+ *	Conditions:
+ *		The zone is locked.
+ */
+vm_offset_t zone_slab_alloc(zone)
+	register zone_t	zone;
+{
+	register zone_slab_t	slab;
+	register vm_offset_t	elem;
+	register int		bin;
+
+	for (bin = ZONE_SLAB_BINS - 1; bin >= 0; bin--)
+		if (!queue_empty(&zone->slab_lists[bin]))
+			break;
+	if (bin < 0) {
+		if (queue_empty(&zone->slab_lists[ZONE_SLAB_EMPTY]))
+			return(0);
+		bin = ZONE_SLAB_EMPTY;
+	}
+
+	slab = (zone_slab_t) queue_first(&zone->slab_lists[bin]);
+	elem = slab->free_elements;
+	slab->free_elements = *((vm_offset_t *) elem);
+	slab->free_count--;
+	zone_slab_requeue(zone, slab);
+
+	return(elem);
+}
+
+/*
+ *	Routine:	zone_slab_free
+ *	Purpose:
+ *		Return an element to its slab.
+ *	Conditions:
+ *		The zone is locked.
+ */
+void zone_slab_free(zone, elem)
+	register zone_t	zone;
+	vm_offset_t	elem;
+{
+	register zone_slab_t	slab;
+
+	slab = zone_slab(elem);
+	*((vm_offset_t *) elem) = slab->free_elements;
+	slab->free_elements = elem;
+	slab->free_count++;
+	zone_slab_requeue(zone, slab);
+}
+
+/*
+ *	Routine:	zone_slab_reclaim
+ *	Purpose:
+ *		Return the zone's free slabs to zone_map.
+ *	Conditions:
+ *		Nothing locked.  May block.
+ */
+void zone_slab_reclaim(zone)
+	register zone_t	zone;
+{
+	queue_head_t		reclaim;
+	register zone_slab_t	slab;
+	spl_t			s;
+
+	queue_init(&reclaim);
+
+	s = splhigh();
+	lock_zone(zone);
+	while (zone->slab_empty_count > 0) {
+		slab = (zone_slab_t)
+			dequeue_head(&zone->slab_lists[ZONE_SLAB_EMPTY]);
+		zone->slab_empty_count--;
+		zone->slab_count--;
+		zone->cur_size -= zone->alloc_size;
+		enqueue_tail(&reclaim, (queue_entry_t) slab);
+	}
+	unlock_zone(zone);
+	splx(s);
+
+	while (!queue_empty(&reclaim)) {
+		slab = (zone_slab_t) dequeue_head(&reclaim);
+		kmem_free(zone_map, zone_slab_addr(slab), zone->alloc_size);
+	}
 }
 
 
@@ -614,6 +985,14 @@ vm_offset_t zalloc(zone)
 
 	check_simple_locks();
 
+#if	NCPUS > 1
+	if (zone->cache_max != 0) {
+		addr = zone_cache_get(zone);
+		if (addr != 0)
+			return(addr);
+	}
+#endif	NCPUS > 1
+
 	lock_zone(zone);
 	REMOVE_FROM_ZONE(zone, addr, vm_offset_t);
 	while (addr == 0) {
@@ -632,7 +1011,8 @@ vm_offset_t zalloc(zone)
 			lock_zone(zone);
 		}
 		else {
-			if ((zone->cur_size + (zone->pageable ?
+			if ((zone->cur_size +
+			     ((zone->pageable || zone->slab) ?
 				zone->alloc_size : zone->elem_size)) >
 			    zone->max_size) {
 				if (zone->exhaustible)
@@ -684,15 +1064,13 @@ vm_offset_t zalloc(zone)
 				thread_wakeup((event_t)&zone->doing_alloc);
 
 				REMOVE_FROM_ZONE(zone, addr, vm_offset_t);
-			} else  if (zone->collectable) {
+			} else  if (zone->slab) {
 				if (kmem_alloc_wired(zone_map,
 						     &addr, zone->alloc_size)
 							!= KERN_SUCCESS)
 					panic("zalloc");
-				zone_page_init(addr, zone->alloc_size,
-							ZONE_PAGE_USED);
-				zcram(zone, addr, zone->alloc_size);
 				lock_zone(zone);
+				zone_slab_cram(zone, addr);
 				REMOVE_FROM_ZONE(zone, addr, vm_offset_t);
 			} else {
 				addr = zget_space(zone->elem_size);
@@ -703,7 +1081,6 @@ vm_offset_t zalloc(zone)
 				zone->count++;
 				zone->cur_size += zone->elem_size;
 				unlock_zone(zone);
-				zone_page_alloc(addr, zone->elem_size);
 				return(addr);
 			}
 		}
@@ -729,6 +1106,14 @@ vm_offset_t zget(zone)
 	if (zone == ZONE_NULL)
 		panic ("zalloc: null zone");
 
+#if	NCPUS > 1
+	if (zone->cache_max != 0) {
+		addr = zone_cache_get(zone);
+		if (addr != 0)
+			return(addr);
+	}
+#endif	NCPUS > 1
+
 	lock_zone(zone);
 	REMOVE_FROM_ZONE(zone, addr, vm_offset_t);
 	unlock_zone(zone);
@@ -742,13 +1127,25 @@ void zfree(zone, elem)
 	register zone_t	zone;
 	vm_offset_t	elem;
 {
+#if	NCPUS > 1
+	/*
+	 *	Elements in the caches are not on the free list,
+	 *	so zone_check can only work without them.
+	 */
+	if ((zone->cache_max != 0) && !zone_check) {
+		zone_cache_put(zone, elem);
+		return;
+	}
+#endif	NCPUS > 1
+
 	lock_zone(zone);
 	if (zone_check) {
 		vm_offset_t this;
 
 		/* check the zone's consistency */
 
-		for (this = zone->free_elements;
+		for (this = (zone->slab ? zone_slab(elem)->free_elements :
+					  zone->free_elements);
 		     this != 0;
 		     this = * (vm_offset_t *) this)
 			if (this == elem)
@@ -758,10 +1155,27 @@ void zfree(zone, elem)
 	unlock_zone(zone);
 }
 
+/*
+ *	Switch a new zone to the slab backend.  Zones that already
+ *	hold memory, and pageable zones, stay on the free list.
+ */
+void zone_slab_enable(zone)
+	register zone_t	zone;
+{
+	if (zone->pageable || zone->slab || (zone->cur_size != 0))
+		return;
+
+	if (zone->alloc_size < zone->elem_size)
+		zone->alloc_size = round_page(zone->elem_size);
+	zone->slab_elems = zone->alloc_size / zone->elem_size;
+	zone->slab = TRUE;
+}
+
 void zcollectable(zone) 
 	zone_t		zone;
 {
 	zone->collectable = TRUE;
+	zone_slab_enable(zone);
 }
 
 void zchange(zone, pageable, sleepable, exhaustible, collectable)
@@ -776,176 +1190,29 @@ void zchange(zone, pageable, sleepable, exhaustible, collectable)
 	zone->exhaustible = exhaustible;
 	zone->collectable = collectable;
 	lock_zone_init(zone);
-}
 
-/*
- *  Zone garbage collection subroutines
- *
- *  These routines have in common the modification of entries in the
- *  zone_page_table.  The latter contains one entry for every page
- *  in the zone_map.  
- *
- *  For each page table entry in the given range:
- *
- *	zone_page_in_use        - decrements in_free_list
- *	zone_page_free          - increments in_free_list
- *	zone_page_init          - initializes in_free_list and alloc_count
- *	zone_page_alloc         - increments alloc_count
- *	zone_page_dealloc       - decrements alloc_count
- *	zone_add_free_page_list - adds the page to the free list
- *   
- *  Two counts are maintained for each page, the in_free_list count and
- *  alloc_count.  The alloc_count is how many zone elements have been
- *  allocated from a page.  (Note that the page could contain elements
- *  that span page boundaries.  The count includes these elements so
- *  one element may be counted in two pages.) In_free_list is a count
- *  of how many zone elements are currently free.  If in_free_list is
- *  equal to alloc_count then the page is eligible for garbage
- *  collection.
- *
- *  Alloc_count and in_free_list are initialized to the correct values
- *  for a particular zone when a page is zcram'ed into a zone.  Subsequent
- *  gets and frees of zone elements will call zone_page_in_use and 
- *  zone_page_free which modify the in_free_list count.  When the zones
- *  garbage collector runs it will walk through a zones free element list,
- *  remove the elements that reside on collectable pages, and use 
- *  zone_add_free_page_list to create a list of pages to be collected.
- */
-
-void zone_page_in_use(addr, size)
-vm_offset_t	addr;
-vm_size_t	size;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		zone_page_table[i].in_free_list--;
-	}
-	unlock_zone_page_table();
-}
-
-void zone_page_free(addr, size)
-vm_offset_t	addr;
-vm_size_t	size;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		/* Set in_free_list to (ZONE_PAGE_USED + 1) if
-		 * it was previously set to ZONE_PAGE_UNUSED.
-		 */
-		if (zone_page_table[i].in_free_list == ZONE_PAGE_UNUSED) {
-			zone_page_table[i].in_free_list = 1;
-		} else {
-			zone_page_table[i].in_free_list++;
-		}
-	}
-	unlock_zone_page_table();
-}
-
-void zone_page_init(addr, size, value)
-
-vm_offset_t	addr;
-vm_size_t	size;
-int		value;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		zone_page_table[i].alloc_count = value;
-		zone_page_table[i].in_free_list = 0;
-	}
-	unlock_zone_page_table();
-}
-
-void zone_page_alloc(addr, size)
-vm_offset_t	addr;
-vm_size_t	size;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		/* Set alloc_count to (ZONE_PAGE_USED + 1) if
-		 * it was previously set to ZONE_PAGE_UNUSED.
-		 */
-		if (zone_page_table[i].alloc_count == ZONE_PAGE_UNUSED) {
-			zone_page_table[i].alloc_count = 1;
-		} else {
-			zone_page_table[i].alloc_count++;
-		}
-	}
-	unlock_zone_page_table();
-}
-
-void zone_page_dealloc(addr, size)
-vm_offset_t	addr;
-vm_size_t	size;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		zone_page_table[i].alloc_count--;
-	}
-	unlock_zone_page_table();
-}
-
-void
-zone_add_free_page_list(free_list, addr, size)
-	struct zone_page_table_entry	**free_list;
-	vm_offset_t	addr;
-	vm_size_t	size;
-{
-	int i, j;
-	if ((addr < zone_map_min_address) ||
-	    (addr+size > zone_map_max_address)) return;
-	i = atop(addr-zone_map_min_address);
-	j = atop((addr+size-1) - zone_map_min_address);
-	lock_zone_page_table();
-	for (; i <= j; i++) {
-		if (zone_page_table[i].alloc_count == 0) {
-			zone_page_table[i].next = *free_list;
-			*free_list = &zone_page_table[i];
-			zone_page_table[i].alloc_count  = ZONE_PAGE_UNUSED;
-			zone_page_table[i].in_free_list = 0;
-		}
-	}
-	unlock_zone_page_table();
+	/*
+	 *	Pageable zones use a sleep lock, and can't be
+	 *	touched at splhigh.  zchange must be called
+	 *	before the zone is used, so the caches are empty.
+	 */
+	if (pageable)
+		zone->cache_max = 0;
+	if (collectable)
+		zone_slab_enable(zone);
 }
 
-
-/* This is used for walking through a zone's free element list.
- */
-struct zone_free_entry {
-	struct zone_free_entry * next;
-};
-
-
 /*	Zone garbage collection
  *
- *	zone_gc will walk through all the free elements in all the
- *	zones that are marked collectable looking for reclaimable
- *	pages.  zone_gc is called by consider_zone_gc when the system
- *	begins to run out of memory.
+ *	zone_gc returns the free slabs of every slab zone to zone_map.
+ *	zalloc and zfree leave free slabs on their zone's list, so
+ *	that a zone that shrinks and grows again doesn't keep giving
+ *	pages back and taking them again.
+ *	Slabs track their own free counts, so nothing has to be
+ *	reconstructed; the only elements it can't see are those in
+ *	the per-processor caches, which are drained first.
+ *	zone_gc is called by consider_zone_gc when the system begins
+ *	to run out of memory.
  */
 void
 zone_gc() 
@@ -953,97 +1220,44 @@ zone_gc()
 	int		max_zones;
 	zone_t		z;
 	int		i;
-	register spl_t	s;
-	struct zone_page_table_entry	*freep;
-	struct zone_page_table_entry	*zone_free_page_list;
 
 	simple_lock(&all_zones_lock);
 	max_zones = num_zones;
 	z = first_zone;
 	simple_unlock(&all_zones_lock);
 
-	zone_free_page_list = (struct zone_page_table_entry *) 0;
-
 	for (i = 0; i < max_zones; i++) {
-		struct zone_free_entry * last;
-		struct zone_free_entry * elt;
 		assert(z != ZONE_NULL);
-	/* run this at splhigh so that interupt routines that use zones
-	   can not interupt while their zone is locked */
-		s=splhigh();
-		lock_zone(z);
-
-		if (!z->pageable && z->collectable) {
 
-		    /* Count the free elements in each page.  This loop
-		     * requires that all in_free_list entries are zero.
+		if (z->slab) {
+#if	NCPUS > 1
+		    /* Empty our own cache into the slabs, and ask the
+		     * other processors to empty theirs, so that a later
+		     * pass can find their slabs.
 		     */
-		    elt = (struct zone_free_entry *)(z->free_elements);
-		    while ((elt != (struct zone_free_entry *)0)) {
-			   zone_page_free((vm_offset_t)elt, z->elem_size);
-			   elt = elt->next;
+		    if (z->cache_max != 0) {
+			register int	cpu;
+			spl_t		s;
+
+			s = splhigh();
+			lock_zone(z);
+			zone_cache_flush(z, &z->cache[cpu_number()],
+					 z->cache[cpu_number()].count);
+			for (cpu = 0; cpu < NCPUS; cpu++)
+			    if (cpu != cpu_number())
+				z->cache[cpu].drain = TRUE;
+			unlock_zone(z);
+			splx(s);
 		    }
+#endif	NCPUS > 1
 
-		    /* Now determine which elements should be removed
-		     * from the free list and, after all the elements
-		     * on a page have been removed, add the element's
-		     * page to a list of pages to be freed.
-		     */
-		    elt = (struct zone_free_entry *)(z->free_elements);
-		    last = elt;
-		    while ((elt != (struct zone_free_entry *)0)) {
-			if (((vm_offset_t)elt>=zone_map_min_address)&&
-			    ((vm_offset_t)elt<=zone_map_max_address)&&
-			    (zone_page(elt)->in_free_list ==
-			     zone_page(elt)->alloc_count)) {
-
-			    z->cur_size -= z->elem_size;
-			    zone_page_in_use((vm_offset_t)elt, z->elem_size);
-			    zone_page_dealloc((vm_offset_t)elt, z->elem_size);
-			    if (zone_page(elt)->alloc_count == 0 ||
-			      zone_page(elt+(z->elem_size-1))->alloc_count==0) {
-				    zone_add_free_page_list(
-					    &zone_free_page_list, 
-					    (vm_offset_t)elt, z->elem_size);
-			    }
-
-
-			    if (elt == last) {
-				elt = elt->next;
-				z->free_elements =(vm_offset_t)elt;
-				last = elt;
-			    } else {
-				last->next = elt->next;
-				elt = elt->next;
-			    }
-			} else {
-			    /* This element is not eligible for collection
-			     * so clear in_free_list in preparation for a
-			     * subsequent garbage collection pass.
-			     */
-			    if (((vm_offset_t)elt>=zone_map_min_address)&&
-				((vm_offset_t)elt<=zone_map_max_address)) {
-				zone_page(elt)->in_free_list = 0;
-			    }
-			    last = elt;
-			    elt = elt->next;
-			}
-		    }
+		    zone_slab_reclaim(z);
 		}
-		unlock_zone(z);		
-		splx(s);
+
 		simple_lock(&all_zones_lock);
 		z = z->next_zone;
 		simple_unlock(&all_zones_lock);
 	}
-
-	for (freep = zone_free_page_list; freep != 0; freep = freep->next) {
-		vm_offset_t	free_addr;
-
-		free_addr = zone_map_min_address + 
-			PAGE_SIZE * (freep - zone_page_table);
-		kmem_free(zone_map, free_addr, PAGE_SIZE);
-	}
 }
 
 boolean_t zone_gc_allowed = TRUE;
@@ -1141,6 +1355,7 @@ kern_return_t host_zone_info(host, namesp, namesCntp, infop, infoCntp)
 		zone_name_t *zn = &names[i];
 		zone_info_t *zi = &info[i];
 		struct zone zcopy;
+		natural_t cached;
 
 		assert(z != ZONE_NULL);
 
@@ -1156,7 +1371,17 @@ kern_return_t host_zone_info(host, namesp, namesCntp, infop, infoCntp)
 		(void) strncpy(zn->zn_name, zcopy.zone_name,
 			       sizeof zn->zn_name);
 
-		zi->zi_count = zcopy.count;
+		cached = 0;
+#if	NCPUS > 1
+		{
+			register int	cpu;
+
+			for (cpu = 0; cpu < NCPUS; cpu++)
+				cached += zcopy.cache[cpu].count;
+		}
+#endif	NCPUS > 1
+
+		zi->zi_count = zcopy.count - cached;
 		zi->zi_cur_size = zcopy.cur_size;
 		zi->zi_max_size = zcopy.max_size;
 		zi->zi_elem_size = zcopy.elem_size;
@@ -1203,4 +1428,93 @@ kern_return_t host_zone_info(host, namesp, namesCntp, infop, infoCntp)
 
 	return KERN_SUCCESS;
 }
+
+/*
+ *	Return the per-processor cache statistics of each zone,
+ *	in the same order as host_zone_info.  Zones created
+ *	between the two calls are at the end.
+ */
+kern_return_t host_zone_cache_info(host, infop, infoCntp)
+	host_t		host;
+	zone_cache_info_array_t *infop;
+	unsigned int	*infoCntp;
+{
+	zone_cache_info_t *info;
+	vm_offset_t	info_addr;
+	vm_size_t	info_size = 0; /*'=0' to quiet gcc warnings */
+	unsigned int	max_zones, i;
+	zone_t		z;
+	kern_return_t	kr;
+
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	simple_lock(&all_zones_lock);
+	max_zones = num_zones;
+	z = first_zone;
+	simple_unlock(&all_zones_lock);
+
+	if (max_zones <= *infoCntp) {
+		/* use in-line memory */
+
+		info = *infop;
+	} else {
+		info_size = round_page(max_zones * sizeof *info);
+		kr = kmem_alloc_pageable(ipc_kernel_map,
+					 &info_addr, info_size);
+		if (kr != KERN_SUCCESS)
+			return kr;
+
+		info = (zone_cache_info_t *) info_addr;
+	}
+
+	for (i = 0; i < max_zones; i++) {
+		zone_cache_info_t *zci = &info[i];
+
+		assert(z != ZONE_NULL);
+
+		zci->zci_cache_max = z->cache_max;
+		zci->zci_count = 0;
+		zci->zci_hits = 0;
+		zci->zci_misses = 0;
+#if	NCPUS > 1
+		{
+			register int	cpu;
+
+			/*
+			 *	The caches are not locked; the
+			 *	numbers are only a snapshot.
+			 */
+			for (cpu = 0; cpu < NCPUS; cpu++) {
+				zci->zci_count += z->cache[cpu].count;
+				zci->zci_hits += z->cache[cpu].hits;
+				zci->zci_misses += z->cache[cpu].misses;
+			}
+		}
+#endif	NCPUS > 1
+
+		simple_lock(&all_zones_lock);
+		z = z->next_zone;
+		simple_unlock(&all_zones_lock);
+	}
+
+	if (info != *infop) {
+		vm_size_t used;
+		vm_map_copy_t copy;
+
+		used = max_zones * sizeof *info;
+
+		if (used != info_size)
+			bzero((char *) (info_addr + used), info_size - used);
+
+		kr = vm_map_copyin(ipc_kernel_map, info_addr, info_size,
+				   TRUE, &copy);
+		assert(kr == KERN_SUCCESS);
+
+		*infop = (zone_cache_info_t *) copy;
+	}
+	*infoCntp = max_zones;
+
+	return KERN_SUCCESS;
+}
 #endif	MACH_DEBUG
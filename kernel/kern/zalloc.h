@@ -149,6 +149,8 @@
 #ifndef	_KERN_ZALLOC_H_
 #define _KERN_ZALLOC_H_
 
+#include <cpus.h>
+
 #include <mach/machine/vm_types.h>
 #include <kern/lock.h>
 #include <kern/queue.h>
@@ -159,7 +161,37 @@
  *	use zones to manage data structures dynamically, creating a zone
  *	for each type of data structure to be managed.
  *
+ *	On multiprocessors, each non-pageable zone keeps a small cache
+ *	of free elements per processor in front of the zone's own free
+ *	list (the depot).  The cache is only touched by its processor,
+ *	at splhigh, so the common zalloc/zfree takes no lock.  Elements
+ *	move between a cache and the depot in batches.
+ */
+
+#if	NCPUS > 1
+struct zone_cache {
+	vm_offset_t	free_elements;	/* local free list */
+	int		count;		/* elements on local free list */
+	boolean_t	drain;		/* empty into depot at next use */
+	unsigned int	hits;		/* allocations satisfied locally */
+	unsigned int	misses;		/* allocations that went to depot */
+};
+#endif	NCPUS > 1
+
+#define	ZONE_CACHE_MAX	32		/* upper bound on per-cpu depth */
+
+/*
+ *	Collectable zones use a slab backend: memory is obtained from
+ *	zone_map in alloc_size chunks (slabs), each keeping its own free
+ *	list and free count.  Partially used slabs are kept on lists
+ *	binned by how full they are, so that allocation can prefer the
+ *	fullest slabs and let the others drain.  Entirely free slabs
+ *	are kept on a separate list until zone_gc returns them to
+ *	zone_map.
  */
+#define	ZONE_SLAB_BINS	4		/* lists of partial slabs */
+#define	ZONE_SLAB_EMPTY	ZONE_SLAB_BINS	/* list of free slabs */
+#define	ZONE_SLAB_FULL	(-1)		/* fully used: on no list */
 
 typedef struct zone {
 	decl_simple_lock_data(,lock)	/* generic lock */
@@ -176,9 +208,20 @@ typedef struct zone {
 	/* boolean_t */	sleepable :1,	/* sleep if empty? */
 	/* boolean_t */ exhaustible :1,	/* merely return if empty? */
 	/* boolean_t */	collectable :1,	/* garbage collect empty pages */
-	/* boolean_t */	expandable :1;	/* expand zone (with message)? */
+	/* boolean_t */	expandable :1,	/* expand zone (with message)? */
+	/* boolean_t */	slab :1;	/* uses the slab backend? */
 	lock_data_t	complex_lock;	/* Lock for pageable zones */
 	struct zone *	next_zone;	/* Link for all-zones list */
+	int		slab_elems;	/* elements per slab */
+	int		slab_count;	/* slabs owned by the zone */
+	int		slab_empty_count; /* slabs with no elements in use */
+	queue_head_t	slab_lists[ZONE_SLAB_BINS + 1];
+					/* partial slabs, by fullness;
+					   then free slabs */
+	int		cache_max;	/* per-cpu cache depth, 0 if none */
+#if	NCPUS > 1
+	struct zone_cache cache[NCPUS];	/* per-cpu element caches */
+#endif	NCPUS > 1
 } *zone_t;
 
 #define		ZONE_NULL	((zone_t) 0)
@@ -161,6 +161,7 @@
 #include <mach/thread_status.h>
 #include <mach/time_value.h>
 #include <mach/vm_attributes.h>
+#include <mach/vm_behavior.h>
 #include <mach/vm_inherit.h>
 #include <mach/vm_prot.h>
 #include <mach/vm_statistics.h>
@@ -173,6 +174,7 @@
 				       processor_set_name_array_t */
 #include <kern/syscall_emulation.h>
 				/* for emulation_vector_t */
+#include <kern/ring.h>		/* for ring_t */
 #include <norma_vm.h>
 #if	NORMA_VM
 typedef struct xmm_obj	*mach_xmm_obj_t;
@@ -194,6 +196,7 @@ typedef mach_port_t	processor_set_name_t;
 typedef mach_port_t	*processor_set_array_t;
 typedef mach_port_t	*processor_set_name_array_t;
 typedef vm_offset_t	*emulation_vector_t;
+typedef mach_port_t	ring_t;
 #endif	/* KERNEL */
 
 /*
@@ -116,6 +116,21 @@ typedef	int		memory_object_copy_strategy_t;
 					/*     change data externally, and */
 					/*     doesn't need to see changes. */
 
+/*
+ *	A memory manager that will take data requests for more than
+ *	one page adds MEMORY_OBJECT_CLUSTER(pages) to the copy
+ *	strategy it gives memory_object_ready or
+ *	memory_object_set_attributes.  The kernel may then request up
+ *	to that many pages at once, and the manager must provide or
+ *	refuse every page of each request.  Otherwise the kernel
+ *	requests one page at a time.
+ */
+#define		MEMORY_OBJECT_CLUSTER_SHIFT	8
+#define		MEMORY_OBJECT_CLUSTER_MASK	0x00ffff00
+#define		MEMORY_OBJECT_CLUSTER(pages)	\
+		(((pages) << MEMORY_OBJECT_CLUSTER_SHIFT) & \
+		 MEMORY_OBJECT_CLUSTER_MASK)
+
 typedef	int		memory_object_return_t;
 					/* Which pages to return to manager
 					   this time (lock_request) */
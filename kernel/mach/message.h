@@ -339,9 +339,31 @@ typedef integer_t mach_msg_option_t;
 #define MACH_RCV_NOTIFY		0x00000200
 #define MACH_RCV_INTERRUPT	0x00000400	/* libmach implements */
 #define MACH_RCV_LARGE		0x00000800
+#define MACH_RCV_BATCH		0x00001000
 
 #define MACH_SEND_ALWAYS	0x00010000	/* internal use only */
 
+/*
+ *  With MACH_RCV_BATCH, a receive that gets a message goes on to
+ *  take messages that are already queued, without blocking, and
+ *  puts them after the first one in the receive buffer.  Each
+ *  message starts where the previous one ends, msgh_size bytes
+ *  later; MACH_MSG_BATCH_NEXT steps from one to the next.
+ *  A queued message is only taken if it and another header fit
+ *  in the rest of the buffer; otherwise it stays queued.
+ *
+ *  The batch ends when fewer than sizeof(mach_msg_header_t) bytes
+ *  are left, or at a header whose msgh_size is zero.  The msgh_id
+ *  of that header is the return code for the last message before
+ *  it.  Messages after the first get the same treatment as the
+ *  first; if one can't be copied out, it is put in the buffer as
+ *  mach_msg would leave it, its error is recorded, and the batch
+ *  ends.  The trap's return code is that of the first message.
+ */
+
+#define MACH_MSG_BATCH_NEXT(msg)					\
+	((mach_msg_header_t *) ((char *) (msg) + (msg)->msgh_size))
+
 
 /*
  *  Much code assumes that mach_msg_return_t == kern_return_t.
@@ -428,6 +450,22 @@ typedef kern_return_t mach_msg_return_t;
 		/* Error receiving message body.  See special bits. */
 
 
+/*
+ *  An element of the vector given to mach_msg_send_vector_trap.
+ *  Each element names a destination in its header; the messages
+ *  share one simple body.  The kernel stores each send's result
+ *  in msgv_return, and pseudo-receives the header of a message
+ *  that couldn't be sent back into msgv_header.  A trap sends a
+ *  bounded number of messages; if it stops early, the first
+ *  unsent element's msgv_return is MACH_SEND_INTERRUPTED and the
+ *  elements from there on must be sent again.
+ */
+
+typedef struct {
+    mach_msg_header_t	msgv_header;
+    mach_msg_return_t	msgv_return;
+} mach_msg_vector_t;
+
 extern mach_msg_return_t
 mach_msg_trap
 #if	defined(c_plusplus) || defined(__STDC__)
@@ -480,6 +518,30 @@ mach_msg
 #endif	/* LINTLIBRARY */
 #endif	/* c_plusplus || __STDC__ */
 
+extern mach_msg_return_t
+mach_msg_send_vector_trap
+#if	defined(c_plusplus) || defined(__STDC__)
+   (mach_msg_vector_t *vector,
+    mach_msg_type_number_t count,
+    char *body,
+    mach_msg_size_t body_size,
+    mach_msg_option_t option,
+    mach_msg_timeout_t timeout);
+#else	/* c_plusplus || __STDC__ */
+#ifdef	LINTLIBRARY
+   (vector, count, body, body_size, option, timeout)
+    mach_msg_vector_t *vector;
+    mach_msg_type_number_t count;
+    char *body;
+    mach_msg_size_t body_size;
+    mach_msg_option_t option;
+    mach_msg_timeout_t timeout;
+{ return MACH_MSG_SUCCESS; }
+#else	/* LINTLIBRARY */
+   ();
+#endif	/* LINTLIBRARY */
+#endif	/* c_plusplus || __STDC__ */
+
 
 /* Definitions for the old IPC interface. */
 
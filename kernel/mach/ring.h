@@ -0,0 +1,91 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	mach/ring.h
+ *
+ *	Layout of the buffer shared by the tasks of a ring channel.
+ *
+ *	A ring channel is a wired buffer mapped into a producer and
+ *	a consumer task (ring_create, ring_map).  Records are passed
+ *	through it without traps.  The consumer sleeps in evc_wait on
+ *	the ring's eventcount when the ring is empty, and a producer
+ *	only calls ring_signal when it finds the consumer asleep.
+ *	ring_create fails with KERN_RESOURCE_SHORTAGE when the wired
+ *	memory in all rings would pass a limit set in the kernel.
+ */
+
+#ifndef	_MACH_RING_H_
+#define	_MACH_RING_H_
+
+#include <mach/machine/vm_types.h>
+
+/*
+ *	The buffer starts with a ring_header, followed by rh_size
+ *	bytes of data.  rh_head and rh_tail are byte counts that
+ *	only grow; their difference is the space in use, and each
+ *	modulo rh_size is an offset in the data area.  Each record
+ *	is a natural_t length word followed by the data, padded to
+ *	a multiple of sizeof(natural_t).
+ *
+ *	Only the consumer stores rh_head.  A producer claims space
+ *	by advancing rh_tail with a compare-and-swap, fills in the
+ *	data, and then commits the record by storing its length
+ *	word with RING_COMMITTED set.  Producers commit in any
+ *	order and never wait for each other; the consumer takes
+ *	records in the order their space was claimed, waiting for
+ *	each to be committed.  It zeroes each record's space as it
+ *	consumes it, so a length word not yet stored reads as 0.
+ *	A producer that dies between claim and commit stops the
+ *	consumer at its record.
+ *
+ *	Any number of producers may share a ring on machines where
+ *	libmach has a compare-and-swap (the i386 and the alpha).
+ *	Elsewhere libmach is built only with RING_SINGLE_PRODUCER,
+ *	and then only one task may produce into a ring.
+ */
+typedef struct ring_header {
+	natural_t		rh_size;	/* size of data area */
+	natural_t		rh_evc;		/* eventcount for evc_wait */
+	volatile natural_t	rh_head;	/* bytes consumed */
+	volatile natural_t	rh_tail;	/* bytes claimed by producers */
+	volatile natural_t	rh_sleeping;	/* consumer in evc_wait */
+	natural_t		rh_reserved[3];
+} *ring_header_t;
+
+#define	RING_DATA(rh)		((char *) ((rh) + 1))
+
+#define	RING_ALIGN(n)		\
+	(((n) + sizeof(natural_t) - 1) &~ (sizeof(natural_t) - 1))
+
+#define	RING_COMMITTED		((natural_t) 1 << 31)	/* in length word */
+
+/*
+ *	Limits on rh_size, which must be a power of two.
+ */
+#define	RING_SIZE_MIN		1024
+#define	RING_SIZE_MAX		(4 * 1024 * 1024)
+
+#endif	/* _MACH_RING_H_ */
@@ -0,0 +1,61 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	mach/vm_behavior.h
+ *
+ *	Virtual memory map behavior definitions.
+ *
+ */
+
+#ifndef	_MACH_VM_BEHAVIOR_H_
+#define	_MACH_VM_BEHAVIOR_H_
+
+/*
+ *	Types defined:
+ *
+ *	vm_behavior_t	expected access pattern of a region.
+ */
+
+typedef int		vm_behavior_t;
+
+/*
+ *	Enumeration of valid values for vm_behavior_t.
+ */
+
+#define	VM_BEHAVIOR_DEFAULT	((vm_behavior_t) 0)	/* cluster on demand */
+#define	VM_BEHAVIOR_RANDOM	((vm_behavior_t) 1)	/* never cluster */
+#define	VM_BEHAVIOR_SEQUENTIAL	((vm_behavior_t) 2)	/* read ahead, and
+							 * release behind */
+
+/*
+ *	Actions on the pages of a region, which are not
+ *	remembered as its behavior.
+ */
+
+#define	VM_BEHAVIOR_WILLNEED	((vm_behavior_t) 3)	/* prefetch now */
+#define	VM_BEHAVIOR_DONTNEED	((vm_behavior_t) 4)	/* release now */
+
+#endif	/* _MACH_VM_BEHAVIOR_H_ */
@@ -106,6 +106,27 @@ typedef struct ipc_info_tree_name {
 
 typedef ipc_info_tree_name_t *ipc_info_tree_name_array_t;
 
+
+typedef struct ipc_info_kmsg_cache {
+	natural_t iikc_size;		/* size of buffers, with overhead */
+	natural_t iikc_count;		/* buffers now cached */
+	natural_t iikc_depth;		/* sum of the cache limits */
+	natural_t iikc_hits;		/* allocations from the caches */
+	natural_t iikc_misses;		/* allocations from kalloc */
+	natural_t iikc_frees;		/* buffers freed to the caches */
+	natural_t iikc_overflows;	/* buffers freed with cache full */
+} ipc_info_kmsg_cache_t;
+
+typedef ipc_info_kmsg_cache_t *ipc_info_kmsg_cache_array_t;
+
+
+typedef struct ipc_info_kobject {
+	natural_t iiko_id;		/* msgh_id of the request */
+	natural_t iiko_calls;		/* requests handled */
+} ipc_info_kobject_t;
+
+typedef ipc_info_kobject_t *ipc_info_kobject_array_t;
+
 /*
  *	Type definitions for mach_port_kernel_object.
  *	By remarkable coincidence, these closely resemble
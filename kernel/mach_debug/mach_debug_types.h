@@ -77,6 +77,7 @@
 #include <mach_debug/vm_info.h>
 #include <mach_debug/zone_info.h>
 #include <mach_debug/hash_info.h>
+#include <mach_debug/wait_info.h>
 
 typedef	char	symtab_name_t[32];
 
@@ -165,4 +165,23 @@ typedef struct vm_page_info {
 
 typedef vm_page_info_t *vm_page_info_array_t;
 
+typedef struct vm_page_free_info {
+	natural_t vpfi_free;		/* pages on the free list */
+	natural_t vpfi_pooled;		/* pages in processor pools */
+	natural_t vpfi_lock_acquires;	/* free list lock acquisitions */
+	natural_t vpfi_lock_pages;	/* pages moved holding the lock */
+	natural_t vpfi_pool_grabs;	/* grabs served by a pool */
+	natural_t vpfi_pool_releases;	/* releases kept by a pool */
+	natural_t vpfi_pool_drains;	/* pools emptied by pageout */
+} vm_page_free_info_t;
+
+typedef struct vm_pageout_info {
+	natural_t vpoi_rate;		/* pages freed or cleaned per second */
+	natural_t vpoi_freed;		/* clean pages freed */
+	natural_t vpoi_cleaned;		/* dirty pages sent to be cleaned */
+	natural_t vpoi_writes;		/* messages sent to clean them */
+	natural_t vpoi_cluster_max;	/* most pages in one message */
+	natural_t vpoi_laundry;		/* pages being cleaned now */
+} vm_pageout_info_t;
+
 #endif	_MACH_DEBUG_VM_INFO_H_
@@ -0,0 +1,47 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+
+#ifndef	_MACH_DEBUG_WAIT_INFO_H_
+#define _MACH_DEBUG_WAIT_INFO_H_
+
+#include <mach/machine/vm_types.h>
+
+/*
+ *	Remember to update the mig type definitions
+ *	in mach_debug_types.defs when adding/removing fields.
+ */
+
+typedef struct wait_queue_info {
+	natural_t	wqi_size;	/* number of hash buckets */
+	natural_t	wqi_waiters;	/* threads waiting on events */
+	natural_t	wqi_max_chain;	/* longest bucket */
+	natural_t	wqi_resizes;	/* times the table has grown */
+	natural_t	wqi_wakeups;	/* wakeup calls */
+	natural_t	wqi_scanned;	/* waiters examined by wakeups */
+	natural_t	wqi_woken;	/* waiters woken by wakeups */
+} wait_queue_info_t;
+
+#endif	_MACH_DEBUG_WAIT_INFO_H_
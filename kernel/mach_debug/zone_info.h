@@ -87,4 +87,14 @@ typedef struct zone_info {
 
 typedef zone_info_t *zone_info_array_t;
 
+
+typedef struct zone_cache_info {
+	natural_t	zci_cache_max;	/* per-cpu cache depth */
+	natural_t	zci_count;	/* elements held in per-cpu caches */
+	natural_t	zci_hits;	/* allocations served by a cache */
+	natural_t	zci_misses;	/* allocations that went to the zone */
+} zone_cache_info_t;
+
+typedef zone_cache_info_t *zone_cache_info_array_t;
+
 #endif	_MACH_DEBUG_ZONE_INFO_H_
@@ -589,7 +589,11 @@ norma_handoff_kmsg(kmsg)
 		if (receiver == ITH_NULL) {
 			/* no receivers; queue kmsg */
 			
-			ipc_kmsg_enqueue_macro(&mqueue->imq_messages, kmsg);
+			if (pset == IPS_NULL)
+				ipc_kmsg_enqueue_macro(&mqueue->imq_messages,
+						       kmsg);
+			else
+				ipc_pset_enqueue(pset, port, kmsg);
 			imq_unlock(mqueue);
 			return;
 		}
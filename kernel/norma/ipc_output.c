@@ -1894,12 +1894,7 @@ netipc_output_replenish()
 			netipc_thread_unlock();
 		} else {
 			netipc_thread_unlock();
-			if (ikm_cache() == IKM_NULL &&
-			    kmsg->ikm_size == IKM_SAVED_KMSG_SIZE) {
-				ikm_cache() = kmsg;
-			} else {
-				ikm_free(kmsg);
-			}
+			ipc_kmsg_cache_free(kmsg);
 		}
 		/*
 		 * Perform deferred copyout (including release) of dest.
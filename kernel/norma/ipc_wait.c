@@ -139,8 +139,8 @@ norma_ipc_kmsg_accept(mqueue, max_size, msg_size)
 	mach_msg_size_t *msg_size;
 {
 	register processor_t myprocessor;
+	register processor_set_t pset;
 	register volatile thread_t *threadp;
-	register volatile int *gcount;
 	register volatile int *lcount;
 	int mycpu;
 
@@ -176,9 +176,9 @@ norma_ipc_kmsg_accept(mqueue, max_size, msg_size)
 	 */
 
 #if	MACH_HOST
-	gcount = (volatile int *) &myprocessor->processor_set->runq.count;
+	pset = myprocessor->processor_set;
 #else	MACH_HOST
-	gcount = (volatile int *) &default_pset.runq.count;
+	pset = &default_pset;
 #endif	MACH_HOST
 
 	/*
@@ -230,7 +230,7 @@ norma_ipc_kmsg_accept(mqueue, max_size, msg_size)
 			c_break_thread++;
 			break;
 		}
-		if (*gcount != 0) {
+		if (pset_runq_count(pset) != 0) {
 			c_break_gcount++;
 			break;
 		}
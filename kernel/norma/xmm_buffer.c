@@ -319,6 +319,7 @@ xmm_buffer_find_page(object, offset)
 			result_prot = VM_PROT_READ;
 			kr = vm_fault_page(object, offset,
 					   VM_PROT_READ, FALSE, FALSE,
+					   VM_BEHAVIOR_DEFAULT,
 					   &result_prot, &m, &top_page,
 					   FALSE, (void (*)()) 0);
 			if (kr == VM_FAULT_MEMORY_SHORTAGE) {
@@ -911,7 +911,8 @@ k_svm_set_ready(mobj, object_ready, may_cache, copy_strategy, use_old_pageout,
 	 *
 	 * THIS WILL BREAK IN ITS CURRENT FORM WHEN WE ENABLE VM_INHERIT_SHARE
 	 */
-	if (copy_strategy == MEMORY_OBJECT_COPY_TEMPORARY) {
+	if ((copy_strategy & ~MEMORY_OBJECT_CLUSTER_MASK) ==
+	    MEMORY_OBJECT_COPY_TEMPORARY) {
 		MOBJ->copy_strategy = MEMORY_OBJECT_COPY_TEMPORARY;
 	} else {
 		MOBJ->copy_strategy = MEMORY_OBJECT_COPY_NONE;
@@ -0,0 +1,386 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	mapbench/mapbench.c
+ *
+ *	Times vm_map_lookup_entry against the number of entries in
+ *	the map, with the kernel's red-black tree (kern/rbtree.c,
+ *	included below) and with the linear list walk it replaced.
+ *	The map entries are stubs that carry only the list links
+ *	and the tree node; the two lookup routines are copied from
+ *	vm/vm_map.c before and after the tree was added.
+ *
+ *		cc -O -idirafter ../.. -o mapbench mapbench.c
+ *		mapbench [lookups]
+ *
+ *	For each map size, the "hint" column times lookups that hit
+ *	the hint, as a fault in the same entry as the last one does;
+ *	"list" and "tree" time lookups at random addresses, which
+ *	miss it; "link" times linking and unlinking an entry, which
+ *	now also updates the tree.  Every lookup is checked against
+ *	the expected entry.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/*
+ *	Enough of mach/boolean.h and kern/assert.h for rbtree.c.
+ */
+#define	_MACH_BOOLEAN_H_
+#define	_KERN_ASSERT_H_
+
+typedef int		boolean_t;
+#define	TRUE		((boolean_t) 1)
+#define	FALSE		((boolean_t) 0)
+
+#define	assert(ex)
+
+#include "../../kern/rbtree.c"
+
+typedef unsigned long	vm_offset_t;
+
+struct vm_map_links {
+	struct vm_map_entry	*prev;
+	struct vm_map_entry	*next;
+	vm_offset_t		start;
+	vm_offset_t		end;
+};
+
+struct vm_map_entry {
+	struct vm_map_links	links;
+#define vme_prev		links.prev
+#define vme_next		links.next
+#define vme_start		links.start
+#define vme_end			links.end
+	struct rbtree_node	tree_node;
+};
+
+typedef struct vm_map_entry	*vm_map_entry_t;
+
+struct vm_map_header {
+	struct vm_map_links	links;
+	struct rbtree		tree;
+	int			nentries;
+};
+
+typedef struct vm_map {
+	struct vm_map_header	hdr;
+	vm_map_entry_t		hint;
+} *vm_map_t;
+
+#define	vm_map_to_entry(map)	((struct vm_map_entry *) &(map)->hdr.links)
+#define	vm_map_first_entry(map)	((map)->hdr.links.next)
+#define	vm_map_last_entry(map)	((map)->hdr.links.prev)
+
+#define	SAVE_HINT(map,value)	((map)->hint = (value))
+
+/*
+ *	From vm/vm_map.c.
+ */
+#define	vm_map_entry_tree_node(hdr, entry)			\
+	(((entry) == (struct vm_map_entry *) &(hdr)->links) ?	\
+	 RBTREE_NODE_NULL : &(entry)->tree_node)
+
+#define	vm_map_tree_entry(node)					\
+	rbtree_entry((node), struct vm_map_entry, tree_node)
+
+#define	_vm_map_entry_link(hdr, after_where, entry)		\
+	MACRO_BEGIN						\
+	(hdr)->nentries++;					\
+	(entry)->vme_prev = (after_where);			\
+	(entry)->vme_next = (after_where)->vme_next;		\
+	(entry)->vme_prev->vme_next =				\
+	 (entry)->vme_next->vme_prev = (entry);			\
+	rbtree_insert_after(&(hdr)->tree,			\
+		vm_map_entry_tree_node((hdr), (after_where)),	\
+		&(entry)->tree_node);				\
+	MACRO_END
+
+#define	_vm_map_entry_unlink(hdr, entry)			\
+	MACRO_BEGIN						\
+	(hdr)->nentries--;					\
+	(entry)->vme_next->vme_prev = (entry)->vme_prev;	\
+	(entry)->vme_prev->vme_next = (entry)->vme_next;	\
+	rbtree_remove(&(hdr)->tree, &(entry)->tree_node);	\
+	MACRO_END
+
+/*
+ *	vm_map_lookup_entry as it was, walking the list from the
+ *	hint or from the head.
+ */
+boolean_t
+lookup_list(map, address, entry)
+	register vm_map_t	map;
+	register vm_offset_t	address;
+	vm_map_entry_t		*entry;
+{
+	register vm_map_entry_t		cur;
+	register vm_map_entry_t		last;
+
+	cur = map->hint;
+
+	if (cur == vm_map_to_entry(map))
+		cur = cur->vme_next;
+
+	if (address >= cur->vme_start) {
+		last = vm_map_to_entry(map);
+		if ((cur != last) && (cur->vme_end > address)) {
+			*entry = cur;
+			return(TRUE);
+		}
+	}
+	else {
+		last = cur->vme_next;
+		cur = vm_map_first_entry(map);
+	}
+
+	while (cur != last) {
+		if (cur->vme_end > address) {
+			if (address >= cur->vme_start) {
+				*entry = cur;
+				SAVE_HINT(map, cur);
+				return(TRUE);
+			}
+			break;
+		}
+		cur = cur->vme_next;
+	}
+	*entry = cur->vme_prev;
+	SAVE_HINT(map, *entry);
+	return(FALSE);
+}
+
+/*
+ *	vm_map_lookup_entry as it is now.
+ */
+boolean_t
+lookup_tree(map, address, entry)
+	register vm_map_t	map;
+	register vm_offset_t	address;
+	vm_map_entry_t		*entry;
+{
+	register vm_map_entry_t		cur;
+	register vm_map_entry_t		tmp;
+	register rbtree_node_t		node;
+
+	cur = map->hint;
+
+	if ((cur != vm_map_to_entry(map)) &&
+	    (address >= cur->vme_start) && (address < cur->vme_end)) {
+		*entry = cur;
+		return(TRUE);
+	}
+
+	cur = vm_map_to_entry(map);
+	node = rbtree_root(&map->hdr.tree);
+	while (node != RBTREE_NODE_NULL) {
+		tmp = vm_map_tree_entry(node);
+		if (address < tmp->vme_start)
+			node = node->left;
+		else {
+			cur = tmp;
+			if (address < tmp->vme_end)
+				break;
+			node = node->right;
+		}
+	}
+
+	*entry = cur;
+	SAVE_HINT(map, cur);
+	return((cur != vm_map_to_entry(map)) && (address < cur->vme_end));
+}
+
+#define	PAGE	4096
+#define	NADDRS	4096		/* precomputed lookup addresses */
+
+static unsigned long	seed = 1;
+
+static unsigned long
+random_next()
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+/*
+ *	A map of n one-page entries with one-page holes between
+ *	them, as left by many small mappings.
+ */
+static struct vm_map_entry *
+map_build(map, n)
+	vm_map_t	map;
+	int		n;
+{
+	struct vm_map_entry *entries, *prev;
+	int i;
+
+	entries = (struct vm_map_entry *) calloc(n + 1, sizeof *entries);
+	if (entries == 0) {
+		fprintf(stderr, "mapbench: out of memory\n");
+		exit(1);
+	}
+	map->hdr.links.next = map->hdr.links.prev = vm_map_to_entry(map);
+	map->hdr.links.start = 0;
+	map->hdr.links.end = 0;
+	map->hdr.nentries = 0;
+	rbtree_init(&map->hdr.tree);
+
+	prev = vm_map_to_entry(map);
+	for (i = 0; i < n; i++) {
+		entries[i].vme_start = (vm_offset_t) (2 * i + 1) * PAGE;
+		entries[i].vme_end = entries[i].vme_start + PAGE;
+		_vm_map_entry_link(&map->hdr, prev, &entries[i]);
+		prev = &entries[i];
+	}
+	map->hint = vm_map_to_entry(map);
+	return entries;
+}
+
+static double
+nsecs(start, end, count)
+	struct timeval *start, *end;
+	long count;
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000.0 +
+		(end->tv_usec - start->tv_usec)) * 1000.0 / count;
+}
+
+static void
+check(map, entries, n, address, found, entry)
+	vm_map_t	map;
+	struct vm_map_entry *entries;
+	int		n;
+	vm_offset_t	address;
+	boolean_t	found;
+	vm_map_entry_t	entry;
+{
+	long i = (long) (address / PAGE) - 1;
+
+	if ((i % 2) == 0 ? (!found || (entry != &entries[i / 2]))
+			 : (found || (entry != (i < 0 ? vm_map_to_entry(map)
+					       : &entries[i / 2])))) {
+		fprintf(stderr, "mapbench: bad lookup of 0x%lx in %d entries\n",
+			address, n);
+		exit(1);
+	}
+}
+
+static void
+bench(n, count)
+	int	n;
+	long	count;
+{
+	struct vm_map map;
+	struct vm_map_entry *entries, extra;
+	vm_offset_t addrs[NADDRS];
+	vm_map_entry_t entry;
+	struct timeval start, end;
+	double hint, list, tree, link;
+	boolean_t found;
+	long i, sum;
+	long list_count;
+
+	entries = map_build(&map, n);
+
+	/*
+	 *	Addresses anywhere in the map, in entries or in the
+	 *	holes between them.
+	 */
+	for (i = 0; i < NADDRS; i++)
+		addrs[i] = (random_next() * 32768 + random_next()) %
+			   ((vm_offset_t) 2 * n * PAGE) + PAGE / 2;
+
+	for (i = 0; i < NADDRS; i++) {
+		found = lookup_list(&map, addrs[i], &entry);
+		check(&map, entries, n, addrs[i], found, entry);
+		found = lookup_tree(&map, addrs[i], &entry);
+		check(&map, entries, n, addrs[i], found, entry);
+	}
+
+	sum = 0;
+	map.hint = &entries[n / 2];
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++)
+		sum += lookup_tree(&map, entries[n / 2].vme_start + (i & 0xff),
+				   &entry);
+	gettimeofday(&end, (struct timezone *) 0);
+	hint = nsecs(&start, &end, count);
+
+	/*
+	 *	The list walk is linear, so do fewer of them in big maps.
+	 */
+	list_count = count / (n / 64 + 1);
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < list_count; i++)
+		sum += lookup_list(&map, addrs[i % NADDRS], &entry);
+	gettimeofday(&end, (struct timezone *) 0);
+	list = nsecs(&start, &end, list_count);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++)
+		sum += lookup_tree(&map, addrs[i % NADDRS], &entry);
+	gettimeofday(&end, (struct timezone *) 0);
+	tree = nsecs(&start, &end, count);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++) {
+		entry = &entries[addrs[i % NADDRS] % n];
+		extra.vme_start = entry->vme_end;
+		extra.vme_end = entry->vme_end + PAGE;
+		_vm_map_entry_link(&map.hdr, entry, &extra);
+		_vm_map_entry_unlink(&map.hdr, &extra);
+	}
+	gettimeofday(&end, (struct timezone *) 0);
+	link = nsecs(&start, &end, count);
+
+	printf("%8d %8.1f %10.1f %8.1f %8.1f\n", n, hint, list, tree, link);
+	if (sum == -1)
+		printf("\n");
+	free((char *) entries);
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	long count;
+	int n;
+
+	count = (argc > 1) ? atol(argv[1]) : 1000000;
+	if (count <= 0) {
+		fprintf(stderr, "usage: mapbench [lookups]\n");
+		exit(2);
+	}
+
+	printf("%8s %8s %10s %8s %8s   (ns per operation)\n",
+	       "entries", "hint", "list", "tree", "link");
+	for (n = 16; n <= 65536; n *= 4)
+		bench(n, count);
+	exit(0);
+}
@@ -0,0 +1,185 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	mig/bench/stubbench.c
+ *
+ *	Times the stubs mig generates for bench.defs, without a
+ *	kernel: mach_msg below hands the request straight to the
+ *	server demux and copies the reply back.  Build it once
+ *	with each mig to compare them:
+ *
+ *		mig bench.defs
+ *		cc -O -o stubbench stubbench.c benchUser.c benchServer.c
+ *		stubbench [iterations]
+ *
+ *	The "server" line times bench_server on a well-formed
+ *	request, the "rpc" line times bench_protect through both
+ *	stubs.  Both stubs are also checked to reject a request
+ *	or reply with a bad msg_type.
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <mach/port.h>
+#include <mach/message.h>
+#include <mach/mig_errors.h>
+#include "bench.h"
+
+extern boolean_t bench_server();
+extern long atol();
+extern void exit();
+
+#define	BENCH_PORT	((mach_port_t) 1)
+#define	BENCH_REPLY	((mach_port_t) 2)
+
+static union {
+	mig_reply_header_t	header;
+	char			space[1024];
+} request_buf, reply_buf;
+
+static int capture_request;
+static int corrupt_reply;
+
+mach_port_t
+mig_get_reply_port()
+{
+	return BENCH_REPLY;
+}
+
+void
+mig_put_reply_port(port)
+	mach_port_t port;
+{
+}
+
+void
+mig_dealloc_reply_port(port)
+	mach_port_t port;
+{
+}
+
+mach_msg_return_t
+mach_msg(msg, option, send_size, rcv_size, rcv_name, timeout, notify)
+	mach_msg_header_t *msg;
+	mach_msg_option_t option;
+	mach_msg_size_t send_size;
+	mach_msg_size_t rcv_size;
+	mach_port_t rcv_name;
+	mach_msg_timeout_t timeout;
+	mach_port_t notify;
+{
+	mach_msg_header_t *reply = &reply_buf.header.Head;
+
+	msg->msgh_size = send_size;
+	if (capture_request)
+		bcopy((char *) msg, request_buf.space, send_size);
+	(void) bench_server(msg, reply);
+	if (corrupt_reply)
+		/* the msg_type following the RetCode */
+		((mach_msg_type_t *) (&reply_buf.header + 1))->msgt_size++;
+	bcopy((char *) reply, (char *) msg, reply->msgh_size);
+	return MACH_MSG_SUCCESS;
+}
+
+kern_return_t
+S_bench_protect(server, address, size, set_maximum, new_protection,
+		 old_protection)
+	mach_port_t server;
+	natural_t address;
+	natural_t size;
+	boolean_t set_maximum;
+	int new_protection;
+	int *old_protection;
+{
+	*old_protection = new_protection;
+	return KERN_SUCCESS;
+}
+
+static double
+usecs(start, end)
+	struct timeval *start, *end;
+{
+	return (end->tv_sec - start->tv_sec) * 1000000.0 +
+	       (end->tv_usec - start->tv_usec);
+}
+
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	mach_msg_header_t *request = &request_buf.header.Head;
+	mach_msg_header_t *reply = &reply_buf.header.Head;
+	struct timeval start, end;
+	long i, n;
+	int old;
+	kern_return_t kr;
+
+	n = (argc > 1) ? atol(argv[1]) : 10000000;
+
+	capture_request = 1;
+	kr = bench_protect(BENCH_PORT, 0x1000, 0x2000, FALSE, 3, &old);
+	capture_request = 0;
+	if ((kr != KERN_SUCCESS) || (old != 3)) {
+		printf("stubbench: rpc failed (%d)\n", kr);
+		exit(1);
+	}
+
+	(void) bench_server(request, reply);
+	if (reply_buf.header.RetCode != KERN_SUCCESS) {
+		printf("stubbench: server rejected a good request\n");
+		exit(1);
+	}
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < n; i++)
+		(void) bench_server(request, reply);
+	gettimeofday(&end, (struct timezone *) 0);
+	printf("server\t%8.2f ns/call\n", usecs(&start, &end) * 1000.0 / n);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < n; i++)
+		(void) bench_protect(BENCH_PORT, i, 0x2000, FALSE, 3, &old);
+	gettimeofday(&end, (struct timezone *) 0);
+	printf("rpc\t%8.2f ns/call\n", usecs(&start, &end) * 1000.0 / n);
+
+	/* the last msg_type of the request */
+	((mach_msg_type_t *) ((char *) request + request->msgh_size -
+			      2 * sizeof(int)))->msgt_name++;
+	(void) bench_server(request, reply);
+	if (reply_buf.header.RetCode != MIG_BAD_ARGUMENTS) {
+		printf("stubbench: server accepted a bad request\n");
+		exit(1);
+	}
+
+	corrupt_reply = 1;
+	kr = bench_protect(BENCH_PORT, 0x1000, 0x2000, FALSE, 3, &old);
+	if (kr != MIG_TYPE_ERROR) {
+		printf("stubbench: user stub accepted a bad reply\n");
+		exit(1);
+	}
+
+	exit(0);
+}
@@ -1303,6 +1303,42 @@ rtCheckVariable(register routine_t *rt)
     rt->rtMaxReplyPos = MaxReplyPos;
 }
 
+/*
+ * Returns TRUE if every argument with a msg_type in the
+ * message (mask) can have it checked quickly (qc).
+ */
+static boolean_t
+rtCheckQuick(const argument_t *args, u_int mask, u_int qc)
+{
+    register const argument_t *arg;
+
+    for (arg = args; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, mask) && !akCheck(arg->argKind, qc))
+	    return FALSE;
+    return TRUE;
+}
+
+/*
+ * Initializes rtFixedRequest and rtFixedReply.  A message has a
+ * fixed layout if it has no variable-sized inline data, a known
+ * msg-simple value, and only quick-checked msg_type fields.  Its
+ * type-check then needs just a size check, a bits check and one
+ * int comparison per argument, which the stubs can do at once.
+ */
+static void
+rtCheckFixed(register routine_t *rt)
+{
+    rt->rtFixedRequest = (rt->rtNumRequestVar == 0) &&
+			 rt->rtSimpleCheckRequest &&
+			 rtCheckQuick(rt->rtArgs, akbRequest, akbRequestQC);
+
+    rt->rtFixedReply = !rt->rtOneWay &&
+		       (rt->rtNumReplyVar == 0) &&
+		       rt->rtSimpleCheckReply &&
+		       rt->rtSimpleReceiveReply &&
+		       rtCheckQuick(rt->rtArgs, akbReply, akbReplyQC);
+}
+
 /*
  * Adds akbDestroy where needed.
  */
@@ -1436,6 +1472,7 @@ rtCheckRoutine(register routine_t *rt)
     rt->rtReplySize = rtFindSize(rt->rtArgs, akbReply);
 
     rtCheckVariable(rt);
+    rtCheckFixed(rt);
     rtCheckDestroy(rt);
     rtAddByReference(rt);
 
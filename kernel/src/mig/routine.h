@@ -435,6 +435,9 @@ typedef struct routine
     int rtMaxRequestPos;	/* maximum of argRequestPos */
     int rtMaxReplyPos;		/* maximum of argReplyPos */
 
+    boolean_t rtFixedRequest;	/* request layout fixed, all args QC */
+    boolean_t rtFixedReply;	/* reply layout fixed, all args QC */
+
     boolean_t rtNoReplyArgs;	/* if so, no reply message arguments beyond
 				   what the server dispatch routine inserts */
 
@@ -560,9 +560,47 @@ WriteReplyHead(FILE *file, const routine_t *rt)
 	fprintf(file, "\tOutP->Head.msgh_size = msgh_size;\n");
 }
 
+/*
+ * A fixed-layout request is checked first against its exact size,
+ * so that a short request is refused before its msg_type fields
+ * are read.  Its simple bit and the RequestCheck template of
+ * msg_type fields are then checked together: the differences are
+ * or'ed together a word at a time, so there is a single branch
+ * however many arguments the request has.
+ */
+static void
+WriteFixedCheckHead(FILE *file, const routine_t *rt)
+{
+    register const argument_t *arg;
+    register int i = 0;
+
+    fprintf(file, "#if\tTypeCheck\n");
+    fprintf(file, "\tif (In0P->Head.msgh_size != %d)\n",
+	    rt->rtRequestSize);
+    WriteMsgError(file, "MIG_BAD_ARGUMENTS");
+    if (rt->rtSimpleReceiveRequest)
+	fprintf(file, "\tif (((In0P->Head.msgh_bits & MACH_MSGH_BITS_COMPLEX)");
+    else
+	fprintf(file, "\tif ((((In0P->Head.msgh_bits & MACH_MSGH_BITS_COMPLEX) ^\n"
+		"\t      MACH_MSGH_BITS_COMPLEX)");
+    for (arg = rt->rtArgs; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, akbRequest))
+	    fprintf(file, " |\n\t     (* (int *) &In0P->%s ^ * (int *) &RequestCheck[%d])",
+		    arg->argTTName, i++);
+    fprintf(file, ") != 0)\n");
+    WriteMsgError(file, "MIG_BAD_ARGUMENTS");
+    fprintf(file, "#endif\t/* TypeCheck */\n");
+    fprintf(file, "\n");
+}
+
 static void
 WriteCheckHead(FILE *file, const routine_t *rt)
 {
+    if (rt->rtFixedRequest) {
+	WriteFixedCheckHead(file, rt);
+	return;
+    }
+
     fprintf(file, "#if\tTypeCheck\n");
     if (rt->rtNumRequestVar > 0)
 	fprintf(file, "\tmsgh_size = In0P->Head.msgh_size;\n");
@@ -842,7 +880,8 @@ WriteInitializePtr(FILE *file, register const argument_t *arg)
 static void
 WriteTypeCheckArg(FILE *file, register const argument_t *arg)
 {
-    if (akCheck(arg->argKind, akbRequest)) {
+    if (akCheck(arg->argKind, akbRequest) &&
+	!arg->argRoutine->rtFixedRequest) {
 	WriteTypeCheck(file, arg);
 
 	if (akCheck(arg->argKind, akbVariable))
@@ -1517,7 +1556,11 @@ WriteRoutine(FILE *file, register const routine_t *rt)
 
     WriteVarDecls(file, rt);
 
-    WriteList(file, rt->rtArgs, WriteCheckDecl, akbRequestQC, "\n", "\n");
+    if (rt->rtFixedRequest)
+	(void) WriteCheckTemplate(file, rt->rtArgs, akbRequest, argNULL,
+				  "RequestCheck");
+    else
+	WriteList(file, rt->rtArgs, WriteCheckDecl, akbRequestQC, "\n", "\n");
     WriteList(file, rt->rtArgs,
 	      IsKernelServer ? WriteTypeDeclOut : WriteTypeDeclIn,
 	      akbReplyInit, "\n", "\n");
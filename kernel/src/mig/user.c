@@ -1391,12 +1391,50 @@ WriteExtractArgValue(FILE *file, register const argument_t *arg)
     fprintf(file, "\n");
 }
 
+/*************************************************************
+ *  Writes one test of the msg_type fields of a fixed-layout
+ *  reply against the ReplyCheck template, following the
+ *  RetCode.  The reply's exact size is tested first, so that
+ *  a short reply is refused before its msg_type fields are
+ *  read; the differences are then or'ed together a word at
+ *  a time, so there is a single branch.  WriteCheckIdentity
+ *  has already checked the simple bit of the reply.
+ *************************************************************/
+static void
+WriteFixedTypeCheck(FILE *file, register const routine_t *rt)
+{
+    register const argument_t *arg;
+    register int i = 0;
+
+    for (arg = rt->rtArgs; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, akbReply) && (arg != rt->rtRetCode))
+	    break;
+    if (arg == argNULL)
+	return;		/* nothing but the RetCode */
+
+    fprintf(file, "#if\tTypeCheck\n");
+    fprintf(file, "\tif (OutP->Head.msgh_size != %d)\n", rt->rtReplySize);
+    WriteMsgError(file, rt, "MIG_TYPE_ERROR");
+    fprintf(file, "\tif ((");
+    for (; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, akbReply) && (arg != rt->rtRetCode)) {
+	    fprintf(file, "%s(* (int *) &OutP->%s ^ * (int *) &ReplyCheck[%d])",
+		    (i == 0) ? "" : " |\n\t     ", arg->argTTName, i);
+	    i++;
+	}
+    fprintf(file, ") != 0)\n");
+    WriteMsgError(file, rt, "MIG_TYPE_ERROR");
+    fprintf(file, "#endif\t/* TypeCheck */\n");
+    fprintf(file, "\n");
+}
+
 static void
 WriteExtractArg(FILE *file, register const argument_t *arg)
 {
     register const routine_t *rt = arg->argRoutine;
 
-    if (akCheck(arg->argKind, akbReply))
+    if (akCheck(arg->argKind, akbReply) &&
+	(!rt->rtFixedReply || (arg == rt->rtRetCode)))
 	WriteTypeCheck(file, arg);
 
     if (akCheckAll(arg->argKind, akbVariable|akbReply))
@@ -1404,10 +1442,14 @@ WriteExtractArg(FILE *file, register const argument_t *arg)
 
     /* Now that the RetCode is type-checked, check its value.
        Must abort immediately if it isn't KERN_SUCCESS, because
-       in that case the reply message is truncated. */
+       in that case the reply message is truncated.  A fixed-layout
+       reply then checks the rest of its msg_type fields at once. */
 
-    if (arg == rt->rtRetCode)
+    if (arg == rt->rtRetCode) {
 	WriteRetCodeCheck(file, rt);
+	if (rt->rtFixedReply)
+	    WriteFixedTypeCheck(file, rt);
+    }
 
     if (akCheckAll(arg->argKind, akbReturnRcv))
 	WriteExtractArgValue(file, arg);
@@ -1528,7 +1570,13 @@ WriteRoutine(FILE *file, register const routine_t *rt)
        for each argument */
 
     WriteList(file, rt->rtArgs, WriteTypeDeclIn, akbRequest, "\n", "\n");
-    if (!rt->rtOneWay)
+    if (!rt->rtOneWay && rt->rtFixedReply) {
+	WriteCheckDecl(file, rt->rtRetCode);
+	fprintf(file, "\n");
+	(void) WriteCheckTemplate(file, rt->rtArgs, akbReply, rt->rtRetCode,
+				  "ReplyCheck");
+    }
+    else if (!rt->rtOneWay)
 	WriteList(file, rt->rtArgs, WriteCheckDecl, akbReplyQC, "\n", "\n");
 
     /* fill in all the request message types and then arguments */
@@ -234,28 +234,65 @@ WriteTypeDeclOut(FILE *file, register const argument_t *arg)
 		    arg->argLongForm, FALSE, arg->argTTName);
 }
 
-void
-WriteCheckDecl(FILE *file, register const argument_t *arg)
+static void
+WriteCheckFields(FILE *file, register const ipc_type_t *it,
+		 const char *indent)
 {
-    register const ipc_type_t *it = arg->argType;
-
     /* We'll only be called for short-form types.
        Note we use itOutNameStr instead of itInNameStr, because
        this declaration will be used to check received types. */
 
-    fprintf(file, "\tstatic mach_msg_type_t %sCheck = {\n", arg->argVarName);
-    fprintf(file, "\t\t/* msgt_name = */\t\t%s,\n", it->itOutNameStr);
-    fprintf(file, "\t\t/* msgt_size = */\t\t%d,\n", it->itSize);
-    fprintf(file, "\t\t/* msgt_number = */\t\t%d,\n", it->itNumber);
-    fprintf(file, "\t\t/* msgt_inline = */\t\t%s,\n",
+    fprintf(file, "%s/* msgt_name = */\t\t%s,\n", indent, it->itOutNameStr);
+    fprintf(file, "%s/* msgt_size = */\t\t%d,\n", indent, it->itSize);
+    fprintf(file, "%s/* msgt_number = */\t\t%d,\n", indent, it->itNumber);
+    fprintf(file, "%s/* msgt_inline = */\t\t%s,\n", indent,
 	    strbool(it->itInLine));
-    fprintf(file, "\t\t/* msgt_longform = */\t\tFALSE,\n");
-    fprintf(file, "\t\t/* msgt_deallocate = */\t\t%s,\n",
+    fprintf(file, "%s/* msgt_longform = */\t\tFALSE,\n", indent);
+    fprintf(file, "%s/* msgt_deallocate = */\t\t%s,\n", indent,
 	    strbool(!it->itInLine));
-    fprintf(file, "\t\t/* msgt_unused = */\t\t0\n");
+    fprintf(file, "%s/* msgt_unused = */\t\t0\n", indent);
+}
+
+void
+WriteCheckDecl(FILE *file, register const argument_t *arg)
+{
+    fprintf(file, "\tstatic mach_msg_type_t %sCheck = {\n", arg->argVarName);
+    WriteCheckFields(file, arg->argType, "\t\t");
     fprintf(file, "\t};\n");
 }
 
+/*
+ * For a fixed-layout message: declares name as a static array of
+ * the msg_type each argument in mask except skip must have, in
+ * message order, so that the stubs can check all the msg_type
+ * fields against it at once.  Returns the number of entries; if
+ * there are none, nothing is declared.
+ */
+int
+WriteCheckTemplate(FILE *file, const argument_t *args, u_int mask,
+		   const argument_t *skip, const char *name)
+{
+    register const argument_t *arg;
+    register int count = 0;
+
+    for (arg = args; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, mask) && (arg != skip))
+	    count++;
+    if (count == 0)
+	return 0;
+
+    fprintf(file, "\tstatic mach_msg_type_t %s[%d] = {\n", name, count);
+    for (arg = args; arg != argNULL; arg = arg->argNext)
+	if (akCheck(arg->argKind, mask) && (arg != skip)) {
+	    fprintf(file, "\t    {\n");
+	    WriteCheckFields(file, arg->argType, "\t\t");
+	    fprintf(file, "\t    },\n");
+	}
+    fprintf(file, "\t};\n");
+    fprintf(file, "\n");
+    return count;
+}
+
 const char *
 ReturnTypeStr(const routine_t *rt)
 {
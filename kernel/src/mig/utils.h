@@ -79,6 +79,9 @@ extern write_list_fn_t WriteTypeDeclIn;
 extern write_list_fn_t WriteTypeDeclOut;
 extern write_list_fn_t WriteCheckDecl;
 
+extern int WriteCheckTemplate(FILE *file, const argument_t *args, u_int mask,
+			      const argument_t *skip, const char *name);
+
 extern const char *ReturnTypeStr(const routine_t *rt);
 
 extern const char *FetchUserType(const ipc_type_t *it);
@@ -0,0 +1,504 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	pagesim/pagesim.c
+ *
+ *	Replays a page reference trace against a model of the
+ *	pageout queues, once with each replacement policy, and
+ *	prints the fault counts side by side:
+ *
+ *	"activate"	every page brought in by a pager goes on
+ *			the active queue (vm_page_activate), as the
+ *			kernel did before vm_page_admit.
+ *	"admit"		pages go through vm_page_admit: on probation
+ *			in the inactive queue unless their ghost entry
+ *			shows a short refault distance.
+ *
+ *	The model follows vm_pageout_scan and vm_resident.c: the
+ *	same inactive, free and free-min targets, the same ghost
+ *	table size and hash, and software reference bits set on
+ *	every reference.  It leaves out everything that does not
+ *	change which page is evicted: dirty pages, laundry, busy
+ *	and wired pages, and timing.
+ *
+ *	The trace has one reference per line, either "page" or
+ *	"object page"; numbers may be decimal, octal or hex, and
+ *	lines starting with '#' are skipped.  Build and run with
+ *
+ *		cc -O -o pagesim pagesim.c
+ *		pagesim [-m pages] [trace]
+ *
+ *	where -m gives the size of physical memory in pages
+ *	(default 1024).  The trace is read from the standard
+ *	input if no file is named.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define	POLICY_ACTIVATE	0
+#define	POLICY_ADMIT	1
+
+#define	Q_NONE		0
+#define	Q_FREE		1
+#define	Q_ACTIVE	2
+#define	Q_INACTIVE	3
+#define	Q_COUNT		4
+
+#define	NIL		(-1)
+
+/*
+ *	Page frames, hash chains and queues are kept in arrays and
+ *	linked by index.
+ */
+struct page {
+	unsigned long	object;
+	unsigned long	offset;		/* in pages */
+	int		next;		/* queue link */
+	int		prev;
+	int		hash_next;	/* VP chain */
+	int		queue;		/* Q_* */
+	char		reference;
+	char		probation;
+};
+
+struct ghost {
+	unsigned long	object;
+	unsigned long	offset;
+	unsigned int	evicted;
+	char		valid;
+};
+
+struct queue {
+	int		first;
+	int		last;
+	unsigned int	count;
+};
+
+struct memory {
+	char		*name;
+	int		policy;
+
+	struct page	*pages;
+	unsigned int	npages;
+
+	int		*buckets;
+	unsigned int	hash_mask;
+
+	struct ghost	*ghosts;
+	unsigned int	ghost_mask;
+
+	struct queue	queues[Q_COUNT];
+
+	unsigned int	free_min;
+	unsigned int	free_target;
+
+	unsigned int	evictions;
+	unsigned long	refs;
+	unsigned long	faults;
+	unsigned long	reactivations;
+	unsigned long	ghost_hits;
+	unsigned long	probations;
+	unsigned long	probation_passes;
+};
+
+/*
+ *	From vm_pageout.c.
+ */
+#define	VM_PAGE_INACTIVE_TARGET(avail)	((avail) * 2 / 3)
+#define	VM_PAGE_FREE_TARGET(free)	(15 + (free) / 80)
+#define	VM_PAGE_FREE_MIN(free)		(10 + (free) / 100)
+
+#define	page_hash(mem, object, offset) \
+	(((unsigned int) (object) + (unsigned int) (offset)) & (mem)->hash_mask)
+
+#define	ghost_hash(mem, object, offset) \
+	(((unsigned int) (object) + (unsigned int) (offset)) & (mem)->ghost_mask)
+
+static void
+queue_enter(mem, q, p)
+	struct memory *mem;
+	int q, p;
+{
+	struct queue *queue = &mem->queues[q];
+	struct page *m = &mem->pages[p];
+
+	m->queue = q;
+	m->next = NIL;
+	m->prev = queue->last;
+	if (queue->last == NIL)
+		queue->first = p;
+	else
+		mem->pages[queue->last].next = p;
+	queue->last = p;
+	queue->count++;
+}
+
+static void
+queue_remove(mem, p)
+	struct memory *mem;
+	int p;
+{
+	struct page *m = &mem->pages[p];
+	struct queue *queue = &mem->queues[m->queue];
+
+	if (m->prev == NIL)
+		queue->first = m->next;
+	else
+		mem->pages[m->prev].next = m->next;
+	if (m->next == NIL)
+		queue->last = m->prev;
+	else
+		mem->pages[m->next].prev = m->prev;
+	queue->count--;
+	m->queue = Q_NONE;
+}
+
+static int
+page_lookup(mem, object, offset)
+	struct memory *mem;
+	unsigned long object, offset;
+{
+	int p;
+
+	for (p = mem->buckets[page_hash(mem, object, offset)];
+	     p != NIL; p = mem->pages[p].hash_next)
+		if ((mem->pages[p].object == object) &&
+		    (mem->pages[p].offset == offset))
+			return p;
+	return NIL;
+}
+
+static void
+page_insert(mem, p, object, offset)
+	struct memory *mem;
+	int p;
+	unsigned long object, offset;
+{
+	int *bucket = &mem->buckets[page_hash(mem, object, offset)];
+
+	mem->pages[p].object = object;
+	mem->pages[p].offset = offset;
+	mem->pages[p].hash_next = *bucket;
+	*bucket = p;
+}
+
+static void
+page_remove(mem, p)
+	struct memory *mem;
+	int p;
+{
+	struct page *m = &mem->pages[p];
+	int *link;
+
+	for (link = &mem->buckets[page_hash(mem, m->object, m->offset)];
+	     *link != p; link = &mem->pages[*link].hash_next)
+		continue;
+	*link = m->hash_next;
+}
+
+/*
+ *	vm_page_deactivate, for a page on the active queue.
+ */
+static void
+page_deactivate(mem, p)
+	struct memory *mem;
+	int p;
+{
+	queue_remove(mem, p);
+	mem->pages[p].reference = 0;
+	queue_enter(mem, Q_INACTIVE, p);
+}
+
+/*
+ *	vm_page_activate.
+ */
+static void
+page_activate(mem, p)
+	struct memory *mem;
+	int p;
+{
+	if (mem->pages[p].queue != Q_NONE)
+		queue_remove(mem, p);
+	mem->pages[p].probation = 0;
+	queue_enter(mem, Q_ACTIVE, p);
+}
+
+/*
+ *	vm_page_admit.
+ */
+static void
+page_admit(mem, p)
+	struct memory *mem;
+	int p;
+{
+	struct page *m = &mem->pages[p];
+	struct ghost *ghost = &mem->ghosts[ghost_hash(mem, m->object,
+							m->offset)];
+
+	if (ghost->valid &&
+	    (ghost->object == m->object) && (ghost->offset == m->offset)) {
+		ghost->valid = 0;
+		if (mem->evictions - ghost->evicted <=
+		    mem->queues[Q_ACTIVE].count) {
+			mem->ghost_hits++;
+			page_activate(mem, p);
+			return;
+		}
+	}
+
+	m->probation = 1;
+	queue_enter(mem, Q_INACTIVE, p);
+	mem->probations++;
+}
+
+/*
+ *	vm_page_ghost_enter.
+ */
+static void
+ghost_enter(mem, p)
+	struct memory *mem;
+	int p;
+{
+	struct page *m = &mem->pages[p];
+	struct ghost *ghost = &mem->ghosts[ghost_hash(mem, m->object,
+							m->offset)];
+
+	ghost->object = m->object;
+	ghost->offset = m->offset;
+	ghost->evicted = mem->evictions++;
+	ghost->valid = 1;
+}
+
+/*
+ *	vm_pageout_scan, less the flow control: refill the inactive
+ *	queue from the active queue, then free pages from the head
+ *	of the inactive queue until the free target is met.
+ */
+static void
+pageout_scan(mem)
+	struct memory *mem;
+{
+	struct queue *active = &mem->queues[Q_ACTIVE];
+	struct queue *inactive = &mem->queues[Q_INACTIVE];
+	struct page *m;
+	unsigned int target;
+	int p;
+
+	for (;;) {
+		target = VM_PAGE_INACTIVE_TARGET(active->count +
+						 inactive->count);
+		while ((inactive->count < target) && (active->first != NIL))
+			page_deactivate(mem, active->first);
+
+		if ((mem->queues[Q_FREE].count >= mem->free_target) ||
+		    (inactive->first == NIL))
+			return;
+
+		p = inactive->first;
+		m = &mem->pages[p];
+		queue_remove(mem, p);
+
+		if (m->reference) {
+			if (m->probation) {
+				m->probation = 0;
+				m->reference = 0;
+				queue_enter(mem, Q_INACTIVE, p);
+				mem->probation_passes++;
+				continue;
+			}
+			page_activate(mem, p);
+			mem->reactivations++;
+			continue;
+		}
+
+		if (mem->policy == POLICY_ADMIT)
+			ghost_enter(mem, p);
+		page_remove(mem, p);
+		m->probation = 0;
+		queue_enter(mem, Q_FREE, p);
+	}
+}
+
+static void
+memory_init(mem, name, policy, npages)
+	struct memory *mem;
+	char *name;
+	int policy;
+	unsigned int npages;
+{
+	unsigned int buckets, ghosts, i;
+	int q;
+
+	mem->name = name;
+	mem->policy = policy;
+	mem->npages = npages;
+
+	for (buckets = 1; buckets < npages; buckets <<= 1)
+		continue;
+	ghosts = buckets / 2;
+	if (ghosts == 0)
+		ghosts = 1;
+
+	mem->pages = (struct page *) calloc(npages, sizeof(struct page));
+	mem->buckets = (int *) malloc(buckets * sizeof(int));
+	mem->ghosts = (struct ghost *) calloc(ghosts, sizeof(struct ghost));
+	if ((mem->pages == 0) || (mem->buckets == 0) || (mem->ghosts == 0)) {
+		fprintf(stderr, "pagesim: out of memory\n");
+		exit(1);
+	}
+	mem->hash_mask = buckets - 1;
+	mem->ghost_mask = ghosts - 1;
+	for (i = 0; i < buckets; i++)
+		mem->buckets[i] = NIL;
+
+	for (q = 0; q < Q_COUNT; q++) {
+		mem->queues[q].first = NIL;
+		mem->queues[q].last = NIL;
+		mem->queues[q].count = 0;
+	}
+	for (i = 0; i < npages; i++)
+		queue_enter(mem, Q_FREE, (int) i);
+
+	mem->free_min = VM_PAGE_FREE_MIN(npages);
+	mem->free_target = VM_PAGE_FREE_TARGET(npages);
+	if (mem->free_target <= mem->free_min)
+		mem->free_target = mem->free_min + 1;
+}
+
+/*
+ *	One reference: a hit sets the reference bit, a miss takes
+ *	a free page (waking the daemon below free_min, as
+ *	vm_page_grab does), queues it as the policy says and then
+ *	marks it used, as vm_fault does once the page is entered.
+ */
+static void
+memory_reference(mem, object, offset)
+	struct memory *mem;
+	unsigned long object, offset;
+{
+	int p;
+
+	mem->refs++;
+	p = page_lookup(mem, object, offset);
+	if (p == NIL) {
+		mem->faults++;
+		if (mem->queues[Q_FREE].count <= mem->free_min)
+			pageout_scan(mem);
+		p = mem->queues[Q_FREE].first;
+		queue_remove(mem, p);
+		page_insert(mem, p, object, offset);
+		if (mem->policy == POLICY_ADMIT)
+			page_admit(mem, p);
+		else
+			page_activate(mem, p);
+	}
+	mem->pages[p].reference = 1;
+}
+
+static void
+memory_report(mem)
+	struct memory *mem;
+{
+	printf("%-10s %10lu %10lu %7.2f%% %10lu %10lu %10lu %10lu\n",
+	       mem->name, mem->refs, mem->faults,
+	       mem->refs ? 100.0 * (mem->refs - mem->faults) / mem->refs : 0.0,
+	       mem->reactivations, mem->probations, mem->probation_passes,
+	       mem->ghost_hits);
+}
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: pagesim [-m pages] [trace]\n");
+	exit(2);
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	struct memory old, new;
+	unsigned long npages = 1024;
+	unsigned long object, offset;
+	char line[256], *cp, *end;
+	FILE *trace = stdin;
+	int i;
+
+	for (i = 1; (i < argc) && (argv[i][0] == '-'); i++) {
+		if ((argv[i][1] == 'm') && (argv[i][2] == '\0') &&
+		    (i + 1 < argc)) {
+			npages = strtoul(argv[++i], &end, 0);
+			if ((*end != '\0') || (npages < 64))
+				usage();
+		} else
+			usage();
+	}
+	if (i + 1 < argc)
+		usage();
+	if ((i < argc) && ((trace = fopen(argv[i], "r")) == NULL)) {
+		perror(argv[i]);
+		exit(1);
+	}
+
+	memory_init(&old, "activate", POLICY_ACTIVATE, (unsigned int) npages);
+	memory_init(&new, "admit", POLICY_ADMIT, (unsigned int) npages);
+
+	while (fgets(line, sizeof line, trace) != NULL) {
+		for (cp = line; (*cp == ' ') || (*cp == '\t'); cp++)
+			continue;
+		if ((*cp == '#') || (*cp == '\n') || (*cp == '\0'))
+			continue;
+		offset = strtoul(cp, &end, 0);
+		if (end == cp) {
+			fprintf(stderr, "pagesim: bad trace line: %s", line);
+			exit(1);
+		}
+		cp = end;
+		object = 0;
+		while ((*cp == ' ') || (*cp == '\t'))
+			cp++;
+		if ((*cp != '\n') && (*cp != '\0')) {
+			object = offset;
+			offset = strtoul(cp, &end, 0);
+			if (end == cp) {
+				fprintf(stderr, "pagesim: bad trace line: %s",
+					line);
+				exit(1);
+			}
+		}
+		memory_reference(&old, object, offset);
+		memory_reference(&new, object, offset);
+	}
+
+	printf("%-10s %10s %10s %8s %10s %10s %10s %10s\n",
+	       "policy", "refs", "faults", "hits",
+	       "react", "probation", "requeued", "ghosthits");
+	memory_report(&old);
+	memory_report(&new);
+	exit(0);
+}
@@ -0,0 +1,353 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	spacebench/spacebench.c
+ *
+ *	Times name lookups in one IPC space from several threads,
+ *	each translating its own names, as the threads of a server
+ *	sending on distinct ports do.  The space is locked as it
+ *	was, with a simple lock, and as it is now, with a read lock
+ *	(kern/lock.c, copied below without the sleeping paths, which
+ *	the space lock never takes).  The simple locks spin on an
+ *	atomic exchange, as the i386 ones do on xchgl; gcc's
+ *	__sync builtins supply it here.
+ *
+ *		cc -O -o spacebench spacebench.c -lpthread
+ *		spacebench [threads [lookups]]
+ *
+ *	For 1, 2, 4 ... threads, up to the number of processors
+ *	online by default, each thread does "lookups" lookups
+ *	(default 1000000); one in WRITE_EVERY takes the lock for
+ *	writing instead, as a right being made or destroyed does.
+ *	The columns are wall-clock ns per lookup over all threads.
+ *	With more threads than processors, spinning threads wait
+ *	out the time slices of preempted lock holders, and the
+ *	numbers mean nothing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+typedef int		boolean_t;
+#define	TRUE		((boolean_t) 1)
+#define	FALSE		((boolean_t) 0)
+
+struct slock {
+	volatile int	lock_data;
+};
+
+typedef struct slock	simple_lock_data_t;
+typedef struct slock	*simple_lock_t;
+
+#define	simple_lock_init(l) \
+	((l)->lock_data = 0)
+
+#define	simple_lock(l) \
+    ({ \
+	while (__sync_lock_test_and_set(&(l)->lock_data, 1)) \
+	    while ((l)->lock_data) \
+		continue; \
+	0; \
+    })
+
+#define	simple_unlock(l) \
+	(__sync_lock_release(&(l)->lock_data))
+
+#define	check_simple_locks()
+#define	current_thread()	((struct thread *) 0)
+
+/*
+ *	From kern/lock.h and kern/lock.c.
+ */
+struct lock {
+	struct thread	*thread;	/* Thread that has lock, if
+					   recursive locking allowed */
+	unsigned int	read_count:16,	/* Number of accepted readers */
+	/* boolean_t */	want_upgrade:1,	/* Read-to-write upgrade waiting */
+	/* boolean_t */	want_write:1,	/* Writer is waiting, or
+					   locked for write */
+	/* boolean_t */	waiting:1,	/* Someone is sleeping on lock */
+	/* boolean_t */	can_sleep:1,	/* Can attempts to lock go to sleep? */
+			recursion_depth:12, /* Depth of recursion */
+			:0;
+	simple_lock_data_t interlock;	/* Hardware interlock field. */
+};
+
+typedef struct lock	lock_data_t;
+typedef struct lock	*lock_t;
+
+int lock_wait_time = 100;
+
+void lock_init(
+	lock_t		l,
+	boolean_t	can_sleep)
+{
+	simple_lock_init(&l->interlock);
+	l->want_write = FALSE;
+	l->want_upgrade = FALSE;
+	l->read_count = 0;
+	l->can_sleep = can_sleep;
+	l->thread = (struct thread *)-1;	/* XXX */
+	l->recursion_depth = 0;
+}
+
+void lock_write(
+	register lock_t	l)
+{
+	register int	i;
+
+	check_simple_locks();
+	simple_lock(&l->interlock);
+
+	if (l->thread == current_thread()) {
+		/*
+		 *	Recursive lock.
+		 */
+		l->recursion_depth++;
+		simple_unlock(&l->interlock);
+		return;
+	}
+
+	/*
+	 *	Try to acquire the want_write bit.
+	 */
+	while (l->want_write) {
+		if ((i = lock_wait_time) > 0) {
+			simple_unlock(&l->interlock);
+			while (--i > 0 && l->want_write)
+				continue;
+			simple_lock(&l->interlock);
+		}
+	}
+	l->want_write = TRUE;
+
+	/* Wait for readers (and upgrades) to finish */
+
+	while ((l->read_count != 0) || l->want_upgrade) {
+		if ((i = lock_wait_time) > 0) {
+			simple_unlock(&l->interlock);
+			while (--i > 0 && (l->read_count != 0 ||
+					l->want_upgrade))
+				continue;
+			simple_lock(&l->interlock);
+		}
+	}
+	simple_unlock(&l->interlock);
+}
+
+void lock_done(
+	register lock_t	l)
+{
+	simple_lock(&l->interlock);
+
+	if (l->read_count != 0)
+		l->read_count--;
+	else
+	if (l->recursion_depth != 0)
+		l->recursion_depth--;
+	else
+	if (l->want_upgrade)
+	 	l->want_upgrade = FALSE;
+	else
+	 	l->want_write = FALSE;
+
+	simple_unlock(&l->interlock);
+}
+
+void lock_read(
+	register lock_t	l)
+{
+	register int	i;
+
+	check_simple_locks();
+	simple_lock(&l->interlock);
+
+	if (l->thread == current_thread()) {
+		/*
+		 *	Recursive lock.
+		 */
+		l->read_count++;
+		simple_unlock(&l->interlock);
+		return;
+	}
+
+	while (l->want_write || l->want_upgrade) {
+		if ((i = lock_wait_time) > 0) {
+			simple_unlock(&l->interlock);
+			while (--i > 0 && (l->want_write ||
+					   l->want_upgrade))
+				continue;
+			simple_lock(&l->interlock);
+		}
+	}
+
+	l->read_count++;
+	simple_unlock(&l->interlock);
+}
+
+/*
+ *	Enough of an IPC space for ipc_entry_lookup's table case:
+ *	names are an index and a generation, as MACH_PORT_INDEX and
+ *	MACH_PORT_GEN take them apart.
+ */
+#define	NENTRIES	1024		/* table size */
+#define	PER_THREAD	16		/* names each thread uses */
+#define	WRITE_EVERY	64		/* lookups per write lock */
+
+#define	IE_BITS_GEN(bits)	((bits) & 0xff000000)
+#define	IE_BITS_TYPE(bits)	((bits) & 0x001f0000)
+#define	MACH_PORT_INDEX(name)	((name) >> 8)
+#define	MACH_PORT_GEN(name)	((name) << 24)
+#define	MACH_PORT_MAKE(index, gen) (((index) << 8) | ((gen) >> 24))
+
+struct ipc_entry {
+	unsigned int	ie_bits;
+	void		*ie_object;
+};
+
+struct ipc_space {
+	simple_lock_data_t is_slock;	/* the lock as it was */
+	lock_data_t	is_lock_data;	/* the lock as it is */
+	struct ipc_entry is_table[NENTRIES];
+	unsigned int	is_table_size;
+} space;
+
+boolean_t	use_rwlock;
+long		lookups;
+
+struct ipc_entry *
+ipc_entry_lookup(name)
+	unsigned int name;
+{
+	unsigned int index;
+	struct ipc_entry *entry;
+
+	index = MACH_PORT_INDEX(name);
+	if (index >= space.is_table_size)
+		return (0);
+	entry = &space.is_table[index];
+	if (IE_BITS_GEN(entry->ie_bits) != MACH_PORT_GEN(name) ||
+	    IE_BITS_TYPE(entry->ie_bits) == 0)
+		return (0);
+	return (entry);
+}
+
+void *
+sender(arg)
+	void *arg;
+{
+	long t = (long) arg;
+	unsigned int names[PER_THREAD];
+	struct ipc_entry *entry;
+	long i;
+	int j;
+
+	for (j = 0; j < PER_THREAD; j++) {
+		i = 1 + t * PER_THREAD + j;
+		names[j] = MACH_PORT_MAKE(i, IE_BITS_GEN(space.is_table[i].ie_bits));
+	}
+
+	for (i = 0; i < lookups; i++) {
+		j = i % PER_THREAD;
+		if (use_rwlock) {
+			if ((i % WRITE_EVERY) == 0)
+				lock_write(&space.is_lock_data);
+			else
+				lock_read(&space.is_lock_data);
+		} else
+			simple_lock(&space.is_slock);
+
+		entry = ipc_entry_lookup(names[j]);
+		if (entry == 0 ||
+		    entry->ie_object != (void *) (long) MACH_PORT_INDEX(names[j])) {
+			fprintf(stderr, "spacebench: bad lookup of 0x%x\n",
+				names[j]);
+			exit(1);
+		}
+
+		if (use_rwlock)
+			lock_done(&space.is_lock_data);
+		else
+			simple_unlock(&space.is_slock);
+	}
+	return (0);
+}
+
+double
+run(nthreads, rwlock)
+	int		nthreads;
+	boolean_t	rwlock;
+{
+	pthread_t threads[64];
+	struct timeval start, end;
+	long t;
+
+	use_rwlock = rwlock;
+	gettimeofday(&start, (struct timezone *) 0);
+	for (t = 0; t < nthreads; t++)
+		pthread_create(&threads[t], 0, sender, (void *) t);
+	for (t = 0; t < nthreads; t++)
+		pthread_join(threads[t], 0);
+	gettimeofday(&end, (struct timezone *) 0);
+
+	return (((end.tv_sec - start.tv_sec) * 1000000.0 +
+		 (end.tv_usec - start.tv_usec)) * 1000.0 /
+		(lookups * nthreads));
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	int maxthreads, n, i;
+
+	maxthreads = (argc > 1) ? atoi(argv[1])
+				: (int) sysconf(_SC_NPROCESSORS_ONLN);
+	lookups = (argc > 2) ? atol(argv[2]) : 1000000;
+	if (maxthreads <= 0 || maxthreads > 64 ||
+	    maxthreads * PER_THREAD >= NENTRIES || lookups <= 0) {
+		fprintf(stderr, "usage: spacebench [threads [lookups]]\n");
+		exit(2);
+	}
+
+	simple_lock_init(&space.is_slock);
+	lock_init(&space.is_lock_data, FALSE);
+	space.is_table_size = NENTRIES;
+	for (i = 1; i < NENTRIES; i++) {
+		space.is_table[i].ie_bits = ((i * 7) << 24) | 0x00010000;
+		space.is_table[i].ie_object = (void *) (long) i;
+	}
+
+	printf("%8s %10s %10s   (ns per lookup)\n",
+	       "threads", "simple", "read");
+	for (n = 1; n <= maxthreads; n *= 2)
+		printf("%8d %10.1f %10.1f\n", n, run(n, FALSE), run(n, TRUE));
+	exit(0);
+}
@@ -0,0 +1,465 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	timerbench/timerbench.c
+ *
+ *	Times set_timeout, reset_timeout and softclock with many
+ *	timers pending, for the timing wheels of kern/mach_clock.c
+ *	and for the sorted list they replaced.  The timeout code
+ *	is copied from mach_clock.c, for one processor and without
+ *	the locks and spl calls; the queue primitives are the
+ *	kernel's own (kern/queue.c, included below).
+ *
+ *		cc -O -idirafter ../.. -o timerbench timerbench.c
+ *		timerbench [pending]
+ *
+ *	With "pending" timers set (default 100000), each due within
+ *	2^16 ticks, the "set" and "reset" columns time setting and
+ *	cancelling one more timer, and "expire" is the softclock
+ *	cost per timer when the clock is run until all have fired.
+ *	Expiry order is checked against the expiration times.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/*
+ *	Enough of kern/lock.h for kern/queue.h.
+ */
+#define	_KERN_LOCK_H_
+
+struct slock {
+	int		lock_data;
+};
+
+#include "../../kern/queue.c"
+
+typedef int		boolean_t;
+#define	TRUE		((boolean_t) 1)
+#define	FALSE		((boolean_t) 0)
+
+struct timer_elt {
+	queue_chain_t	chain;
+	int		(*fcn)();
+	char *		param;
+	unsigned long	ticks;
+	int		set;
+	struct timer_wheel *wheel;
+};
+#define	TELT_UNSET	0
+#define	TELT_SET	1
+
+typedef	struct timer_elt	timer_elt_data_t;
+typedef	struct timer_elt	*timer_elt_t;
+
+unsigned long	elapsed_ticks = 0;
+
+/*
+ *	From kern/mach_clock.c.
+ */
+#define	TW0_BITS	8
+#define	TW0_SIZE	(1 << TW0_BITS)
+#define	TW0_MASK	(TW0_SIZE - 1)
+#define	TWN_BITS	6
+#define	TWN_SIZE	(1 << TWN_BITS)
+#define	TWN_MASK	(TWN_SIZE - 1)
+#define	TWN_LEVELS	4
+
+#define	TW_SHIFT(level)	(TW0_BITS + (level) * TWN_BITS)
+
+struct timer_wheel {
+	unsigned long	curtick;
+	unsigned long	nexttick;
+	int		count;
+	boolean_t	running;
+	queue_head_t	tw0[TW0_SIZE];
+	queue_head_t	twn[TWN_LEVELS][TWN_SIZE];
+} timer_wheel;
+
+void timer_wheel_insert(w, telt)
+	register struct timer_wheel	*w;
+	register timer_elt_t		telt;
+{
+	register unsigned long	delta = telt->ticks - w->curtick;
+	register queue_t	slot;
+	register int		level;
+
+	if ((long) delta < 0) {
+		slot = &w->tw0[w->curtick & TW0_MASK];
+	}
+	else if (delta < TW0_SIZE) {
+		slot = &w->tw0[telt->ticks & TW0_MASK];
+	}
+	else {
+		for (level = 0; level < TWN_LEVELS - 1; level++)
+			if (delta < (1UL << TW_SHIFT(level + 1)))
+				break;
+		slot = &w->twn[level][(telt->ticks >> TW_SHIFT(level)) &
+				      TWN_MASK];
+	}
+
+	enqueue_tail(slot, (queue_entry_t) telt);
+}
+
+void timer_wheel_cascade(w, level, index)
+	register struct timer_wheel	*w;
+	int				level;
+	int				index;
+{
+	register queue_t	slot = &w->twn[level][index];
+	register timer_elt_t	telt;
+
+	while (!queue_empty(slot)) {
+		telt = (timer_elt_t) dequeue_head(slot);
+		timer_wheel_insert(w, telt);
+	}
+}
+
+void timer_wheel_next(w)
+	register struct timer_wheel	*w;
+{
+	register unsigned long	next = w->curtick;
+
+	while (((next & TW0_MASK) != 0) &&
+	       queue_empty(&w->tw0[next & TW0_MASK]))
+		next++;
+	w->nexttick = next;
+}
+
+void timer_wheel_run(w)
+	register struct timer_wheel	*w;
+{
+	register timer_elt_t	telt;
+	register queue_t	slot;
+	register int		(*fcn)();
+	register char		*param;
+	register int		level, index;
+
+	if (w->running)
+	    return;
+	w->running = TRUE;
+
+	while ((long) (elapsed_ticks - w->curtick) >= 0) {
+	    if (w->count == 0) {
+		w->curtick = elapsed_ticks + 1;
+		break;
+	    }
+
+	    if ((w->curtick & TW0_MASK) == 0) {
+		for (level = 0; level < TWN_LEVELS; level++) {
+		    index = (w->curtick >> TW_SHIFT(level)) & TWN_MASK;
+		    timer_wheel_cascade(w, level, index);
+		    if (index != 0)
+			break;
+		}
+	    }
+
+	    slot = &w->tw0[w->curtick & TW0_MASK];
+	    while (!queue_empty(slot)) {
+		telt = (timer_elt_t) dequeue_head(slot);
+		fcn = telt->fcn;
+		param = telt->param;
+		telt->set = TELT_UNSET;
+		w->count--;
+
+		(*fcn)(param);
+	    }
+
+	    w->curtick++;
+	}
+
+	timer_wheel_next(w);
+	w->running = FALSE;
+}
+
+void wheel_set_timeout(telt, interval)
+	register timer_elt_t	telt;
+	register unsigned int	interval;
+{
+	register struct timer_wheel	*w = &timer_wheel;
+
+	if ((w->count == 0) && !w->running) {
+	    w->curtick = elapsed_ticks;
+	    w->nexttick = (w->curtick | TW0_MASK) + 1;
+	}
+
+	telt->ticks = elapsed_ticks + interval;
+	telt->wheel = w;
+	timer_wheel_insert(w, telt);
+	w->count++;
+	telt->set = TELT_SET;
+
+	if ((long) (telt->ticks - w->nexttick) < 0)
+	    w->nexttick = telt->ticks;
+}
+
+boolean_t wheel_reset_timeout(telt)
+	register timer_elt_t	telt;
+{
+	register struct timer_wheel	*w;
+
+	if (telt->set == TELT_SET) {
+	    w = telt->wheel;
+	    remqueue((queue_t) 0, (queue_entry_t) telt);
+	    w->count--;
+	    telt->set = TELT_UNSET;
+	    return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ *	The sorted list, from mach_clock.c before the wheels.
+ */
+timer_elt_data_t	timer_head;
+
+void list_softclock()
+{
+	register timer_elt_t	telt;
+	register int	(*fcn)();
+	register char	*param;
+
+	while (TRUE) {
+	    telt = (timer_elt_t) queue_first(&timer_head.chain);
+	    if (telt->ticks > elapsed_ticks)
+		break;
+	    fcn = telt->fcn;
+	    param = telt->param;
+
+	    remqueue(&timer_head.chain, (queue_entry_t)telt);
+	    telt->set = TELT_UNSET;
+
+	    (*fcn)(param);
+	}
+}
+
+void list_set_timeout(telt, interval)
+	register timer_elt_t	telt;
+	register unsigned int	interval;
+{
+	register timer_elt_t	next;
+
+	interval += elapsed_ticks;
+
+	for (next = (timer_elt_t)queue_first(&timer_head.chain);
+	     ;
+	     next = (timer_elt_t)queue_next((queue_entry_t)next)) {
+
+	    if (next->ticks > interval)
+		break;
+	}
+	telt->ticks = interval;
+	insque((queue_entry_t) telt, ((queue_entry_t)next)->prev);
+	telt->set = TELT_SET;
+}
+
+boolean_t list_reset_timeout(telt)
+	register timer_elt_t	telt;
+{
+	if (telt->set) {
+	    remqueue(&timer_head.chain, (queue_entry_t)telt);
+	    telt->set = TELT_UNSET;
+	    return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ *	The benchmark.
+ */
+#define	INTERVAL_MAX	(1 << 16)	/* ticks */
+#define	OPS_MAX		100000		/* timed set/reset pairs */
+
+static unsigned long	seed = 1;
+
+static unsigned int
+random_interval()
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 8) % (INTERVAL_MAX - 1)) + 1;
+}
+
+static unsigned long	fired;
+static unsigned long	last_fired;
+
+static int
+expire(param)
+	char *param;
+{
+	timer_elt_t telt = (timer_elt_t) param;
+
+	if ((telt->ticks > elapsed_ticks) || (telt->ticks < last_fired)) {
+		fprintf(stderr, "timerbench: timer for tick %lu ran at %lu\n",
+			telt->ticks, elapsed_ticks);
+		exit(1);
+	}
+	last_fired = telt->ticks;
+	fired++;
+	return 0;
+}
+
+static double
+nsecs(start, end, count)
+	struct timeval *start, *end;
+	long count;
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000.0 +
+		(end->tv_usec - start->tv_usec)) * 1000.0 / count;
+}
+
+static int
+compare_ticks(a, b)
+	const void *a, *b;
+{
+	unsigned long ta = (*(timer_elt_t *) a)->ticks;
+	unsigned long tb = (*(timer_elt_t *) b)->ticks;
+
+	return (ta < tb) ? -1 : (ta > tb);
+}
+
+static void
+bench(name, timers, pending, ops, set, reset, run)
+	char *name;
+	timer_elt_t timers;
+	long pending, ops;
+	void (*set)();
+	boolean_t (*reset)();
+	void (*run)();
+{
+	struct timeval start, end;
+	double set_ns, reset_ns, expire_ns;
+	timer_elt_t *sorted;
+	long i;
+
+	elapsed_ticks = 0;
+	fired = 0;
+	last_fired = 0;
+	seed = 1;
+
+	for (i = 0; i < pending + ops; i++) {
+		timers[i].fcn = expire;
+		timers[i].param = (char *) &timers[i];
+		timers[i].set = TELT_UNSET;
+	}
+
+	if (set == list_set_timeout) {
+		/*
+		 *	Filling the list one timer at a time takes
+		 *	quadratic time; link it in order instead.
+		 */
+		sorted = (timer_elt_t *) malloc(pending * sizeof *sorted);
+		for (i = 0; i < pending; i++) {
+			timers[i].ticks = random_interval();
+			sorted[i] = &timers[i];
+		}
+		qsort((char *) sorted, pending, sizeof *sorted, compare_ticks);
+		for (i = 0; i < pending; i++) {
+			enqueue_tail(&timer_head.chain, (queue_entry_t) sorted[i]);
+			sorted[i]->set = TELT_SET;
+		}
+		free((char *) sorted);
+	} else
+		for (i = 0; i < pending; i++)
+			(*set)(&timers[i], random_interval());
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < ops; i++)
+		(*set)(&timers[pending + i], random_interval());
+	gettimeofday(&end, (struct timezone *) 0);
+	set_ns = nsecs(&start, &end, ops);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < ops; i++)
+		if (!(*reset)(&timers[pending + i])) {
+			fprintf(stderr, "timerbench: reset failed\n");
+			exit(1);
+		}
+	gettimeofday(&end, (struct timezone *) 0);
+	reset_ns = nsecs(&start, &end, ops);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	while (fired < pending) {
+		elapsed_ticks++;
+		(*run)();
+	}
+	gettimeofday(&end, (struct timezone *) 0);
+	expire_ns = nsecs(&start, &end, pending);
+
+	printf("%-8s %10ld %10.1f %10.1f %10.1f\n",
+	       name, pending, set_ns, reset_ns, expire_ns);
+}
+
+static void
+wheel_run()
+{
+	if ((long) (elapsed_ticks - timer_wheel.nexttick) >= 0)
+		timer_wheel_run(&timer_wheel);
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	timer_elt_t timers;
+	long pending, ops;
+	int level, i;
+
+	pending = (argc > 1) ? atol(argv[1]) : 100000;
+	if (pending <= 0) {
+		fprintf(stderr, "usage: timerbench [pending]\n");
+		exit(2);
+	}
+	ops = (pending < OPS_MAX) ? pending : OPS_MAX;
+
+	timers = (timer_elt_t) calloc(pending + ops, sizeof *timers);
+	if (timers == 0) {
+		fprintf(stderr, "timerbench: out of memory\n");
+		exit(1);
+	}
+
+	printf("%-8s %10s %10s %10s %10s   (ns per timer)\n",
+	       "", "pending", "set", "reset", "expire");
+
+	for (i = 0; i < TW0_SIZE; i++)
+		queue_init(&timer_wheel.tw0[i]);
+	for (level = 0; level < TWN_LEVELS; level++)
+		for (i = 0; i < TWN_SIZE; i++)
+			queue_init(&timer_wheel.twn[level][i]);
+	bench("wheel", timers, pending, ops,
+	      wheel_set_timeout, wheel_reset_timeout, wheel_run);
+
+	/*
+	 *	Each insertion walks the list, so time fewer.
+	 */
+	queue_init(&timer_head.chain);
+	timer_head.ticks = ~0UL;
+	bench("list", timers, pending, ops / 100 + 1,
+	      list_set_timeout, list_reset_timeout, list_softclock);
+
+	exit(0);
+}
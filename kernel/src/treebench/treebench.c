@@ -0,0 +1,610 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	treebench/treebench.c
+ *
+ *	Checks the balanced tree of ipc/ipc_splay.c (included below)
+ *	against a reference set, then times it against the splay
+ *	tree it replaced.  The splay tree's lookup, insert and delete
+ *	are copied from the old ipc_splay.c, renamed splay_*.
+ *
+ *		cc -O -idirafter ../.. -o treebench treebench.c
+ *		treebench [operations]
+ *
+ *	The check does random inserts, deletes, lookups, bounds,
+ *	splits, joins and traversals, some deleting as they go, and
+ *	verifies the order and height invariants of the tree as it
+ *	goes.  Then, for trees of several sizes, the "rand" columns
+ *	time lookups of random names in the tree, the "hot" columns
+ *	lookups that cycle through 8 names, which favors the splay
+ *	tree, and the "ins/del" columns an insert and a delete of a
+ *	random name.  Every lookup is checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/*
+ *	Enough of mach/boolean.h, mach/port.h, kern/assert.h,
+ *	ipc/ipc_entry.h and ipc/ipc_splay.h for ipc_splay.c.
+ */
+#define	_MACH_BOOLEAN_H_
+#define	_MACH_PORT_H_
+#define	_KERN_ASSERT_H_
+#define	_IPC_IPC_ENTRY_H_
+#define	_IPC_IPC_SPLAY_H_
+
+typedef int		boolean_t;
+#define	TRUE		((boolean_t) 1)
+#define	FALSE		((boolean_t) 0)
+
+typedef unsigned int	mach_port_t;
+
+#define	assert(ex)							\
+	do {								\
+		if (!(ex)) {						\
+			fprintf(stderr, "treebench: %s, line %d: %s\n",	\
+				__FILE__, __LINE__, #ex);		\
+			exit(1);					\
+		}							\
+	} while (0)
+
+typedef struct ipc_tree_entry {
+	mach_port_t ite_name;
+	struct ipc_tree_entry *ite_lchild;
+	struct ipc_tree_entry *ite_rchild;
+	unsigned int ite_height;
+} *ipc_tree_entry_t;
+
+#define	ITE_NULL	((ipc_tree_entry_t) 0)
+
+typedef struct ipc_splay_tree {
+	ipc_tree_entry_t ist_root;	/* root of the tree */
+	ipc_tree_entry_t ist_next;	/* current entry of traversal */
+} *ipc_splay_tree_t;
+
+#define	ist_lock_init(splay)
+#define	ist_lock(splay)
+#define	ist_unlock(splay)
+
+int	nfreed;				/* entries freed by the tree */
+
+#define	ite_free(entry)		(nfreed++, free((char *) (entry)))
+
+#include "../../ipc/ipc_splay.c"
+
+/*
+ *	The splay tree, from the old ipc_splay.c.
+ */
+typedef struct splay_tree {
+	mach_port_t st_name;		/* name used in last lookup */
+	ipc_tree_entry_t st_root;	/* root of middle tree */
+	ipc_tree_entry_t st_ltree;	/* root of left tree */
+	ipc_tree_entry_t *st_ltreep;	/* pointer into left tree */
+	ipc_tree_entry_t st_rtree;	/* root of right tree */
+	ipc_tree_entry_t *st_rtreep;	/* pointer into right tree */
+} *splay_tree_t;
+
+static void
+splay_prim_lookup(name, tree, treep, ltreep, ltreepp, rtreep, rtreepp)
+	mach_port_t name;
+	ipc_tree_entry_t tree, *treep;
+	ipc_tree_entry_t *ltreep, **ltreepp;
+	ipc_tree_entry_t *rtreep, **rtreepp;
+{
+	mach_port_t tname;			/* temp name */
+	ipc_tree_entry_t lchild, rchild;	/* temp child pointers */
+
+#define	link_left					\
+MACRO_BEGIN						\
+	*ltreep = tree;					\
+	ltreep = &tree->ite_rchild;			\
+	tree = *ltreep;					\
+MACRO_END
+
+#define	link_right					\
+MACRO_BEGIN						\
+	*rtreep = tree;					\
+	rtreep = &tree->ite_lchild;			\
+	tree = *rtreep;					\
+MACRO_END
+
+#define rotate_left					\
+MACRO_BEGIN						\
+	ipc_tree_entry_t temp = tree;			\
+							\
+	tree = temp->ite_rchild;			\
+	temp->ite_rchild = tree->ite_lchild;		\
+	tree->ite_lchild = temp;			\
+MACRO_END
+
+#define rotate_right					\
+MACRO_BEGIN						\
+	ipc_tree_entry_t temp = tree;			\
+							\
+	tree = temp->ite_lchild;			\
+	temp->ite_lchild = tree->ite_rchild;		\
+	tree->ite_rchild = temp;			\
+MACRO_END
+
+	while (name != (tname = tree->ite_name)) {
+		if (name < tname) {
+			/* descend to left */
+
+			lchild = tree->ite_lchild;
+			if (lchild == ITE_NULL)
+				break;
+			tname = lchild->ite_name;
+
+			if ((name < tname) &&
+			    (lchild->ite_lchild != ITE_NULL))
+				rotate_right;
+			link_right;
+			if ((name > tname) &&
+			    (lchild->ite_rchild != ITE_NULL))
+				link_left;
+		} else {
+			/* descend to right */
+
+			rchild = tree->ite_rchild;
+			if (rchild == ITE_NULL)
+				break;
+			tname = rchild->ite_name;
+
+			if ((name > tname) &&
+			    (rchild->ite_rchild != ITE_NULL))
+				rotate_left;
+			link_left;
+			if ((name < tname) &&
+			    (rchild->ite_lchild != ITE_NULL))
+				link_right;
+		}
+	}
+
+	*treep = tree;
+	*ltreepp = ltreep;
+	*rtreepp = rtreep;
+
+#undef	link_left
+#undef	link_right
+#undef	rotate_left
+#undef	rotate_right
+}
+
+static void
+splay_prim_assemble(tree, ltree, ltreep, rtree, rtreep)
+	ipc_tree_entry_t tree;
+	ipc_tree_entry_t *ltree, *ltreep;
+	ipc_tree_entry_t *rtree, *rtreep;
+{
+	*ltreep = tree->ite_lchild;
+	*rtreep = tree->ite_rchild;
+
+	tree->ite_lchild = *ltree;
+	tree->ite_rchild = *rtree;
+}
+
+void
+splay_tree_init(splay)
+	splay_tree_t splay;
+{
+	splay->st_root = ITE_NULL;
+}
+
+ipc_tree_entry_t
+splay_tree_lookup(splay, name)
+	splay_tree_t splay;
+	mach_port_t name;
+{
+	ipc_tree_entry_t root;
+
+	root = splay->st_root;
+	if (root != ITE_NULL) {
+		if (splay->st_name != name) {
+			splay_prim_assemble(root,
+				&splay->st_ltree, splay->st_ltreep,
+				&splay->st_rtree, splay->st_rtreep);
+			splay_prim_lookup(name, root, &root,
+				&splay->st_ltree, &splay->st_ltreep,
+				&splay->st_rtree, &splay->st_rtreep);
+			splay->st_name = name;
+			splay->st_root = root;
+		}
+
+		if (name != root->ite_name)
+			root = ITE_NULL;
+	}
+
+	return root;
+}
+
+void
+splay_tree_insert(splay, name, entry)
+	splay_tree_t splay;
+	mach_port_t name;
+	ipc_tree_entry_t entry;
+{
+	ipc_tree_entry_t root;
+
+	root = splay->st_root;
+	if (root == ITE_NULL) {
+		entry->ite_lchild = ITE_NULL;
+		entry->ite_rchild = ITE_NULL;
+	} else {
+		if (splay->st_name != name) {
+			splay_prim_assemble(root,
+				&splay->st_ltree, splay->st_ltreep,
+				&splay->st_rtree, splay->st_rtreep);
+			splay_prim_lookup(name, root, &root,
+				&splay->st_ltree, &splay->st_ltreep,
+				&splay->st_rtree, &splay->st_rtreep);
+		}
+
+		if (name < root->ite_name) {
+			*splay->st_ltreep = ITE_NULL;
+			*splay->st_rtreep = root;
+		} else {
+			*splay->st_ltreep = root;
+			*splay->st_rtreep = ITE_NULL;
+		}
+
+		entry->ite_lchild = splay->st_ltree;
+		entry->ite_rchild = splay->st_rtree;
+	}
+
+	entry->ite_name = name;
+	splay->st_root = entry;
+	splay->st_name = name;
+	splay->st_ltreep = &splay->st_ltree;
+	splay->st_rtreep = &splay->st_rtree;
+}
+
+void
+splay_tree_delete(splay, name, entry)
+	splay_tree_t splay;
+	mach_port_t name;
+	ipc_tree_entry_t entry;
+{
+	ipc_tree_entry_t root, saved;
+
+	root = splay->st_root;
+
+	if (splay->st_name != name) {
+		splay_prim_assemble(root,
+			&splay->st_ltree, splay->st_ltreep,
+			&splay->st_rtree, splay->st_rtreep);
+		splay_prim_lookup(name, root, &root,
+			&splay->st_ltree, &splay->st_ltreep,
+			&splay->st_rtree, &splay->st_rtreep);
+	}
+
+	assert(root == entry);
+
+	*splay->st_ltreep = root->ite_lchild;
+	*splay->st_rtreep = root->ite_rchild;
+	ite_free(root);
+
+	root = splay->st_ltree;
+	saved = splay->st_rtree;
+
+	if (root == ITE_NULL)
+		root = saved;
+	else if (saved != ITE_NULL) {
+		splay_prim_lookup(MACH_PORT_LARGEST, root, &root,
+			&splay->st_ltree, &splay->st_ltreep,
+			&splay->st_rtree, &splay->st_rtreep);
+		splay_prim_assemble(root,
+			&splay->st_ltree, splay->st_ltreep,
+			&splay->st_rtree, splay->st_rtreep);
+		root->ite_rchild = saved;
+	}
+
+	splay->st_root = root;
+	if (root != ITE_NULL) {
+		splay->st_name = root->ite_name;
+		splay->st_ltreep = &splay->st_ltree;
+		splay->st_rtreep = &splay->st_rtree;
+	}
+}
+
+static unsigned long	seed = 1;
+
+mach_port_t
+random_next()
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+#define	random_name()	((random_next() << 15) | random_next())
+
+ipc_tree_entry_t
+entry_alloc()
+{
+	ipc_tree_entry_t entry;
+
+	entry = (ipc_tree_entry_t) malloc(sizeof *entry);
+	if (entry == ITE_NULL) {
+		fprintf(stderr, "treebench: out of memory\n");
+		exit(1);
+	}
+	return (entry);
+}
+
+/*
+ *	Verify the order and height invariants of a subtree whose
+ *	names lie in [low, high]; returns its height and adds its
+ *	size to *countp.
+ */
+unsigned int
+check_tree(tree, low, high, countp)
+	ipc_tree_entry_t tree;
+	mach_port_t low, high;
+	int *countp;
+{
+	unsigned int lheight, rheight;
+
+	if (tree == ITE_NULL)
+		return (0);
+	assert(low <= tree->ite_name && tree->ite_name <= high);
+	lheight = (tree->ite_lchild == ITE_NULL) ? 0 :
+		check_tree(tree->ite_lchild, low, tree->ite_name - 1, countp);
+	rheight = (tree->ite_rchild == ITE_NULL) ? 0 :
+		check_tree(tree->ite_rchild, tree->ite_name + 1, high, countp);
+	assert(lheight <= rheight + 1 && rheight <= lheight + 1);
+	assert(tree->ite_height == ((lheight > rheight) ? lheight : rheight) + 1);
+	(*countp)++;
+	return (tree->ite_height);
+}
+
+int
+tree_size(splay)
+	ipc_splay_tree_t splay;
+{
+	int count = 0;
+
+	(void) check_tree(splay->ist_root, MACH_PORT_SMALLEST,
+			  MACH_PORT_LARGEST, &count);
+	return (count);
+}
+
+#define	NCHECK		20000		/* names in the check */
+
+char	present[NCHECK];		/* reference set */
+
+void
+check(ops)
+	long ops;
+{
+	struct ipc_splay_tree tree, small;
+	ipc_tree_entry_t entry;
+	mach_port_t name, lower, upper, last;
+	long i;
+	int n, op, count;
+
+	ipc_splay_tree_init(&tree);
+	n = 0;
+	for (i = 0; i < ops; i++) {
+		name = random_name() % NCHECK;
+		op = random_next() % 10;
+		if (op < 5) {
+			if (!present[name]) {
+				ipc_splay_tree_insert(&tree, name, entry_alloc());
+				present[name] = 1;
+				n++;
+			}
+		} else if (op < 8) {
+			entry = ipc_splay_tree_lookup(&tree, name);
+			assert((entry != ITE_NULL) == present[name]);
+			if (entry != ITE_NULL) {
+				assert(entry->ite_name == name);
+				ipc_splay_tree_delete(&tree, name, entry);
+				present[name] = 0;
+				n--;
+			}
+		} else if (op < 9) {
+			ipc_splay_tree_bounds(&tree, name, &lower, &upper);
+			for (last = name; last != MACH_PORT_LARGEST; last--)
+				if (present[last])
+					break;
+			assert(lower == last);
+			for (last = name; last < NCHECK; last++)
+				if (present[last])
+					break;
+			assert(upper == ((last < NCHECK) ? last : MACH_PORT_SMALLEST));
+		} else {
+			ipc_splay_tree_split(&tree, name, &small);
+			count = 0;
+			for (entry = ipc_splay_traverse_start(&small);
+			     entry != ITE_NULL;
+			     entry = ipc_splay_traverse_next(&small, FALSE)) {
+				assert(entry->ite_name < name);
+				count++;
+			}
+			ipc_splay_traverse_finish(&small);
+			assert(count == tree_size(&small));
+			assert(count + tree_size(&tree) == n);
+			ipc_splay_tree_join(&tree, &small);
+		}
+		if ((i % 1000) == 0)
+			assert(tree_size(&tree) == n);
+	}
+	assert(tree_size(&tree) == n);
+
+	/*
+	 *	Traverse, deleting the odd names, then delete the rest.
+	 */
+	count = 0;
+	last = 0;
+	for (entry = ipc_splay_traverse_start(&tree);
+	     entry != ITE_NULL;
+	     entry = ipc_splay_traverse_next(&tree, (name & 1))) {
+		name = entry->ite_name;
+		assert(count == 0 || name > last);
+		last = name;
+		count++;
+		if (name & 1) {
+			present[name] = 0;
+			n--;
+		}
+	}
+	ipc_splay_traverse_finish(&tree);
+	assert(tree_size(&tree) == n);
+	printf("check: %ld operations, %d names, height %u\n",
+	       ops, count, (tree.ist_root == ITE_NULL) ? 0 :
+			   tree.ist_root->ite_height);
+
+	for (entry = ipc_splay_traverse_start(&tree);
+	     entry != ITE_NULL;
+	     entry = ipc_splay_traverse_next(&tree, TRUE))
+		present[entry->ite_name] = 0;
+	ipc_splay_traverse_finish(&tree);
+	assert(tree.ist_root == ITE_NULL);
+}
+
+double
+nsecs(start, end, count)
+	struct timeval *start, *end;
+	long count;
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000.0 +
+		(end->tv_usec - start->tv_usec)) * 1000.0 / count;
+}
+
+#define	NHOT		8		/* names in the hot set */
+
+void
+bench(n, count)
+	int n;
+	long count;
+{
+	struct ipc_splay_tree avl;
+	struct splay_tree splay;
+	mach_port_t *names;
+	ipc_tree_entry_t entry;
+	struct timeval start, end;
+	double avl_rand, splay_rand, avl_hot, splay_hot, avl_upd, splay_upd;
+	mach_port_t name;
+	long i;
+	int j;
+
+	names = (mach_port_t *) malloc(n * sizeof *names);
+	ipc_splay_tree_init(&avl);
+	splay_tree_init(&splay);
+
+	/*
+	 *	Even names are in the trees, so an odd name never is.
+	 */
+	for (j = 0; j < n; j++) {
+		do
+			name = random_name() << 1;
+		while (ipc_splay_tree_lookup(&avl, name) != ITE_NULL);
+		names[j] = name;
+		ipc_splay_tree_insert(&avl, name, entry_alloc());
+		splay_tree_insert(&splay, name, entry_alloc());
+	}
+
+#define	TIME(result, lookup, tree, index)				\
+	gettimeofday(&start, (struct timezone *) 0);			\
+	for (i = 0; i < count; i++) {					\
+		name = names[(index)];					\
+		entry = lookup((tree), name);				\
+		if (entry == ITE_NULL || entry->ite_name != name) {	\
+			fprintf(stderr, "treebench: bad lookup\n");	\
+			exit(1);					\
+		}							\
+	}								\
+	gettimeofday(&end, (struct timezone *) 0);			\
+	(result) = nsecs(&start, &end, count)
+
+	TIME(avl_rand, ipc_splay_tree_lookup, &avl, (i * 7919) % n);
+	TIME(splay_rand, splay_tree_lookup, &splay, (i * 7919) % n);
+	TIME(avl_hot, ipc_splay_tree_lookup, &avl, i % NHOT);
+	TIME(splay_hot, splay_tree_lookup, &splay, i % NHOT);
+
+#undef	TIME
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++) {
+		name = names[(i * 7919) % n] + 1;
+		entry = entry_alloc();
+		ipc_splay_tree_insert(&avl, name, entry);
+		ipc_splay_tree_delete(&avl, name, entry);
+	}
+	gettimeofday(&end, (struct timezone *) 0);
+	avl_upd = nsecs(&start, &end, count);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < count; i++) {
+		name = names[(i * 7919) % n] + 1;
+		entry = entry_alloc();
+		splay_tree_insert(&splay, name, entry);
+		splay_tree_delete(&splay, name, entry);
+	}
+	gettimeofday(&end, (struct timezone *) 0);
+	splay_upd = nsecs(&start, &end, count);
+
+	assert(tree_size(&avl) == n);
+
+	printf("%8d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n", n,
+	       avl_rand, splay_rand, avl_hot, splay_hot, avl_upd, splay_upd);
+
+	for (entry = ipc_splay_traverse_start(&avl);
+	     entry != ITE_NULL;
+	     entry = ipc_splay_traverse_next(&avl, TRUE))
+		continue;
+	ipc_splay_traverse_finish(&avl);
+	while (splay.st_root != ITE_NULL)
+		splay_tree_delete(&splay, splay.st_root->ite_name,
+				  splay.st_root);
+	free((char *) names);
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	long count;
+	int n;
+
+	count = (argc > 1) ? atol(argv[1]) : 1000000;
+	if (count <= 0) {
+		fprintf(stderr, "usage: treebench [operations]\n");
+		exit(2);
+	}
+
+	check(count / 5);
+
+	printf("%8s %17s %17s %17s   (ns per operation)\n",
+	       "", "rand", "hot", "ins/del");
+	printf("%8s %8s %8s %8s %8s %8s %8s\n", "entries",
+	       "avl", "splay", "avl", "splay", "avl", "splay");
+	for (n = 16; n <= 262144; n *= 8)
+		bench(n, count);
+	exit(0);
+}
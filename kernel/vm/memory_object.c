@@ -509,7 +509,7 @@ retry_lookup:
 		vm_page_insert(data_m, object, offset);
 
 		if (was_absent)
-			vm_page_activate(data_m);
+			vm_page_admit(data_m);
 		else
 			vm_page_deactivate(data_m);
 
@@ -1196,9 +1196,22 @@ memory_object_set_attributes_common(object, object_ready, may_cache,
 	memory_object_copy_strategy_t copy_strategy;
 	boolean_t use_old_pageout;
 {
+	unsigned int	cluster;
+
 	if (object == VM_OBJECT_NULL)
 		return(KERN_INVALID_ARGUMENT);
 
+	/*
+	 *	Separate the data request size the pager will take
+	 *	(see MEMORY_OBJECT_CLUSTER) from the copy strategy.
+	 */
+
+	cluster = (copy_strategy & MEMORY_OBJECT_CLUSTER_MASK) >>
+			MEMORY_OBJECT_CLUSTER_SHIFT;
+	if (cluster == 0)
+		cluster = 1;
+	copy_strategy &= ~MEMORY_OBJECT_CLUSTER_MASK;
+
 	/*
 	 *	Verify the attributes of importance
 	 */
@@ -1237,6 +1250,7 @@ memory_object_set_attributes_common(object, object_ready, may_cache,
 
 	object->can_persist = may_cache;
 	object->pager_ready = object_ready;
+	object->pager_cluster = cluster;
 	if (copy_strategy == MEMORY_OBJECT_COPY_TEMPORARY) {
 		object->temporary = TRUE;
 	} else {
@@ -566,3 +566,51 @@ host_virtual_physical_table_info(host, infop, countp)
 
 	return KERN_SUCCESS;
 }
+
+/*
+ *	Routine:	host_vm_page_free_info
+ *	Purpose:
+ *		Return the free page list lock counts and the
+ *		state of the per-processor free page pools.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ */
+
+kern_return_t
+host_vm_page_free_info(host, infop)
+	host_t host;
+	vm_page_free_info_t *infop;
+{
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	vm_page_free_info(infop);
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	host_vm_pageout_info
+ *	Purpose:
+ *		Return the pageout daemon's clean-and-free
+ *		rate and clustering counts.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ */
+
+kern_return_t
+host_vm_pageout_info(host, infop)
+	host_t host;
+	vm_pageout_info_t *infop;
+{
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	vm_pageout_info(infop);
+	return KERN_SUCCESS;
+}
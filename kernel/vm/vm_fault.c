@@ -280,6 +280,7 @@ typedef struct vm_fault_state {
 	struct vm_object *vmf_object;
 	vm_offset_t vmf_offset;
 	vm_prot_t vmf_prot;
+	vm_behavior_t vmf_behavior;
 
 	boolean_t vmfp_backoff;
 	struct vm_object *vmfp_object;
@@ -292,6 +293,20 @@ zone_t		vm_fault_state_zone = 0;
 
 int		vm_object_absent_max = 50;
 
+/*
+ *	Limits, in pages, on clustered data requests (vm_fault_cluster)
+ *	and on fault-around (vm_fault_around).  A limit of one page
+ *	turns the feature off.
+ */
+int		vm_fault_cluster_max = 8;
+int		vm_fault_around_max = 8;
+
+/*
+ *	In sequential regions, pages more than vm_fault_behind_lag
+ *	pages behind a fault are deactivated (see vm_fault_behind).
+ */
+int		vm_fault_behind_lag = 16;
+
 int		vm_fault_debug = 0;
 
 boolean_t	vm_fault_dirty_handling = FALSE;
@@ -372,6 +387,98 @@ vm_fault_cleanup(object, top_page)
 #endif	/* MACH_PCSAMPLE */
 
 
+/*
+ *	Routine:	vm_fault_cluster
+ *	Purpose:
+ *		Decide how much of an object to request from its
+ *		pager, given that the page at "offset" is missing
+ *		and has already been marked absent.  Only pagers
+ *		that asked for it (see MEMORY_OBJECT_CLUSTER) are
+ *		sent more than one page at a time.
+ *
+ *		Each object remembers where a sequential reader
+ *		would fault next.  A fault there doubles the
+ *		request, up to the smaller of the pager's limit
+ *		and vm_fault_cluster_max pages; any other fault
+ *		starts over at one page.  Sequential regions start
+ *		at the largest request, and random ones are never
+ *		clustered.
+ *
+ *		The pages following "offset" are entered in the
+ *		object absent and busy, like the faulting page,
+ *		so that other faults on them wait for the data.
+ *		The request stops short at a resident page, at a
+ *		page the pager is known not to have, and when the
+ *		object has too many requests outstanding.  Like
+ *		the faulting page, the extra pages are real pages
+ *		for the default pager.
+ *	Conditions:
+ *		The object is locked, and is left locked.
+ *	Results:
+ *		The length of the data request, in bytes.
+ */
+vm_size_t vm_fault_cluster(object, offset, behavior)
+	register vm_object_t	object;
+	vm_offset_t		offset;
+	vm_behavior_t		behavior;
+{
+	register vm_page_t	m;
+	register vm_offset_t	end;
+	register vm_offset_t	off;
+	unsigned int		max;
+	unsigned int		window;
+
+	max = object->pager_cluster;
+	if (max > vm_fault_cluster_max)
+		max = vm_fault_cluster_max;
+	if ((behavior == VM_BEHAVIOR_RANDOM) || (max <= 1))
+		return(PAGE_SIZE);
+
+	if (behavior == VM_BEHAVIOR_SEQUENTIAL)
+		window = max;
+	else if (offset == object->pagein_next) {
+		window = object->pagein_window * 2;
+		if (window > max)
+			window = max;
+	} else
+		window = 1;
+
+	end = offset + ptoa(window);
+	if (end > object->size)
+		end = object->size;
+
+	for (off = offset + PAGE_SIZE; off < end; off += PAGE_SIZE) {
+		if (object->absent_count >= vm_object_absent_max)
+			break;
+		if (vm_page_lookup(object, off) != VM_PAGE_NULL)
+			break;
+#if	MACH_PAGEMAP
+		if (vm_external_state_get(object->existence_info,
+					  off + object->paging_offset) ==
+		    VM_EXTERNAL_STATE_ABSENT)
+			break;
+#endif	MACH_PAGEMAP
+
+		m = vm_page_grab_fictitious();
+		if (m == VM_PAGE_NULL)
+			break;
+		if (object->internal && !vm_page_convert(m)) {
+			vm_page_release_fictitious(m);
+			break;
+		}
+
+		vm_page_lock_queues();
+		vm_page_insert(m, object, off);
+		vm_page_unlock_queues();
+
+		m->absent = TRUE;
+		object->absent_count++;
+	}
+
+	object->pagein_next = off;
+	object->pagein_window = atop(off - offset);
+	return(off - offset);
+}
 
 /*
  *	Routine:	vm_fault_page
@@ -392,6 +499,10 @@ vm_fault_cleanup(object, top_page)
  *		or thread_terminate), then the "interruptible"
  *		parameter should be asserted.
  *
+ *		The expected access pattern of the region being
+ *		faulted, given in "behavior", determines how many
+ *		pages are requested from an external pager at once.
+ *
  *	Results:
  *		The page containing the proper data is returned
  *		in "result_page".
@@ -414,7 +525,7 @@ vm_fault_cleanup(object, top_page)
  */
 vm_fault_return_t vm_fault_page(first_object, first_offset,
 				fault_type, must_be_resident, interruptible,
-				protection,
+				behavior, protection,
 				result_page, top_page,
 				resume, continuation)
  /* Arguments: */
@@ -423,6 +534,7 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 	vm_prot_t	fault_type;	/* What access is requested */
 	boolean_t	must_be_resident;/* Must page be resident? */
 	boolean_t	interruptible;	/* May fault be interrupted? */
+	vm_behavior_t	behavior;	/* Expected access pattern */
  /* Modifies in place: */
 	vm_prot_t	*protection;	/* Protection for mapping */
  /* Returns: */
@@ -445,6 +557,7 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 	vm_object_t	copy_object;
 	boolean_t	look_for_page;
 	vm_prot_t	access_required;
+	vm_size_t	length;
 
 	if (resume) {
 		register vm_fault_state_t *state =
@@ -846,6 +959,8 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 			m->absent = TRUE;
 			object->absent_count++;
 
+			length = vm_fault_cluster(object, offset, behavior);
+
 			/*
 			 *	We have a busy page, so we can
 			 *	release the object lock.
@@ -862,23 +977,34 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 			if ((rc = memory_object_data_request(object->pager, 
 				object->pager_request,
 				m->offset + object->paging_offset, 
-				PAGE_SIZE, access_required)) != KERN_SUCCESS) {
+				length, access_required)) != KERN_SUCCESS) {
+				register vm_offset_t	off;
+				register vm_page_t	p;
+
 				if (rc != MACH_SEND_INTERRUPTED)
 					printf("%s(0x%x, 0x%x, 0x%x, 0x%x, 0x%x) failed, %d\n",
 						"memory_object_data_request",
 						object->pager,
 						object->pager_request,
 						m->offset + object->paging_offset, 
-						PAGE_SIZE, access_required, rc);
+						length, access_required, rc);
 				/*
-				 *	Don't want to leave a busy page around,
+				 *	Don't want to leave busy pages around,
 				 *	but the data request may have blocked,
-				 *	so check if it's still there and busy.
+				 *	so check if they are still there and busy.
 				 */
 				vm_object_lock(object);
 				if (m == vm_page_lookup(object,offset) &&
 				    m->absent && m->busy)
 					VM_PAGE_FREE(m);
+				for (off = offset + PAGE_SIZE;
+				     off < offset + length;
+				     off += PAGE_SIZE) {
+					p = vm_page_lookup(object, off);
+					if (p != VM_PAGE_NULL &&
+					    p->absent && p->busy)
+						VM_PAGE_FREE(p);
+				}
 				vm_fault_cleanup(object, first_m);
 				return((rc == MACH_SEND_INTERRUPTED) ?
 					VM_FAULT_INTERRUPTED :
@@ -1320,6 +1446,126 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 #undef	RELEASE_PAGE
 }
 
+/*
+ *	Routine:	vm_fault_around
+ *	Purpose:
+ *		Enter the resident neighbours of a page that has
+ *		just been faulted in, so that a scan through a
+ *		region takes one fault per window rather than one
+ *		per page.  The window is vm_fault_around_max pages,
+ *		aligned around the fault, or following it in a
+ *		sequential region.
+ *
+ *		Only pages of the top-level object that need no
+ *		further work are entered, and never for writing,
+ *		so copy-on-write and the pager's lock requests
+ *		are still handled by real faults.  Addresses that
+ *		are already mapped are left alone.
+ *	Conditions:
+ *		The map is locked for reading, by vm_map_verify.
+ *		The object is unlocked, but referenced.
+ */
+void vm_fault_around(map, vaddr, object, offset, prot, behavior)
+	vm_map_t	map;
+	vm_offset_t	vaddr;
+	vm_object_t	object;
+	vm_offset_t	offset;
+	vm_prot_t	prot;
+	vm_behavior_t	behavior;
+{
+	vm_map_entry_t		entry;
+	register vm_offset_t	va;
+	vm_offset_t		start, end;
+	register vm_page_t	m;
+
+	if (!vm_map_lookup_entry(map, vaddr, &entry) || entry->is_sub_map)
+		return;
+
+	if (behavior == VM_BEHAVIOR_SEQUENTIAL)
+		start = vaddr;
+	else
+		start = vaddr - ptoa(atop(vaddr) % vm_fault_around_max);
+	end = start + ptoa(vm_fault_around_max);
+
+	if (start < entry->vme_start)
+		start = entry->vme_start;
+	if (end > entry->vme_end || end < start)
+		end = entry->vme_end;
+
+	prot &= ~VM_PROT_WRITE;
+
+	for (va = start; va < end; va += PAGE_SIZE) {
+		if (va == vaddr || pmap_extract(map->pmap, va) != 0)
+			continue;
+
+		vm_object_lock(object);
+		m = vm_page_lookup(object, offset + (va - vaddr));
+		if ((m == VM_PAGE_NULL) || m->busy || m->absent ||
+		    m->error || m->fictitious || (prot & m->page_lock)) {
+			vm_object_unlock(object);
+			continue;
+		}
+
+		/*
+		 *	Hold the page busy while it is entered,
+		 *	since pmap_enter may block.
+		 */
+		m->busy = TRUE;
+		vm_object_unlock(object);
+
+		PMAP_ENTER(map->pmap, va, m, prot, FALSE);
+
+		vm_object_lock(object);
+		vm_page_lock_queues();
+		if (software_reference_bits) {
+			if (!m->active && !m->inactive)
+				vm_page_activate(m);
+			m->reference = TRUE;
+		} else {
+			vm_page_activate(m);
+		}
+		vm_page_unlock_queues();
+		PAGE_WAKEUP_DONE(m);
+		vm_object_unlock(object);
+	}
+}
+
+/*
+ *	Routine:	vm_fault_behind
+ *	Purpose:
+ *		Deactivate the pages a sequential reader has left
+ *		behind, so that the pageout daemon reclaims them
+ *		before pages that are still in use.  The window of
+ *		vm_fault_around_max pages that ends
+ *		vm_fault_behind_lag pages before the fault is
+ *		deactivated; touching one of its pages again
+ *		reactivates it as usual.
+ *	Conditions:
+ *		The object and the page queues are locked.
+ */
+void vm_fault_behind(object, offset)
+	register vm_object_t	object;
+	vm_offset_t		offset;
+{
+	register vm_offset_t	off;
+	vm_offset_t		start;
+	register vm_page_t	m;
+
+	if (offset < ptoa(vm_fault_behind_lag))
+		return;
+	off = offset - ptoa(vm_fault_behind_lag);
+	start = (off > ptoa(vm_fault_around_max)) ?
+			off - ptoa(vm_fault_around_max) : 0;
+
+	while (off > start) {
+		off -= PAGE_SIZE;
+		m = vm_page_lookup(object, off);
+		if ((m != VM_PAGE_NULL) && m->active && !m->busy &&
+		    (m->wire_count == 0))
+			vm_page_deactivate(m);
+	}
+}
+
 /*
  *	Routine:	vm_fault
  *	Purpose:
@@ -1368,7 +1614,9 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 	vm_object_t		object;		/* Top-level object */
 	vm_offset_t		offset;		/* Top-level offset */
 	vm_prot_t		prot;		/* Protection for mapping */
+	vm_behavior_t		behavior;	/* Expected access pattern */
 	vm_object_t		old_copy_object; /* Saved copy object */
+	vm_object_t		page_object;	/* Object of result page */
 	vm_page_t		result_page;	/* Result of vm_fault_page */
 	vm_page_t		top_page;	/* Placeholder page */
 	kern_return_t		kr;
@@ -1392,10 +1640,11 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 		wired = state->vmf_wired;
 		offset = state->vmf_offset;
 		prot = state->vmf_prot;
+		behavior = state->vmf_behavior;
 
 		kr = vm_fault_page(object, offset, fault_type,
 				(change_wiring && !wired), !change_wiring,
-				&prot, &result_page, &top_page,
+				behavior, &prot, &result_page, &top_page,
 				TRUE, vm_fault_continue);
 		goto after_vm_fault_page;
 	}
@@ -1428,7 +1677,7 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 
 	if ((kr = vm_map_lookup(&map, vaddr, fault_type, &version,
 				&object, &offset,
-				&prot, &wired)) != KERN_SUCCESS) {
+				&prot, &wired, &behavior)) != KERN_SUCCESS) {
 		goto done;
 	}
 
@@ -1472,15 +1721,16 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 		state->vmf_object = object;
 		state->vmf_offset = offset;
 		state->vmf_prot = prot;
+		state->vmf_behavior = behavior;
 
 		kr = vm_fault_page(object, offset, fault_type,
 				   (change_wiring && !wired), !change_wiring,
-				   &prot, &result_page, &top_page,
+				   behavior, &prot, &result_page, &top_page,
 				   FALSE, vm_fault_continue);
 	} else {
 		kr = vm_fault_page(object, offset, fault_type,
 				   (change_wiring && !wired), !change_wiring,
-				   &prot, &result_page, &top_page,
+				   behavior, &prot, &result_page, &top_page,
 				   FALSE, (void (*)()) 0);
 	}
     after_vm_fault_page:
@@ -1589,7 +1839,7 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 		kr = vm_map_lookup(&map, vaddr,
 				   fault_type & ~VM_PROT_WRITE, &version,
 				   &retry_object, &retry_offset, &retry_prot,
-				   &wired);
+				   &wired, &behavior);
 
 		if (kr != KERN_SUCCESS) {
 			vm_object_lock(m->object);
@@ -1654,6 +1904,14 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 
 	PMAP_ENTER(map->pmap, vaddr, m, prot, wired);
 
+	/*
+	 *	Map the resident neighbours of the page as well,
+	 *	while the map is still verified.
+	 */
+	if (!change_wiring && !wired && (m->object == object) &&
+	    (behavior != VM_BEHAVIOR_RANDOM) && (vm_fault_around_max > 1))
+		vm_fault_around(map, vaddr, object, offset, prot, behavior);
+
 	/*
 	 *	If the page is not wired down and isn't already
 	 *	on a pageout queue, then put it where the
@@ -1673,16 +1931,36 @@ kern_return_t vm_fault(map, vaddr, fault_type, change_wiring,
 	} else {
 		vm_page_activate(m);
 	}
+	if (!change_wiring && (behavior == VM_BEHAVIOR_SEQUENTIAL))
+		vm_fault_behind(m->object, m->offset);
 	vm_page_unlock_queues();
 
 	/*
 	 *	Unlock everything, and return
 	 */
 
+	page_object = m->object;
 	vm_map_verify_done(map, &version);
 	PAGE_WAKEUP_DONE(m);
 	kr = KERN_SUCCESS;
-	UNLOCK_AND_DEALLOCATE;
+
+	/*
+	 *	Keep a sequential reader ahead of its faults by
+	 *	starting the next window in now.  The data requests
+	 *	may block, so they are made with the map and the
+	 *	page released; the paging reference, which is
+	 *	still held, keeps the objects from being collapsed
+	 *	or terminated meanwhile.
+	 */
+	if (!change_wiring && !wired && (behavior == VM_BEHAVIOR_SEQUENTIAL)) {
+		vm_object_unlock(page_object);
+		vm_object_willneed(object, offset + PAGE_SIZE,
+				   offset + ptoa(vm_fault_cluster_max));
+		vm_object_lock(page_object);
+	}
+
+	vm_fault_cleanup(page_object, top_page);
+	vm_object_deallocate(object);
 
 #undef	UNLOCK_AND_DEALLOCATE
 #undef	RELEASE_PAGE
@@ -1785,7 +2063,7 @@ void vm_fault_unwire(map, entry)
 						entry->offset +
 						  (va - entry->vme_start),
 						VM_PROT_NONE, TRUE,
-						FALSE, &prot,
+						FALSE, entry->behavior, &prot,
 						&result_page,
 						&top_page,
 						FALSE, (void (*)()) 0);
@@ -2080,6 +2358,7 @@ kern_return_t	vm_fault_copy(
 
 			switch (vm_fault_page(src_object, src_offset,
 					VM_PROT_READ, FALSE, interruptible,
+					VM_BEHAVIOR_DEFAULT,
 					&prot, &result_page, &src_top_page,
 					FALSE, (void (*)()) 0)) {
 
@@ -2118,6 +2397,7 @@ kern_return_t	vm_fault_copy(
 
 		switch (vm_fault_page(dst_object, dst_offset, VM_PROT_WRITE,
 				FALSE, FALSE /* interruptible */,
+				VM_BEHAVIOR_DEFAULT,
 				&prot, &result_page, &dst_top_page,
 				FALSE, (void (*)()) 0)) {
 
@@ -64,6 +64,8 @@
 #define _VM_VM_FAULT_H_
 
 #include <mach/kern_return.h>
+#include <mach/vm_behavior.h>
+#include <mach/machine/vm_types.h>
 
 /*
  *	Page fault handling based on vm_object only.
@@ -79,6 +81,9 @@ typedef	kern_return_t	vm_fault_return_t;
 
 extern void vm_fault_init();
 extern vm_fault_return_t vm_fault_page();
+extern vm_size_t	vm_fault_cluster();
+
+extern int		vm_object_absent_max;
 
 extern void		vm_fault_cleanup();
 /*
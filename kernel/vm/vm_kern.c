@@ -450,6 +450,42 @@ projected_buffer_deallocate(map, start, end)
 }
 
 
+/*
+ *	projected_buffer_release
+ *
+ *	Give up the kernel's hold on a persistent projected buffer.
+ *      The buffer is deleted now if no task has it mapped, or
+ *      else by projected_buffer_deallocate of the last mapping.
+ *      Returns TRUE if it was deleted now.
+ */
+
+boolean_t
+projected_buffer_release(kernel_addr)
+	vm_offset_t kernel_addr;
+{
+	vm_map_entry_t k_entry;
+	boolean_t deleted;
+
+	vm_map_lock(kernel_map);
+	if (!vm_map_lookup_entry(kernel_map, kernel_addr, &k_entry) ||
+	    k_entry->projected_on != 0) {
+	  vm_map_unlock(kernel_map);
+	  return(FALSE);
+	}
+
+	deleted = (k_entry->object.vm_object->ref_count == 1);
+	if (deleted) {
+	  if (kernel_map->first_free == k_entry)
+	    kernel_map->first_free = k_entry->vme_prev;
+	  vm_map_entry_delete(kernel_map, k_entry);
+	} else
+	  k_entry->projected_on = (vm_map_entry_t) -1;
+              /*Now deleted with the last user mapping*/
+	vm_map_unlock(kernel_map);
+	return(deleted);
+}
+
+
 /*
  *	projected_buffer_collect
  *
@@ -96,6 +96,7 @@ extern kern_return_t    projected_buffer_allocate();
 extern kern_return_t    projected_buffer_deallocate();
 extern kern_return_t    projected_buffer_map();
 extern kern_return_t    projected_buffer_collect();
+extern boolean_t	projected_buffer_release();
 
 extern void		kmem_init();
 
@@ -542,7 +542,9 @@ MACRO_END
  *	Synchronization is required prior to most operations.
  *
  *	Maps consist of an ordered doubly-linked list of simple
- *	entries; a single hint is used to speed up lookups.
+ *	entries; a single hint is used to speed up lookups.  The
+ *	entries are also indexed by a red-black tree, which is
+ *	consulted when the hint does not match.
  *
  *	Sharing maps have been deleted from this version of Mach.
  *	All shared objects are now mapped directly into the respective
@@ -664,6 +666,7 @@ vm_map_t vm_map_create(pmap, min, max, pageable)
 
 	vm_map_first_entry(result) = vm_map_to_entry(result);
 	vm_map_last_entry(result)  = vm_map_to_entry(result);
+	rbtree_init(&result->hdr.tree);
 	result->hdr.nentries = 0;
 	result->hdr.entries_pageable = pageable;
 
@@ -742,7 +745,18 @@ void _vm_map_entry_dispose(map_header, entry)
  *	vm_map_entry_{un,}link:
  *
  *	Insert/remove entries from maps (or map copies).
+ *
+ *	The entry tree is kept in step with the list.  Insertion
+ *	is done relative to the list predecessor, so no addresses
+ *	are compared; the header itself is not in the tree.
  */
+#define	vm_map_entry_tree_node(hdr, entry)			\
+	(((entry) == (struct vm_map_entry *) &(hdr)->links) ?	\
+	 RBTREE_NODE_NULL : &(entry)->tree_node)
+
+#define	vm_map_tree_entry(node)					\
+	rbtree_entry((node), struct vm_map_entry, tree_node)
+
 #define vm_map_entry_link(map, after_where, entry)	\
 	_vm_map_entry_link(&(map)->hdr, after_where, entry)
 
@@ -756,6 +770,9 @@ void _vm_map_entry_dispose(map_header, entry)
 	(entry)->vme_next = (after_where)->vme_next;	\
 	(entry)->vme_prev->vme_next =			\
 	 (entry)->vme_next->vme_prev = (entry);		\
+	rbtree_insert_after(&(hdr)->tree,		\
+		vm_map_entry_tree_node((hdr), (after_where)), \
+		&(entry)->tree_node);			\
 	MACRO_END
 
 #define vm_map_entry_unlink(map, entry)			\
@@ -769,6 +786,7 @@ void _vm_map_entry_dispose(map_header, entry)
 	(hdr)->nentries--;				\
 	(entry)->vme_next->vme_prev = (entry)->vme_prev; \
 	(entry)->vme_prev->vme_next = (entry)->vme_next; \
+	rbtree_remove(&(hdr)->tree, &(entry)->tree_node); \
 	MACRO_END
 
 /*
@@ -846,69 +864,50 @@ boolean_t vm_map_lookup_entry(map, address, entry)
 	vm_map_entry_t		*entry;		/* OUT */
 {
 	register vm_map_entry_t		cur;
-	register vm_map_entry_t		last;
+	register vm_map_entry_t		tmp;
+	register rbtree_node_t		node;
 
 	/*
-	 *	Start looking either from the head of the
-	 *	list, or from the hint.
+	 *	First, make a quick check to see if the hint
+	 *	is the entry we want (which is usually the case).
+	 *	We don't need to save the hint here... it is
+	 *	the same hint.
 	 */
 
 	simple_lock(&map->hint_lock);
 	cur = map->hint;
 	simple_unlock(&map->hint_lock);
 
-	if (cur == vm_map_to_entry(map))
-		cur = cur->vme_next;
-
-	if (address >= cur->vme_start) {
-	    	/*
-		 *	Go from hint to end of list.
-		 *
-		 *	But first, make a quick check to see if
-		 *	we are already looking at the entry we
-		 *	want (which is usually the case).
-		 *	Note also that we don't need to save the hint
-		 *	here... it is the same hint (unless we are
-		 *	at the header, in which case the hint didn't
-		 *	buy us anything anyway).
-		 */
-		last = vm_map_to_entry(map);
-		if ((cur != last) && (cur->vme_end > address)) {
-			*entry = cur;
-			return(TRUE);
-		}
-	}
-	else {
-	    	/*
-		 *	Go from start to hint, *inclusively*
-		 */
-		last = cur->vme_next;
-		cur = vm_map_first_entry(map);
+	if ((cur != vm_map_to_entry(map)) &&
+	    (address >= cur->vme_start) && (address < cur->vme_end)) {
+		*entry = cur;
+		return(TRUE);
 	}
 
 	/*
-	 *	Search linearly
+	 *	Otherwise descend the entry tree, remembering the
+	 *	last entry that starts at or below the address.
+	 *	If there is none, the address precedes the first
+	 *	entry and the header is returned.
 	 */
 
-	while (cur != last) {
-		if (cur->vme_end > address) {
-			if (address >= cur->vme_start) {
-			    	/*
-				 *	Save this lookup for future
-				 *	hints, and return
-				 */
-
-				*entry = cur;
-				SAVE_HINT(map, cur);
-				return(TRUE);
-			}
-			break;
+	cur = vm_map_to_entry(map);
+	node = rbtree_root(&map->hdr.tree);
+	while (node != RBTREE_NODE_NULL) {
+		tmp = vm_map_tree_entry(node);
+		if (address < tmp->vme_start)
+			node = node->left;
+		else {
+			cur = tmp;
+			if (address < tmp->vme_end)
+				break;
+			node = node->right;
 		}
-		cur = cur->vme_next;
 	}
-	*entry = cur->vme_prev;
-	SAVE_HINT(map, *entry);
-	return(FALSE);
+
+	*entry = cur;
+	SAVE_HINT(map, cur);
+	return((cur != vm_map_to_entry(map)) && (address < cur->vme_end));
 }
 
 /*
@@ -1038,6 +1037,7 @@ kern_return_t vm_map_find_entry(map, address, size, mask, object, o_entry)
 	    (entry->object.vm_object == object) &&
 	    (entry->needs_copy == FALSE) &&
 	    (entry->inheritance == VM_INHERIT_DEFAULT) &&
+	    (entry->behavior == VM_BEHAVIOR_DEFAULT) &&
 	    (entry->protection == VM_PROT_DEFAULT) &&
 	    (entry->max_protection == VM_PROT_ALL) &&
 	    (entry->wired_count == 1) &&
@@ -1064,6 +1064,7 @@ kern_return_t vm_map_find_entry(map, address, size, mask, object, o_entry)
 		new_entry->needs_copy = FALSE;
 
 		new_entry->inheritance = VM_INHERIT_DEFAULT;
+		new_entry->behavior = VM_BEHAVIOR_DEFAULT;
 		new_entry->protection = VM_PROT_DEFAULT;
 		new_entry->max_protection = VM_PROT_ALL;
 		new_entry->wired_count = 1;
@@ -1351,6 +1352,7 @@ kern_return_t vm_map_enter(
 	    (!entry->is_shared) &&
 	    (!entry->is_sub_map) &&
 	    (entry->inheritance == inheritance) &&
+	    (entry->behavior == VM_BEHAVIOR_DEFAULT) &&
 	    (entry->protection == cur_protection) &&
 	    (entry->max_protection == max_protection) &&
 	    (entry->wired_count == 0) &&  /* implies user_wired_count == 0 */
@@ -1393,6 +1395,7 @@ kern_return_t vm_map_enter(
 	new_entry->needs_copy = needs_copy;
 
 	new_entry->inheritance = inheritance;
+	new_entry->behavior = VM_BEHAVIOR_DEFAULT;
 	new_entry->protection = cur_protection;
 	new_entry->max_protection = max_protection;
 	new_entry->wired_count = 0;
@@ -1748,6 +1751,98 @@ kern_return_t vm_map_inherit(map, start, end, new_inheritance)
 	return(KERN_SUCCESS);
 }
 
+/*
+ *	vm_map_behavior_set:
+ *
+ *	Sets the expected access pattern of the specified address
+ *	range in the target map.  vm_fault consults it to size
+ *	data requests and fault-around, and to deactivate pages
+ *	behind a sequential reader.
+ *
+ *	VM_BEHAVIOR_WILLNEED and VM_BEHAVIOR_DONTNEED are not
+ *	remembered; they start bringing in, or release, the
+ *	pages of the range at once.  That is done one entry at
+ *	a time with the map unlocked, since data requests may
+ *	block; the range is looked up again after each entry.
+ */
+kern_return_t vm_map_behavior_set(map, start, end, new_behavior)
+	register vm_map_t	map;
+	register vm_offset_t	start;
+	register vm_offset_t	end;
+	register vm_behavior_t	new_behavior;
+{
+	register vm_map_entry_t	entry;
+	vm_map_entry_t	temp_entry;
+
+	if ((new_behavior == VM_BEHAVIOR_WILLNEED) ||
+	    (new_behavior == VM_BEHAVIOR_DONTNEED)) {
+		vm_object_t	object;
+		vm_offset_t	next, s, e;
+
+		vm_map_lock_read(map);
+		VM_MAP_RANGE_CHECK(map, start, end);
+		vm_map_unlock_read(map);
+
+		for (; start < end; start = next) {
+			vm_map_lock_read(map);
+			if (vm_map_lookup_entry(map, start, &temp_entry))
+				entry = temp_entry;
+			else
+				entry = temp_entry->vme_next;
+			if ((entry == vm_map_to_entry(map)) ||
+			    (entry->vme_start >= end)) {
+				vm_map_unlock_read(map);
+				break;
+			}
+
+			next = (end < entry->vme_end) ? end : entry->vme_end;
+			object = entry->object.vm_object;
+			if (entry->is_sub_map || (object == VM_OBJECT_NULL) ||
+			    ((new_behavior == VM_BEHAVIOR_DONTNEED) &&
+			     (entry->wired_count != 0))) {
+				vm_map_unlock_read(map);
+				continue;
+			}
+
+			s = (start > entry->vme_start) ?
+				start : entry->vme_start;
+			s = entry->offset + (s - entry->vme_start);
+			e = entry->offset + (next - entry->vme_start);
+			vm_object_reference(object);
+			vm_map_unlock_read(map);
+
+			if (new_behavior == VM_BEHAVIOR_WILLNEED)
+				vm_object_willneed(object, s, e);
+			else
+				vm_object_dontneed(object, s, e);
+			vm_object_deallocate(object);
+		}
+		return(KERN_SUCCESS);
+	}
+
+	vm_map_lock(map);
+
+	VM_MAP_RANGE_CHECK(map, start, end);
+
+	if (vm_map_lookup_entry(map, start, &temp_entry)) {
+		entry = temp_entry;
+		vm_map_clip_start(map, entry, start);
+	}
+	else
+		entry = temp_entry->vme_next;
+
+	while ((entry != vm_map_to_entry(map)) && (entry->vme_start < end)) {
+		vm_map_clip_end(map, entry, end);
+
+		entry->behavior = new_behavior;
+
+		entry = entry->vme_next;
+	}
+
+	vm_map_unlock(map);
+	return(KERN_SUCCESS);
+}
+
 /*
  *	vm_map_pageable_common:
  *
@@ -2888,7 +2983,8 @@ start_pass_1:
  *	
  *	Description:
  *		Link a copy chain ("copy") into a map at the
- *		specified location (after "where").
+ *		specified location (after "where").  Each entry
+ *		is also added to the map's entry tree.
  *	Side effects:
  *		The copy chain is destroyed.
  *	Warning:
@@ -2896,6 +2992,17 @@ start_pass_1:
  */
 #define	vm_map_copy_insert(map, where, copy)				\
 	MACRO_BEGIN							\
+	register vm_map_entry_t	_prev, _entry;				\
+									\
+	_prev = (where);						\
+	for (_entry = vm_map_copy_first_entry(copy);			\
+	     _entry != vm_map_copy_to_entry(copy);			\
+	     _entry = _entry->vme_next) {				\
+		rbtree_insert_after(&(map)->hdr.tree,			\
+			vm_map_entry_tree_node(&(map)->hdr, _prev),	\
+			&_entry->tree_node);				\
+		_prev = _entry;						\
+	}								\
 	(((where)->vme_next)->vme_prev = vm_map_copy_last_entry(copy))	\
 		->vme_next = ((where)->vme_next);			\
 	((where)->vme_next = vm_map_copy_first_entry(copy))		\
@@ -2904,6 +3011,75 @@ start_pass_1:
 	zfree(vm_map_copy_zone, (vm_offset_t) copy);			\
 	MACRO_END
 
+/*
+ *	Copying out medium-size regions, typically out-of-line
+ *	message data, enters the resident pages of the copy into the
+ *	destination pmap read-only, so the receiver does not take a
+ *	fault per page to find data that is already in memory.  The
+ *	pages are still shared copy-on-write; the first write to one
+ *	faults and copies it as before.  Small copies are not worth
+ *	the pmap work, and large ones are often only partly touched.
+ */
+boolean_t	vm_map_copyout_enter_enable = TRUE;
+vm_size_t	vm_map_copyout_enter_min = 8 * 1024;
+vm_size_t	vm_map_copyout_enter_max = 256 * 1024;
+int		vm_map_copyout_entered = 0;	/* pages entered */
+
+/*
+ *	Routine:	vm_map_copyout_enter
+ *
+ *	Description:
+ *		Enter the resident pages of a copied-out entry
+ *		into the destination pmap, without write access.
+ *		Only anonymous memory is handled; other objects
+ *		may have data manager locks on their pages.
+ *
+ *	In/out conditions:
+ *		The destination map is locked.
+ */
+void vm_map_copyout_enter(pmap, entry)
+	pmap_t		pmap;
+	vm_map_entry_t	entry;
+{
+	register vm_object_t	object = entry->object.vm_object;
+	register vm_offset_t	va;
+	vm_offset_t		offset;
+	register vm_page_t	m;
+
+	if (entry->is_sub_map || entry->wired_count != 0 ||
+	    object == VM_OBJECT_NULL || !object->temporary)
+		return;
+
+	vm_object_lock(object);
+	vm_object_paging_begin(object);
+
+	offset = entry->offset;
+	for (va = entry->vme_start; va < entry->vme_end; va += PAGE_SIZE) {
+		m = vm_page_lookup(object, offset);
+		offset += PAGE_SIZE;
+		if (m == VM_PAGE_NULL || m->busy || m->absent ||
+		    m->error || m->fictitious)
+			continue;
+
+		m->busy = TRUE;
+		vm_object_unlock(object);
+
+		PMAP_ENTER(pmap, va, m,
+			   entry->protection & ~VM_PROT_WRITE, FALSE);
+
+		vm_object_lock(object);
+		PAGE_WAKEUP_DONE(m);
+		vm_page_lock_queues();
+		if (!m->active && !m->inactive)
+		    vm_page_activate(m);
+		vm_page_unlock_queues();
+		vm_map_copyout_entered++;
+	}
+
+	vm_object_paging_end(object);
+	vm_object_unlock(object);
+}
+
 /*
  *	Routine:	vm_map_copyout
  *
@@ -3033,6 +3209,7 @@ kern_return_t vm_map_copyout(dst_map, dst_addr, copy)
 	    vm_map_copy_first_entry(copy) =
 	     vm_map_copy_last_entry(copy) =
 		vm_map_copy_to_entry(copy);
+	    rbtree_init(&copy->cpy_hdr.tree);
 
 	    /*
 	     * Copy each entry.
@@ -3062,6 +3239,7 @@ kern_return_t vm_map_copyout(dst_map, dst_addr, copy)
 		entry->vme_end += adjustment;
 
 		entry->inheritance = VM_INHERIT_DEFAULT;
+		entry->behavior = VM_BEHAVIOR_DEFAULT;
 		entry->protection = VM_PROT_DEFAULT;
 		entry->max_protection = VM_PROT_ALL;
 		entry->projected_on = 0;
@@ -3132,6 +3310,20 @@ kern_return_t vm_map_copyout(dst_map, dst_addr, copy)
 
 	}
 
+	/*
+	 *	Map in what the receiver would fault on first.
+	 */
+
+	if (vm_map_copyout_enter_enable &&
+	    dst_map->pmap != kernel_pmap &&
+	    size >= vm_map_copyout_enter_min &&
+	    size <= vm_map_copyout_enter_max) {
+		for (entry = vm_map_copy_first_entry(copy);
+		     entry != vm_map_copy_to_entry(copy);
+		     entry = entry->vme_next)
+			vm_map_copyout_enter(dst_map->pmap, entry);
+	}
+
 	/*
 	 *	Correct the page alignment for the result
 	 */
@@ -3261,6 +3453,7 @@ StartAgain:
 	    last->is_shared != FALSE ||
 	    last->is_sub_map != FALSE ||
 	    last->inheritance != VM_INHERIT_DEFAULT ||
+	    last->behavior != VM_BEHAVIOR_DEFAULT ||
 	    last->protection != VM_PROT_DEFAULT ||
 	    last->max_protection != VM_PROT_ALL ||
 	    (must_wire ? (last->wired_count != 1 ||
@@ -3372,6 +3565,7 @@ create_object:
 	entry->vme_end = start + size;
 	
 	entry->inheritance = VM_INHERIT_DEFAULT;
+	entry->behavior = VM_BEHAVIOR_DEFAULT;
 	entry->protection = VM_PROT_DEFAULT;
 	entry->max_protection = VM_PROT_ALL;
 	entry->projected_on = 0;
@@ -3613,6 +3807,7 @@ kern_return_t vm_map_copyin(src_map, src_addr, len, src_destroy, copy_result)
 	 vm_map_copy_last_entry(copy) = vm_map_copy_to_entry(copy);
 	copy->type = VM_MAP_COPY_ENTRY_LIST;
 	copy->cpy_hdr.nentries = 0;
+	rbtree_init(&copy->cpy_hdr.tree);
 	copy->cpy_hdr.entries_pageable = TRUE;
 
 	copy->offset = src_addr;
@@ -4259,6 +4454,7 @@ retry:
 				
 				kr = vm_fault_page(src_object, src_offset,
 						   VM_PROT_READ, FALSE, FALSE,
+						   VM_BEHAVIOR_DEFAULT,
 						   &result_prot, &m, &top_page,
 						   FALSE, (void (*)()) 0);
 				/*
@@ -4810,7 +5006,8 @@ vm_map_t vm_map_fork(old_map)
  *	type specified.
  *
  *	Returns the (object, offset, protection) for
- *	this address, whether it is wired down, and whether
+ *	this address, whether it is wired down, the
+ *	expected access pattern of its entry, and whether
  *	this map has the only reference to the data in question.
  *	In order to later verify this lookup, a "version"
  *	is returned.
@@ -4826,7 +5023,7 @@ vm_map_t vm_map_fork(old_map)
  *	remain the same.
  */
 kern_return_t vm_map_lookup(var_map, vaddr, fault_type, out_version,
-				object, offset, out_prot, wired)
+				object, offset, out_prot, wired, behavior)
 	vm_map_t		*var_map;	/* IN/OUT */
 	register vm_offset_t	vaddr;
 	register vm_prot_t	fault_type;
@@ -4836,6 +5033,7 @@ kern_return_t vm_map_lookup(var_map, vaddr, fault_type, out_version,
 	vm_offset_t		*offset;	/* OUT */
 	vm_prot_t		*out_prot;	/* OUT */
 	boolean_t		*wired;		/* OUT */
+	vm_behavior_t		*behavior;	/* OUT */
 {
 	register vm_map_entry_t		entry;
 	register vm_map_t		map = *var_map;
@@ -4976,6 +5174,7 @@ kern_return_t vm_map_lookup(var_map, vaddr, fault_type, out_version,
         *offset = (vaddr - entry->vme_start) + entry->offset;
         *object = entry->object.vm_object;
 	*out_prot = prot;
+	*behavior = entry->behavior;
 
 	/*
 	 *	Lock the object to prevent it from disappearing
@@ -5129,6 +5328,7 @@ void vm_map_simplify(map, start)
 		(this_entry->is_sub_map == FALSE) &&
 
 		(prev_entry->inheritance == this_entry->inheritance) &&
+		(prev_entry->behavior == this_entry->behavior) &&
 		(prev_entry->protection == this_entry->protection) &&
 		(prev_entry->max_protection == this_entry->max_protection) &&
 		(prev_entry->wired_count == this_entry->wired_count) &&
@@ -5478,6 +5678,7 @@ retry:
 				
 				kr = vm_fault_page(object, offset,
 						   VM_PROT_READ, FALSE, FALSE,
+						   VM_BEHAVIOR_DEFAULT,
 						   &result_prot, &m, &top_page,
 						   FALSE, (void (*)()) 0);
 				if (kr == VM_FAULT_MEMORY_SHORTAGE) {
@@ -5570,6 +5771,7 @@ retry:
 			
 			kr = vm_fault_page(object, offset,
 					   VM_PROT_READ, FALSE, FALSE,
+					   VM_BEHAVIOR_DEFAULT,
 					   &result_prot, &m, &top_page,
 					   FALSE, (void (*)()) 0);
 			if (kr == VM_FAULT_MEMORY_SHORTAGE) {
@@ -5663,6 +5865,7 @@ vm_map_convert_from_page_list(copy)
 	    vm_map_copy_last_entry(copy) = vm_map_copy_to_entry(copy);
 	copy->type = VM_MAP_COPY_ENTRY_LIST;
 	copy->cpy_hdr.nentries = 0;
+	rbtree_init(&copy->cpy_hdr.tree);
 	copy->cpy_hdr.entries_pageable = TRUE;
 
 	/*
@@ -5679,6 +5882,7 @@ vm_map_convert_from_page_list(copy)
 	new_entry->protection = VM_PROT_DEFAULT;
 	new_entry->max_protection = VM_PROT_ALL;
 	new_entry->inheritance = VM_INHERIT_DEFAULT;
+	new_entry->behavior = VM_BEHAVIOR_DEFAULT;
 	new_entry->wired_count = 0;
 	new_entry->user_wired_count = 0;
 	new_entry->projected_on = 0;
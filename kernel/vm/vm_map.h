@@ -165,11 +165,13 @@
 #include <mach/machine/vm_types.h>
 #include <mach/vm_prot.h>
 #include <mach/vm_inherit.h>
+#include <mach/vm_behavior.h>
 #include <vm/pmap.h>
 #include <vm/vm_object.h>
 #include <vm/vm_page.h>
 #include <kern/lock.h>
 #include <kern/macro_help.h>
+#include <kern/rbtree.h>
 
 /*
  *	Types defined:
@@ -202,7 +204,8 @@ typedef union vm_map_object {
  *	Implementation:
  *		Address map entries consist of start and end addresses,
  *		a VM object (or sub map) and offset into that object,
- *		and user-exported inheritance and protection information.
+ *		and user-exported inheritance, protection and behavior
+ *		information.
  *		Control information for virtual copy operations is also
  *		stored in the address map entry.
  */
@@ -219,6 +222,7 @@ struct vm_map_entry {
 #define vme_next		links.next
 #define vme_start		links.start
 #define vme_end			links.end
+	struct rbtree_node	tree_node;	/* links in entry tree */
 	union vm_map_object	object;		/* object I point to */
 	vm_offset_t		offset;		/* offset into object */
 	unsigned int
@@ -233,6 +237,7 @@ struct vm_map_entry {
 	vm_prot_t		protection;	/* protection code */
 	vm_prot_t		max_protection;	/* maximum protection */
 	vm_inherit_t		inheritance;	/* inheritance */
+	vm_behavior_t		behavior;	/* expected access pattern */
 	unsigned short		wired_count;	/* can be paged if = 0 */
 	unsigned short		user_wired_count; /* for vm_wire */
 	struct vm_map_entry     *projected_on;  /* 0 for normal map entry
@@ -254,6 +259,7 @@ typedef struct vm_map_entry	*vm_map_entry_t;
  */
 struct vm_map_header {
 	struct vm_map_links	links;		/* first, last, min, max */
+	struct rbtree		tree;		/* Sorted tree of entries */
 	int			nentries;	/* Number of entries */
 	boolean_t		entries_pageable;
 						/* are map entries pageable? */
@@ -269,10 +275,12 @@ struct vm_map_header {
  *
  *	Implementation:
  *		Maps are doubly-linked lists of map entries, sorted
- *		by address.  One hint is used to start
- *		searches again from the last successful search,
- *		insertion, or removal.  Another hint is used to
- *		quickly find free space.
+ *		by address.  The same entries are also kept in a
+ *		red-black tree, so that lookups which miss the hint
+ *		take logarithmic rather than linear time.  One hint
+ *		is used to start searches again from the last
+ *		successful search, insertion, or removal.  Another
+ *		hint is used to quickly find free space.
  */
 typedef struct vm_map {
 	lock_data_t		lock;		/* Lock for map data */
@@ -494,6 +502,7 @@ extern kern_return_t	vm_map_find_entry();	/* Enter a mapping primitive */
 extern kern_return_t	vm_map_remove();	/* Deallocate a region */
 extern kern_return_t	vm_map_protect();	/* Change protection */
 extern kern_return_t	vm_map_inherit();	/* Change inheritance */
+extern kern_return_t	vm_map_behavior_set();	/* Change behavior */
 
 extern void		vm_map_print();		/* Debugging: print a map */
 
@@ -641,6 +641,9 @@ void vm_object_bootstrap(void)
 	vm_object_template->lock_restart = FALSE;
 	vm_object_template->use_old_pageout = TRUE; /* XXX change later */
 	vm_object_template->last_alloc = (vm_offset_t) 0;
+	vm_object_template->pagein_next = (vm_offset_t) 0;
+	vm_object_template->pagein_window = 1;
+	vm_object_template->pager_cluster = 1;
 
 #if	MACH_PAGEMAP
 	vm_object_template->existence_info = VM_EXTERNAL_NULL;
@@ -1476,6 +1479,7 @@ kern_return_t vm_object_copy_slowly(
 
 			result = vm_fault_page(src_object, src_offset,
 				VM_PROT_READ, FALSE, interruptible,
+				VM_BEHAVIOR_DEFAULT,
 				&prot, &_result_page, &top_page,
 				FALSE, (void (*)()) 0);
 
@@ -3180,6 +3184,175 @@ void vm_object_page_remove(
 	}
 }
 
+/*
+ *	Routine:	vm_object_willneed
+ *	Purpose:
+ *		Start bringing in the pages in the specified
+ *		object range that are not resident, without
+ *		waiting for them to arrive.
+ *
+ *		Each missing page is requested from the first
+ *		object in the shadow chain whose pager may have
+ *		it, as vm_fault_page would.  The pages are left
+ *		absent and busy until the data arrives, so that
+ *		faults on them wait for it.  Nothing is requested
+ *		from pagers that are not ready, and the range is
+ *		abandoned when an object has too many requests
+ *		outstanding or pages run short.
+ *
+ *	In/out conditions:
+ *		The object must *not* be locked, and must be
+ *		kept referenced by the caller.
+ */
+void vm_object_willneed(
+	vm_object_t	object,
+	vm_offset_t	start,
+	vm_offset_t	end)
+{
+	register vm_object_t	o, next;
+	register vm_offset_t	offset;
+	register vm_page_t	m;
+	vm_size_t		length;
+	kern_return_t		kr;
+
+	if (end > object->size)
+		end = object->size;
+
+	for (; start < end; start += length) {
+		length = PAGE_SIZE;
+
+		/*
+		 *	Find the object that would supply the page.
+		 */
+
+		o = object;
+		offset = start;
+		vm_object_lock(o);
+		for (;;) {
+			if (vm_page_lookup(o, offset) != VM_PAGE_NULL)
+				break;
+			if (o->pager_created
+#if	MACH_PAGEMAP
+			    && (vm_external_state_get(o->existence_info,
+					offset + o->paging_offset) !=
+				VM_EXTERNAL_STATE_ABSENT)
+#endif	/* MACH_PAGEMAP */
+			    )
+				break;
+			if ((next = o->shadow) == VM_OBJECT_NULL)
+				break;
+			vm_object_lock(next);
+			offset += o->shadow_offset;
+			vm_object_unlock(o);
+			o = next;
+		}
+
+		if ((vm_page_lookup(o, offset) != VM_PAGE_NULL) ||
+		    !o->pager_created || !o->pager_ready) {
+			vm_object_unlock(o);
+			continue;
+		}
+
+		if (o->absent_count >= vm_object_absent_max) {
+			vm_object_unlock(o);
+			return;
+		}
+
+		m = vm_page_grab_fictitious();
+		if (m == VM_PAGE_NULL) {
+			vm_object_unlock(o);
+			return;
+		}
+
+		/*
+		 *	Requests to the default pager must reserve
+		 *	a real page in advance (see vm_fault_page).
+		 */
+
+		if (o->internal && !vm_page_convert(m)) {
+			vm_page_release_fictitious(m);
+			vm_object_unlock(o);
+			return;
+		}
+
+		vm_page_lock_queues();
+		vm_page_insert(m, o, offset);
+		vm_page_unlock_queues();
+
+		m->absent = TRUE;
+		o->absent_count++;
+
+		length = vm_fault_cluster(o, offset, VM_BEHAVIOR_SEQUENTIAL);
+
+		vm_object_paging_begin(o);
+		vm_object_unlock(o);
+
+		vm_stat.pageins++;
+
+		kr = memory_object_data_request(o->pager, o->pager_request,
+						offset + o->paging_offset,
+						length, VM_PROT_READ);
+
+		vm_object_lock(o);
+		if (kr != KERN_SUCCESS) {
+			vm_offset_t	off;
+
+			for (off = offset; off < offset + length;
+			     off += PAGE_SIZE) {
+				m = vm_page_lookup(o, off);
+				if (m != VM_PAGE_NULL && m->absent && m->busy)
+					VM_PAGE_FREE(m);
+			}
+			vm_object_paging_end(o);
+			vm_object_unlock(o);
+			return;
+		}
+		vm_object_paging_end(o);
+		vm_object_unlock(o);
+	}
+}
+
+/*
+ *	Routine:	vm_object_dontneed
+ *	Purpose:
+ *		Release the pages in the specified object range.
+ *		Clean pages are freed at once, as the pageout
+ *		daemon would free them; dirty and precious pages
+ *		are deactivated so that they are cleaned soon.
+ *		Pages that are busy or wired are left alone.
+ *
+ *	In/out conditions:
+ *		The object must *not* be locked.
+ */
+void vm_object_dontneed(
+	vm_object_t	object,
+	vm_offset_t	start,
+	vm_offset_t	end)
+{
+	register vm_page_t	m;
+
+	vm_object_lock(object);
+	for (; start < end; start += PAGE_SIZE) {
+		m = vm_page_lookup(object, start);
+		if ((m == VM_PAGE_NULL) || m->busy || m->absent ||
+		    m->error || m->fictitious || m->laundry ||
+		    (m->wire_count != 0))
+			continue;
+
+		pmap_page_protect(m->phys_addr, VM_PROT_NONE);
+		if (!m->dirty)
+			m->dirty = pmap_is_modified(m->phys_addr);
+
+		vm_page_lock_queues();
+		if (!m->dirty && !m->precious)
+			vm_page_free(m);
+		else
+			vm_page_deactivate(m);
+		vm_page_unlock_queues();
+	}
+	vm_object_unlock(object);
+}
+
 /*
  *	Routine:	vm_object_coalesce
  *	Function:	Coalesces two objects backing up adjoining
@@ -269,6 +269,15 @@ struct vm_object {
 						 * of their can_persist value
 						 */
 	vm_offset_t		last_alloc;	/* last allocation offset */
+	vm_offset_t		pagein_next;	/* Offset at which a sequential
+						 * reader will fault next
+						 */
+	unsigned int		pagein_window;	/* Pages in the last data
+						 * request (see vm_fault_cluster)
+						 */
+	unsigned int		pager_cluster;	/* Most pages the pager will
+						 * take in one data request
+						 */
 #if	MACH_PAGEMAP
 	vm_external_t		existence_info;
 #endif	/* MACH_PAGEMAP */
@@ -305,6 +314,14 @@ extern void		vm_object_page_remove(
 	vm_object_t	object,
 	vm_offset_t	start,
 	vm_offset_t	end);
+extern void		vm_object_willneed(
+	vm_object_t	object,
+	vm_offset_t	start,
+	vm_offset_t	end);
+extern void		vm_object_dontneed(
+	vm_object_t	object,
+	vm_offset_t	start,
+	vm_offset_t	end);
 extern void		vm_object_shadow(
 	vm_object_t	*object,	/* in/out */
 	vm_offset_t	*offset,	/* in/out */
@@ -188,6 +188,8 @@ struct vm_page {
 			laundry:1,	/* page is being cleaned now (P)*/
 			free:1,		/* page is on free list (P) */
 			reference:1,	/* page has been used (P) */
+			probation:1,	/* page has not been found used
+					 * since it was paged in (P) */
 			:0;		/* (force to 'long' boundary) */
 #ifdef	ns32000
 	int		pad;		/* extra space for ns32000 bit ops */
@@ -238,7 +240,9 @@ typedef struct vm_page	*vm_page_t;
  *		Not referenced in any map, but still has an
  *		object/offset-page mapping, and may be dirty.
  *		This is the list of pages that should be
- *		paged out next.
+ *		paged out next.  Pages paged in from a pager
+ *		also start here, on probation, unless they
+ *		were evicted recently (see vm_page_admit).
  *	active
  *		A list of pages which have been placed in
  *		at least one physical map.  This list is
@@ -308,6 +312,7 @@ extern boolean_t	vm_page_convert(vm_page_t);
 extern void		vm_page_more_fictitious(void);
 extern vm_page_t	vm_page_grab(void);
 extern void		vm_page_release(vm_page_t);
+extern void		vm_page_pool_drain(void);
 extern void		vm_page_wait(void (*)(void));
 extern vm_page_t	vm_page_alloc(
 	vm_object_t	object,
@@ -318,6 +323,8 @@ extern void		vm_page_init(
 extern void		vm_page_free(vm_page_t);
 extern void		vm_page_activate(vm_page_t);
 extern void		vm_page_deactivate(vm_page_t);
+extern void		vm_page_admit(vm_page_t);
+extern void		vm_page_ghost_enter(vm_page_t);
 extern void		vm_page_rename(
 	vm_page_t	mem,
 	vm_object_t	new_object,
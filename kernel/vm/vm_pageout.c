@@ -255,13 +255,19 @@
 #include <mach/memory_object_user.h>
 #include <mach/vm_param.h>
 #include <mach/vm_statistics.h>
+#include <mach_vm_debug.h>
+
 #include <kern/counters.h>
+#include <kern/sched.h>
 #include <kern/thread.h>
 #include <vm/pmap.h>
 #include <vm/vm_map.h>
 #include <vm/vm_object.h>
 #include <vm/vm_page.h>
 #include <vm/vm_pageout.h>
+#if	MACH_VM_DEBUG
+#include <mach_debug/vm_info.h>
+#endif	MACH_VM_DEBUG
 #include <machine/vm_tuning.h>
 #include <machine/thread.h>		/* for KEEP_STACKS */
 
@@ -287,6 +293,17 @@
 #define	VM_PAGEOUT_PAUSE_MAX	10		/* number of pauses */
 #endif	VM_PAGEOUT_PAUSE_MAX
 
+/*
+ *	The pageout daemon writes a dirty page back together with
+ *	up to VM_PAGEOUT_CLUSTER_MAX - 1 dirty inactive neighbours,
+ *	in one message.  Keep this below VM_PAGEOUT_BURST_MAX, or
+ *	every cluster will make the daemon pause for the pagers.
+ */
+
+#ifndef	VM_PAGEOUT_CLUSTER_MAX
+#define	VM_PAGEOUT_CLUSTER_MAX	8		/* number of pages */
+#endif	VM_PAGEOUT_CLUSTER_MAX
+
 /*
  *	To obtain a reasonable LRU approximation, the inactive queue
  *	needs to be large enough to give pages on it a chance to be
@@ -369,6 +386,7 @@ unsigned int vm_pageout_burst_wait = 0;		/* milliseconds per page */
 unsigned int vm_pageout_empty_wait = 0;		/* milliseconds */
 unsigned int vm_pageout_pause_count = 0;
 unsigned int vm_pageout_pause_max = 0;
+unsigned int vm_pageout_cluster_max = 0;	/* number of pages */
 
 /*
  *	These variables record the pageout daemon's actions:
@@ -382,9 +400,23 @@ unsigned int vm_pageout_inactive_nolock = 0;	/* debugging */
 unsigned int vm_pageout_inactive_busy = 0;	/* debugging */
 unsigned int vm_pageout_inactive_absent = 0;	/* debugging */
 unsigned int vm_pageout_inactive_used = 0;	/* debugging */
+unsigned int vm_pageout_inactive_probation = 0;	/* debugging */
 unsigned int vm_pageout_inactive_clean = 0;	/* debugging */
 unsigned int vm_pageout_inactive_dirty = 0;	/* debugging */
 unsigned int vm_pageout_inactive_double = 0;	/* debugging */
+unsigned int vm_pageout_cluster_pages = 0;	/* debugging */
+unsigned int vm_pageout_cluster_writes = 0;	/* debugging */
+
+/*
+ *	Clean-and-free throughput of the pageout daemon: the number
+ *	of pages it freed or sent to be cleaned during the last
+ *	second (sched_tick) in which it did any work.  Like the
+ *	counters above, only the daemon modifies these.
+ */
+
+unsigned int vm_pageout_rate = 0;		/* pages per second */
+unsigned int vm_pageout_rate_pages = 0;		/* pages this second */
+unsigned int vm_pageout_rate_tick = 0;		/* sched_tick of this second */
 
 #if	NORMA_VM
 /*
@@ -707,6 +739,223 @@ vm_pageout_page(m, initial, flush)
 	vm_object_paging_end(old_object);
 }
 
+/*
+ *	Routine:	vm_pageout_account
+ *	Purpose:
+ *		Charge pages freed or sent to be cleaned by the
+ *		pageout daemon to the current second, for
+ *		vm_pageout_rate.
+ */
+void
+vm_pageout_account(pages)
+	unsigned int		pages;
+{
+	if (vm_pageout_rate_tick != sched_tick) {
+		vm_pageout_rate = (vm_pageout_rate_tick + 1 == sched_tick) ?
+					vm_pageout_rate_pages : 0;
+		vm_pageout_rate_pages = 0;
+		vm_pageout_rate_tick = sched_tick;
+	}
+	vm_pageout_rate_pages += pages;
+}
+
+/*
+ *	Routine:	vm_pageout_cluster_take
+ *	Purpose:
+ *		Decide whether a neighbour of a page being paged out
+ *		should go along with it.  It should if the daemon
+ *		would page it out anyway: it is inactive, dirty, not
+ *		recently referenced and not otherwise in use.
+ *		If so, take it as vm_pageout_scan would: make it
+ *		busy, pull it off the inactive queue and unmap it.
+ *
+ *	In/out conditions:
+ *		The object and the page queues must be locked.
+ */
+boolean_t
+vm_pageout_cluster_take(m)
+	register vm_page_t	m;
+{
+	if ((m == VM_PAGE_NULL) || !m->inactive || m->busy ||
+	    m->absent || m->error || m->fictitious || m->precious ||
+	    m->laundry || (m->wire_count != 0) || m->reference ||
+	    pmap_is_referenced(m->phys_addr))
+		return FALSE;
+
+	if (!m->dirty && !pmap_is_modified(m->phys_addr))
+		return FALSE;
+
+	queue_remove(&vm_page_queue_inactive, m, vm_page_t, pageq);
+	m->inactive = FALSE;
+	vm_page_inactive_count--;
+
+	vm_page_ghost_enter(m);
+
+	m->busy = TRUE;
+	pmap_page_protect(m->phys_addr, VM_PROT_NONE);
+	m->dirty = TRUE;
+	return TRUE;
+}
+
+/*
+ *	Routine:	vm_pageout_cluster
+ *	Purpose:
+ *		Flush a dirty page chosen by vm_pageout_scan back
+ *		to its memory object, together with the run of dirty
+ *		inactive pages around it in the same object, in a
+ *		single memory_object_data_write (or data_return).
+ *		At most vm_pageout_cluster_max pages are sent.
+ *
+ *		Pages that need special handling (double-paged or
+ *		clean precious pages) go alone through
+ *		vm_pageout_page.
+ *
+ *	In/out conditions:
+ *		The page must be busy, unmapped and not on any
+ *		pageout queues.  The object to which it belongs
+ *		must be locked, and is left locked.
+ *	Returns:
+ *		The number of pages sent.
+ */
+int
+vm_pageout_cluster(m)
+	register vm_page_t	m;
+{
+	vm_page_t		pages[VM_PAGEOUT_CLUSTER_MAX];
+	vm_page_t		holding_pages[VM_PAGEOUT_CLUSTER_MAX];
+	register vm_object_t	object;
+	register vm_object_t	new_object;
+	vm_offset_t		first, last;
+	vm_offset_t		paging_offset;
+	vm_map_copy_t		copy;
+	kern_return_t		rc;
+	register int		i, count, max;
+
+	assert(m->busy);
+
+	max = vm_pageout_cluster_max;
+	if (max > VM_PAGEOUT_CLUSTER_MAX)
+		max = VM_PAGEOUT_CLUSTER_MAX;
+
+	if ((max <= 1) || m->laundry || m->absent || m->error ||
+	    !m->dirty) {
+		vm_pageout_page(m, FALSE, TRUE);
+		vm_pageout_cluster_pages++;
+		vm_pageout_cluster_writes++;
+		vm_pageout_account(1);
+		return 1;
+	}
+
+	/*
+	 *	Gather the run: first back, then forward.
+	 */
+
+	object = m->object;
+	first = m->offset;
+	last = m->offset + PAGE_SIZE;
+	count = 1;
+
+	vm_page_lock_queues();
+	while ((count < max) && (first >= PAGE_SIZE) &&
+	       vm_pageout_cluster_take(vm_page_lookup(object,
+						      first - PAGE_SIZE))) {
+		first -= PAGE_SIZE;
+		count++;
+	}
+	while ((count < max) && (last < object->size) &&
+	       vm_pageout_cluster_take(vm_page_lookup(object, last))) {
+		last += PAGE_SIZE;
+		count++;
+	}
+	vm_page_unlock_queues();
+
+	for (i = 0; i < count; i++)
+		pages[i] = vm_page_lookup(object, first + ptoa(i));
+
+	/*
+	 *	Create a paging reference to let us play with the object.
+	 */
+
+	paging_offset = first + object->paging_offset;
+	vm_object_paging_begin(object);
+	vm_object_unlock(object);
+
+	/*
+	 *	Move the pages, in order, into a new object.
+	 */
+
+	new_object = vm_object_allocate(last - first);
+	for (i = 0; i < count; i++)
+		holding_pages[i] = vm_pageout_setup(pages[i],
+					paging_offset + ptoa(i),
+					new_object,
+					ptoa(i),	/* new offset */
+					TRUE);		/* flush */
+
+	rc = vm_map_copyin_object(new_object, 0, last - first, &copy);
+	assert(rc == KERN_SUCCESS);
+
+	if (object->use_old_pageout) {
+		rc = memory_object_data_write(
+			 object->pager,
+			 object->pager_request,
+			 paging_offset, (pointer_t) copy, last - first);
+	}
+	else {
+		rc = memory_object_data_return(
+			 object->pager,
+			 object->pager_request,
+			 paging_offset, (pointer_t) copy, last - first,
+			 TRUE, FALSE);
+	}
+
+	if (rc != KERN_SUCCESS)
+		vm_map_copy_discard(copy);
+
+	vm_pageout_cluster_pages += count;
+	vm_pageout_cluster_writes++;
+	vm_pageout_account(count);
+
+	/*
+	 *	Clean up.
+	 */
+
+	vm_object_lock(object);
+	for (i = 0; i < count; i++)
+		if (holding_pages[i] != VM_PAGE_NULL)
+		    VM_PAGE_FREE(holding_pages[i]);
+	vm_object_paging_end(object);
+
+	return count;
+}
+
+#if	MACH_VM_DEBUG
+/*
+ *	Routine:	vm_pageout_info
+ *	Purpose:
+ *		Return the pageout daemon's clean-and-free
+ *		rate and clustering counts.
+ *	Conditions:
+ *		Nothing locked.
+ */
+void
+vm_pageout_info(info)
+	vm_pageout_info_t	*info;
+{
+	if (vm_pageout_rate_tick == sched_tick)
+		info->vpoi_rate = vm_pageout_rate;
+	else if (vm_pageout_rate_tick + 1 == sched_tick)
+		info->vpoi_rate = vm_pageout_rate_pages;
+	else
+		info->vpoi_rate = 0;
+	info->vpoi_freed = vm_pageout_inactive_clean;
+	info->vpoi_cleaned = vm_pageout_cluster_pages;
+	info->vpoi_writes = vm_pageout_cluster_writes;
+	info->vpoi_cluster_max = vm_pageout_cluster_max;
+	info->vpoi_laundry = vm_page_laundry_count;
+}
+#endif	MACH_VM_DEBUG
+
 /*
  *	vm_pageout_scan does the dirty work for the pageout daemon.
  *	It returns with vm_page_queue_free_lock held and
@@ -758,6 +1007,7 @@ void vm_pageout_scan()
 #endif	KEEP_STACKS
 	stack_collect();
 	net_kmsg_collect();
+	vm_page_pool_drain();
 	consider_task_collect();
 	consider_thread_collect();
 	consider_zone_gc();
@@ -958,6 +1208,29 @@ void vm_pageout_scan()
 
 		assert(!m->fictitious);
 		if (m->reference || pmap_is_referenced(m->phys_addr)) {
+			if (m->probation) {
+				/*
+				 *	The page has been paged in and used
+				 *	once.  Send it around the inactive
+				 *	queue again; it is activated only if
+				 *	it is used again by then.  This keeps
+				 *	a single pass over a large object from
+				 *	displacing the working set.
+				 */
+
+				m->probation = FALSE;
+				m->reference = FALSE;
+				pmap_clear_reference(m->phys_addr);
+				queue_enter(&vm_page_queue_inactive, m,
+					    vm_page_t, pageq);
+				m->inactive = TRUE;
+				vm_page_inactive_count++;
+				vm_page_unlock_queues();
+				vm_object_unlock(object);
+				vm_pageout_inactive_probation++;
+				continue;
+			}
+
 			vm_object_unlock(object);
 			vm_page_activate(m);
 			vm_stat.reactivations++;
@@ -966,6 +1239,13 @@ void vm_pageout_scan()
 			continue;
 		}
 
+		/*
+		 *	The page is going; remember it in case it
+		 *	is wanted again soon (see vm_page_admit).
+		 */
+
+		vm_page_ghost_enter(m);
+
 		/*
 		 *	Eliminate all mappings.
 		 */
@@ -981,6 +1261,7 @@ void vm_pageout_scan()
 
 		if (!m->dirty && !m->precious) {
 			vm_pageout_inactive_clean++;
+			vm_pageout_account(1);
 			goto reclaim_page;
 		}
 
@@ -1019,9 +1300,8 @@ void vm_pageout_scan()
 			panic("vm_pageout_scan");
 
 		vm_pageout_inactive_dirty++;
-		vm_pageout_page(m, FALSE, TRUE);	/* flush it */
+		burst_count += vm_pageout_cluster(m);	/* flushes them */
 		vm_object_unlock(object);
-		burst_count++;
 	}
 }
 
@@ -1109,6 +1389,10 @@ void vm_pageout()
 	if (vm_pageout_pause_max == 0)
 		vm_pageout_pause_max = VM_PAGEOUT_PAUSE_MAX;
 
+	if ((vm_pageout_cluster_max == 0) ||
+	    (vm_pageout_cluster_max > VM_PAGEOUT_CLUSTER_MAX))
+		vm_pageout_cluster_max = VM_PAGEOUT_CLUSTER_MAX;
+
 	if (vm_pageout_reserved_internal == 0)
 		vm_pageout_reserved_internal =
 			VM_PAGEOUT_RESERVED_INTERNAL(vm_page_free_reserved);
@@ -67,5 +67,6 @@
 
 extern vm_page_t vm_pageout_setup();
 extern void vm_pageout_page();
+extern int vm_pageout_cluster();
 
 #endif	_VM_VM_PAGEOUT_H_
@@ -261,6 +261,7 @@
 
 #include <mach/vm_prot.h>
 #include <kern/counters.h>
+#include <kern/cpu_number.h>
 #include <kern/sched_prim.h>
 #include <kern/task.h>
 #include <kern/thread.h>
@@ -277,6 +278,7 @@
 #if	MACH_VM_DEBUG
 #include <mach/kern_return.h>
 #include <mach_debug/hash_info.h>
+#include <mach_debug/vm_info.h>
 #include <vm/vm_user.h>
 #endif
 
@@ -312,6 +314,40 @@ vm_page_bucket_t *vm_page_buckets;		/* Array of buckets */
 unsigned int	vm_page_bucket_count = 0;	/* How big is array? */
 unsigned int	vm_page_hash_mask;		/* Mask for hash function */
 
+/*
+ *	A page evicted by the pageout daemon leaves a ghost entry
+ *	behind, recording the value of vm_page_evictions when it
+ *	went.  If the page is paged in again, the evictions since
+ *	then give its refault distance: the page would still be
+ *	resident had the inactive queue been that much longer.
+ *	A page refaulting within the size of the active queue is
+ *	part of the working set, and vm_page_admit activates it at
+ *	once; other pages start on probation in the inactive queue,
+ *	so that a single pass over a large object cannot push the
+ *	working set out.
+ *
+ *	The ghost table is hashed like the VP table, and a new
+ *	entry simply replaces an older one in the same slot.  It is
+ *	protected by the page queues lock.
+ */
+typedef struct {
+	vm_object_t	object;
+	vm_offset_t	offset;
+	unsigned int	evicted;	/* vm_page_evictions at eviction */
+} vm_page_ghost_t;
+
+vm_page_ghost_t	*vm_page_ghosts;		/* Array of ghost entries */
+unsigned int	vm_page_ghost_count = 0;	/* How big is array? */
+unsigned int	vm_page_ghost_mask;		/* Mask for hash function */
+
+unsigned int	vm_page_evictions = 0;		/* Pages evicted so far */
+unsigned int	vm_page_ghost_hits = 0;		/* Refaults activated */
+unsigned int	vm_page_probations = 0;		/* Pageins on probation */
+
+#define vm_page_ghost_hash(object, offset) \
+	(((unsigned int)(vm_offset_t)object + (unsigned int)atop(offset)) \
+		& vm_page_ghost_mask)
+
 /*
  *	The virtual page size is currently implemented as a runtime
  *	variable, but is constant once initialized using vm_set_page_size.
@@ -349,6 +385,39 @@ int		vm_page_fictitious_count;
 
 unsigned int	vm_page_free_count_minimum;	/* debugging */
 
+unsigned int	vm_page_free_lock_acquires;	/* by grab and release */
+unsigned int	vm_page_free_lock_pages;	/* pages they moved */
+
+#if	NCPUS > 1
+/*
+ *	Each processor keeps a pool of free pages in front of the
+ *	free list, so most grabs and releases don't take
+ *	vm_page_queue_free_lock.  Pools are refilled and drained
+ *	VM_PAGE_POOL_BATCH pages at a time.
+ *
+ *	Pooled pages are not counted in vm_page_free_count.  So
+ *	that they don't hide memory when it is short, pools are
+ *	only refilled above vm_page_free_target, releases bypass
+ *	them below vm_page_free_min or while threads wait for
+ *	pages, and the pageout daemon empties them whenever it
+ *	runs (vm_page_pool_drain).
+ *
+ *	The free list lock is taken before a pool lock.
+ */
+#define	VM_PAGE_POOL_BATCH	16
+#define	VM_PAGE_POOL_MAX	(2 * VM_PAGE_POOL_BATCH)
+
+struct vm_page_pool {
+	decl_simple_lock_data(,	lock)
+	vm_page_t	pages;		/* linked by pageq.next */
+	int		count;		/* number of pages */
+	unsigned int	grabs;		/* grabs served by the pool */
+	unsigned int	releases;	/* releases kept by the pool */
+} vm_page_pool[NCPUS];
+
+unsigned int	vm_page_pool_drains;
+#endif	/* NCPUS > 1 */
+
 /*
  *	Occasionally, the virtual memory system uses
  *	resident page structures that do not refer to
@@ -468,6 +537,7 @@ void vm_page_bootstrap(
 	m->dirty = FALSE;
 	m->precious = FALSE;
 	m->reference = FALSE;
+	m->probation = FALSE;
 
 	m->phys_addr = 0;		/* reset later */
 
@@ -480,6 +550,10 @@ void vm_page_bootstrap(
 
 	simple_lock_init(&vm_page_queue_free_lock);
 	simple_lock_init(&vm_page_queue_lock);
+#if	NCPUS > 1
+	for (i = 0; i < NCPUS; i++)
+		simple_lock_init(&vm_page_pool[i].lock);
+#endif	/* NCPUS > 1 */
 
 	vm_page_queue_free = VM_PAGE_NULL;
 	vm_page_queue_fictitious = VM_PAGE_NULL;
@@ -531,6 +605,28 @@ void vm_page_bootstrap(
 		simple_lock_init(&bucket->lock);
 	}
 
+	/*
+	 *	Allocate the ghost table, with one entry for every
+	 *	two physical pages (rounded up to a power of two).
+	 */
+
+	if (vm_page_ghost_count == 0)
+		vm_page_ghost_count = vm_page_bucket_count / 2;
+	if (vm_page_ghost_count == 0)
+		vm_page_ghost_count = 1;
+
+	vm_page_ghost_mask = vm_page_ghost_count - 1;
+
+	vm_page_ghosts = (vm_page_ghost_t *)
+		pmap_steal_memory(vm_page_ghost_count *
+				  sizeof(vm_page_ghost_t));
+
+	for (i = 0; i < vm_page_ghost_count; i++) {
+		vm_page_ghosts[i].object = VM_OBJECT_NULL;
+		vm_page_ghosts[i].offset = 0;
+		vm_page_ghosts[i].evicted = 0;
+	}
+
 	/*
 	 *	Machine-dependent code allocates the resident page table.
 	 *	It uses vm_page_init to initialize the page frames.
@@ -1090,6 +1186,67 @@ boolean_t vm_page_convert(
 	return TRUE;
 }
 
+#if	NCPUS > 1
+/*
+ *	vm_page_pool_flush:
+ *
+ *	Move up to n pages from a pool to the free list,
+ *	which is locked.  Returns the number moved.
+ */
+
+static int vm_page_pool_flush(
+	register struct vm_page_pool *pool,
+	int			n)
+{
+	register vm_page_t	mem;
+	register int		i;
+
+	simple_lock(&pool->lock);
+	for (i = 0; (i < n) && ((mem = pool->pages) != VM_PAGE_NULL); i++) {
+		pool->pages = (vm_page_t) mem->pageq.next;
+		mem->pageq.next = (queue_entry_t) vm_page_queue_free;
+		vm_page_queue_free = mem;
+	}
+	pool->count -= i;
+	simple_unlock(&pool->lock);
+
+	vm_page_free_count += i;
+	vm_page_free_lock_pages += i;
+	return i;
+}
+#endif	/* NCPUS > 1 */
+
+/*
+ *	vm_page_pool_drain:
+ *
+ *	Return the pages in all processors' pools to
+ *	the free list, and wake threads waiting for them.
+ *	Called by the pageout daemon.
+ */
+
+void vm_page_pool_drain(void)
+{
+#if	NCPUS > 1
+	register int	cpu, n;
+
+	simple_lock(&vm_page_queue_free_lock);
+	n = 0;
+	for (cpu = 0; cpu < NCPUS; cpu++)
+		if (vm_page_pool[cpu].count > 0)
+			n += vm_page_pool_flush(&vm_page_pool[cpu],
+						VM_PAGE_POOL_MAX);
+	vm_page_pool_drains++;
+
+	/* one waiter per page; see vm_page_release */
+	while ((n-- > 0) && (vm_page_free_wanted > 0) &&
+	       (vm_page_free_count >= vm_page_free_reserved)) {
+		vm_page_free_wanted--;
+		thread_wakeup_one((event_t) &vm_page_free_count);
+	}
+	simple_unlock(&vm_page_queue_free_lock);
+#endif	/* NCPUS > 1 */
+}
+
 /*
  *	vm_page_grab:
  *
@@ -1100,8 +1257,35 @@ boolean_t vm_page_convert(
 vm_page_t vm_page_grab(void)
 {
 	register vm_page_t	mem;
+#if	NCPUS > 1
+	register struct vm_page_pool *pool = &vm_page_pool[cpu_number()];
+	register int		n;
+
+	/*
+	 *	Try this processor's pool first.  The reserved pool
+	 *	rule below applies to pooled pages as well; the
+	 *	unlocked look at vm_page_free_count is good enough.
+	 */
+
+	if ((pool->count > 0) &&
+	    ((vm_page_free_count >= vm_page_free_reserved) ||
+	     current_thread()->vm_privilege)) {
+		simple_lock(&pool->lock);
+		mem = pool->pages;
+		if (mem != VM_PAGE_NULL) {
+			pool->pages = (vm_page_t) mem->pageq.next;
+			pool->count--;
+			pool->grabs++;
+			simple_unlock(&pool->lock);
+			mem->free = FALSE;
+			return mem;
+		}
+		simple_unlock(&pool->lock);
+	}
+#endif	/* NCPUS > 1 */
 
 	simple_lock(&vm_page_queue_free_lock);
+	vm_page_free_lock_acquires++;
 
 	/*
 	 *	Only let privileged threads (involved in pageout)
@@ -1122,6 +1306,31 @@ vm_page_t vm_page_grab(void)
 	mem = vm_page_queue_free;
 	vm_page_queue_free = (vm_page_t) mem->pageq.next;
 	mem->free = FALSE;
+	vm_page_free_lock_pages++;
+
+#if	NCPUS > 1
+	/*
+	 *	While pages are plentiful, refill the pool with
+	 *	a batch so the next grabs don't need the lock.
+	 */
+
+	if (vm_page_free_count >= vm_page_free_target + VM_PAGE_POOL_BATCH) {
+		register vm_page_t m;
+
+		simple_lock(&pool->lock);
+		for (n = 0; (n < VM_PAGE_POOL_BATCH) &&
+			    (pool->count < VM_PAGE_POOL_MAX); n++) {
+			m = vm_page_queue_free;
+			vm_page_queue_free = (vm_page_t) m->pageq.next;
+			m->pageq.next = (queue_entry_t) pool->pages;
+			pool->pages = m;
+			pool->count++;
+		}
+		simple_unlock(&pool->lock);
+		vm_page_free_count -= n;
+		vm_page_free_lock_pages += n;
+	}
+#endif	/* NCPUS > 1 */
 	simple_unlock(&vm_page_queue_free_lock);
 
 	/*
@@ -1389,13 +1598,50 @@ out:
 void vm_page_release(
 	register vm_page_t	mem)
 {
+#if	NCPUS > 1
+	register struct vm_page_pool *pool = &vm_page_pool[cpu_number()];
+
+	/*
+	 *	Keep the page in this processor's pool, unless
+	 *	memory is short or someone is waiting for a page.
+	 */
+
+	if ((vm_page_free_count >= vm_page_free_min) &&
+	    (vm_page_free_wanted == 0)) {
+		simple_lock(&pool->lock);
+		if (pool->count < VM_PAGE_POOL_MAX) {
+			if (mem->free)
+				panic("vm_page_release");
+			mem->free = TRUE;
+			mem->pageq.next = (queue_entry_t) pool->pages;
+			pool->pages = mem;
+			pool->count++;
+			pool->releases++;
+			simple_unlock(&pool->lock);
+			return;
+		}
+		simple_unlock(&pool->lock);
+	}
+#endif	/* NCPUS > 1 */
+
 	simple_lock(&vm_page_queue_free_lock);
+	vm_page_free_lock_acquires++;
 	if (mem->free)
 		panic("vm_page_release");
 	mem->free = TRUE;
 	mem->pageq.next = (queue_entry_t) vm_page_queue_free;
 	vm_page_queue_free = mem;
 	vm_page_free_count++;
+	vm_page_free_lock_pages++;
+
+#if	NCPUS > 1
+	/*
+	 *	If the pool is full, return a batch with this page.
+	 */
+
+	if (pool->count >= VM_PAGE_POOL_MAX)
+		(void) vm_page_pool_flush(pool, VM_PAGE_POOL_BATCH);
+#endif	/* NCPUS > 1 */
 
 	/*
 	 *	Check if we should wake up someone waiting for page.
@@ -1615,6 +1861,63 @@ void vm_page_deactivate(
 	}
 }
 
+/*
+ *	vm_page_admit:
+ *
+ *	Put a page that has just been paged in on a pageout queue.
+ *	If its ghost entry shows that it was evicted recently, it
+ *	is activated; otherwise it goes on the inactive queue on
+ *	probation, and must be found used twice by the pageout
+ *	daemon before it is activated.
+ *
+ *	The page queues must be locked.
+ */
+
+void vm_page_admit(
+	register vm_page_t	m)
+{
+	register vm_page_ghost_t *ghost;
+
+	VM_PAGE_CHECK(m);
+
+	ghost = &vm_page_ghosts[vm_page_ghost_hash(m->object, m->offset)];
+	if ((ghost->object == m->object) && (ghost->offset == m->offset)) {
+		ghost->object = VM_OBJECT_NULL;
+		if (vm_page_evictions - ghost->evicted <=
+		    (unsigned int) vm_page_active_count) {
+			vm_page_ghost_hits++;
+			vm_page_activate(m);
+			return;
+		}
+	}
+
+	vm_page_deactivate(m);
+	if (m->inactive) {
+		m->probation = TRUE;
+		vm_page_probations++;
+	}
+}
+
+/*
+ *	vm_page_ghost_enter:
+ *
+ *	Record that the pageout daemon is evicting the page,
+ *	for vm_page_admit.
+ *
+ *	The page queues must be locked.
+ */
+
+void vm_page_ghost_enter(
+	register vm_page_t	m)
+{
+	register vm_page_ghost_t *ghost;
+
+	ghost = &vm_page_ghosts[vm_page_ghost_hash(m->object, m->offset)];
+	ghost->object = m->object;
+	ghost->offset = m->offset;
+	ghost->evicted = vm_page_evictions++;
+}
+
 /*
  *	vm_page_activate:
  *
@@ -1634,6 +1937,7 @@ void vm_page_activate(
 		vm_page_inactive_count--;
 		m->inactive = FALSE;
 	}
+	m->probation = FALSE;
 	if (m->wire_count == 0) {
 		if (m->active)
 			panic("vm_page_activate: already active");
@@ -1711,6 +2015,37 @@ vm_page_info(
 
 	return vm_page_bucket_count;
 }
+
+/*
+ *	Routine:	vm_page_free_info
+ *	Purpose:
+ *		Return the free list lock counts and the
+ *		state of the per-processor free page pools.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+vm_page_free_info(
+	vm_page_free_info_t *info)
+{
+#if	NCPUS > 1
+	int cpu;
+#endif	/* NCPUS > 1 */
+
+	bzero((char *) info, sizeof *info);
+	info->vpfi_free = vm_page_free_count;
+	info->vpfi_lock_acquires = vm_page_free_lock_acquires;
+	info->vpfi_lock_pages = vm_page_free_lock_pages;
+#if	NCPUS > 1
+	for (cpu = 0; cpu < NCPUS; cpu++) {
+		info->vpfi_pooled += vm_page_pool[cpu].count;
+		info->vpfi_pool_grabs += vm_page_pool[cpu].grabs;
+		info->vpfi_pool_releases += vm_page_pool[cpu].releases;
+	}
+	info->vpfi_pool_drains = vm_page_pool_drains;
+#endif	/* NCPUS > 1 */
+}
 #endif	/* MACH_VM_DEBUG */
 
 #include <mach_kdb.h>
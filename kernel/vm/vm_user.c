@@ -281,6 +281,39 @@ kern_return_t vm_inherit(map, start, size, new_inheritance)
 			      new_inheritance));
 }
 
+/*
+ *	vm_behavior_set sets the expected access pattern of the
+ *	specified range in the specified map.  It governs how many
+ *	pages vm_fault requests from the pager and maps at once.
+ *	WILLNEED and DONTNEED instead prefetch or release the
+ *	pages of the range.
+ */
+kern_return_t vm_behavior_set(map, start, size, new_behavior)
+	register vm_map_t	map;
+	vm_offset_t		start;
+	vm_size_t		size;
+	vm_behavior_t		new_behavior;
+{
+	if (map == VM_MAP_NULL)
+		return(KERN_INVALID_ARGUMENT);
+
+	switch (new_behavior) {
+	case VM_BEHAVIOR_DEFAULT:
+	case VM_BEHAVIOR_RANDOM:
+	case VM_BEHAVIOR_SEQUENTIAL:
+	case VM_BEHAVIOR_WILLNEED:
+	case VM_BEHAVIOR_DONTNEED:
+		break;
+	default:
+		return(KERN_INVALID_ARGUMENT);
+	}
+
+	return(vm_map_behavior_set(map,
+				   trunc_page(start),
+				   round_page(start+size),
+				   new_behavior));
+}
+
 /*
  *	vm_protect sets the protection of the specified range in the
  *	specified map.
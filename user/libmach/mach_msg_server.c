@@ -166,3 +166,141 @@ mach_msg_server(demux, max_size, rcv_name)
 	}
     }
 }
+
+/*
+ *	Routine:	mach_msg_server_batch
+ *	Purpose:
+ *		Like mach_msg_server, but receives with MACH_RCV_BATCH,
+ *		so a busy port or port set is drained several requests
+ *		per trap.  The receive buffer has room for "count"
+ *		requests of max_size bytes.  Replies are sent one at
+ *		a time as each request is handled.  A request after
+ *		the first that couldn't be received is dropped.
+ */
+
+mach_msg_return_t
+mach_msg_server_batch(demux, max_size, rcv_name, count)
+    boolean_t (*demux)();
+    mach_msg_size_t max_size;
+    mach_port_t rcv_name;
+    unsigned int count;
+{
+    register mach_msg_header_t *request, *next;
+    register mig_reply_header_t *bufReply;
+    mach_msg_header_t *bufRequest;
+    mach_msg_size_t rcv_size;
+    register mach_msg_return_t mr, last_mr;
+    char *end;
+
+    if (count == 0)
+	count = 1;
+    rcv_size = count * max_size + sizeof(mach_msg_header_t);
+
+    bufRequest = (mach_msg_header_t *) malloc(rcv_size);
+    if (bufRequest == 0)
+	return KERN_RESOURCE_SHORTAGE;
+    bufReply = (mig_reply_header_t *) malloc(max_size);
+    if (bufReply == 0)
+	return KERN_RESOURCE_SHORTAGE;
+    end = (char *) bufRequest + rcv_size;
+
+    for (;;) {
+	mr = mach_msg(bufRequest, MACH_RCV_MSG|MACH_RCV_BATCH,
+		      0, rcv_size, rcv_name,
+		      MACH_MSG_TIMEOUT_NONE, MACH_PORT_NULL);
+	if (mr == MACH_RCV_TOO_LARGE)
+	    /* the kernel destroyed the request */
+	    continue;
+	if (mr != MACH_MSG_SUCCESS)
+	    break;
+
+	for (request = bufRequest; request != 0; request = next) {
+	    /* find the next request and this one's status */
+
+	    next = MACH_MSG_BATCH_NEXT(request);
+	    last_mr = MACH_MSG_SUCCESS;
+	    if (end - (char *) next < sizeof(mach_msg_header_t))
+		next = 0;
+	    else if (next->msgh_size == 0) {
+		last_mr = next->msgh_id;
+		next = 0;
+	    }
+
+	    if (last_mr != MACH_MSG_SUCCESS) {
+		/* this request couldn't be received whole, and
+		   ends the batch; drop what rights it brought
+		   and keep serving */
+
+		if ((last_mr &~ MACH_MSG_MASK) == MACH_RCV_BODY_ERROR)
+		    mach_msg_destroy(request);
+		else if ((last_mr &~ MACH_MSG_MASK) ==
+						MACH_RCV_HEADER_ERROR) {
+		    /* only the header was copied out */
+		    request->msgh_bits &= ~MACH_MSGH_BITS_COMPLEX;
+		    mach_msg_destroy(request);
+		}
+		continue;
+	    }
+
+	    (void) (*demux)(request, &bufReply->Head);
+
+	    if (bufReply->RetCode != KERN_SUCCESS) {
+		if (bufReply->RetCode == MIG_NO_REPLY)
+		    continue;
+
+		if (bufReply->RetCode == MIG_DESTROY_REQUEST) {
+		    /* destroy request without sending a reply */
+
+		    mach_msg_destroy(request);
+		    continue;
+		}
+
+		/* don't destroy the reply port right,
+		   so we can send an error message */
+		request->msgh_remote_port = MACH_PORT_NULL;
+		mach_msg_destroy(request);
+	    }
+
+	    if (bufReply->Head.msgh_remote_port == MACH_PORT_NULL) {
+		/* no reply port, so destroy the reply */
+		if (bufReply->Head.msgh_bits & MACH_MSGH_BITS_COMPLEX)
+		    mach_msg_destroy(&bufReply->Head);
+
+		continue;
+	    }
+
+	    /* send the reply; see mach_msg_server about the timeout */
+
+	    mr = mach_msg(&bufReply->Head,
+			  (MACH_MSGH_BITS_REMOTE(bufReply->Head.msgh_bits) ==
+						MACH_MSG_TYPE_MOVE_SEND_ONCE) ?
+			  MACH_SEND_MSG : MACH_SEND_MSG|MACH_SEND_TIMEOUT,
+			  bufReply->Head.msgh_size, 0, MACH_PORT_NULL,
+			  0, MACH_PORT_NULL);
+	    switch (mr) {
+	      case MACH_MSG_SUCCESS:
+		break;
+
+	      case MACH_SEND_INVALID_DEST:
+	      case MACH_SEND_TIMED_OUT:
+		/* the reply can't be delivered, so destroy it */
+		mach_msg_destroy(&bufReply->Head);
+		break;
+
+	      default:
+		/* should only happen if the server is buggy */
+		next = 0;
+		break;
+	    }
+	}
+
+	if ((mr != MACH_MSG_SUCCESS) &&
+	    (mr != MACH_SEND_INVALID_DEST) &&
+	    (mr != MACH_SEND_TIMED_OUT))
+	    break;
+    }
+
+    free((char *) bufRequest);
+    free((char *) bufReply);
+    return mr;
+}
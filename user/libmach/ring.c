@@ -0,0 +1,278 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	ring.c
+ *
+ *	Producer and consumer sides of ring channels.
+ *	See mach/ring.h.
+ */
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <mach/port.h>
+#include <mach/ring.h>
+
+extern kern_return_t evc_wait();
+extern kern_return_t ring_signal();
+
+/*
+ *	Machine-dependent synchronization.
+ *
+ *	ring_barrier orders every earlier load and store before
+ *	every later one.  ring_order orders earlier stores before
+ *	later stores and earlier loads before later loads, which
+ *	machines that keep memory operations in order get for
+ *	free.  ring_cas atomically stores new in *p if *p is old,
+ *	and says whether it did.
+ *
+ *	Where there is no ring_cas, ring_send is safe only with
+ *	one producer per ring, and libmach must be built with
+ *	RING_SINGLE_PRODUCER to say so; see mach/ring.h.
+ */
+#if	defined(i386) && defined(__GNUC__)
+
+#define	ring_barrier()	\
+	__asm__ volatile("lock; addl $0, 0(%%esp)" : : : "memory")
+#define	ring_order()	__asm__ volatile("" : : : "memory")
+
+static __inline__ boolean_t
+ring_cas(p, old, new)
+    volatile natural_t *p;
+    natural_t old;
+    natural_t new;
+{
+    natural_t prev;
+
+    __asm__ volatile("lock; cmpxchgl %2, %1"
+		     : "=a" (prev), "+m" (*p)
+		     : "r" (new), "0" (old)
+		     : "memory");
+    return prev == old;
+}
+
+#else	/* defined(i386) && defined(__GNUC__) */
+#if	defined(alpha) && defined(__GNUC__)
+
+#define	ring_barrier()	__asm__ volatile("mb" : : : "memory")
+#define	ring_order()	ring_barrier()
+
+/*
+ *	ldl_l sign-extends the word it loads, so old is compared
+ *	sign-extended too.
+ */
+static __inline__ boolean_t
+ring_cas(p, old, new)
+    volatile natural_t *p;
+    natural_t old;
+    natural_t new;
+{
+    long prev, tmp;
+
+    __asm__ volatile("1:	ldl_l	%0, %2\n"
+		     "	cmpeq	%0, %3, %1\n"
+		     "	beq	%1, 2f\n"
+		     "	mov	%4, %1\n"
+		     "	stl_c	%1, %2\n"
+		     "	beq	%1, 1b\n"
+		     "	mb\n"
+		     "2:"
+		     : "=&r" (prev), "=&r" (tmp), "+m" (*p)
+		     : "r" ((long) (int) old), "r" ((long) new)
+		     : "memory");
+    return (natural_t) prev == old;
+}
+
+#else	/* defined(alpha) && defined(__GNUC__) */
+
+#ifndef	RING_SINGLE_PRODUCER
+#error	"no compare-and-swap for ring_send; build with -DRING_SINGLE_PRODUCER"
+#endif	/* RING_SINGLE_PRODUCER */
+
+#define	ring_barrier()
+#define	ring_order()
+#define	ring_cas(p, old, new)	(*(p) = (new), 1)
+
+#endif	/* defined(alpha) && defined(__GNUC__) */
+#endif	/* defined(i386) && defined(__GNUC__) */
+
+/*
+ *	The length word of the record at pos.  Records start on a
+ *	natural_t boundary and rh_size is a power of two, so the
+ *	word never wraps.
+ */
+#define	RING_WORD(rh, pos)	\
+	((volatile natural_t *) (RING_DATA(rh) + ((pos) & ((rh)->rh_size - 1))))
+
+/*
+ *	Copy between a buffer and the data area, which may wrap.
+ */
+static void
+ring_copyin(rh, pos, data, size)
+    register ring_header_t rh;
+    natural_t pos;
+    char *data;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bcopy(data, RING_DATA(rh) + off, n);
+    bcopy(data + n, RING_DATA(rh), size - n);
+}
+
+static void
+ring_copyout(rh, pos, data, size)
+    register ring_header_t rh;
+    natural_t pos;
+    char *data;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bcopy(RING_DATA(rh) + off, data, n);
+    bcopy(RING_DATA(rh), data + n, size - n);
+}
+
+static void
+ring_clear(rh, pos, size)
+    register ring_header_t rh;
+    natural_t pos;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bzero(RING_DATA(rh) + off, n);
+    bzero(RING_DATA(rh), size - n);
+}
+
+/*
+ *	Routine:	ring_send
+ *	Purpose:
+ *		Append a record to the ring, and wake the consumer
+ *		if it is asleep.  Returns KERN_NO_SPACE, without
+ *		waiting, if the ring is full.
+ *
+ *		Producers claim space by advancing rh_tail, fill it
+ *		in, and then commit it by storing its length word.
+ *		No producer waits for another.
+ */
+
+kern_return_t
+ring_send(ring, rh, data, size)
+    mach_port_t ring;
+    register ring_header_t rh;
+    char *data;
+    natural_t size;
+{
+    register natural_t start;
+    natural_t len = sizeof(natural_t) + RING_ALIGN(size);
+
+    do {
+	start = rh->rh_tail;
+	if (len > rh->rh_size - (start - rh->rh_head))
+	    return KERN_NO_SPACE;
+    } while (!ring_cas(&rh->rh_tail, start, start + len));
+
+    ring_copyin(rh, start + sizeof(natural_t), data, size);
+
+    /*
+     *	The record must be in the ring before the consumer can
+     *	see its length word.  The length word must be stored
+     *	before rh_sleeping is read; ring_receive does the
+     *	opposite, so one of the two sees the other's store.
+     */
+    ring_order();
+    *RING_WORD(rh, start) = size | RING_COMMITTED;
+    ring_barrier();
+
+    if (rh->rh_sleeping) {
+	rh->rh_sleeping = 0;
+	return ring_signal(ring);
+    }
+    return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	ring_receive
+ *	Purpose:
+ *		Remove the next record from the ring into data,
+ *		sleeping until there is one.  On return *sizep is
+ *		the size of the record.  If that is more than size,
+ *		KERN_NO_SPACE is returned and the record is left in
+ *		the ring.
+ */
+
+kern_return_t
+ring_receive(rh, data, size, sizep)
+    register ring_header_t rh;
+    char *data;
+    natural_t size;
+    natural_t *sizep;
+{
+    register natural_t head = rh->rh_head;
+    register volatile natural_t *word = RING_WORD(rh, head);
+    natural_t len;
+    kern_return_t kr;
+
+    while ((*word & RING_COMMITTED) == 0) {
+	rh->rh_sleeping = 1;
+	ring_barrier();
+	if (*word & RING_COMMITTED)
+	    break;
+	kr = evc_wait(rh->rh_evc);
+	if (kr != KERN_SUCCESS)
+	    return kr;
+    }
+    rh->rh_sleeping = 0;
+
+    /* read the length word before the record it covers */
+    ring_order();
+
+    len = *word & ~RING_COMMITTED;
+    *sizep = len;
+    if (len > size)
+	return KERN_NO_SPACE;
+    ring_copyout(rh, head + sizeof(natural_t), data, len);
+
+    /*
+     *	Zero the record, so that producers reusing the space
+     *	never leave a stale length word where a record starts,
+     *	and finish with it before they can reuse it.
+     */
+    len = sizeof(natural_t) + RING_ALIGN(len);
+    ring_clear(rh, head, len);
+    ring_order();
+    rh->rh_head = head + len;
+    return KERN_SUCCESS;
+}
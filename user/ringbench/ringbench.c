@@ -0,0 +1,460 @@
+/*
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ *
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ *
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * Carnegie Mellon requests users of this software to return to
+ *
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ *
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ *	File:	ringbench/ringbench.c
+ *
+ *	Times records through a ring channel on a host, with
+ *	threads for the producer and consumer tasks.  ring_send and
+ *	ring_receive are copied below from libmach/ring.c, and the
+ *	buffer layout from mach/ring.h.  gcc's __sync builtins
+ *	supply the compare-and-swap and barrier that the i386 code
+ *	does in assembler, and a condition variable stands in for
+ *	the ring's eventcount.
+ *
+ *		cc -O -o ringbench ringbench.c -lpthread
+ *		ringbench [producers [records]]
+ *
+ *	The "ring" lines pass "records" (default 1000000) 64-byte
+ *	records from one producer, and then from "producers"
+ *	(default 4) at once, through a 64KB ring.  There is no
+ *	Mach kernel on the host to time mach_msg against, so the
+ *	"pipe" line passes the same records through a pipe, a
+ *	write and a read per record, as the nearest measure of
+ *	a trap per record.  Every record is checked, and so is
+ *	that a producer which claims space and never commits it
+ *	holds up no other producer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+typedef int		boolean_t;
+typedef int		kern_return_t;
+typedef int		mach_port_t;
+typedef unsigned int	natural_t;
+
+#define	KERN_SUCCESS	0
+#define	KERN_NO_SPACE	3
+
+#define	bcopy(from, to, n)	memcpy((to), (from), (n))
+#define	bzero(p, n)		memset((p), 0, (n))
+
+/*
+ *	From mach/ring.h.
+ */
+typedef struct ring_header {
+	natural_t		rh_size;	/* size of data area */
+	natural_t		rh_evc;		/* eventcount for evc_wait */
+	volatile natural_t	rh_head;	/* bytes consumed */
+	volatile natural_t	rh_tail;	/* bytes claimed by producers */
+	volatile natural_t	rh_sleeping;	/* consumer in evc_wait */
+	natural_t		rh_reserved[3];
+} *ring_header_t;
+
+#define	RING_DATA(rh)		((char *) ((rh) + 1))
+
+#define	RING_ALIGN(n)		\
+	(((n) + sizeof(natural_t) - 1) &~ (sizeof(natural_t) - 1))
+
+#define	RING_COMMITTED		((natural_t) 1 << 31)	/* in length word */
+
+/*
+ *	The ring's eventcount.
+ */
+pthread_mutex_t	evc_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t	evc_cond = PTHREAD_COND_INITIALIZER;
+int		evc_count;
+long		signals;
+
+kern_return_t
+evc_wait(ev_id)
+	natural_t ev_id;
+{
+	pthread_mutex_lock(&evc_mutex);
+	while (evc_count == 0)
+		pthread_cond_wait(&evc_cond, &evc_mutex);
+	evc_count = 0;
+	pthread_mutex_unlock(&evc_mutex);
+	return KERN_SUCCESS;
+}
+
+kern_return_t
+ring_signal(ring)
+	mach_port_t ring;
+{
+	pthread_mutex_lock(&evc_mutex);
+	evc_count++;
+	signals++;
+	pthread_cond_signal(&evc_cond);
+	pthread_mutex_unlock(&evc_mutex);
+	return KERN_SUCCESS;
+}
+
+#define	ring_barrier()		__sync_synchronize()
+#define	ring_order()		__asm__ volatile("" : : : "memory")
+#define	ring_cas(p, old, new)	__sync_bool_compare_and_swap((p), (old), (new))
+
+#define	RING_WORD(rh, pos)	\
+	((volatile natural_t *) (RING_DATA(rh) + ((pos) & ((rh)->rh_size - 1))))
+
+/*
+ *	From libmach/ring.c.
+ */
+static void
+ring_copyin(rh, pos, data, size)
+    register ring_header_t rh;
+    natural_t pos;
+    char *data;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bcopy(data, RING_DATA(rh) + off, n);
+    bcopy(data + n, RING_DATA(rh), size - n);
+}
+
+static void
+ring_copyout(rh, pos, data, size)
+    register ring_header_t rh;
+    natural_t pos;
+    char *data;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bcopy(RING_DATA(rh) + off, data, n);
+    bcopy(RING_DATA(rh), data + n, size - n);
+}
+
+static void
+ring_clear(rh, pos, size)
+    register ring_header_t rh;
+    natural_t pos;
+    natural_t size;
+{
+    register natural_t off = pos & (rh->rh_size - 1);
+    register natural_t n = rh->rh_size - off;
+
+    if (n > size)
+	n = size;
+    bzero(RING_DATA(rh) + off, n);
+    bzero(RING_DATA(rh), size - n);
+}
+
+kern_return_t
+ring_send(ring, rh, data, size)
+    mach_port_t ring;
+    register ring_header_t rh;
+    char *data;
+    natural_t size;
+{
+    register natural_t start;
+    natural_t len = sizeof(natural_t) + RING_ALIGN(size);
+
+    do {
+	start = rh->rh_tail;
+	if (len > rh->rh_size - (start - rh->rh_head))
+	    return KERN_NO_SPACE;
+    } while (!ring_cas(&rh->rh_tail, start, start + len));
+
+    ring_copyin(rh, start + sizeof(natural_t), data, size);
+
+    ring_order();
+    *RING_WORD(rh, start) = size | RING_COMMITTED;
+    ring_barrier();
+
+    if (rh->rh_sleeping) {
+	rh->rh_sleeping = 0;
+	return ring_signal(ring);
+    }
+    return KERN_SUCCESS;
+}
+
+kern_return_t
+ring_receive(rh, data, size, sizep)
+    register ring_header_t rh;
+    char *data;
+    natural_t size;
+    natural_t *sizep;
+{
+    register natural_t head = rh->rh_head;
+    register volatile natural_t *word = RING_WORD(rh, head);
+    natural_t len;
+    kern_return_t kr;
+
+    while ((*word & RING_COMMITTED) == 0) {
+	rh->rh_sleeping = 1;
+	ring_barrier();
+	if (*word & RING_COMMITTED)
+	    break;
+	kr = evc_wait(rh->rh_evc);
+	if (kr != KERN_SUCCESS)
+	    return kr;
+    }
+    rh->rh_sleeping = 0;
+
+    ring_order();
+
+    len = *word & ~RING_COMMITTED;
+    *sizep = len;
+    if (len > size)
+	return KERN_NO_SPACE;
+    ring_copyout(rh, head + sizeof(natural_t), data, len);
+
+    len = sizeof(natural_t) + RING_ALIGN(len);
+    ring_clear(rh, head, len);
+    ring_order();
+    rh->rh_head = head + len;
+    return KERN_SUCCESS;
+}
+
+#define	RING_BYTES	(64 * 1024)	/* data area */
+#define	RECORD		64		/* bytes per record */
+#define	MAXPROD		64
+
+struct record {
+	natural_t	producer;
+	natural_t	seq;
+	char		fill[RECORD - 2 * sizeof(natural_t)];
+};
+
+ring_header_t	rh;
+long		records;		/* per producer */
+int		pipefd[2];
+
+void
+fail(what, r)
+	char *what;
+	struct record *r;
+{
+	fprintf(stderr, "ringbench: %s: producer %u record %u\n",
+		what, r->producer, r->seq);
+	exit(1);
+}
+
+void *
+producer(arg)
+	void *arg;
+{
+	struct record r;
+	long i;
+
+	memset(&r, 0, sizeof r);
+	r.producer = (natural_t) (long) arg;
+	for (i = 0; i < records; i++) {
+		r.seq = i;
+		r.fill[0] = (char) i;
+		while (ring_send(1, rh, (char *) &r, sizeof r) == KERN_NO_SPACE)
+			sched_yield();
+	}
+	return (0);
+}
+
+void *
+pipe_producer(arg)
+	void *arg;
+{
+	struct record r;
+	long i;
+
+	memset(&r, 0, sizeof r);
+	for (i = 0; i < records; i++) {
+		r.seq = i;
+		r.fill[0] = (char) i;
+		if (write(pipefd[1], (char *) &r, sizeof r) != sizeof r) {
+			perror("ringbench: write");
+			exit(1);
+		}
+	}
+	return (0);
+}
+
+void
+ring_reset()
+{
+	memset((char *) rh, 0, sizeof(struct ring_header) + RING_BYTES);
+	rh->rh_size = RING_BYTES;
+	evc_count = 0;
+	signals = 0;
+}
+
+double
+nsecs(start, end, count)
+	struct timeval *start, *end;
+	long count;
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000.0 +
+		(end->tv_usec - start->tv_usec)) * 1000.0 / count;
+}
+
+void
+run_ring(nprod)
+	int nprod;
+{
+	pthread_t threads[MAXPROD];
+	natural_t next[MAXPROD];
+	struct record r;
+	struct timeval start, end;
+	natural_t size;
+	long i, total;
+	double ns;
+
+	ring_reset();
+	total = records * nprod;
+	memset((char *) next, 0, sizeof next);
+
+	gettimeofday(&start, (struct timezone *) 0);
+	for (i = 0; i < nprod; i++)
+		pthread_create(&threads[i], 0, producer, (void *) i);
+	for (i = 0; i < total; i++) {
+		if (ring_receive(rh, (char *) &r, sizeof r, &size) != KERN_SUCCESS ||
+		    size != sizeof r)
+			fail("bad size", &r);
+		if (r.producer >= nprod || r.seq != next[r.producer] ||
+		    r.fill[0] != (char) r.seq)
+			fail("out of order", &r);
+		next[r.producer]++;
+	}
+	for (i = 0; i < nprod; i++)
+		pthread_join(threads[i], 0);
+	gettimeofday(&end, (struct timezone *) 0);
+
+	ns = nsecs(&start, &end, total);
+	printf("ring %3d %10.1f %12.0f %10ld\n", nprod, ns, 1e9 / ns, signals);
+}
+
+void
+run_pipe()
+{
+	pthread_t thread;
+	struct record r;
+	struct timeval start, end;
+	long i;
+	int n, got;
+	double ns;
+
+	if (pipe(pipefd) < 0) {
+		perror("ringbench: pipe");
+		exit(1);
+	}
+	gettimeofday(&start, (struct timezone *) 0);
+	pthread_create(&thread, 0, pipe_producer, (void *) 0);
+	for (i = 0; i < records; i++) {
+		for (got = 0; got < sizeof r; got += n)
+			if ((n = read(pipefd[0], (char *) &r + got,
+				      sizeof r - got)) <= 0) {
+				perror("ringbench: read");
+				exit(1);
+			}
+		if (r.seq != i || r.fill[0] != (char) i)
+			fail("out of order", &r);
+	}
+	pthread_join(thread, 0);
+	gettimeofday(&end, (struct timezone *) 0);
+	close(pipefd[0]);
+	close(pipefd[1]);
+
+	ns = nsecs(&start, &end, records);
+	printf("pipe %3d %10.1f %12.0f %10s\n", 1, ns, 1e9 / ns, "-");
+}
+
+/*
+ *	Claim space for a record and never commit it, as a producer
+ *	that dies in ring_send would.  Other producers must still
+ *	get their records in; the consumer waits at the claimed one
+ *	until it is committed.
+ */
+void
+check_stall()
+{
+	struct record r;
+	natural_t start, size;
+	long saved = records;
+	int i;
+
+	ring_reset();
+	start = rh->rh_tail;
+	rh->rh_tail = start + sizeof(natural_t) + sizeof r;
+
+	records = 16;
+	producer((void *) 1);		/* returns only if not held up */
+	records = saved;
+
+	memset(&r, 0, sizeof r);
+	r.producer = 0;
+	ring_copyin(rh, start + sizeof(natural_t), (char *) &r, sizeof r);
+	*RING_WORD(rh, start) = sizeof r | RING_COMMITTED;
+
+	for (i = 0; i < 17; i++) {
+		if (ring_receive(rh, (char *) &r, sizeof r, &size) != KERN_SUCCESS ||
+		    size != sizeof r)
+			fail("bad size after stall", &r);
+		if ((i == 0) ? (r.producer != 0)
+			     : (r.producer != 1 || r.seq != i - 1))
+			fail("out of order after stall", &r);
+	}
+}
+
+int
+main(argc, argv)
+	int argc;
+	char **argv;
+{
+	int nprod;
+
+	nprod = (argc > 1) ? atoi(argv[1]) : 4;
+	records = (argc > 2) ? atol(argv[2]) : 1000000;
+	if (nprod <= 0 || nprod > MAXPROD || records <= 0) {
+		fprintf(stderr, "usage: ringbench [producers [records]]\n");
+		exit(2);
+	}
+
+	rh = (ring_header_t) malloc(sizeof(struct ring_header) + RING_BYTES);
+	if (rh == 0) {
+		fprintf(stderr, "ringbench: out of memory\n");
+		exit(1);
+	}
+	check_stall();
+
+	printf("%4s %3s %10s %12s %10s\n",
+	       "", "thr", "ns/record", "records/s", "wakeups");
+	run_ring(1);
+	if (nprod > 1)
+		run_ring(nprod);
+	run_pipe();
+	exit(0);
+}
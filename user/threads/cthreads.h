@@ -535,6 +535,14 @@ extern mach_msg_return_t cthread_mach_msg(mach_msg_header_t *_header,
 					  mach_port_t _notify,
 					  int _min, int _max);
 
+extern mach_msg_return_t cthread_mach_msg_server(
+				boolean_t (*_demux)(mach_msg_header_t *,
+						    mach_msg_header_t *),
+				mach_msg_size_t _max_size,
+				mach_port_t _rcv_name,
+				int _min, int _max,
+				mach_msg_timeout_t _idle);
+
 extern void		cthread_fork_prepare(void);
 
 extern void		cthread_fork_parent(void);
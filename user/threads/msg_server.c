@@ -0,0 +1,266 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1993 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+/*
+ * 	File:	msg_server.c
+ *
+ *	A multi-threaded version of mach_msg_server.
+ */
+
+#include <cthreads.h>
+#include <mach/message.h>
+#include <mach/mig_errors.h>
+
+/*
+ * State shared by the workers of one server.  The counts
+ * are protected by the lock.  A worker counts as waiting
+ * from the time it is forked, or has finished a request,
+ * until it receives the next request.
+ */
+typedef struct msg_server {
+	struct mutex		lock;
+	boolean_t		(*demux)(mach_msg_header_t *,
+					 mach_msg_header_t *);
+	mach_msg_size_t		max_size;
+	mach_port_t		rcv_name;
+	int			min;		/* workers always kept */
+	int			max;		/* most workers ever */
+	mach_msg_timeout_t	idle;		/* ms before a spare exits */
+	int			workers;	/* workers running */
+	int			waiting;	/* workers waiting for requests */
+} *msg_server_t;
+
+static any_t msg_server_worker(any_t arg);
+
+/*
+ * Start one more worker.  The caller has already counted it
+ * in workers and waiting.
+ */
+static void
+msg_server_fork(msg_server_t s)
+{
+	cthread_detach(cthread_fork((cthread_fn_t) msg_server_worker,
+				    (any_t) s));
+}
+
+/*
+ * The worker loop.  Each worker owns its request and reply
+ * buffers for its whole life, and sends each reply and
+ * receives the next request in one mach_msg, so the kernel
+ * can take its RPC fast path.
+ *
+ * When the last waiting worker receives a request, there is
+ * nobody left to take the next one off the queue, so another
+ * worker is forked (up to max).  A worker above min that
+ * waits idle ms without a request exits.
+ */
+static any_t
+msg_server_worker(any_t arg)
+{
+	register msg_server_t s = (msg_server_t) arg;
+	register mig_reply_header_t *bufRequest, *bufReply, *bufTemp;
+	register mach_msg_return_t mr;
+	mach_msg_option_t option;
+	mach_msg_size_t send_size;
+	mach_msg_timeout_t timeout;
+	boolean_t grow;
+
+	bufRequest = (mig_reply_header_t *) malloc(s->max_size);
+	bufReply = (mig_reply_header_t *) malloc(s->max_size);
+	if ((bufRequest == 0) || (bufReply == 0)) {
+		mr = KERN_RESOURCE_SHORTAGE;
+		goto done;
+	}
+
+	option = MACH_RCV_MSG;
+	send_size = 0;
+
+	for (;;) {
+		/*
+		 *	Only spare workers time out.  The timeout
+		 *	also bounds a send that needs MACH_SEND_TIMEOUT,
+		 *	which is harmless: either way the send can't
+		 *	block indefinitely.
+		 */
+		if (s->workers > s->min) {
+			option |= MACH_RCV_TIMEOUT;
+			timeout = s->idle;
+		} else
+			timeout = 0;
+
+		mr = cthread_mach_msg(&bufRequest->Head, option,
+				      send_size, s->max_size, s->rcv_name,
+				      timeout, MACH_PORT_NULL,
+				      s->min, s->max);
+		option = MACH_RCV_MSG;
+		send_size = 0;
+
+		switch (mr) {
+		  case MACH_MSG_SUCCESS:
+			break;
+
+		  case MACH_RCV_TIMED_OUT:
+			mutex_lock(&s->lock);
+			if (s->workers > s->min) {
+				s->workers--;
+				s->waiting--;
+				mutex_unlock(&s->lock);
+				cthread_msg_busy(s->rcv_name, s->min, s->max);
+				free((char *) bufRequest);
+				free((char *) bufReply);
+				return (any_t) mr;
+			}
+			mutex_unlock(&s->lock);
+			continue;
+
+		  case MACH_SEND_INVALID_DEST:
+		  case MACH_SEND_TIMED_OUT:
+			/* the reply can't be delivered, so destroy it */
+			mach_msg_destroy(&bufRequest->Head);
+			continue;
+
+		  case MACH_RCV_TOO_LARGE:
+			/* the kernel destroyed the request */
+			continue;
+
+		  default:
+			/* should only happen if the server is buggy */
+			goto done;
+		}
+
+		/* we have a request message */
+
+		mutex_lock(&s->lock);
+		s->waiting--;
+		grow = (s->waiting == 0) && (s->workers < s->max);
+		if (grow) {
+			s->workers++;
+			s->waiting++;
+		}
+		mutex_unlock(&s->lock);
+		if (grow)
+			msg_server_fork(s);
+
+		/* let another thread receive while we work */
+		cthread_msg_busy(s->rcv_name, s->min, s->max);
+
+		(void) (*s->demux)(&bufRequest->Head, &bufReply->Head);
+
+		mutex_lock(&s->lock);
+		s->waiting++;
+		mutex_unlock(&s->lock);
+
+		if (bufReply->RetCode != KERN_SUCCESS) {
+			if (bufReply->RetCode == MIG_NO_REPLY)
+				continue;
+
+			if (bufReply->RetCode == MIG_DESTROY_REQUEST) {
+				/* destroy request without sending a reply */
+
+				mach_msg_destroy(&bufRequest->Head);
+				continue;
+			}
+
+			/* don't destroy the reply port right,
+			   so we can send an error message */
+			bufRequest->Head.msgh_remote_port = MACH_PORT_NULL;
+			mach_msg_destroy(&bufRequest->Head);
+		}
+
+		if (bufReply->Head.msgh_remote_port == MACH_PORT_NULL) {
+			/* no reply port, so destroy the reply */
+			if (bufReply->Head.msgh_bits & MACH_MSGH_BITS_COMPLEX)
+				mach_msg_destroy(&bufReply->Head);
+			continue;
+		}
+
+		/* send reply with the next receive; see mach_msg_server */
+
+		bufTemp = bufRequest;
+		bufRequest = bufReply;
+		bufReply = bufTemp;
+
+		option = (MACH_MSGH_BITS_REMOTE(bufRequest->Head.msgh_bits) ==
+						MACH_MSG_TYPE_MOVE_SEND_ONCE) ?
+			 MACH_SEND_MSG|MACH_RCV_MSG :
+			 MACH_SEND_MSG|MACH_SEND_TIMEOUT|MACH_RCV_MSG;
+		send_size = bufRequest->Head.msgh_size;
+	}
+
+    done:
+	mutex_lock(&s->lock);
+	s->workers--;
+	s->waiting--;
+	mutex_unlock(&s->lock);
+	cthread_msg_busy(s->rcv_name, s->min, s->max);
+	if (bufRequest != 0)
+		free((char *) bufRequest);
+	if (bufReply != 0)
+		free((char *) bufReply);
+	return (any_t) mr;
+}
+
+/*
+ *	Routine:	cthread_mach_msg_server
+ *	Purpose:
+ *		Like mach_msg_server, but serves rcv_name (usually
+ *		a port set) with between min and max cthreads.
+ *		Workers are added while requests arrive faster than
+ *		the waiting workers take them, and a worker above
+ *		min exits after idle ms without a request.  The
+ *		calling thread becomes a worker; it returns only
+ *		if its own receive fails, leaving the others running.
+ */
+mach_msg_return_t
+cthread_mach_msg_server(boolean_t (*demux)(mach_msg_header_t *,
+					   mach_msg_header_t *),
+			mach_msg_size_t max_size, mach_port_t rcv_name,
+			int min, int max, mach_msg_timeout_t idle)
+{
+	register msg_server_t s;
+
+	if (min < 1)
+		min = 1;
+	if (max < min)
+		max = min;
+
+	s = (msg_server_t) malloc(sizeof(struct msg_server));
+	if (s == 0)
+		return KERN_RESOURCE_SHORTAGE;
+	mutex_init(&s->lock);
+	s->demux = demux;
+	s->max_size = max_size;
+	s->rcv_name = rcv_name;
+	s->min = min;
+	s->max = max;
+	s->idle = idle;
+	s->workers = min;
+	s->waiting = min;
+
+	while (--min > 0)
+		msg_server_fork(s);
+
+	return (mach_msg_return_t) msg_server_worker((any_t) s);
+}